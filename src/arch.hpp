@@ -3,5 +3,12 @@
 
 #define LSB_TRAP_MASK 0xffffffffffffff00ull
 #define TRAP_BYTE 0xcc
+#define ENDBR64 "\xf3\x0f\x1e\xfa"
+#define PUSH_RBP 0x55
+#define MOV_RBP_RSP "\x48\x89\xe5"
+#define LSB_SYSCALL_MASK 0xffffffffffff0000ull
+#define SYSCALL_INSN 0x050f // `syscall` read as a little-endian word
+#define JMP_REL32 0xe9
+#define NOP_BYTE 0x90
 
 #endif
\ No newline at end of file
@@ -0,0 +1,229 @@
+/*
+    Benchmarks of the stop path of the debugger on the fixture programs in
+    src/fixtures. Every benchmark runs a batch session with `-ex` commands
+    and takes the time of the measured command from the statistics of the
+    debugger, so the launch of the fixture is not counted. Compare runs with
+    --benchmark_format=json or --benchmark_out=<file>.
+*/
+#include "cfg.hpp"
+#include "debugger.hpp"
+#include "elfinfo.hpp"
+#include "stats.hpp"
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define BENCH_HITS 2000
+#define BENCH_STEPS 5000
+#define BENCH_QUERIES 200
+#define BENCH_DUMPS 4
+// Sessions per benchmark, a fixed number keeps runs comparable
+#define BENCH_SESSIONS 5
+// The size of bench_buffer in bigstruct.c
+#define BENCH_BUFFER_SIZE (64 << 20)
+
+/**
+ * @brief Retrieves the address of a symbol of a non-PIE fixture.
+ */
+static uint64_t symbol_address(const char *fixture, const char *name,
+                               bool object = false) {
+    ElfInfo elf(fixture);
+    const elf_symbol *sym =
+        object ? elf.lookup_object(name) : elf.lookup_function(name);
+    return sym != nullptr ? sym->addr : 0;
+}
+
+/**
+ * @brief Formats a hex address for a command line.
+ */
+static std::string hex(uint64_t value) {
+    std::ostringstream out;
+    out << std::hex << value;
+    return out.str();
+}
+
+/**
+ * @brief Runs a batch session on a fixture with the output discarded.
+ *
+ * @param fixture The fixture program.
+ * @param commands The command lines.
+ */
+static void run_session(const char *fixture,
+                        const std::vector<std::string> &commands) {
+    std::vector<std::string> args = {"debugrik_bench", fixture};
+    for (auto &cmd: commands) {
+        args.push_back(CFG_COMMAND_OPTION);
+        args.push_back(cmd);
+    }
+    std::vector<char *> argv;
+    for (auto &arg: args) {
+        argv.push_back(&arg[0]);
+    }
+    Configuration cfg(argv.size(), argv.data());
+
+    std::cout.flush();
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    pid_t pid = -1;
+    Debugger dbg(cfg);
+    dbg.start(&pid);
+    dbg.kill_target();
+
+    std::cout.flush();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    if (pid > 0) {
+        waitpid(pid, nullptr, __WALL);
+    }
+}
+
+/**
+ * @brief Runs a session per iteration and reports the time of one command.
+ *
+ * @param state The benchmark state, manual time.
+ * @param fixture The fixture program.
+ * @param commands The command lines.
+ * @param cmd The measured command.
+ * @return The number of times the command ran.
+ */
+static uint64_t measure(benchmark::State &state, const char *fixture,
+                        const std::vector<std::string> &commands,
+                        const char *cmd) {
+    uint64_t runs = 0;
+    stats_histogram all = {};
+    for (auto _: state) {
+        global_stats.reset();
+        run_session(fixture, commands);
+        auto it = global_stats.commands().find(cmd);
+        if (it == global_stats.commands().end() || it->second.count == 0) {
+            state.SkipWithError("the command did not run");
+            return 0;
+        }
+        state.SetIterationTime(it->second.total_ns / 1e9);
+        runs += it->second.count;
+        for (int i = 0; i < STATS_BUCKETS; i++) {
+            all.buckets[i] += it->second.buckets[i];
+        }
+        all.count += it->second.count;
+        all.max_ns = std::max(all.max_ns, it->second.max_ns);
+    }
+    state.counters["p99_us"] = all.percentile(0.99) / 1000.0;
+    state.counters["max_us"] = all.max_ns / 1000.0;
+    return runs;
+}
+
+static void BM_BreakpointHits(benchmark::State &state) {
+    uint64_t addr = symbol_address(BENCH_FIXTURE_LOOP, "bench_hit");
+    uint64_t hits =
+        measure(state, BENCH_FIXTURE_LOOP,
+                {"b " + hex(addr), "r",
+                 "repeat " + std::to_string(BENCH_HITS) + " c"},
+                "c");
+    state.SetItemsProcessed(hits);
+}
+BENCHMARK(BM_BreakpointHits)
+    ->UseManualTime()
+    ->Iterations(BENCH_SESSIONS)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_BreakpointHitsThreads(benchmark::State &state) {
+    uint64_t addr = symbol_address(BENCH_FIXTURE_THREADS, "bench_hit");
+    uint64_t hits =
+        measure(state, BENCH_FIXTURE_THREADS,
+                {"b " + hex(addr), "r",
+                 "repeat " + std::to_string(BENCH_HITS) + " c"},
+                "c");
+    state.SetItemsProcessed(hits);
+}
+BENCHMARK(BM_BreakpointHitsThreads)
+    ->UseManualTime()
+    ->Iterations(BENCH_SESSIONS)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SingleSteps(benchmark::State &state) {
+    uint64_t addr = symbol_address(BENCH_FIXTURE_LOOP, "bench_hit");
+    uint64_t steps =
+        measure(state, BENCH_FIXTURE_LOOP,
+                {"b " + hex(addr), "r",
+                 "repeat " + std::to_string(BENCH_STEPS) + " s"},
+                "s");
+    state.SetItemsProcessed(steps);
+}
+BENCHMARK(BM_SingleSteps)
+    ->UseManualTime()
+    ->Iterations(BENCH_SESSIONS)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_Disassemble(benchmark::State &state) {
+    uint64_t addr = symbol_address(BENCH_FIXTURE_RECURSION, "bench_bottom");
+    uint64_t runs =
+        measure(state, BENCH_FIXTURE_RECURSION,
+                {"b " + hex(addr), "r",
+                 "repeat " + std::to_string(BENCH_QUERIES) + " dis"},
+                "dis");
+    state.SetItemsProcessed(runs);
+}
+BENCHMARK(BM_Disassemble)
+    ->UseManualTime()
+    ->Iterations(BENCH_SESSIONS)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_Backtrace(benchmark::State &state) {
+    uint64_t addr = symbol_address(BENCH_FIXTURE_RECURSION, "bench_bottom");
+    uint64_t runs =
+        measure(state, BENCH_FIXTURE_RECURSION,
+                {"b " + hex(addr), "r",
+                 "repeat " + std::to_string(BENCH_QUERIES) + " bt"},
+                "bt");
+    state.SetItemsProcessed(runs);
+}
+BENCHMARK(BM_Backtrace)
+    ->UseManualTime()
+    ->Iterations(BENCH_SESSIONS)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_InfoLocals(benchmark::State &state) {
+    uint64_t addr = symbol_address(BENCH_FIXTURE_BIGSTRUCT, "bench_stop");
+    uint64_t runs =
+        measure(state, BENCH_FIXTURE_BIGSTRUCT,
+                {"b " + hex(addr), "r",
+                 "repeat " + std::to_string(BENCH_QUERIES) + " il"},
+                "il");
+    state.SetItemsProcessed(runs);
+}
+BENCHMARK(BM_InfoLocals)
+    ->UseManualTime()
+    ->Iterations(BENCH_SESSIONS)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_MemoryBandwidth(benchmark::State &state) {
+    uint64_t stop = symbol_address(BENCH_FIXTURE_BIGSTRUCT, "bench_stop");
+    uint64_t buffer =
+        symbol_address(BENCH_FIXTURE_BIGSTRUCT, "bench_buffer", true);
+    std::string dump = "dump " + hex(buffer) + " " + hex(BENCH_BUFFER_SIZE) +
+                       " /dev/null raw";
+    uint64_t dumps =
+        measure(state, BENCH_FIXTURE_BIGSTRUCT,
+                {"b " + hex(stop), "r",
+                 "repeat " + std::to_string(BENCH_DUMPS) + " " + dump},
+                "dump");
+    state.SetBytesProcessed(dumps * BENCH_BUFFER_SIZE);
+}
+BENCHMARK(BM_MemoryBandwidth)
+    ->UseManualTime()
+    ->Iterations(BENCH_SESSIONS)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
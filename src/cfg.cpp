@@ -1,18 +1,80 @@
 #include "cfg.hpp"
 #include "utils.hpp"
 
+#include <string.h>
+
 const char *Configuration::get_path() { return path; }
 
+const char *Configuration::get_core_path() { return core_path; }
+
+bool Configuration::is_mi() { return mi; }
+
+const char *Configuration::get_mi_socket() { return mi_socket; }
+
+const std::vector<std::string> &Configuration::get_batch() { return batch; }
+
+const char *Configuration::get_gdbserver() { return gdbserver; }
+
+const std::vector<std::string> &Configuration::get_debug_dirs() {
+    return debug_dirs;
+}
+
+const char *Configuration::get_stats_json() { return stats_json; }
+
 bool Configuration::validate() { return access(path, F_OK) != -1; }
 
-Configuration::Configuration(int argc, char **argv) {
-    if (argc != 2) {
-        printf("Usage: %s PATH\n", argv[0]);
+Configuration::Configuration(int argc, char **argv)
+    : path(nullptr), core_path(nullptr), mi(false), mi_socket(nullptr),
+      gdbserver(nullptr), stats_json(nullptr) {
+    bool ok = argc >= 2;
+    for (int i = 2; ok && i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], CFG_CORE_OPTION) == 0 && has_value) {
+            core_path = argv[++i];
+        } else if (strcmp(argv[i], CFG_MI_OPTION) == 0) {
+            mi = true;
+        } else if (strcmp(argv[i], CFG_MI_SOCKET_OPTION) == 0 && has_value) {
+            mi = true;
+            mi_socket = argv[++i];
+        } else if (strcmp(argv[i], CFG_SCRIPT_OPTION) == 0 && has_value) {
+            if (access(argv[++i], R_OK) == -1) {
+                panic("bad script (not found)");
+            }
+            batch.push_back(std::string("source ") + argv[i]);
+        } else if (strcmp(argv[i], CFG_COMMAND_OPTION) == 0 && has_value) {
+            batch.push_back(argv[++i]);
+        } else if (strcmp(argv[i], CFG_GDBSERVER_OPTION) == 0 && has_value) {
+            gdbserver = argv[++i];
+        } else if (strcmp(argv[i], CFG_DEBUG_DIR_OPTION) == 0 && has_value) {
+            debug_dirs.push_back(argv[++i]);
+        } else if (strcmp(argv[i], CFG_STATS_JSON_OPTION) == 0 && has_value) {
+            stats_json = argv[++i];
+        } else {
+            ok = false;
+        }
+    }
+    // The remote interfaces drive a live process only and take no script
+    bool remote = mi || gdbserver != nullptr;
+    if (!ok || (mi && gdbserver != nullptr) ||
+        (remote && (core_path != nullptr || !batch.empty()))) {
+        printf("Usage: %s PATH [" CFG_CORE_OPTION " CORE] [" CFG_SCRIPT_OPTION
+               " SCRIPT]... [" CFG_COMMAND_OPTION " COMMAND]...\n"
+               "       [" CFG_DEBUG_DIR_OPTION " DIR]... [" CFG_STATS_JSON_OPTION
+               " FILE]\n"
+               "       %s PATH " CFG_MI_OPTION " | " CFG_MI_SOCKET_OPTION
+               " SOCKET | " CFG_GDBSERVER_OPTION " [HOST]:PORT\n",
+               argv[0], argv[0]);
         panic("incorrect parameters");
+        return;
     }
 
+    debug_dirs.push_back(CFG_DEFAULT_DEBUG_DIR);
     path = argv[1];
     if (!validate()) {
         panic("bad target (not found)");
     }
-}
\ No newline at end of file
+
+    if (core_path != nullptr && access(core_path, F_OK) == -1) {
+        panic("bad core file (not found)");
+    }
+}
@@ -1,7 +1,19 @@
 #ifndef CFG_H
 #define CFG_H
 
+#include <string>
 #include <unistd.h>
+#include <vector>
+
+#define CFG_CORE_OPTION "--core"
+#define CFG_MI_OPTION "--mi"
+#define CFG_MI_SOCKET_OPTION "--mi-socket"
+#define CFG_SCRIPT_OPTION "-x"
+#define CFG_COMMAND_OPTION "-ex"
+#define CFG_GDBSERVER_OPTION "--gdbserver"
+#define CFG_DEBUG_DIR_OPTION "--debug-dir"
+#define CFG_STATS_JSON_OPTION "--stats-json"
+#define CFG_DEFAULT_DEBUG_DIR "/usr/lib/debug"
 
 /**
  * @brief The Configuration class represents the configuration settings for the
@@ -11,6 +23,13 @@
  */
 class Configuration {
     const char *path;
+    const char *core_path;
+    bool mi;
+    const char *mi_socket;
+    std::vector<std::string> batch;
+    const char *gdbserver;
+    std::vector<std::string> debug_dirs;
+    const char *stats_json;
 
   private:
     /**
@@ -39,6 +58,59 @@ class Configuration {
      * @return The configuration path as a null-terminated string.
      */
     const char *get_path();
+
+    /**
+     * @brief Gets the path of the core file to analyze.
+     *
+     * @return The core file path or nullptr to debug a live process.
+     */
+    const char *get_core_path();
+
+    /**
+     * @brief Checks whether the debugger is driven through the machine
+     * interface.
+     *
+     * @return true for `--mi` and `--mi-socket`.
+     */
+    bool is_mi();
+
+    /**
+     * @brief Gets the path of the Unix socket of the machine interface.
+     *
+     * @return The socket path or nullptr to use stdin and stdout.
+     */
+    const char *get_mi_socket();
+
+    /**
+     * @brief Gets the command lines given with `-x` and `-ex`, in order.
+     *
+     * A script is given as a `source` command.
+     *
+     * @return The command lines, empty for an interactive session.
+     */
+    const std::vector<std::string> &get_batch();
+
+    /**
+     * @brief Gets the address to serve the GDB remote protocol on.
+     *
+     * @return `[host]:port` or nullptr.
+     */
+    const char *get_gdbserver();
+
+    /**
+     * @brief Gets the directories to look for separate debug info in.
+     *
+     * @return The `--debug-dir` directories in order, then the default one.
+     */
+    const std::vector<std::string> &get_debug_dirs();
+
+    /**
+     * @brief Gets the file to write the statistics of the debugger to at
+     * exit.
+     *
+     * @return The path or nullptr.
+     */
+    const char *get_stats_json();
 };
 
 #endif
\ No newline at end of file
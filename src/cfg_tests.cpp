@@ -38,4 +38,126 @@ TEST(ConfigTestSuite, cfg_bad_file_specified) {
     Configuration cfg(argc, argv);
     ASSERT_TRUE(strcmp(cfg.get_path(), TEST_PATH_CORRECT) != 0);
     ASSERT_TRUE(panic_triggered);
-}
\ No newline at end of file
+}
+
+TEST(ConfigTestSuite, cfg_load_core_file) {
+    int argc = 4;
+    char *argv[argc];
+
+    argv[0] = strdup("testik");
+    argv[1] = strdup(TEST_PATH_CORRECT);
+    argv[2] = strdup(CFG_CORE_OPTION);
+    argv[3] = strdup(TEST_PATH_CORRECT);
+
+    panic_triggered = false;
+    Configuration cfg(argc, argv);
+    ASSERT_FALSE(panic_triggered);
+    ASSERT_TRUE(strcmp(cfg.get_core_path(), TEST_PATH_CORRECT) == 0);
+}
+
+TEST(ConfigTestSuite, cfg_machine_interface) {
+    int argc = 4;
+    char *argv[argc];
+
+    argv[0] = strdup("testik");
+    argv[1] = strdup(TEST_PATH_CORRECT);
+    argv[2] = strdup(CFG_MI_SOCKET_OPTION);
+    argv[3] = strdup("/tmp/dbg.sock");
+
+    panic_triggered = false;
+    Configuration cfg(argc, argv);
+    ASSERT_FALSE(panic_triggered);
+    ASSERT_TRUE(cfg.is_mi());
+    ASSERT_TRUE(strcmp(cfg.get_mi_socket(), "/tmp/dbg.sock") == 0);
+    ASSERT_TRUE(cfg.get_core_path() == nullptr);
+}
+
+TEST(ConfigTestSuite, cfg_unknown_option) {
+    int argc = 3;
+    char *argv[argc];
+
+    argv[0] = strdup("testik");
+    argv[1] = strdup(TEST_PATH_CORRECT);
+    argv[2] = strdup("--bogus");
+
+    panic_triggered = false;
+    Configuration cfg(argc, argv);
+    ASSERT_TRUE(panic_triggered);
+}
+
+TEST(ConfigTestSuite, cfg_batch_commands) {
+    int argc = 6;
+    char *argv[argc];
+
+    argv[0] = strdup("testik");
+    argv[1] = strdup(TEST_PATH_CORRECT);
+    argv[2] = strdup(CFG_COMMAND_OPTION);
+    argv[3] = strdup("b 401136");
+    argv[4] = strdup(CFG_SCRIPT_OPTION);
+    argv[5] = strdup(TEST_PATH_CORRECT);
+
+    panic_triggered = false;
+    Configuration cfg(argc, argv);
+    ASSERT_FALSE(panic_triggered);
+    ASSERT_EQ(cfg.get_batch().size(), 2u);
+    ASSERT_EQ(cfg.get_batch()[0], "b 401136");
+    ASSERT_EQ(cfg.get_batch()[1], "source " TEST_PATH_CORRECT);
+}
+
+TEST(ConfigTestSuite, cfg_gdbserver_excludes_core) {
+    int argc = 6;
+    char *argv[argc];
+
+    argv[0] = strdup("testik");
+    argv[1] = strdup(TEST_PATH_CORRECT);
+    argv[2] = strdup(CFG_GDBSERVER_OPTION);
+    argv[3] = strdup(":1234");
+    argv[4] = strdup(CFG_CORE_OPTION);
+    argv[5] = strdup(TEST_PATH_CORRECT);
+
+    panic_triggered = false;
+    Configuration cfg(4, argv);
+    ASSERT_FALSE(panic_triggered);
+    ASSERT_TRUE(strcmp(cfg.get_gdbserver(), ":1234") == 0);
+
+    Configuration bad(argc, argv);
+    ASSERT_TRUE(panic_triggered);
+}
+
+TEST(ConfigTestSuite, cfg_debug_dirs) {
+    int argc = 6;
+    char *argv[argc];
+
+    argv[0] = strdup("testik");
+    argv[1] = strdup(TEST_PATH_CORRECT);
+    argv[2] = strdup(CFG_DEBUG_DIR_OPTION);
+    argv[3] = strdup("/opt/debug");
+    argv[4] = strdup(CFG_DEBUG_DIR_OPTION);
+    argv[5] = strdup("/srv/debug");
+
+    panic_triggered = false;
+    Configuration cfg(argc, argv);
+    ASSERT_FALSE(panic_triggered);
+    ASSERT_EQ(cfg.get_debug_dirs().size(), 3u);
+    ASSERT_EQ(cfg.get_debug_dirs()[0], "/opt/debug");
+    ASSERT_EQ(cfg.get_debug_dirs()[1], "/srv/debug");
+    ASSERT_EQ(cfg.get_debug_dirs()[2], CFG_DEFAULT_DEBUG_DIR);
+}
+
+TEST(ConfigTestSuite, cfg_stats_json) {
+    int argc = 4;
+    char *argv[argc];
+
+    argv[0] = strdup("testik");
+    argv[1] = strdup(TEST_PATH_CORRECT);
+    argv[2] = strdup(CFG_STATS_JSON_OPTION);
+    argv[3] = strdup("/tmp/stats.json");
+
+    panic_triggered = false;
+    Configuration cfg(argc, argv);
+    ASSERT_FALSE(panic_triggered);
+    ASSERT_TRUE(strcmp(cfg.get_stats_json(), "/tmp/stats.json") == 0);
+
+    Configuration none(2, argv);
+    ASSERT_TRUE(none.get_stats_json() == nullptr);
+}
@@ -0,0 +1,122 @@
+#include "coverage.hpp"
+#include "arch.hpp"
+
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+
+/**
+ * @brief A basic block entry of the drcov BB table.
+ */
+struct drcov_bb {
+    uint32_t start;
+    uint16_t size;
+    uint16_t mod_id;
+} __attribute__((packed));
+
+Coverage::Coverage(std::vector<uint64_t> leaders, uint64_t end)
+    : addrs(std::move(leaders)) {
+    sizes.resize(addrs.size());
+    for (size_t i = 0; i < addrs.size(); i++) {
+        uint64_t next = i + 1 < addrs.size() ? addrs[i + 1] : end;
+        sizes[i] = std::min<uint64_t>(next - addrs[i], COVERAGE_MAX_BLOCK);
+    }
+    orig.resize(addrs.size());
+    bitmap.resize((addrs.size() + 63) / 64);
+}
+
+bool Coverage::patch(int mem_fd, bool trap) {
+    std::vector<uint8_t> buf;
+    size_t i = 0;
+    while (i < addrs.size()) {
+        size_t j = i;
+        while (j + 1 < addrs.size() &&
+               addrs[j + 1] - addrs[j] <= COVERAGE_MAX_GAP) {
+            j++;
+        }
+
+        uint64_t start = addrs[i];
+        size_t len = addrs[j] - start + 1;
+        buf.resize(len);
+        if (pread(mem_fd, buf.data(), len, start) != (ssize_t)len) {
+            return false;
+        }
+
+        for (size_t k = i; k <= j; k++) {
+            // Traps of covered blocks are already gone
+            if (bitmap[k / 64] & (1ull << (k % 64))) {
+                continue;
+            }
+            uint8_t &byte = buf[addrs[k] - start];
+            if (trap) {
+                orig[k] = byte;
+                byte = TRAP_BYTE;
+            } else {
+                byte = orig[k];
+            }
+        }
+
+        if (pwrite(mem_fd, buf.data(), len, start) != (ssize_t)len) {
+            return false;
+        }
+        i = j + 1;
+    }
+    return true;
+}
+
+bool Coverage::arm(int mem_fd) { return patch(mem_fd, true); }
+
+bool Coverage::disarm(int mem_fd) { return patch(mem_fd, false); }
+
+bool Coverage::hit(int mem_fd, uint64_t addr) {
+    auto it = std::lower_bound(addrs.begin(), addrs.end(), addr);
+    if (it == addrs.end() || *it != addr) {
+        return false;
+    }
+
+    size_t idx = it - addrs.begin();
+    if (bitmap[idx / 64] & (1ull << (idx % 64))) {
+        return false;
+    }
+    bitmap[idx / 64] |= 1ull << (idx % 64);
+    return pwrite(mem_fd, &orig[idx], 1, addr) == 1;
+}
+
+size_t Coverage::blocks() { return addrs.size(); }
+
+size_t Coverage::covered() {
+    size_t total = 0;
+    for (uint64_t word: bitmap) {
+        total += __builtin_popcountll(word);
+    }
+    return total;
+}
+
+bool Coverage::write_drcov(const char *path, const std::string &module,
+                           uint64_t base, uint64_t end) {
+    FILE *out = fopen(path, "wb");
+    if (out == nullptr) {
+        return false;
+    }
+
+    fprintf(out, "DRCOV VERSION: 2\n"
+                 "DRCOV FLAVOR: debugrik\n"
+                 "Module Table: version 2, count 1\n"
+                 "Columns: id, base, end, entry, checksum, timestamp, path\n");
+    fprintf(out,
+            " 0, 0x%016llx, 0x%016llx, 0x0000000000000000, 0x00000000, "
+            "0x00000000, %s\n",
+            (unsigned long long)base, (unsigned long long)end,
+            module.c_str());
+    fprintf(out, "BB Table: %zu bbs\n", covered());
+
+    for (size_t i = 0; i < addrs.size(); i++) {
+        if (!(bitmap[i / 64] & (1ull << (i % 64)))) {
+            continue;
+        }
+        drcov_bb bb = {(uint32_t)(addrs[i] - base), sizes[i], 0};
+        fwrite(&bb, sizeof(bb), 1, out);
+    }
+
+    return fclose(out) == 0;
+}
@@ -0,0 +1,108 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define COVERAGE_DEFAULT_OUTPUT "coverage.drcov"
+// Blocks further apart are patched with separate writes
+#define COVERAGE_MAX_GAP (1 << 20)
+#define COVERAGE_MAX_BLOCK 0xffff
+
+/**
+ * @brief The Coverage class keeps one-shot breakpoints planted at the starts
+ * of basic blocks and the bitmap of the blocks that were executed.
+ *
+ * All traps are written and removed in bulk through `/proc/<pid>/mem`, a
+ * trap hit is removed for good, so the target converges to native speed.
+ */
+class Coverage {
+  public:
+    /**
+     * @brief Constructs a `Coverage` object for the given blocks.
+     *
+     * @param leaders Run-time addresses of the block starts, sorted and unique.
+     * @param end The address past the last block.
+     */
+    Coverage(std::vector<uint64_t> leaders, uint64_t end);
+
+    /**
+     * @brief Writes the trap byte at every block start.
+     *
+     * @param mem_fd `/proc/<pid>/mem` of the target.
+     * @return false if the memory can not be patched.
+     */
+    bool arm(int mem_fd);
+
+    /**
+     * @brief Restores the original bytes of the blocks that were not hit.
+     *
+     * @param mem_fd `/proc/<pid>/mem` of the target.
+     * @return false if the memory can not be patched.
+     */
+    bool disarm(int mem_fd);
+
+    /**
+     * @brief Marks the block starting at the given address as covered and
+     * removes its trap.
+     *
+     * @param mem_fd `/proc/<pid>/mem` of the target.
+     * @param addr The address of the hit trap.
+     * @return false if there is no block at the address.
+     */
+    bool hit(int mem_fd, uint64_t addr);
+
+    /**
+     * @brief Returns the number of blocks.
+     */
+    size_t blocks();
+
+    /**
+     * @brief Returns the number of covered blocks.
+     */
+    size_t covered();
+
+    /**
+     * @brief Writes the covered blocks in drcov format.
+     *
+     * @param path The output file.
+     * @param module The path of the covered module.
+     * @param base The run-time address the module is loaded at.
+     * @param end The address past the end of the module.
+     * @return false if the file can not be written.
+     */
+    bool write_drcov(const char *path, const std::string &module,
+                     uint64_t base, uint64_t end);
+
+  private:
+    /**
+     * @brief Reads the original bytes and writes them back with the given
+     * blocks replaced by the trap byte, one read and one write per run of
+     * close blocks.
+     *
+     * @param mem_fd `/proc/<pid>/mem` of the target.
+     * @param trap Whether to put traps or original bytes.
+     * @return false if the memory can not be patched.
+     */
+    bool patch(int mem_fd, bool trap);
+
+    /**
+     * @brief The block start addresses, sorted.
+     */
+    std::vector<uint64_t> addrs;
+    /**
+     * @brief The block sizes.
+     */
+    std::vector<uint16_t> sizes;
+    /**
+     * @brief The original bytes under the traps.
+     */
+    std::vector<uint8_t> orig;
+    /**
+     * @brief One bit per block, set when the block was executed.
+     */
+    std::vector<uint64_t> bitmap;
+};
+
+#endif
@@ -0,0 +1,396 @@
+#include "debugfile.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <zstd.h>
+
+#ifndef ELFCOMPRESS_ZSTD
+#define ELFCOMPRESS_ZSTD 2
+#endif
+
+#define DEBUGFILE_CRC_CHUNK (1 << 16)
+
+/**
+ * @brief A read-only mapping of a whole file.
+ */
+struct mapped_file {
+    /**
+     * @brief The file contents, nullptr if the file is not mapped.
+     */
+    const uint8_t *data;
+    /**
+     * @brief The size of the file.
+     */
+    size_t size;
+};
+
+/**
+ * @brief Maps a file for reading.
+ */
+static bool map_file(const std::string &path, mapped_file &file) {
+    file = {nullptr, 0};
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    file = {(const uint8_t *)mem, (size_t)st.st_size};
+    return true;
+}
+
+/**
+ * @brief Unmaps a file mapped by `map_file`.
+ */
+static void unmap_file(mapped_file &file) {
+    if (file.data != nullptr) {
+        munmap((void *)file.data, file.size);
+    }
+    file = {nullptr, 0};
+}
+
+/**
+ * @brief Checks the ELF header and the section header table of a file.
+ */
+static const Elf64_Ehdr *elf_header(const mapped_file &file) {
+    auto *ehdr = (const Elf64_Ehdr *)file.data;
+    if (file.size < sizeof(Elf64_Ehdr) ||
+        memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+        ehdr->e_shentsize != sizeof(Elf64_Shdr) || ehdr->e_shnum == 0 ||
+        ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) > file.size ||
+        ehdr->e_shstrndx >= ehdr->e_shnum) {
+        return nullptr;
+    }
+    return ehdr;
+}
+
+/**
+ * @brief Finds the GNU build ID in a SHT_NOTE section.
+ */
+static void read_build_id(const uint8_t *notes, size_t size,
+                          std::string &build_id) {
+    static const char digits[] = "0123456789abcdef";
+    size_t pos = 0;
+    while (pos + sizeof(Elf64_Nhdr) <= size) {
+        auto *nhdr = (const Elf64_Nhdr *)(notes + pos);
+        size_t name_pos = pos + sizeof(Elf64_Nhdr);
+        size_t desc_pos = name_pos + ((nhdr->n_namesz + 3) & ~3u);
+        size_t next = desc_pos + ((nhdr->n_descsz + 3) & ~3u);
+        if (next > size) {
+            return;
+        }
+        if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+            memcmp(notes + name_pos, "GNU", 4) == 0) {
+            build_id.clear();
+            for (size_t i = 0; i < nhdr->n_descsz; i++) {
+                build_id += digits[notes[desc_pos + i] >> 4];
+                build_id += digits[notes[desc_pos + i] & 0xf];
+            }
+            return;
+        }
+        pos = next;
+    }
+}
+
+bool read_debug_link_info(const std::string &path, debug_link_info &info) {
+    info = {"", "", 0, false, false};
+    mapped_file file;
+    if (!map_file(path, file)) {
+        return false;
+    }
+    const Elf64_Ehdr *ehdr = elf_header(file);
+    if (ehdr == nullptr) {
+        unmap_file(file);
+        return false;
+    }
+
+    auto *shdrs = (const Elf64_Shdr *)(file.data + ehdr->e_shoff);
+    const Elf64_Shdr &strtab = shdrs[ehdr->e_shstrndx];
+    if (strtab.sh_offset + strtab.sh_size > file.size) {
+        unmap_file(file);
+        return false;
+    }
+    const char *names = (const char *)(file.data + strtab.sh_offset);
+
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        const Elf64_Shdr &shdr = shdrs[i];
+        if (shdr.sh_name >= strtab.sh_size ||
+            (shdr.sh_type != SHT_NOBITS &&
+             shdr.sh_offset + shdr.sh_size > file.size)) {
+            continue;
+        }
+        const char *name = names + shdr.sh_name;
+        const uint8_t *data = file.data + shdr.sh_offset;
+
+        if (shdr.sh_type == SHT_NOTE && info.build_id.empty()) {
+            read_build_id(data, shdr.sh_size, info.build_id);
+        } else if (strcmp(name, ".gnu_debuglink") == 0) {
+            // The name, padding to 4 bytes and the CRC
+            size_t len = strnlen((const char *)data, shdr.sh_size);
+            size_t crc_pos = (len + 4) & ~(size_t)3;
+            if (crc_pos + sizeof(uint32_t) <= shdr.sh_size) {
+                info.debuglink.assign((const char *)data, len);
+                memcpy(&info.crc, data + crc_pos, sizeof(info.crc));
+            }
+        } else if (strncmp(name, ".debug_", 7) == 0 &&
+                   shdr.sh_type != SHT_NOBITS) {
+            info.has_debug_info |= strcmp(name, ".debug_info") == 0;
+            info.compressed |= (shdr.sh_flags & SHF_COMPRESSED) != 0;
+        }
+    }
+    unmap_file(file);
+    return true;
+}
+
+bool file_crc32(const std::string &path, uint32_t &crc) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<uint8_t> buf(DEBUGFILE_CRC_CHUNK);
+    uLong sum = crc32(0, Z_NULL, 0);
+    ssize_t got;
+    while ((got = read(fd, buf.data(), buf.size())) > 0) {
+        sum = crc32(sum, buf.data(), got);
+    }
+    close(fd);
+    crc = sum;
+    return got == 0;
+}
+
+std::string find_debug_file(const std::string &path,
+                            const std::vector<std::string> &dirs) {
+    debug_link_info info;
+    if (!read_debug_link_info(path, info)) {
+        return "";
+    }
+    if (info.has_debug_info) {
+        return path;
+    }
+
+    // Build IDs identify the build exactly, the CRC is the fallback
+    auto matches = [&](const std::string &candidate, bool by_crc) {
+        debug_link_info other;
+        uint32_t crc;
+        if (candidate == path || access(candidate.c_str(), R_OK) != 0 ||
+            !read_debug_link_info(candidate, other) || !other.has_debug_info) {
+            return false;
+        }
+        if (!info.build_id.empty() && other.build_id == info.build_id) {
+            return true;
+        }
+        return by_crc && file_crc32(candidate, crc) && crc == info.crc;
+    };
+
+    if (info.build_id.size() > 2) {
+        for (auto &dir: dirs) {
+            std::string candidate = dir + "/" DEBUGFILE_BUILD_ID_DIR "/" +
+                                    info.build_id.substr(0, 2) + "/" +
+                                    info.build_id.substr(2) + DEBUGFILE_SUFFIX;
+            if (matches(candidate, false)) {
+                return candidate;
+            }
+        }
+    }
+
+    if (info.debuglink.empty()) {
+        return "";
+    }
+    char real[PATH_MAX];
+    if (realpath(path.c_str(), real) == nullptr) {
+        return "";
+    }
+    std::string exe_dir(real);
+    exe_dir.erase(exe_dir.rfind('/'));
+
+    std::vector<std::string> candidates = {
+        exe_dir + "/" + info.debuglink,
+        exe_dir + "/" DEBUGFILE_LINK_DIR "/" + info.debuglink};
+    for (auto &dir: dirs) {
+        candidates.push_back(dir + exe_dir + "/" + info.debuglink);
+    }
+    for (auto &candidate: candidates) {
+        if (matches(candidate, true)) {
+            return candidate;
+        }
+    }
+    return "";
+}
+
+std::string cache_directory() {
+    std::string base;
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg != nullptr && xdg[0] == '/') {
+        base = xdg;
+    } else if (home != nullptr) {
+        base = std::string(home) + "/.cache";
+    } else {
+        return "";
+    }
+
+    std::string dir = base + "/" DEBUGFILE_CACHE_DIR;
+    if ((mkdir(base.c_str(), 0700) < 0 && errno != EEXIST) ||
+        (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST)) {
+        return "";
+    }
+    return dir;
+}
+
+/**
+ * @brief Decompresses the contents of a SHF_COMPRESSED section.
+ */
+static bool decompress_section(uint32_t type, const uint8_t *src, size_t size,
+                               std::vector<uint8_t> &out) {
+    if (type == ELFCOMPRESS_ZLIB) {
+        uLongf len = out.size();
+        return uncompress(out.data(), &len, src, size) == Z_OK &&
+               len == out.size();
+    }
+    if (type == ELFCOMPRESS_ZSTD) {
+        size_t len = ZSTD_decompress(out.data(), out.size(), src, size);
+        return !ZSTD_isError(len) && len == out.size();
+    }
+    return false;
+}
+
+/**
+ * @brief Writes the whole buffer, retrying short writes.
+ */
+static bool write_full(int fd, const void *data, size_t size) {
+    const uint8_t *pos = (const uint8_t *)data;
+    while (size > 0) {
+        ssize_t got = write(fd, pos, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        pos += got;
+        size -= got;
+    }
+    return true;
+}
+
+/**
+ * @brief Pads the file with zeros up to the alignment.
+ */
+static bool write_padding(int fd, uint64_t &offset, uint64_t align) {
+    static const uint8_t zeros[64] = {};
+    uint64_t padded = align > 1 ? (offset + align - 1) / align * align : offset;
+    while (offset < padded) {
+        size_t len = std::min<uint64_t>(sizeof(zeros), padded - offset);
+        if (!write_full(fd, zeros, len)) {
+            return false;
+        }
+        offset += len;
+    }
+    return true;
+}
+
+bool decompress_debug_file(const std::string &path,
+                           const std::string &out_path) {
+    mapped_file file;
+    if (!map_file(path, file)) {
+        return false;
+    }
+    const Elf64_Ehdr *ehdr = elf_header(file);
+    if (ehdr == nullptr) {
+        unmap_file(file);
+        return false;
+    }
+    Elf64_Ehdr new_ehdr = *ehdr;
+    std::vector<Elf64_Shdr> shdrs(ehdr->e_shnum);
+    memcpy(shdrs.data(), file.data + ehdr->e_shoff,
+           shdrs.size() * sizeof(Elf64_Shdr));
+
+    // Written next to the cache entry and renamed, a reader never sees
+    // a partial file
+    std::string tmp_path = out_path + "." + std::to_string(getpid());
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        unmap_file(file);
+        return false;
+    }
+
+    // The original contents stay where they are
+    uint64_t offset = file.size;
+    bool ok = write_full(fd, file.data, file.size);
+    for (auto &shdr: shdrs) {
+        if (!ok) {
+            break;
+        }
+        if ((shdr.sh_flags & SHF_COMPRESSED) == 0 ||
+            shdr.sh_type == SHT_NOBITS) {
+            continue;
+        }
+        Elf64_Chdr chdr;
+        if (shdr.sh_size < sizeof(chdr) ||
+            shdr.sh_offset + shdr.sh_size > file.size) {
+            ok = false;
+            break;
+        }
+        memcpy(&chdr, file.data + shdr.sh_offset, sizeof(chdr));
+        std::vector<uint8_t> data(chdr.ch_size);
+        ok = decompress_section(chdr.ch_type,
+                                file.data + shdr.sh_offset + sizeof(chdr),
+                                shdr.sh_size - sizeof(chdr), data) &&
+             write_padding(fd, offset, chdr.ch_addralign) &&
+             write_full(fd, data.data(), data.size());
+
+        shdr.sh_offset = offset;
+        shdr.sh_size = chdr.ch_size;
+        shdr.sh_addralign = chdr.ch_addralign;
+        shdr.sh_flags &= ~(uint64_t)SHF_COMPRESSED;
+        offset += data.size();
+    }
+    unmap_file(file);
+
+    ok = ok && write_padding(fd, offset, sizeof(uint64_t));
+    new_ehdr.e_shoff = offset;
+    ok = ok &&
+         write_full(fd, shdrs.data(), shdrs.size() * sizeof(Elf64_Shdr)) &&
+         pwrite(fd, &new_ehdr, sizeof(new_ehdr), 0) == sizeof(new_ehdr);
+    ok = close(fd) == 0 && ok &&
+         rename(tmp_path.c_str(), out_path.c_str()) == 0;
+    if (!ok) {
+        unlink(tmp_path.c_str());
+    }
+    return ok;
+}
+
+std::string uncompressed_debug_file(const std::string &path) {
+    debug_link_info info;
+    if (!read_debug_link_info(path, info) || !info.compressed ||
+        info.build_id.empty()) {
+        return path;
+    }
+    std::string dir = cache_directory();
+    if (dir.empty()) {
+        return path;
+    }
+
+    // The build ID names the contents, a cached copy is never stale
+    std::string cached = dir + "/" + info.build_id + DEBUGFILE_SUFFIX;
+    if (access(cached.c_str(), R_OK) == 0) {
+        return cached;
+    }
+    return decompress_debug_file(path, cached) ? cached : path;
+}
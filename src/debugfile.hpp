@@ -0,0 +1,108 @@
+#ifndef DEBUGFILE_H
+#define DEBUGFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define DEBUGFILE_BUILD_ID_DIR ".build-id"
+#define DEBUGFILE_SUFFIX ".debug"
+#define DEBUGFILE_LINK_DIR ".debug"
+#define DEBUGFILE_CACHE_DIR "debugrik"
+
+/**
+ * @brief What an ELF file tells about its debug info.
+ */
+struct debug_link_info {
+    /**
+     * @brief The GNU build ID in hex, empty if there is none.
+     */
+    std::string build_id;
+    /**
+     * @brief The file name from `.gnu_debuglink`, empty if there is none.
+     */
+    std::string debuglink;
+    /**
+     * @brief The CRC32 of the debug file from `.gnu_debuglink`.
+     */
+    uint32_t crc;
+    /**
+     * @brief Whether the file has a `.debug_info` section with contents.
+     */
+    bool has_debug_info;
+    /**
+     * @brief Whether some `.debug_*` section is SHF_COMPRESSED.
+     */
+    bool compressed;
+};
+
+/**
+ * @brief Reads the build ID, the debug link and the debug sections of an
+ * ELF file.
+ *
+ * @param path The ELF file.
+ * @param info Filled with the information.
+ * @return false if the file is not a readable ELF64 file.
+ */
+bool read_debug_link_info(const std::string &path, debug_link_info &info);
+
+/**
+ * @brief Computes the `.gnu_debuglink` CRC32 of a file.
+ *
+ * @param path The file.
+ * @param crc Filled with the checksum.
+ * @return false if the file can not be read.
+ */
+bool file_crc32(const std::string &path, uint32_t &crc);
+
+/**
+ * @brief Finds the file with the debug info of an executable.
+ *
+ * The executable itself is used if it has debug info. Otherwise, as gdb
+ * does, `<dir>/.build-id/xx/yyyy.debug` is tried in every debug directory,
+ * then the `.gnu_debuglink` name next to the executable, in its `.debug`
+ * subdirectory and under every debug directory. A candidate must have the
+ * same build ID or the CRC from the link.
+ *
+ * @param path The executable.
+ * @param dirs The debug directories.
+ * @return The debug file or an empty string.
+ */
+std::string find_debug_file(const std::string &path,
+                            const std::vector<std::string> &dirs);
+
+/**
+ * @brief Retrieves the cache directory of the debugger, creating it.
+ *
+ * @return `$XDG_CACHE_HOME/debugrik` or `~/.cache/debugrik`, empty if it can
+ * not be created.
+ */
+std::string cache_directory();
+
+/**
+ * @brief Writes a copy of an ELF file with the compressed sections
+ * decompressed.
+ *
+ * zlib and zstd compressed sections are stored after the original
+ * contents and a new section header table points at them.
+ *
+ * @param path The ELF file.
+ * @param out_path The copy to write.
+ * @return false if the file can not be read, decompressed or written.
+ */
+bool decompress_debug_file(const std::string &path,
+                           const std::string &out_path);
+
+/**
+ * @brief Retrieves a debug file with uncompressed debug sections.
+ *
+ * The decompressed copy is kept in the cache directory by build ID, so
+ * decompression happens once per build, not once per session.
+ *
+ * @param path The debug file.
+ * @return The cached copy, or the file itself if nothing is compressed or
+ * the copy can not be made.
+ */
+std::string uncompressed_debug_file(const std::string &path);
+
+#endif
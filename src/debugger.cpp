@@ -1,18 +1,41 @@
 #include "debugger.hpp"
 #include "arch.hpp"
+#include "coverage.hpp"
 #include "disassm.hpp"
 #include "dwarfinfo.hpp"
+#include "ftrace.hpp"
+#include "gcore.hpp"
+#include "memdump.hpp"
+#include "memsearch.hpp"
+#include "stats.hpp"
+#include "syscalls.hpp"
+#include "tracelog.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <iomanip>
 #include <iostream>
+#include <linux/seccomp.h>
 #include <map>
+#include <signal.h>
+#include <sstream>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <string>
+#include <sys/mman.h>
+#include <sys/personality.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <sys/ptrace.h>
 #include <sys/user.h>
 #include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 #include <utility>
 #include <vector>
@@ -25,312 +48,3356 @@
 - move all registers operations to separate function
 */
 
-Debugger::Debugger(Configuration cfg) : is_started(false) {
+Debugger::Debugger(Configuration cfg)
+    : c_pid(-1), is_started(false), DwInfo(nullptr), Tgt(nullptr),
+      solibs(nullptr), trace_ring(nullptr), agent_ring(0), agent_code(0),
+      agent_used(0), mem_fd(-1), scratch_page(0), scratch_owner(0),
+      scratch_failed(false),
+      in_syscall(false), trace_options(0), snapshot(nullptr), mi_fd(-1),
+      hit_breakpoint(0), in_bp_commands(false), exit_status(0) {
+    core_path = cfg.get_core_path();
+    mi = cfg.is_mi();
+    mi_socket = cfg.get_mi_socket();
+    gdbserver_address = cfg.get_gdbserver();
+    batch = cfg.get_batch();
+    debug_dirs = cfg.get_debug_dirs();
+    aliases = {{"run", "r"},   {"break", "b"}, {"continue", "c"},
+               {"step", "s"},  {"next", "n"},  {"backtrace", "bt"},
+               {"quit", "exit"}};
     target = cfg.get_path();
     disaska = new Disassm;
+    ElfSyms = new ElfInfo(target);
+    events = new EventLoop;
 }
 
 void Debugger::spawn_target() {
+    if (mi && mi_socket == nullptr) {
+        // stdin and stdout carry the protocol, keep the target off them
+        int null_fd = open("/dev/null", O_RDONLY);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
     o_log("spawning the target", target);
+    EventLoop::restore_signals();
+    signal(SIGPIPE, SIG_DFL);
     if (ptrace(PTRACE_TRACEME, 0, 0, 0) == -1) {
         panic("ptrace failed");
     }
+
+    if (!syscall_catches.empty()) {
+        // Let the debugger enable PTRACE_O_TRACESECCOMP first, otherwise
+        // filtered calls fail with ENOSYS
+        raise(SIGSTOP);
+
+        auto prog = build_seccomp_filter(syscall_catches);
+        struct sock_fprog fprog = {(unsigned short)prog.size(), prog.data()};
+        if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0 ||
+            prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) != 0) {
+            panic("seccomp filter installation failed");
+        }
+    }
+    // As gdb does, a PIE and its libraries get the same addresses in every
+    // run, so breakpoints set by address survive `r`
+    int persona = personality(0xffffffff);
+    if (persona != -1) {
+        personality(persona | ADDR_NO_RANDOMIZE);
+    }
     execl(target, target, nullptr);
 }
 
-void Debugger::kill_target() { ptrace(PTRACE_KILL, c_pid); }
+void Debugger::kill_target() {
+    ptrace(PTRACE_KILL, c_pid);
+    for (auto &cp: checkpoints) {
+        kill(cp.pid, SIGKILL);
+    }
+    drop_snapshot();
+}
+
+int Debugger::start(pid_t *gp) {
+    pid_out = gp;
+    if (core_path != nullptr) {
+        run_core();
+    } else if (mi) {
+        run_mi();
+    } else if (gdbserver_address != nullptr) {
+        run_gdbserver();
+    } else {
+        run_debugger();
+    }
+    return exit_status;
+}
 
-void Debugger::start(pid_t *gp) {
-    c_pid = fork();
-    *gp = c_pid;
+void Debugger::launch(int *wait_status) {
+    pid_t pid = fork();
 
-    if (c_pid == 0) {
+    if (pid == 0) {
         spawn_target();
-    } else if (c_pid > 0) {
-        DwInfo = new DwarfInfo(target, c_pid);
-        run_debugger();
-    } else {
+    } else if (pid < 0) {
         panic("failed to fork (startup error)");
     }
-}
+    c_pid = pid;
+    *pid_out = c_pid;
 
-void Debugger::run_debugger() {
-    int wait_status;
-    wait(&wait_status);
+    trace_options = 0;
+    if (!syscall_catches.empty()) {
+        waitpid(c_pid, wait_status, 0);
+        trace_options = PTRACE_O_TRACESECCOMP | PTRACE_O_TRACESYSGOOD;
+        ptrace(PTRACE_SETOPTIONS, c_pid, 0, trace_options);
+        ptrace(PTRACE_CONT, c_pid, 0, 0);
+    }
+    syscall_filter = syscall_catches;
+    in_syscall = false;
 
-outer:
-    while (WIFSTOPPED(wait_status)) {
-        std::string inp;
+    // Wait for the exec, execve itself may be one of the caught calls
+    waitpid(c_pid, wait_status, 0);
+    while (WIFSTOPPED(*wait_status) &&
+           (*wait_status >> 8) == SECCOMP_STOP_STATUS) {
+        ptrace(PTRACE_CONT, c_pid, 0, 0);
+        waitpid(c_pid, wait_status, 0);
+    }
 
-        std::cout << "dbg> ";
-        std::cin >> inp;
+    // Opened after exec, so it refers to the memory of the new image
+    switch_process(c_pid);
+    // The gdbserver keeps its own breakpoints, a trap of ours in ld.so would
+    // be a stop its client never asked for
+    if (gdbserver_address == nullptr) {
+        init_solibs();
+    }
+}
 
-        if (inp == "c") {
-            continue_execution(&wait_status);
-        } else if (inp == "b") {
-            uint64_t addr;
-            std::cin >> std::hex >> addr;
+void Debugger::switch_process(pid_t pid) {
+    // The snapshot belongs to the previous process
+    drop_snapshot();
+    c_pid = pid;
+    *pid_out = c_pid;
+    events->watch(c_pid);
 
-            set_breakpoint(addr);
-            std::cout << "Breakpoint set at: " << std::hex << (void *)addr
-                      << std::endl;
-        } else if (inp == "exit") {
-            std::cout << "bye" << std::endl;
-            break;
-        } else if (inp == "ir") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED) info_regs();
-        } else if (inp == "s") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED)
-                step(&wait_status);
-        } else if (inp == "il") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED) info_locals();
-        } else if (inp == "lf") {
-            list_functions();
-        } else if (inp == "dis") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED) disassemble();
-        } else if (inp == "r") {
-            run_requirement(!is_started, MSG_ALREADY_STARTED)
-                continue_execution(&wait_status);
-        } else if (inp == "x") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED) x_read();
-        } else if (inp == "set") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED) x_set();
-        } else if (inp == "n") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED)
-                next(&wait_status);
-        } else if (inp == "p") {
-            run_requirement(is_started, MSG_SHOULD_BE_RUNNED) print();
+    std::string mem_path = "/proc/" + std::to_string(c_pid) + "/mem";
+    if (mem_fd >= 0) {
+        close(mem_fd);
+    }
+    mem_fd = open(mem_path.c_str(), O_RDWR);
+    scratch_page = scratch_owner = 0;
+    drop_agent();
+    scratch_failed = false;
+
+    delete Tgt;
+    Tgt = new LiveTarget(c_pid);
+    delete DwInfo;
+    DwInfo = new DwarfInfo(target, Tgt, debug_dirs);
+    DwInfo->start_indexing();
+}
+
+void Debugger::init_solibs() {
+    // The previous process is gone, nothing of its libraries is mapped
+    for (auto it = breakpoints.begin(); it != breakpoints.end();) {
+        if (it->second.kind == BP_SOLIB) {
+            it = breakpoints.erase(it);
         } else {
-            unknown();
+            ++it;
+        }
+    }
+    for (auto &pending: pending_breakpoints) {
+        if (pending.addr != 0) {
+            breakpoints.erase(pending.addr);
+            pending.addr = 0;
         }
     }
+
+    delete solibs;
+    solibs = new SharedLibs;
+    std::vector<proc_map> maps;
+    read_proc_maps(c_pid, maps);
+    if (!solibs->attach(ElfSyms->interpreter(), maps)) {
+        delete solibs;
+        solibs = nullptr;
+        return;
+    }
+    insert_breakpoint(solibs->break_address(), BP_SOLIB);
 }
 
-void Debugger::next(int *status) {
-    struct user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+void Debugger::update_solibs() {
+    std::vector<so_module *> added;
+    std::vector<std::string> removed;
+    if (solibs == nullptr || !solibs->update(*Tgt, added, removed)) {
+        return;
+    }
 
-    uint8_t buf[MAX_INSTR_SIZE + 1];
-    read_process_memory(c_pid, regs.rip, buf, MAX_INSTR_SIZE);
+    // The code of an unloaded library is gone with its trap bytes
+    for (auto &path: removed) {
+        for (auto &pending: pending_breakpoints) {
+            if (pending.addr != 0 && pending.path == path) {
+                breakpoints.erase(pending.addr);
+                pending.addr = 0;
+            }
+        }
+    }
+    if (added.empty()) {
+        return;
+    }
+    for (auto &pending: pending_breakpoints) {
+        if (pending.addr == 0 && resolve_pending(pending)) {
+            std::cout << "Breakpoint " << pending.module << ":"
+                      << pending.function << " resolved at " << std::hex
+                      << (void *)pending.addr << std::endl;
+        }
+    }
+}
 
-    uint64_t *curr_instr_sz =
-        disaska->next_instr_addr(buf, MAX_INSTR_SIZE, regs.rip);
-    // std::cout << curr_instr_sz << std::endl;
+bool Debugger::solib_event(int *wait_status, breakpoint &bp,
+                           struct user_regs_struct &regs) {
+    if (solibs == nullptr || bp.addr != solibs->break_address()) {
+        return false;
+    }
+    update_solibs();
+    if (bp.kind != BP_SOLIB) {
+        return false;
+    }
+    step_over_breakpoint(wait_status, bp, regs);
+    return true;
+}
 
-    // set_breakpoint((uint64_t) curr_instr_sz);
+bool Debugger::resolve_pending(pending_breakpoint &pending) {
+    so_module *module =
+        solibs != nullptr ? solibs->find_module(pending.module) : nullptr;
+    if (module == nullptr) {
+        return false;
+    }
+    const elf_symbol *sym =
+        solibs->symbols(*module)->lookup_function(pending.function);
+    if (sym == nullptr) {
+        return false;
+    }
 
-    if (curr_instr_sz != nullptr) {
-        set_breakpoint((uint64_t)curr_instr_sz);
-        continue_execution(status);
+    if (find_tracepoint(sym->addr + module->bias) != nullptr) {
+        return false;
+    }
+    pending.addr = sym->addr + module->bias;
+    pending.path = module->path;
+    breakpoint *bp = find_breakpoint(pending.addr);
+    if (bp != nullptr) {
+        bp->kind = BP_USER;
     } else {
-        step(status);
+        insert_breakpoint(pending.addr, BP_USER);
     }
+    return true;
+}
 
-    // std::cout << disaska->handle << std::endl;
-    // Get next after CUR_INSTR instruction address
+void Debugger::break_in_module(const std::string &spec) {
+    size_t colon = spec.find(':');
+    pending_breakpoint pending = {spec.substr(0, colon),
+                                  spec.substr(colon + 1), "", 0};
+    if (pending.module.empty() || pending.function.empty()) {
+        std::cout << "usage: b <lib>:<function>" << std::endl;
+        return;
+    }
+
+    if (resolve_pending(pending)) {
+        std::cout << "Breakpoint set at: " << std::hex << (void *)pending.addr
+                  << std::endl;
+    } else if (solibs != nullptr &&
+               solibs->find_module(pending.module) != nullptr) {
+        std::cout << "no function " << pending.function << " in "
+                  << pending.module << std::endl;
+        return;
+    } else {
+        std::cout << "Breakpoint pending on " << spec << std::endl;
+    }
+    pending_breakpoints.push_back(pending);
 }
 
-void Debugger::x_set() {
-    uint64_t val;
-    std::string reg;
+void Debugger::list_solibs() {
+    if (solibs == nullptr) {
+        std::cout << "no shared libraries" << std::endl;
+        return;
+    }
+    for (so_module *module: solibs->modules()) {
+        std::cout << std::hex << (void *)module->bias << "  "
+                  << (module->elf != nullptr ? "symbols  " : "         ")
+                  << module->path << std::endl;
+    }
+}
 
-    std::cin >> reg;
-    std::cin >> std::hex >> val;
+const elf_symbol *Debugger::function_at(uint64_t pc, uint64_t bias,
+                                        uint64_t &offset,
+                                        std::string &module) {
+    module.clear();
+    const elf_symbol *sym = ElfSyms->find_function(pc - bias);
+    if (sym != nullptr) {
+        offset = pc - bias - sym->addr;
+        return sym;
+    }
 
-    // Get actual register values
+    // Only the library containing the address has its symbols read
+    so_module *lib =
+        solibs != nullptr && core_path == nullptr ? solibs->module_at(pc)
+                                                  : nullptr;
+    if (lib == nullptr) {
+        return nullptr;
+    }
+    sym = solibs->symbols(*lib)->find_function(pc - lib->bias);
+    if (sym != nullptr) {
+        offset = pc - lib->bias - sym->addr;
+        module = lib->path.substr(lib->path.rfind('/') + 1);
+    }
+    return sym;
+}
+
+void Debugger::tracepoint(int *wait_status) {
+    std::string spec;
+    if (!(cmd_args >> spec)) {
+        collect_tracepoints();
+        for (size_t i = 0; i < tracepoints.size(); i++) {
+            fast_tracepoint &tp = tracepoints[i];
+            std::cout << "#" << std::dec << i << "  " << std::hex
+                      << (void *)tp.addr << " " << tp.name << ": " << std::dec
+                      << tp.hits << " hits" << (tp.active ? "" : " (gone)")
+                      << std::endl;
+        }
+        if (trace_ring != nullptr && trace_ring->lost() > 0) {
+            std::cout << std::dec << trace_ring->lost()
+                      << " hits lost, the ring was full" << std::endl;
+        }
+        return;
+    }
+    if (!is_started || !WIFSTOPPED(*wait_status)) {
+        std::cout << MSG_SHOULD_BE_RUNNED << std::endl;
+        return;
+    }
+    if (in_syscall) {
+        std::cout << MSG_IN_SYSCALL << std::endl;
+        return;
+    }
+
+    const elf_symbol *sym = ElfSyms->lookup_function(spec);
+    uint64_t addr;
+    if (sym != nullptr) {
+        addr = sym->addr + ElfSyms->load_bias(c_pid);
+    } else {
+        // A misspelled name must not become an address, "foo" is 0xf
+        char *end;
+        errno = 0;
+        addr = strtoull(spec.c_str(), &end, 16);
+        if (spec.empty() || *end != '\0' || errno != 0 || addr == 0) {
+            std::cout << "no function or address " << spec << std::endl;
+            return;
+        }
+    }
+    // Whole instructions covering the jump are moved to the trampoline
+    uint8_t code[FASTTRACE_JMP_SIZE + X86_MAX_INSN_LEN];
+    ssize_t len = mem_read(code, sizeof(code), addr);
+    if (len < FASTTRACE_JMP_SIZE) {
+        std::cout << "cannot read the code at " << std::hex << (void *)addr
+                  << std::endl;
+        return;
+    }
+    if (!init_agent(addr)) {
+        std::cout << "cannot inject the tracing agent" << std::endl;
+        return;
+    }
+    uint64_t tramp = agent_code + agent_used;
+    std::vector<uint8_t> tramp_code;
+    fasttrace_record_code(agent_ring, tracepoints.size(), tramp_code);
+    size_t size = 0, first_size = 0;
+    while (size < FASTTRACE_JMP_SIZE) {
+        displaced_insn insn;
+        if (len <= (ssize_t)size ||
+            !disaska->relocate(code + size, len - size, addr + size,
+                               tramp + tramp_code.size(), insn) ||
+            insn.branch) {
+            std::cout << "cannot relocate the code at " << std::hex
+                      << (void *)(addr + size) << std::endl;
+            return;
+        }
+        tramp_code.insert(tramp_code.end(), insn.code, insn.code + insn.size);
+        size += insn.size;
+        first_size = first_size == 0 ? size : first_size;
+    }
+    fasttrace_jump_code(addr + size, tramp_code);
+
+    // Nothing may run from the middle of the patched instructions
     struct user_regs_struct regs;
     ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
-    std::map<std::string, unsigned long long> rm = expand_regs(regs);
+    bool busy = regs.rip > addr && regs.rip < addr + size;
+    for (size_t i = 0; i < size; i++) {
+        busy = busy || find_breakpoint(addr + i) != nullptr;
+    }
+    for (auto &tp: tracepoints) {
+        busy = busy || (tp.active && tp.addr < addr + size &&
+                        addr < tp.addr + tp.size);
+    }
+    // A branch to a later displaced instruction would land inside the jump.
+    // The direct branches of the function are checked, in code without a
+    // known function only a single displaced instruction is safe
+    uint64_t bias = ElfSyms->load_bias(c_pid);
+    const elf_symbol *func = ElfSyms->find_function(addr - bias);
+    const uint8_t *func_code;
+    if (func != nullptr && func->size != 0 &&
+        ElfSyms->code_at(func->addr, func->size, func_code)) {
+        std::vector<uint64_t> leaders;
+        disaska->find_block_leaders(func_code, func->size, func->addr + bias,
+                                    leaders);
+        for (uint64_t leader: leaders) {
+            busy = busy || (leader > addr && leader < addr + size);
+        }
+    } else {
+        busy = busy || first_size < size;
+    }
+    int64_t rel = tramp - (addr + FASTTRACE_JMP_SIZE);
+    if (busy || rel != (int32_t)rel ||
+        agent_used + tramp_code.size() > FASTTRACE_CODE_SIZE) {
+        std::cout << "cannot place a tracepoint at " << std::hex
+                  << (void *)addr << std::endl;
+        return;
+    }
 
-    std::cout << reg << std::endl;
-    if (rm.count(reg) == 0) {
-        std::cout << "bad register name" << std::endl;
+    uint8_t jump[sizeof(code)];
+    memset(jump, NOP_BYTE, size);
+    jump[0] = JMP_REL32;
+    int32_t rel32 = rel;
+    memcpy(jump + 1, &rel32, sizeof(rel32));
+    if (mem_write(tramp_code.data(), tramp_code.size(), tramp) !=
+            (ssize_t)tramp_code.size() ||
+        mem_write(jump, size, addr) != (ssize_t)size) {
+        perror("tp: write");
         return;
     }
+    Tgt->wrote(tramp, tramp_code.data(), tramp_code.size());
+    Tgt->wrote(addr, jump, size);
+    agent_used += (tramp_code.size() + 15) & ~15ul;
+    tracepoints.push_back({addr, (uint32_t)size, spec, 0, true});
+    std::cout << "Tracepoint " << std::dec << tracepoints.size() - 1
+              << " at " << std::hex << (void *)addr << std::endl;
+}
 
-    rm[reg] = val;
-    flatten_regs(regs, rm);
-    ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+bool Debugger::init_agent(uint64_t near) {
+    if (trace_ring != nullptr) {
+        return true;
+    }
+    uint64_t ret;
+    if (agent_code == 0) {
+        uint64_t hint = near > 2 * FASTTRACE_HINT_GAP
+                            ? (near & ~(uint64_t)(DISPLACED_PAGE_SIZE - 1)) -
+                                  FASTTRACE_HINT_GAP
+                            : 0;
+        uint64_t args[6] = {hint,
+                            FASTTRACE_CODE_SIZE,
+                            PROT_READ | PROT_EXEC,
+                            MAP_PRIVATE | MAP_ANONYMOUS,
+                            (uint64_t)-1,
+                            0};
+        // memfd_create takes its name from the memory of the target
+        if (!inject_syscall(SYS_mmap, args, ret) || ret > -4096ull ||
+            mem_write(FASTTRACE_MEMFD_NAME, sizeof(FASTTRACE_MEMFD_NAME),
+                      ret) != sizeof(FASTTRACE_MEMFD_NAME)) {
+            return false;
+        }
+        agent_code = ret;
+        agent_used = (sizeof(FASTTRACE_MEMFD_NAME) + 15) & ~15ul;
+    }
+
+    uint64_t size = fasttrace_ring_size(FASTTRACE_RING_RECORDS), fd;
+    uint64_t memfd_args[6] = {agent_code, 0, 0, 0, 0, 0};
+    if (!inject_syscall(SYS_memfd_create, memfd_args, fd) || fd > -4096ull) {
+        return false;
+    }
+    uint64_t truncate_args[6] = {fd, size, 0, 0, 0, 0};
+    uint64_t mmap_args[6] = {0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                             0};
+    bool ok = inject_syscall(SYS_ftruncate, truncate_args, ret) && ret == 0 &&
+              inject_syscall(SYS_mmap, mmap_args, agent_ring) &&
+              agent_ring <= -4096ull;
+
+    // The debugger maps the same file before the target closes it
+    void *mem = MAP_FAILED;
+    if (ok) {
+        std::string path = "/proc/" + std::to_string(c_pid) + "/fd/" +
+                           std::to_string(fd);
+        int local = open(path.c_str(), O_RDWR);
+        if (local >= 0) {
+            mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       local, 0);
+            close(local);
+        }
+    }
+    uint64_t close_args[6] = {fd, 0, 0, 0, 0, 0};
+    inject_syscall(SYS_close, close_args, ret);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    trace_ring = new TraceRing(mem, FASTTRACE_RING_RECORDS);
+    trace_ring->start();
+    return true;
 }
 
-void Debugger::x_read() {
-    unsigned long addr, k;
+void Debugger::collect_tracepoints() {
+    if (trace_ring == nullptr) {
+        return;
+    }
+    size_t first = tp_records.size();
+    trace_ring->take(tp_records);
+    for (size_t i = first; i < tp_records.size(); i++) {
+        if (tp_records[i].id < tracepoints.size()) {
+            tracepoints[tp_records[i].id].hits++;
+        }
+    }
+}
 
-    std::cin >> std::hex >> addr;
-    std::cin >> k;
+void Debugger::drop_agent() {
+    if (trace_ring != nullptr) {
+        trace_ring->stop();
+        collect_tracepoints();
+        delete trace_ring;
+        trace_ring = nullptr;
+    }
+    for (auto &tp: tracepoints) {
+        tp.active = false;
+    }
+    agent_ring = agent_code = agent_used = 0;
+}
+
+void Debugger::tracepoint_dump() {
+    std::string out_path;
+    if (!(cmd_args >> out_path)) {
+        out_path = FASTTRACE_DEFAULT_OUTPUT;
+    }
+    collect_tracepoints();
 
-    if (k > MAX_XREAD_K) {
-        std::cout << "to much bytes to read!" << std::endl;
+    FILE *out = fopen(out_path.c_str(), "w");
+    if (out == nullptr) {
+        perror(out_path.c_str());
+        return;
+    }
+    fprintf(out, "# tp tsc rsp rax rcx rdx rsi rdi r8 r9\n");
+    for (auto &rec: tp_records) {
+        fprintf(out, "%llu %llu %llx %llx %llx %llx %llx %llx %llx %llx\n",
+                (unsigned long long)rec.id, (unsigned long long)rec.tsc,
+                (unsigned long long)rec.rsp, (unsigned long long)rec.rax,
+                (unsigned long long)rec.rcx, (unsigned long long)rec.rdx,
+                (unsigned long long)rec.rsi, (unsigned long long)rec.rdi,
+                (unsigned long long)rec.r8, (unsigned long long)rec.r9);
+    }
+    if (fclose(out) != 0) {
+        perror(out_path.c_str());
         return;
     }
-    uint64_t memo[k];
+    std::cout << std::dec << tp_records.size() << " hits written to "
+              << out_path << std::endl;
+}
 
-    read_process_memory(c_pid, addr, (uint8_t *)memo, sizeof(uint64_t) * k);
-    dump((void *)addr, memo, k);
+void Debugger::memcache_info() {
+    auto *live = (LiveTarget *)Tgt;
+    uint64_t hits = live->cache_hits(), misses = live->cache_misses();
+    std::cout << std::dec << "Memory cache: " << hits << " page hits, "
+              << misses << " misses";
+    if (hits + misses > 0) {
+        std::cout << ", " << hits * 100 / (hits + misses) << "% hit rate";
+    }
+    std::cout << std::endl;
 }
 
-void Debugger::continue_execution(int *wait_status) {
-    ptrace(PTRACE_CONT, c_pid, 0, 0);
-    is_started = true;
+void Debugger::stats() {
+    std::string arg;
+    if (cmd_args >> arg) {
+        if (arg != "reset") {
+            std::cout << "usage: stats [reset]" << std::endl;
+            return;
+        }
+        global_stats.reset();
+        return;
+    }
+    global_stats.print();
+    if (is_started && core_path == nullptr) {
+        memcache_info();
+    }
+}
 
-    wait(wait_status);
+void Debugger::relaunch(int *wait_status) {
+    events->unwatch(c_pid);
+    ptrace(PTRACE_KILL, c_pid, 0, 0);
+    waitpid(c_pid, nullptr, 0);
 
-    // Then we got to breakpoint
-    if (WIFSTOPPED(*wait_status) && WSTOPSIG(*wait_status) == SIGTRAP) {
-        struct user_regs_struct regs;
-        ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+    launch(wait_status);
 
-        for (int i = 0; i < breakpoint_count; i++) {
-            if (regs.rip - 1 == breakpoints[i].addr) {
-                // If it's our breakpoint
-                printf("Breakpoint hit at 0x%lx\n", breakpoints[i].addr);
+    // Randomization is off, so the breakpoints are at the same places in
+    // the new image; their bytes are read again, the file may have changed
+    for (auto &kv: breakpoints) {
+        if (kv.second.kind == BP_SOLIB) {
+            // Planted by launch() already
+            continue;
+        }
+        errno = 0;
+        long data = ptrace(PTRACE_PEEKTEXT, c_pid, (void *)kv.first, 0);
+        if (errno == 0) {
+            kv.second.original_data = data;
+        }
+        poke_byte(kv.first, TRAP_BYTE);
+    }
+}
 
-                // Restore original instruction
-                ptrace(PTRACE_POKETEXT, c_pid, (void *)breakpoints[i].addr,
-                       (void *)breakpoints[i].original_data);
+void Debugger::run_debugger() {
+    int wait_status;
+    launch(&wait_status);
 
-                // Execute instructions after restoring
-                regs.rip -= 1;
-                ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
-                ptrace(PTRACE_SINGLESTEP, c_pid, 0, 0);
+    if (!batch.empty()) {
+        run_batch(&wait_status);
+    } else {
+        interact(&wait_status);
+    }
+}
 
-                // Wait until next breakpoint?
-                wait(wait_status);
+void Debugger::interact(int *wait_status) {
+    line_reader more = [&](std::string &line) {
+        return read_line(line, wait_status, "> ");
+    };
 
-                // Reinsert prev breakpoint
-                ptrace(PTRACE_POKETEXT, c_pid, (void *)breakpoints[i].addr,
-                       (void *)(breakpoints[i].original_data & LSB_TRAP_MASK |
-                                TRAP_BYTE));
-                break;
+    // An exited target can still be brought back from a checkpoint
+    std::string line, last;
+    while (wait_status == nullptr || WIFSTOPPED(*wait_status) ||
+           !checkpoints.empty()) {
+        if (!read_line(line, wait_status, "dbg> ")) {
+            std::cout << "bye" << std::endl;
+            break;
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            if (last.empty()) {
+                continue;
             }
+            line = last;
+        } else {
+            // A block is not repeated, its lines are gone
+            last = opens_block(line) ? "" : line;
+        }
+
+        if (run_line(line, more, wait_status) == CMD_EXIT) {
+            break;
         }
     }
 }
 
-void Debugger::step(int *wait_status) {
-    ptrace(PTRACE_SINGLESTEP, c_pid, 0, 0);
-    wait(wait_status);
+void Debugger::run_batch(int *wait_status) {
+    line_reader none = [](std::string &) { return false; };
+    for (auto &line: batch) {
+        if (target_gone(line, wait_status)) {
+            exit_status = 1;
+            continue;
+        }
+        command_result result = run_line(line, none, wait_status);
+        if (result == CMD_EXIT) {
+            return;
+        }
+        if (result != CMD_DONE) {
+            exit_status = 1;
+        }
+    }
 }
 
-void Debugger::info_regs() {
-    std::string name;
-    struct user_regs_struct regs;
+bool Debugger::target_gone(const std::string &line, int *wait_status) {
+    // The interactive loop ends here too, checkpoints could bring it back
+    if (wait_status == nullptr || WIFSTOPPED(*wait_status) ||
+        !checkpoints.empty()) {
+        return false;
+    }
+    std::string cmd, args;
+    if (!split_command(line, cmd, args)) {
+        return false;
+    }
+    expand_alias(aliases, cmd, args);
+    if (cmd == "exit") {
+        return false;
+    }
+    std::cout << MSG_NOT_RUNNING << ": " << line << std::endl;
+    return true;
+}
 
-    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+command_result Debugger::run_line(const std::string &line,
+                                  const line_reader &more, int *wait_status) {
+    std::string cmd, args;
+    if (!split_command(line, cmd, args)) {
+        return CMD_DONE;
+    }
+    expand_alias(aliases, cmd, args);
 
-    std::map<std::string, unsigned long long> p_map = expand_regs(regs);
+    // Commands that work on command lines rather than the target
+    if (cmd == "repeat") {
+        return repeat(args, more, wait_status);
+    } else if (cmd == "commands") {
+        return breakpoint_commands(args, more);
+    } else if (cmd == "alias") {
+        alias(args);
+        return CMD_DONE;
+    } else if (cmd == "source") {
+        return source(args, wait_status);
+    } else if (cmd == "echo") {
+        std::cout << args << std::endl;
+        return CMD_DONE;
+    }
 
-    std::cout << "Registers:" << std::endl;
+    cmd_args.clear();
+    cmd_args.str(args);
+    command_result result = execute(cmd, wait_status);
+    if (result != CMD_DONE || in_bp_commands) {
+        return result;
+    }
+    return run_bp_commands(wait_status);
+}
 
-    int modulus = 0;
-    for (auto kv: p_map) {
-        std::cout << kv.first << "=" << std::setw(16) << std::setfill('0')
-                  << std::hex << kv.second << " ";
+command_result Debugger::run_lines(const std::vector<std::string> &lines,
+                                   int *wait_status, size_t *failed_line) {
+    size_t pos = 0;
+    line_reader more = [&](std::string &line) {
+        if (pos >= lines.size()) {
+            return false;
+        }
+        line = lines[pos++];
+        return true;
+    };
 
-        if (++modulus % 3 == 0) {
-            std::cout << std::endl;
+    std::string line;
+    while (more(line)) {
+        size_t line_no = pos;
+        command_result result = target_gone(line, wait_status)
+                                    ? CMD_REFUSED
+                                    : run_line(line, more, wait_status);
+        if (result != CMD_DONE) {
+            if (failed_line != nullptr) {
+                *failed_line = line_no;
+            }
+            return result;
         }
     }
+    return CMD_DONE;
+}
 
-    // last newline not sent yet
-    if (modulus % 3 != 0)
-        std::cout << std::endl;
+command_result Debugger::run_bp_commands(int *wait_status) {
+    // A `c` among the commands may hit the next breakpoint, handled here
+    // rather than recursively so that long runs keep a flat stack
+    command_result result = CMD_DONE;
+    while (result == CMD_DONE && hit_breakpoint != 0) {
+        auto it = bp_commands.find(hit_breakpoint);
+        hit_breakpoint = 0;
+        if (it == bp_commands.end()) {
+            break;
+        }
+        std::vector<std::string> lines = it->second;
+        in_bp_commands = true;
+        result = run_lines(lines, wait_status);
+        in_bp_commands = false;
+    }
+    return result;
 }
 
-void Debugger::disassemble() {
-    struct user_regs_struct regs;
-    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+command_result Debugger::repeat(const std::string &args,
+                                const line_reader &more, int *wait_status) {
+    std::istringstream in(args);
+    unsigned long count;
+    std::string command;
+    if (!(in >> std::dec >> count)) {
+        std::cout << "usage: repeat <n> [command]" << std::endl;
+        return CMD_REFUSED;
+    }
+    std::getline(in >> std::ws, command);
 
-    Dwarf_Addr low_pc, high_pc, tmp_low_pc, tmp_high_pc;
-    std::string name;
+    std::vector<std::string> body;
+    if (!command.empty()) {
+        body.push_back(command);
+    } else if (!read_block(more, body)) {
+        std::cout << "missing " SCRIPT_BLOCK_END << std::endl;
+        return CMD_REFUSED;
+    }
 
-    DwInfo->get_function_by_rip(regs.rip, name, low_pc, high_pc);
-    uint8_t *code = new uint8_t[high_pc - low_pc];
+    for (unsigned long i = 0; i < count; i++) {
+        // Nothing left to run once the target is gone
+        if (wait_status != nullptr && !WIFSTOPPED(*wait_status)) {
+            break;
+        }
+        command_result result = run_lines(body, wait_status);
+        if (result != CMD_DONE) {
+            return result;
+        }
+    }
+    return CMD_DONE;
+}
 
-    if (!read_process_memory(c_pid, low_pc, code, high_pc - low_pc)) {
-        perror("ptrace read");
-        ptrace(PTRACE_DETACH, c_pid, nullptr, nullptr);
+command_result Debugger::breakpoint_commands(const std::string &args,
+                                             const line_reader &more) {
+    std::istringstream in(args);
+    uint64_t addr = 0;
+    bool has_addr = static_cast<bool>(in >> std::hex >> addr);
+
+    // The block is consumed even if the breakpoint is wrong
+    std::vector<std::string> body;
+    if (!read_block(more, body)) {
+        std::cout << "missing " SCRIPT_BLOCK_END << std::endl;
+        return CMD_REFUSED;
+    }
+    breakpoint *bp = has_addr ? find_breakpoint(addr) : nullptr;
+    if (bp == nullptr || bp->kind != BP_USER) {
+        std::cout << "no breakpoint at " << std::hex << (void *)addr
+                  << std::endl;
+        return CMD_REFUSED;
+    }
+
+    if (body.empty()) {
+        bp_commands.erase(addr);
     } else {
-        // Loop over all breakpoints for reverting changes: now dump contains
-        // TRAP instructions
-        for (int i = 0; i < breakpoint_count; i++) {
-            std::string breakpoint_position;
-            DwInfo->get_function_by_rip(breakpoints[i].addr,
-                                        breakpoint_position, tmp_low_pc,
-                                        tmp_high_pc);
+        bp_commands[addr] = body;
+    }
+    return CMD_DONE;
+}
 
-            if (name == breakpoint_position) {
-                // patch_idx contains trap byte
-                int patch_idx = breakpoints[i].addr - tmp_low_pc;
-                code[patch_idx] = (uint8_t)breakpoints[i].original_data;
-            }
+void Debugger::alias(const std::string &args) {
+    std::string name, command;
+    if (!split_command(args, name, command)) {
+        std::map<std::string, std::string> sorted(aliases.begin(),
+                                                  aliases.end());
+        for (auto &kv: sorted) {
+            std::cout << kv.first << " = " << kv.second << std::endl;
         }
+    } else if (command.empty()) {
+        aliases.erase(name);
+    } else {
+        aliases[name] = command;
+    }
+}
 
-        std::cout << "assembly:" << std::endl;
-        disaska->print_disassembly(code, high_pc - low_pc, low_pc);
+command_result Debugger::source(const std::string &path, int *wait_status) {
+    std::vector<std::string> lines;
+    if (!read_script(path.c_str(), lines)) {
+        std::cout << "cannot read " << path << std::endl;
+        return CMD_REFUSED;
     }
 
-    delete[] code;
+    size_t failed_line = 0;
+    command_result result = run_lines(lines, wait_status, &failed_line);
+    if (result == CMD_REFUSED || result == CMD_UNKNOWN) {
+        std::cout << path << ":" << std::dec << failed_line
+                  << ": the script is stopped" << std::endl;
+    }
+    return result;
 }
 
-void Debugger::list_functions() {
-    std::string cmd = "nm " + std::string(target) + " | grep '.* T .*'";
-    system(cmd.c_str());
+const std::unordered_map<std::string, command_info> &
+Debugger::command_table() {
+    static const std::unordered_map<std::string, command_info> table = {
+        {"c",
+         {REQ_NONE, false,
+          [](Debugger &d, int *ws) { d.continue_execution(ws); }}},
+        {"b",
+         {REQ_NONE, false,
+          [](Debugger &d, int *) {
+              std::string spec;
+              d.cmd_args >> spec;
+              if (spec.find(':') != std::string::npos) {
+                  d.break_in_module(spec);
+                  return;
+              }
+              uint64_t addr = strtoull(spec.c_str(), nullptr, 16);
+
+              d.set_breakpoint(addr);
+              std::cout << "Breakpoint set at: " << std::hex << (void *)addr
+                        << std::endl;
+          }}},
+        {"ir", {REQ_STARTED, true, [](Debugger &d, int *) { d.info_regs(); }}},
+        {"s", {REQ_STARTED, false, [](Debugger &d, int *ws) { d.step(ws); }}},
+        {"il",
+         {REQ_STARTED, true, [](Debugger &d, int *) { d.info_locals(); }}},
+        {"lf",
+         {REQ_NONE, true, [](Debugger &d, int *) { d.list_functions(); }}},
+        {"dis",
+         {REQ_STARTED, true, [](Debugger &d, int *) { d.disassemble(); }}},
+        {"r",
+         {REQ_NOT_STARTED, false,
+          [](Debugger &d, int *ws) {
+              if (d.syscall_catches != d.syscall_filter) {
+                  // The filter can be installed only before exec
+                  d.relaunch(ws);
+              }
+              d.continue_execution(ws);
+          }}},
+        {"x", {REQ_STARTED, true, [](Debugger &d, int *) { d.x_read(); }}},
+        {"set", {REQ_STARTED, false, [](Debugger &d, int *) { d.x_set(); }}},
+        {"n", {REQ_STARTED, false, [](Debugger &d, int *ws) { d.next(ws); }}},
+        {"p", {REQ_STARTED, true, [](Debugger &d, int *) { d.print(); }}},
+        {"finish",
+         {REQ_STARTED, false, [](Debugger &d, int *ws) { d.finish(ws); }}},
+        {"until",
+         {REQ_STARTED, false,
+          [](Debugger &d, int *ws) { d.until(ws, false); }}},
+        {"advance",
+         {REQ_STARTED, false, [](Debugger &d, int *ws) { d.until(ws, true); }}},
+        {"ftrace",
+         {REQ_NONE, false, [](Debugger &d, int *ws) { d.ftrace(ws); }}},
+        {"catch",
+         {REQ_NOT_STARTED, false,
+          [](Debugger &d, int *) { d.catch_syscalls(); }}},
+        {"strace",
+         {REQ_NONE, false, [](Debugger &d, int *ws) { d.strace(ws); }}},
+        {"coverage",
+         {REQ_NONE, false, [](Debugger &d, int *ws) { d.coverage(ws); }}},
+        {"record",
+         {REQ_NONE, false, [](Debugger &d, int *ws) { d.record(ws); }}},
+        {"replay-view",
+         {REQ_NONE, false, [](Debugger &d, int *) { d.replay_view(); }}},
+        {"checkpoint",
+         {REQ_STOPPED, false, [](Debugger &d, int *) { d.make_checkpoint(); }}},
+        {"restart",
+         {REQ_NONE, false, [](Debugger &d, int *ws) { d.restart(ws); }}},
+        {"gcore", {REQ_STOPPED, false, [](Debugger &d, int *) { d.gcore(); }}},
+        {"bt", {REQ_STARTED, true, [](Debugger &d, int *) { d.backtrace(); }}},
+        {"libs",
+         {REQ_NONE, false, [](Debugger &d, int *) { d.list_solibs(); }}},
+        {"tp",
+         {REQ_NONE, false, [](Debugger &d, int *ws) { d.tracepoint(ws); }}},
+        {"tpdump",
+         {REQ_NONE, false, [](Debugger &d, int *) { d.tracepoint_dump(); }}},
+        {"memcache",
+         {REQ_STARTED, false, [](Debugger &d, int *) { d.memcache_info(); }}},
+        {"stats", {REQ_NONE, true, [](Debugger &d, int *) { d.stats(); }}},
+        {"find", {REQ_STOPPED, false, [](Debugger &d, int *) { d.find(); }}},
+        {"dump",
+         {REQ_STOPPED, false, [](Debugger &d, int *) { d.dump_memory(); }}},
+        {"snap", {REQ_STOPPED, false, [](Debugger &d, int *) { d.snap(); }}},
+        {"snapdiff",
+         {REQ_STOPPED, false, [](Debugger &d, int *) { d.snapdiff(); }}},
+    };
+    return table;
 }
 
-void Debugger::info_locals() {
-    struct user_regs_struct regs;
-    if (ptrace(PTRACE_GETREGS, c_pid, 0, &regs) < 0) {
-        perror("ptrace(GETREGS)");
-        exit(EXIT_FAILURE);
+command_result Debugger::execute(const std::string &cmd, int *wait_status) {
+    if (cmd == "exit") {
+        int code;
+        if (cmd_args >> std::dec >> code) {
+            exit_status = code;
+        }
+        std::cout << "bye" << std::endl;
+        return CMD_EXIT;
     }
 
-    Dwarf_Addr low_pc, high_pc;
-    std::string func_name;
-    DwInfo->get_function_by_rip(regs.rip, func_name, low_pc, high_pc);
-    auto locals = DwInfo->get_local_vars((char *)func_name.c_str());
-    for (auto l: locals) {
-        std::cout << l.first << '=' << (void *)l.second << std::endl;
+    auto &table = command_table();
+    auto it = table.find(cmd);
+    if (it == table.end()) {
+        unknown();
+        return CMD_UNKNOWN;
     }
-}
+    const command_info &info = it->second;
+
+    if (core_path != nullptr) {
+        // Nothing runs, only the commands that inspect the state work
+        run_requirement(info.on_core, MSG_CORE_ONLY);
+    } else if (info.requirement == REQ_STARTED) {
+        run_requirement(is_started, MSG_SHOULD_BE_RUNNED);
+    } else if (info.requirement == REQ_NOT_STARTED) {
+        run_requirement(!is_started, MSG_ALREADY_STARTED);
+    } else if (info.requirement == REQ_STOPPED) {
+        run_requirement(WIFSTOPPED(*wait_status), MSG_SHOULD_BE_RUNNED);
+    }
+    uint64_t start = stats_now();
+    info.run(*this, wait_status);
+    global_stats.time_command(cmd, stats_now() - start);
+    global_stats.prompt();
+    return CMD_DONE;
+}
+
+bool Debugger::read_line(std::string &line, int *wait_status,
+                         const char *prompt) {
+    std::cout << prompt << std::flush;
+    for (;;) {
+        loop_event event;
+        events->next_event(event);
+        switch (event.type) {
+        case EVENT_LINE:
+            line.swap(event.line);
+            return true;
+        case EVENT_EOF:
+            return false;
+        case EVENT_INTERRUPT:
+            std::cout << std::endl << prompt << std::flush;
+            break;
+        case EVENT_EXIT:
+            report_exit(event.pid, event.status, wait_status);
+            std::cout << prompt << std::flush;
+            break;
+        case EVENT_STOP:
+            report_stop(event.pid, event.status, wait_status);
+            std::cout << prompt << std::flush;
+            break;
+        }
+    }
+}
+
+void Debugger::report_stop(pid_t pid, int status, int *wait_status) {
+    std::cout << std::endl << "process " << std::dec << pid
+              << " stopped by " << strsignal(WSTOPSIG(status)) << std::endl;
+    if (pid == c_pid && wait_status != nullptr) {
+        *wait_status = status;
+    }
+}
+
+void Debugger::report_exit(pid_t pid, int status, int *wait_status) {
+    std::cout << std::endl << "process " << std::dec << pid;
+    if (WIFEXITED(status)) {
+        std::cout << " exited with code " << WEXITSTATUS(status) << std::endl;
+    } else if (WIFSIGNALED(status)) {
+        std::cout << " killed by " << strsignal(WTERMSIG(status)) << std::endl;
+    } else {
+        std::cout << " is gone" << std::endl;
+    }
+
+    if (pid == c_pid && wait_status != nullptr) {
+        *wait_status = status;
+    }
+    for (size_t i = 0; i < checkpoints.size(); i++) {
+        if (checkpoints[i].pid == pid) {
+            std::cout << "checkpoint " << i << " is lost" << std::endl;
+            checkpoints.erase(checkpoints.begin() + i);
+            break;
+        }
+    }
+    if (snapshot != nullptr && snapshot->copy() == pid) {
+        std::cout << "the snapshot is lost" << std::endl;
+        delete snapshot;
+        snapshot = nullptr;
+    }
+}
+
+void Debugger::run_core() {
+    auto *core = new CoreTarget(core_path);
+    if (!core->loaded()) {
+        delete core;
+        panic("cannot load the core file");
+    }
+    Tgt = core;
+    DwInfo = new DwarfInfo(target, Tgt, debug_dirs);
+    DwInfo->start_indexing();
+    is_started = true;
+
+    std::cout << "Core was generated by pid " << std::dec << core->pid()
+              << ", terminated with signal " << strsignal(core->signal())
+              << std::endl;
+    backtrace();
+
+    if (!batch.empty()) {
+        run_batch(nullptr);
+    } else {
+        interact(nullptr);
+    }
+}
+
+void Debugger::run_gdbserver() {
+    int wait_status;
+    launch(&wait_status);
+
+    int fd = GdbServer::accept_client(gdbserver_address);
+    if (fd < 0) {
+        perror("gdbserver");
+        return;
+    }
+    // The server waits for the target itself
+    events->unwatch(c_pid);
+    GdbServer server(c_pid);
+    server.serve(fd, wait_status);
+    close(fd);
+}
+
+void Debugger::run_mi() {
+    if (mi_socket != nullptr) {
+        mi_fd = mi_accept(mi_socket);
+        if (mi_fd < 0) {
+            perror("mi socket");
+            return;
+        }
+        // Requests and responses share the connection
+        delete events;
+        events = new EventLoop(mi_fd);
+    } else {
+        mi_fd = STDOUT_FILENO;
+    }
+    // A gone client must not kill the debugger before the target
+    signal(SIGPIPE, SIG_IGN);
+
+    std::ostringstream console;
+    std::streambuf *saved_cout = std::cout.rdbuf(console.rdbuf());
+
+    int wait_status;
+    launch(&wait_status);
+    std::string out;
+    mi_stop_event(out, "started", wait_status);
+
+    while (WIFSTOPPED(wait_status) || !checkpoints.empty()) {
+        // Pipelined requests are answered with one write
+        if (!out.empty() && !events->ready()) {
+            if (!write_all(mi_fd, out)) {
+                break;
+            }
+            out.clear();
+        }
+
+        loop_event event;
+        events->next_event(event);
+        if (event.type == EVENT_EOF) {
+            break;
+        } else if (event.type == EVENT_EXIT) {
+            report_exit(event.pid, event.status, &wait_status);
+            mi_exit_event(out, event.pid, event.status);
+        } else if (event.type == EVENT_STOP) {
+            report_stop(event.pid, event.status, &wait_status);
+            out += "{\"event\":\"stopped\",\"pid\":" +
+                   std::to_string(event.pid) + ",\"signal\":" +
+                   std::to_string(WSTOPSIG(event.status)) + "}\n";
+        } else if (event.type == EVENT_LINE &&
+                   event.line.find_first_not_of(" \t\r") != std::string::npos &&
+                   !mi_handle(event.line, &wait_status, console, out)) {
+            break;
+        }
+    }
+    write_all(mi_fd, out);
+
+    std::cout.rdbuf(saved_cout);
+    signal(SIGPIPE, SIG_DFL);
+    if (mi_socket != nullptr) {
+        close(mi_fd);
+        unlink(mi_socket);
+    }
+}
+
+bool Debugger::mi_handle(const std::string &line, int *wait_status,
+                         std::ostringstream &console, std::string &out) {
+    mi_request req;
+    if (!parse_mi_request(line, req)) {
+        out += "{\"id\":" + req.id +
+               ",\"ok\":false,\"error\":\"bad request\"}\n";
+        return true;
+    }
+
+    console.str("");
+    uint64_t waits = events->wait_count();
+    std::string fields;
+    command_result result;
+    if (req.cmd[0] == '-') {
+        result = mi_command(req, *wait_status, fields);
+    } else {
+        // Aliases, `repeat` and breakpoint commands work here too
+        line_reader none = [](std::string &) { return false; };
+        result = run_line(req.cmd + " " + req.fields["args"], none,
+                          wait_status);
+    }
+    std::cout.flush();
+
+    std::string text = console.str();
+    out += "{\"id\":" + req.id;
+    if (result == CMD_DONE || result == CMD_EXIT) {
+        out += ",\"ok\":true" + fields + ",\"console\":";
+    } else {
+        while (!text.empty() && text.back() == '\n') {
+            text.pop_back();
+        }
+        out += ",\"ok\":false,\"error\":";
+    }
+    json_string(out, text);
+    out += "}\n";
+
+    // The target ran, tell where it is now
+    if (events->wait_count() != waits) {
+        mi_stop_event(out, "stopped", *wait_status);
+    }
+    return result != CMD_EXIT;
+}
+
+command_result Debugger::mi_command(mi_request &req, int wait_status,
+                                    std::string &fields) {
+    bool stopped = WIFSTOPPED(wait_status);
+    if (req.cmd == "-status") {
+        fields += ",\"pid\":" + std::to_string(c_pid) + ",\"state\":";
+        fields += stopped ? "\"stopped\"" : "\"exited\"";
+        return CMD_DONE;
+    }
+    if (req.cmd != "-regs" && req.cmd != "-read-memory" &&
+        req.cmd != "-stack") {
+        unknown();
+        return CMD_UNKNOWN;
+    }
+    run_requirement(stopped, MSG_SHOULD_BE_RUNNED);
+
+    if (req.cmd == "-regs") {
+        struct user_regs_struct regs;
+        Tgt->get_regs(regs);
+        std::map<std::string, unsigned long long> p_map = expand_regs(regs);
+        fields += ",\"regs\":{";
+        const char *sep = "";
+        for (auto &kv: p_map) {
+            // Short names are padded for the table of `ir`
+            std::string name = kv.first;
+            name.erase(0, name.find_first_not_of(' '));
+            fields += sep;
+            json_string(fields, name);
+            fields += ':';
+            json_hex(fields, kv.second);
+            sep = ",";
+        }
+        fields += '}';
+    } else if (req.cmd == "-read-memory") {
+        uint64_t addr, size;
+        if (!mi_number(req.fields["addr"], addr) ||
+            !mi_number(req.fields["size"], size) || size > MI_READ_MAX) {
+            std::cout << "addr and size up to " << std::dec << MI_READ_MAX
+                      << " are needed" << std::endl;
+            return CMD_REFUSED;
+        }
+        std::vector<uint8_t> data(size);
+        if (!Tgt->read_memory(addr, data.data(), size)) {
+            std::cout << "cannot access memory at " << std::hex << (void *)addr
+                      << std::endl;
+            return CMD_REFUSED;
+        }
+        static const char digits[] = "0123456789abcdef";
+        fields += ",\"addr\":";
+        json_hex(fields, addr);
+        fields += ",\"data\":\"";
+        for (uint8_t byte: data) {
+            fields += digits[byte >> 4];
+            fields += digits[byte & 0xf];
+        }
+        fields += '"';
+    } else {
+        std::vector<uint64_t> pcs;
+        uint64_t bias;
+        if (!stack_frames(pcs, bias)) {
+            std::cout << "cannot read registers" << std::endl;
+            return CMD_REFUSED;
+        }
+        fields += ",\"frames\":[";
+        for (size_t i = 0; i < pcs.size(); i++) {
+            fields += i == 0 ? "{\"pc\":" : ",{\"pc\":";
+            json_hex(fields, pcs[i]);
+            uint64_t offset;
+            std::string module;
+            const elf_symbol *sym = function_at(pcs[i], bias, offset, module);
+            if (sym != nullptr) {
+                fields += ",\"function\":";
+                json_string(fields, sym->name);
+                fields += ",\"offset\":" + std::to_string(offset);
+            }
+            if (!module.empty()) {
+                fields += ",\"module\":";
+                json_string(fields, module);
+            }
+            fields += '}';
+        }
+        fields += ']';
+    }
+    return CMD_DONE;
+}
+
+void Debugger::mi_stop_event(std::string &out, const char *name,
+                             int wait_status) {
+    if (!WIFSTOPPED(wait_status)) {
+        mi_exit_event(out, c_pid, wait_status);
+        return;
+    }
+    struct user_regs_struct regs;
+    Tgt->get_regs(regs);
+    out += "{\"event\":\"";
+    out += name;
+    out += "\",\"pid\":" + std::to_string(c_pid) +
+           ",\"signal\":" + std::to_string(WSTOPSIG(wait_status)) + ",\"rip\":";
+    json_hex(out, regs.rip);
+    out += "}\n";
+}
+
+void Debugger::mi_exit_event(std::string &out, pid_t pid, int status) {
+    out += "{\"event\":\"exited\",\"pid\":" + std::to_string(pid);
+    if (WIFEXITED(status)) {
+        out += ",\"code\":" + std::to_string(WEXITSTATUS(status));
+    } else if (WIFSIGNALED(status)) {
+        out += ",\"signal\":" + std::to_string(WTERMSIG(status));
+    }
+    out += "}\n";
+}
+
+void Debugger::next(int *status) {
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+
+    uint8_t buf[MAX_INSTR_SIZE + 1];
+    Tgt->read_memory(regs.rip, buf, MAX_INSTR_SIZE);
+
+    uint64_t *curr_instr_sz =
+        disaska->next_instr_addr(buf, MAX_INSTR_SIZE, regs.rip);
+    // std::cout << curr_instr_sz << std::endl;
+
+    // set_breakpoint((uint64_t) curr_instr_sz);
+
+    if (curr_instr_sz != nullptr) {
+        set_breakpoint((uint64_t)curr_instr_sz);
+        continue_execution(status);
+    } else {
+        step(status);
+    }
+
+    // std::cout << disaska->handle << std::endl;
+    // Get next after CUR_INSTR instruction address
+}
+
+void Debugger::x_set() {
+    uint64_t val;
+    std::string reg;
+
+    cmd_args >> reg;
+    cmd_args >> std::hex >> val;
+
+    // Get actual register values
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+    std::map<std::string, unsigned long long> rm = expand_regs(regs);
+
+    std::cout << reg << std::endl;
+    if (rm.count(reg) == 0) {
+        std::cout << "bad register name" << std::endl;
+        return;
+    }
+
+    rm[reg] = val;
+    flatten_regs(regs, rm);
+    ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+}
+
+void Debugger::x_read() {
+    unsigned long addr, k;
+
+    cmd_args >> std::hex >> addr;
+    cmd_args >> k;
+
+    // A quit pager must not kill the debugger with SIGPIPE
+    FILE *pager_out = nullptr;
+    const char *pager = getenv("PAGER");
+    if (k / 2 > XREAD_PAGER_LINES && mi_fd < 0 && isatty(STDOUT_FILENO)) {
+        std::cout.flush();
+        signal(SIGPIPE, SIG_IGN);
+        pager_out = popen(pager != nullptr ? pager : XREAD_DEFAULT_PAGER, "w");
+    }
+
+    static uint64_t memo[XREAD_CHUNK];
+    static char text[XREAD_CHUNK / 2 * MEMDUMP_QWORD_LINE_MAX];
+    for (unsigned long done = 0; done < k;) {
+        size_t count = std::min<unsigned long>(k - done, XREAD_CHUNK);
+        uint64_t chunk_addr = addr + done * sizeof(uint64_t);
+        size_t text_size = 0;
+        if (!Tgt->read_memory(chunk_addr, (uint8_t *)memo,
+                              count * sizeof(uint64_t))) {
+            text_size = snprintf(text, sizeof(text),
+                                 "cannot access memory at %#lx\n", chunk_addr);
+            count = k - done;
+        } else {
+            for (size_t i = 0; i < count; i += 2) {
+                text_size += format_qword_line(
+                    chunk_addr + i * sizeof(uint64_t), &memo[i],
+                    std::min<size_t>(2, count - i), text + text_size);
+            }
+        }
+
+        // Without the pager it goes through std::cout, which may be captured
+        if (pager_out == nullptr) {
+            std::cout.write(text, text_size);
+        } else if (fwrite(text, 1, text_size, pager_out) != text_size) {
+            break;
+        }
+        done += count;
+    }
+
+    if (pager_out != nullptr) {
+        pclose(pager_out);
+        signal(SIGPIPE, SIG_DFL);
+    } else {
+        std::cout.flush();
+    }
+}
+
+void Debugger::dump_memory() {
+    std::string args, path, format_name = "raw";
+    uint64_t addr, size;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+    bool ok = static_cast<bool>(in >> std::hex >> addr >> size >> path);
+    in >> format_name;
+    dump_format format;
+    if (!ok || !parse_dump_format(format_name, format)) {
+        std::cout << "usage: dump <addr> <len> <file> [raw|hex|elf]"
+                  << std::endl;
+        return;
+    }
+
+    MemDump dump(c_pid);
+    uint64_t start_ns = monotonic_ns();
+    if (!dump.write(path.c_str(), addr, size, format)) {
+        perror("dump");
+        return;
+    }
+    uint64_t elapsed_ns = std::max<uint64_t>(monotonic_ns() - start_ns, 1);
+
+    std::cout << "Dumped " << std::dec << dump.copied() / 1024 << " KiB to "
+              << path << ", " << (size - dump.copied()) / 1024
+              << " KiB of holes skipped, in " << elapsed_ns / 1000000
+              << " ms (" << dump.copied() * 1000 / elapsed_ns << " MB/s)"
+              << std::endl;
+}
+
+void Debugger::continue_execution(int *wait_status) {
+    is_started = true;
+    hit_breakpoint = 0;
+
+    for (;;) {
+        // From a syscall catchpoint stop again when the call returns
+        resume(in_syscall ? PTRACE_SYSCALL : PTRACE_CONT);
+        events->wait_process(c_pid, wait_status);
+
+        if (report_syscall_stop(*wait_status) || !WIFSTOPPED(*wait_status) ||
+            WSTOPSIG(*wait_status) != SIGTRAP) {
+            return;
+        }
+
+        // Then we got to breakpoint
+        struct user_regs_struct regs;
+        ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+
+        breakpoint *bp = find_breakpoint(regs.rip - 1);
+        if (bp == nullptr) {
+            return;
+        }
+        if (solib_event(wait_status, *bp, regs)) {
+            // Library loads are not stops of their own
+            if (!WIFSTOPPED(*wait_status)) {
+                return;
+            }
+            continue;
+        }
+
+        // If it's our breakpoint
+        std::cout << "Breakpoint hit at " << std::hex << (void *)bp->addr
+                  << std::endl;
+        hit_breakpoint = bp->addr;
+        step_over_breakpoint(wait_status, *bp, regs);
+        return;
+    }
+}
+
+breakpoint *Debugger::find_breakpoint(uint64_t addr) {
+    auto it = breakpoints.find(addr);
+    return it == breakpoints.end() ? nullptr : &it->second;
+}
+
+const fast_tracepoint *Debugger::find_tracepoint(uint64_t addr) {
+    for (auto &tp: tracepoints) {
+        if (tp.active && addr >= tp.addr && addr < tp.addr + tp.size) {
+            return &tp;
+        }
+    }
+    return nullptr;
+}
+
+breakpoint &Debugger::insert_breakpoint(uint64_t addr, bp_kind kind) {
+    long data = ptrace(PTRACE_PEEKTEXT, c_pid, (void *)addr, 0);
+    breakpoint &bp = breakpoints[addr];
+    bp = {addr, data, kind, 0};
+
+    // Change the real instruction
+    poke_byte(addr, TRAP_BYTE);
+    return bp;
+}
+
+void Debugger::remove_breakpoint(uint64_t addr) {
+    auto it = breakpoints.find(addr);
+    if (it == breakpoints.end()) {
+        return;
+    }
+    poke_byte(addr, (uint8_t)it->second.original_data);
+    breakpoints.erase(it);
+    if (scratch_owner == addr) {
+        scratch_owner = 0;
+    }
+}
+
+void Debugger::poke_byte(uint64_t addr, uint8_t byte) {
+    Tgt->wrote(addr, &byte, sizeof(byte));
+    // A single pwrite, and neighbouring breakpoints are never overwritten
+    // with stale data as it happens with word-sized PTRACE_POKETEXT
+    if (mem_write(&byte, sizeof(byte), addr) == sizeof(byte)) {
+        return;
+    }
+    long data = ptrace(PTRACE_PEEKTEXT, c_pid, (void *)addr, 0);
+    ptrace(PTRACE_POKETEXT, c_pid, (void *)addr,
+           (void *)((data & LSB_TRAP_MASK) | byte));
+}
+
+ssize_t Debugger::mem_read(void *buf, size_t size, uint64_t addr) {
+    ssize_t got = pread(mem_fd, buf, size, addr);
+    if (got > 0) {
+        global_stats.read_bytes(got);
+    }
+    return got;
+}
+
+ssize_t Debugger::mem_write(const void *buf, size_t size, uint64_t addr) {
+    ssize_t put = pwrite(mem_fd, buf, size, addr);
+    if (put > 0) {
+        global_stats.written_bytes(put);
+    }
+    return put;
+}
+
+void Debugger::resume(enum __ptrace_request request, int sig) {
+    Tgt->flush();
+    events->resumed(c_pid);
+    ptrace(request, c_pid, 0, sig);
+}
+
+int Debugger::step_over_breakpoint(int *wait_status, breakpoint &bp,
+                                   struct user_regs_struct &regs) {
+    int calls = displaced_step(wait_status, bp, regs);
+    if (calls > 0) {
+        return calls;
+    }
+
+    // Restore original instruction
+    poke_byte(bp.addr, (uint8_t)bp.original_data);
+
+    // Execute instructions after restoring
+    regs.rip -= 1;
+    ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+    resume(PTRACE_SINGLESTEP);
+
+    // Wait until next breakpoint?
+    events->wait_process(c_pid, wait_status);
+
+    // Reinsert prev breakpoint
+    poke_byte(bp.addr, TRAP_BYTE);
+    return 5;
+}
+
+int Debugger::displaced_step(int *wait_status, breakpoint &bp,
+                             struct user_regs_struct &regs) {
+    uint64_t scratch = scratch_address(bp.addr);
+    if (scratch == 0) {
+        return 0;
+    }
+
+    int calls = 4;
+    if (scratch_owner != bp.addr) {
+        uint8_t code[X86_MAX_INSN_LEN];
+        ssize_t len = mem_read(code, sizeof(code), bp.addr);
+        if (len <= 0) {
+            return 0;
+        }
+        // The copy is made of the original bytes, not of traps
+        for (ssize_t i = 0; i < len; i++) {
+            breakpoint *other = find_breakpoint(bp.addr + i);
+            if (other != nullptr) {
+                code[i] = (uint8_t)other->original_data;
+            }
+        }
+        displaced_insn insn;
+        if (!disaska->relocate(code, len, bp.addr, scratch, insn) ||
+            mem_write(insn.code, insn.size, scratch) != insn.size) {
+            return 0;
+        }
+        Tgt->wrote(scratch, insn.code, insn.size);
+        scratch_owner = bp.addr;
+        scratch_insn = insn;
+        calls += 2;
+    }
+
+    uint64_t rsp = regs.rsp;
+    regs.rip = scratch;
+    ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+    resume(PTRACE_SINGLESTEP);
+    events->wait_process(c_pid, wait_status);
+    if (!WIFSTOPPED(*wait_status)) {
+        return calls;
+    }
+
+    // Back from the copy to the original code, also when a signal stopped
+    // the target before the instruction ran
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+    if (scratch_insn.relative ||
+        (regs.rip >= scratch && regs.rip < scratch + scratch_insn.size)) {
+        regs.rip += bp.addr - scratch;
+    }
+    if (scratch_insn.call && regs.rsp == rsp - sizeof(uint64_t)) {
+        uint64_t ret_addr = bp.addr + scratch_insn.size;
+        ptrace(PTRACE_POKEDATA, c_pid, (void *)regs.rsp, (void *)ret_addr);
+        Tgt->wrote(regs.rsp, (uint8_t *)&ret_addr, sizeof(ret_addr));
+        calls++;
+    }
+    ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+    return calls;
+}
+
+uint64_t Debugger::scratch_address(uint64_t near) {
+    if (scratch_page != 0 || scratch_failed) {
+        return scratch_page;
+    }
+    uint64_t hint = near > 2 * DISPLACED_HINT_GAP
+                        ? (near & ~(uint64_t)(DISPLACED_PAGE_SIZE - 1)) -
+                              DISPLACED_HINT_GAP
+                        : 0;
+    uint64_t args[6] = {hint,
+                        DISPLACED_PAGE_SIZE,
+                        PROT_READ | PROT_EXEC,
+                        MAP_PRIVATE | MAP_ANONYMOUS,
+                        (uint64_t)-1,
+                        0};
+    uint64_t addr;
+    // Errors come back as -4095..-1
+    if (!inject_syscall(SYS_mmap, args, addr) || addr > -4096ull) {
+        scratch_failed = true;
+        return 0;
+    }
+    scratch_page = addr;
+    return scratch_page;
+}
+
+bool Debugger::inject_syscall(long nr, const uint64_t (&args)[6],
+                              uint64_t &ret) {
+    struct user_regs_struct saved, regs;
+    ptrace(PTRACE_GETREGS, c_pid, 0, &saved);
+    errno = 0;
+    long code = ptrace(PTRACE_PEEKTEXT, c_pid, (void *)saved.rip, 0);
+    if (errno != 0) {
+        return false;
+    }
+
+    regs = saved;
+    regs.rax = nr;
+    regs.rdi = args[0];
+    regs.rsi = args[1];
+    regs.rdx = args[2];
+    regs.r10 = args[3];
+    regs.r8 = args[4];
+    regs.r9 = args[5];
+    // Not a syscall restart after an interrupted call
+    regs.orig_rax = -1;
+    ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+    ptrace(PTRACE_POKETEXT, c_pid, (void *)saved.rip,
+           (void *)((code & LSB_SYSCALL_MASK) | SYSCALL_INSN));
+
+    bool ok = false;
+    int status, pending_sig = 0;
+    for (;;) {
+        resume(PTRACE_SINGLESTEP);
+        if (events->wait_process(c_pid, &status) < 0 ||
+            !WIFSTOPPED(status)) {
+            return false;
+        }
+        if ((status >> 8) == SECCOMP_STOP_STATUS) {
+            // A caught call, let it run
+        } else if (WSTOPSIG(status) == SIGTRAP) {
+            ok = true;
+            break;
+        } else {
+            pending_sig = WSTOPSIG(status);
+        }
+    }
+
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+    ret = regs.rax;
+    ptrace(PTRACE_SETREGS, c_pid, 0, &saved);
+    ptrace(PTRACE_POKETEXT, c_pid, (void *)saved.rip, (void *)code);
+    if (pending_sig != 0) {
+        // Queued again, so it is delivered on the next resume
+        kill(c_pid, pending_sig);
+    }
+    return ok;
+}
+
+int Debugger::emulate_prologue(breakpoint &bp, struct user_regs_struct &regs) {
+    uint8_t code[sizeof(long)];
+    memcpy(code, &bp.original_data, sizeof(code));
+
+    size_t len = 0;
+    bool pushed = false, framed = false;
+    if (memcmp(code, ENDBR64, sizeof(ENDBR64) - 1) == 0) {
+        len += sizeof(ENDBR64) - 1;
+    }
+    if (code[len] == PUSH_RBP) {
+        pushed = true;
+        len++;
+        if (memcmp(code + len, MOV_RBP_RSP, sizeof(MOV_RBP_RSP) - 1) == 0) {
+            framed = true;
+            len += sizeof(MOV_RBP_RSP) - 1;
+        }
+    }
+
+    // Never jump over another breakpoint
+    for (size_t i = 1; i < len; i++) {
+        if (find_breakpoint(bp.addr + i) != nullptr) {
+            return 0;
+        }
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    int calls = 1;
+    if (pushed) {
+        regs.rsp -= sizeof(uint64_t);
+        ptrace(PTRACE_POKEDATA, c_pid, (void *)regs.rsp, (void *)regs.rbp);
+        Tgt->wrote(regs.rsp, (uint8_t *)&regs.rbp, sizeof(regs.rbp));
+        calls++;
+    }
+    if (framed) {
+        regs.rbp = regs.rsp;
+    }
+    regs.rip = bp.addr + len;
+    ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+    return calls;
+}
+
+void Debugger::step(int *wait_status) {
+    resume(PTRACE_SINGLESTEP);
+    in_syscall = false;
+    events->wait_process(c_pid, wait_status);
+}
+
+void Debugger::info_regs() {
+    std::string name;
+    struct user_regs_struct regs;
+
+    Tgt->get_regs(regs);
+
+    std::map<std::string, unsigned long long> p_map = expand_regs(regs);
+
+    std::cout << "Registers:" << std::endl;
+
+    int modulus = 0;
+    for (auto kv: p_map) {
+        std::cout << kv.first << "=" << std::setw(16) << std::setfill('0')
+                  << std::hex << kv.second << " ";
+
+        if (++modulus % 3 == 0) {
+            std::cout << std::endl;
+        }
+    }
+
+    // last newline not sent yet
+    if (modulus % 3 != 0)
+        std::cout << std::endl;
+}
+
+void Debugger::disassemble() {
+    struct user_regs_struct regs;
+    Tgt->get_regs(regs);
+
+    Dwarf_Addr low_pc, high_pc;
+    std::string name;
+
+    DwInfo->get_function_by_rip(regs.rip, name, low_pc, high_pc);
+    uint8_t *code = new uint8_t[high_pc - low_pc];
+
+    if (!Tgt->read_memory(low_pc, code, high_pc - low_pc)) {
+        perror("ptrace read");
+        ptrace(PTRACE_DETACH, c_pid, nullptr, nullptr);
+    } else {
+        // Loop over all breakpoints for reverting changes: now dump contains
+        // TRAP instructions
+        for (auto &kv: breakpoints) {
+            if (kv.first >= low_pc && kv.first < high_pc) {
+                // patch_idx contains trap byte
+                int patch_idx = kv.first - low_pc;
+                code[patch_idx] = (uint8_t)kv.second.original_data;
+            }
+        }
+
+        std::cout << "assembly:" << std::endl;
+        disaska->print_disassembly(code, high_pc - low_pc, low_pc);
+    }
+
+    delete[] code;
+}
+
+void Debugger::list_functions() {
+    std::string cmd = "nm " + std::string(target) + " | grep '.* T .*'";
+    system(cmd.c_str());
+}
+
+void Debugger::info_locals() {
+    struct user_regs_struct regs;
+    if (!Tgt->get_regs(regs)) {
+        perror("ptrace(GETREGS)");
+        exit(EXIT_FAILURE);
+    }
+
+    Dwarf_Addr low_pc, high_pc;
+    std::string func_name;
+    DwInfo->get_function_by_rip(regs.rip, func_name, low_pc, high_pc);
+    auto locals = DwInfo->get_local_vars((char *)func_name.c_str());
+    for (auto l: locals) {
+        std::cout << l.first << '=' << (void *)l.second << std::endl;
+    }
+}
 
 void Debugger::set_breakpoint(uint64_t addr) {
     std::cout << "Setting the breakpoint to: " << std::hex << (void *)addr
               << std::endl;
-    long data = ptrace(PTRACE_PEEKTEXT, c_pid, (void *)addr, 0);
-    long breakpoint = (data & LSB_TRAP_MASK) | TRAP_BYTE;
+    breakpoint *bp = find_breakpoint(addr);
+    if (bp != nullptr) {
+        // A temporary one becomes permanent
+        bp->kind = BP_USER;
+        return;
+    }
+    if (find_tracepoint(addr) != nullptr) {
+        std::cout << "a tracepoint covers " << std::hex << (void *)addr
+                  << std::endl;
+        return;
+    }
+
+    // Track using breakpoints
+    insert_breakpoint(addr, BP_USER);
+}
+
+void Debugger::print() {
+    std::string inp;
+    cmd_args >> inp;
+
+    struct user_regs_struct regs;
+    if (!Tgt->get_regs(regs)) {
+        perror("ptrace(GETREGS)");
+        exit(EXIT_FAILURE);
+    }
+
+    Dwarf_Addr low_pc, high_pc;
+    std::string func_name;
+    DwInfo->get_function_by_rip(regs.rip, func_name, low_pc, high_pc);
+    auto locals = DwInfo->get_local_vars((char *)func_name.c_str());
+
+    if (inp[0] == '*') {
+        long val = 0;
+        Tgt->read_memory(locals[std::string(inp.c_str() + 1)], (uint8_t *)&val,
+                         sizeof(val));
+        std::cout << (inp.c_str() + 1) << '=' << (void *)val << std::endl;
+    } else {
+        std::cout << inp << '=' << std::hex << (void *)locals[inp] << std::endl;
+    }
+}
+
+void Debugger::unknown() { std::cout << "unknown command" << std::endl; }
+
+bool Debugger::current_frame(struct user_regs_struct &regs, uint64_t &cfa,
+                             uint64_t &ret_addr) {
+    Dwarf_Addr low_pc = 0, high_pc = 0;
+    std::string func_name;
+    DwInfo->get_function_by_rip(regs.rip, func_name, low_pc, high_pc);
+    if (func_name.empty()) {
+        return false;
+    }
+
+    // Until `push rbp; mov rbp, rsp` is done rbp still belongs to the caller
+    uint8_t prologue[sizeof(uint64_t)];
+    if (!Tgt->read_memory(low_pc, prologue, sizeof(prologue))) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(prologue); i++) {
+        breakpoint *bp = find_breakpoint(low_pc + i);
+        if (bp != nullptr) {
+            prologue[i] = (uint8_t)bp->original_data;
+        }
+    }
+    size_t push_idx = 0;
+    if (memcmp(prologue, ENDBR64, sizeof(ENDBR64) - 1) == 0) {
+        push_idx += sizeof(ENDBR64) - 1;
+    }
+    // Without a frame pointer the frame can not be found from rbp. The jump
+    // of a tracepoint hides the prologue, it is taken as a usual one.
+    if (find_tracepoint(low_pc) == nullptr &&
+        (prologue[push_idx] != PUSH_RBP ||
+         memcmp(prologue + push_idx + 1, MOV_RBP_RSP,
+                sizeof(MOV_RBP_RSP) - 1) != 0)) {
+        return false;
+    }
+    uint64_t push_rbp = low_pc + push_idx;
+
+    if (regs.rip <= push_rbp) {
+        cfa = regs.rsp + sizeof(uint64_t);
+    } else if (regs.rip == push_rbp + 1) {
+        cfa = regs.rsp + 2 * sizeof(uint64_t);
+    } else {
+        cfa = regs.rbp + 2 * sizeof(uint64_t);
+    }
+
+    ret_addr = 0;
+    Tgt->read_memory(cfa - sizeof(uint64_t), (uint8_t *)&ret_addr,
+                     sizeof(ret_addr));
+    return true;
+}
+
+void Debugger::backtrace() {
+    std::vector<uint64_t> pcs;
+    uint64_t bias;
+    if (!stack_frames(pcs, bias)) {
+        std::cout << "cannot read registers" << std::endl;
+        return;
+    }
+
+    for (size_t depth = 0; depth < pcs.size(); depth++) {
+        std::cout << "#" << std::dec << depth << "  " << std::hex
+                  << (void *)pcs[depth];
+        uint64_t offset;
+        std::string module;
+        const elf_symbol *sym = function_at(pcs[depth], bias, offset, module);
+        if (sym != nullptr) {
+            std::cout << " in " << sym->name << "+0x" << offset;
+        }
+        if (!module.empty()) {
+            std::cout << " (" << module << ")";
+        }
+        // A return address may be past the line of the call
+        std::string file;
+        uint32_t line;
+        uint64_t addr = pcs[depth] - bias - (depth > 0 ? 1 : 0);
+        if (sym != nullptr && module.empty() &&
+            DwInfo->find_line(addr, file, line)) {
+            std::cout << " at " << file << ":" << std::dec << line;
+        }
+        std::cout << std::endl;
+    }
+}
+
+bool Debugger::stack_frames(std::vector<uint64_t> &pcs, uint64_t &bias) {
+    struct user_regs_struct regs;
+    if (!Tgt->get_regs(regs)) {
+        return false;
+    }
+
+    std::vector<proc_map> maps;
+    if (core_path != nullptr) {
+        ((CoreTarget *)Tgt)->mappings(maps);
+    } else {
+        read_proc_maps(c_pid, maps);
+    }
+    bias = ElfSyms->load_bias(maps);
+    pcs.assign(1, regs.rip);
+
+    // The innermost frame may be in its prologue, the rest use rbp
+    uint64_t cfa, pc, rbp = regs.rbp;
+    if (current_frame(regs, cfa, pc)) {
+        if (cfa == regs.rbp + 2 * sizeof(uint64_t)) {
+            Tgt->read_memory(regs.rbp, (uint8_t *)&rbp, sizeof(rbp));
+        }
+    } else {
+        uint64_t frame[2];
+        if (!Tgt->read_memory(rbp, (uint8_t *)frame, sizeof(frame))) {
+            return true;
+        }
+        rbp = frame[0];
+        pc = frame[1];
+    }
+
+    while (pc != 0 && pcs.size() < BT_MAX_FRAMES) {
+        pcs.push_back(pc);
+
+        // Saved rbp and the return address, callers are higher on the stack
+        uint64_t frame[2];
+        if (rbp == 0 ||
+            !Tgt->read_memory(rbp, (uint8_t *)frame, sizeof(frame)) ||
+            (frame[0] != 0 && frame[0] <= rbp)) {
+            break;
+        }
+        rbp = frame[0];
+        pc = frame[1];
+    }
+    return true;
+}
+
+uint64_t Debugger::run_to_temp_stops(int *wait_status,
+                                     const std::vector<temp_stop> &stops) {
+    for (auto &stop: stops) {
+        if (find_tracepoint(stop.addr) != nullptr) {
+            std::cout << "a tracepoint covers " << std::hex
+                      << (void *)stop.addr << ", not stopping there"
+                      << std::endl;
+        } else if (find_breakpoint(stop.addr) == nullptr) {
+            insert_breakpoint(stop.addr, BP_TEMP);
+        }
+    }
+
+    uint64_t reached = 0;
+    bool exited = false;
+    for (;;) {
+        resume(PTRACE_CONT);
+        events->wait_process(c_pid, wait_status);
+
+        if (!WIFSTOPPED(*wait_status)) {
+            exited = true;
+            break;
+        }
+        if (WSTOPSIG(*wait_status) != SIGTRAP ||
+            report_syscall_stop(*wait_status)) {
+            break;
+        }
+
+        struct user_regs_struct regs;
+        ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+        breakpoint *bp = find_breakpoint(regs.rip - 1);
+        if (bp == nullptr) {
+            break;
+        }
+        if (solib_event(wait_status, *bp, regs)) {
+            if (!WIFSTOPPED(*wait_status)) {
+                exited = true;
+                break;
+            }
+            continue;
+        }
+
+        if (bp->kind != BP_TEMP) {
+            std::cout << "Breakpoint hit at " << std::hex << (void *)bp->addr
+                      << std::endl;
+            hit_breakpoint = bp->addr;
+            step_over_breakpoint(wait_status, *bp, regs);
+            break;
+        }
+
+        bool matched = false;
+        for (auto &stop: stops) {
+            if (stop.addr != bp->addr || regs.rsp < stop.min_rsp) {
+                continue;
+            }
+            uint64_t cfa = 0, ret_addr;
+            if (stop.min_cfa != 0) {
+                regs.rip -= 1;
+                current_frame(regs, cfa, ret_addr);
+                regs.rip += 1;
+            }
+            if (cfa >= stop.min_cfa) {
+                matched = true;
+                break;
+            }
+        }
+
+        if (matched) {
+            // Stop right at the address, the trap is removed below
+            reached = bp->addr;
+            regs.rip -= 1;
+            ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+            break;
+        }
+
+        // A deeper frame of a recursive call, keep going
+        step_over_breakpoint(wait_status, *bp, regs);
+        if (!WIFSTOPPED(*wait_status)) {
+            exited = true;
+            break;
+        }
+    }
+
+    for (auto &stop: stops) {
+        breakpoint *bp = find_breakpoint(stop.addr);
+        if (bp == nullptr || bp->kind != BP_TEMP) {
+            continue;
+        }
+        if (exited) {
+            breakpoints.erase(stop.addr);
+        } else {
+            remove_breakpoint(stop.addr);
+        }
+    }
+
+    return reached;
+}
+
+void Debugger::print_return_value(const char *func_name) {
+    dw_type type;
+    if (!DwInfo->get_return_type(func_name, type)) {
+        return;
+    }
+
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+
+    std::cout << "Value returned (" << type.name << "): ";
+    if (type.encoding == DW_ATE_float) {
+        struct user_fpregs_struct fpregs;
+        ptrace(PTRACE_GETFPREGS, c_pid, 0, &fpregs);
+        if (type.byte_size == sizeof(float)) {
+            float val;
+            memcpy(&val, &fpregs.xmm_space[0], sizeof(val));
+            std::cout << val << std::endl;
+        } else {
+            double val;
+            memcpy(&val, &fpregs.xmm_space[0], sizeof(val));
+            std::cout << val << std::endl;
+        }
+        return;
+    }
+
+    uint64_t val = regs.rax;
+    if (type.byte_size < sizeof(uint64_t)) {
+        val &= (1ull << (type.byte_size * 8)) - 1;
+    }
+
+    switch (type.encoding) {
+    case DW_ATE_boolean:
+        std::cout << (val ? "true" : "false") << std::endl;
+        break;
+    case DW_ATE_signed:
+    case DW_ATE_signed_char: {
+        // Sign-extend the value to 64 bits
+        int shift = 64 - type.byte_size * 8;
+        std::cout << std::dec << ((int64_t)(val << shift) >> shift)
+                  << std::endl;
+        break;
+    }
+    case DW_ATE_unsigned:
+    case DW_ATE_unsigned_char:
+        std::cout << std::dec << val << std::endl;
+        break;
+    default:
+        if (type.byte_size > 2 * sizeof(uint64_t)) {
+            // Returned in memory, the caller's buffer address is in rax
+            std::cout << "at " << (void *)regs.rax << std::endl;
+        } else if (type.byte_size > sizeof(uint64_t)) {
+            std::cout << "rax=" << (void *)regs.rax
+                      << " rdx=" << (void *)regs.rdx << std::endl;
+        } else {
+            std::cout << (void *)val << std::endl;
+        }
+    }
+}
+
+void Debugger::finish(int *status) {
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+
+    Dwarf_Addr low_pc = 0, high_pc = 0;
+    std::string func_name;
+    uint64_t cfa, ret_addr;
+    DwInfo->get_function_by_rip(regs.rip, func_name, low_pc, high_pc);
+    if (!current_frame(regs, cfa, ret_addr)) {
+        std::cout << MSG_NO_FRAME << std::endl;
+        return;
+    }
+
+    std::cout << "Run till exit from " << func_name << std::endl;
+
+    // After `ret` rsp points right above the return address
+    if (run_to_temp_stops(status, {{ret_addr, cfa, 0}}) == ret_addr) {
+        std::cout << "Returned to " << std::hex << (void *)ret_addr
+                  << std::endl;
+        print_return_value(func_name.c_str());
+    }
+}
+
+void Debugger::until(int *status, bool any_frame) {
+    uint64_t addr;
+    cmd_args >> std::hex >> addr;
+
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+
+    uint64_t cfa, ret_addr;
+    if (!current_frame(regs, cfa, ret_addr)) {
+        std::cout << MSG_NO_FRAME << std::endl;
+        return;
+    }
+
+    uint64_t reached =
+        run_to_temp_stops(status, {{addr, 0, any_frame ? 0 : cfa},
+                                   {ret_addr, cfa, 0}});
+    if (reached != 0) {
+        std::cout << "Stopped at " << std::hex << (void *)reached << std::endl;
+    }
+}
+
+void Debugger::ftrace(int *wait_status) {
+    std::string args, glob, out_path;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+    if (!(in >> glob)) {
+        std::cout << "usage: ftrace <glob> [file]" << std::endl;
+        return;
+    }
+    if (!(in >> out_path)) {
+        out_path = FTRACE_DEFAULT_OUTPUT;
+    }
+
+    uint64_t bias = ElfSyms->load_bias(c_pid);
+    std::vector<std::string> names;
+    for (auto &sym: ElfSyms->functions()) {
+        uint64_t addr = sym.addr + bias;
+        if (fnmatch(glob.c_str(), sym.name.c_str(), 0) != 0 ||
+            find_breakpoint(addr) != nullptr ||
+            find_tracepoint(addr) != nullptr) {
+            continue;
+        }
+        insert_breakpoint(addr, BP_TRACE_ENTRY).trace_ref = names.size();
+        names.push_back(sym.name);
+    }
+    if (names.empty()) {
+        std::cout << "no functions match " << glob << std::endl;
+        return;
+    }
+    std::cout << "Tracing " << std::dec << names.size() << " functions"
+              << std::endl;
+
+    TraceBuffer trace;
+    std::unordered_map<pid_t, std::vector<trace_frame>> stacks;
+    uint64_t syscalls = 0, handler_ns = 0, start_ns = monotonic_ns();
+    bool exited = false;
+    int sig = 0;
+    is_started = true;
+
+    for (;;) {
+        resume(PTRACE_CONT, sig);
+        events->wait_process(c_pid, wait_status);
+        uint64_t hit_ns = monotonic_ns();
+        syscalls += 2;
+        sig = 0;
+
+        if (!WIFSTOPPED(*wait_status)) {
+            exited = true;
+            break;
+        }
+        if (WSTOPSIG(*wait_status) == SIGINT ||
+            report_syscall_stop(*wait_status)) {
+            break;
+        }
+        if (WSTOPSIG(*wait_status) != SIGTRAP) {
+            // Not ours, deliver it to the target
+            sig = WSTOPSIG(*wait_status);
+            continue;
+        }
+
+        struct user_regs_struct regs;
+        ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+        syscalls++;
+
+        breakpoint *bp = find_breakpoint(regs.rip - 1);
+        if (bp == nullptr) {
+            break;
+        }
+
+        if (solib_event(wait_status, *bp, regs)) {
+            syscalls += 5;
+        } else if (bp->kind == BP_TRACE_ENTRY) {
+            // Return address is on the top of the stack right at the entry
+            uint64_t ret_addr =
+                ptrace(PTRACE_PEEKDATA, c_pid, (void *)regs.rsp, 0);
+            syscalls++;
+
+            breakpoint *ret_bp = find_breakpoint(ret_addr);
+            if (ret_bp == nullptr && find_tracepoint(ret_addr) == nullptr) {
+                ret_bp = &insert_breakpoint(ret_addr, BP_TRACE_RETURN);
+                syscalls += 2;
+            }
+            if (ret_bp != nullptr && ret_bp->kind == BP_TRACE_RETURN) {
+                ret_bp->trace_ref++;
+            }
+
+            // A return into a tracepoint jump is not seen, no frame to pop
+            if (ret_bp != nullptr) {
+                stacks[c_pid].push_back(
+                    {bp->trace_ref, regs.rsp + sizeof(uint64_t), ret_addr});
+            }
+            trace.record(c_pid, bp->trace_ref, FTRACE_ENTRY, hit_ns);
+
+            int calls = emulate_prologue(*bp, regs);
+            if (calls == 0) {
+                calls = step_over_breakpoint(wait_status, *bp, regs);
+            }
+            syscalls += calls;
+        } else if (bp->kind == BP_TRACE_RETURN) {
+            // Pop every frame that is gone, longjmp may skip some returns
+            std::vector<trace_frame> &stack = stacks[c_pid];
+            while (!stack.empty() && stack.back().cfa <= regs.rsp) {
+                trace.record(c_pid, stack.back().func, FTRACE_EXIT, hit_ns);
+                breakpoint *frame_bp = find_breakpoint(stack.back().ret_addr);
+                if (frame_bp != nullptr && frame_bp->kind == BP_TRACE_RETURN) {
+                    frame_bp->trace_ref--;
+                }
+                stack.pop_back();
+            }
+
+            if (bp->trace_ref == 0) {
+                // Nobody else returns here, drop the trap instead of stepping
+                remove_breakpoint(bp->addr);
+                regs.rip -= 1;
+                ptrace(PTRACE_SETREGS, c_pid, 0, &regs);
+                syscalls += 2;
+            } else {
+                // Outer recursive frames will return here too
+                syscalls += step_over_breakpoint(wait_status, *bp, regs);
+            }
+        } else {
+            std::cout << "Breakpoint hit at " << std::hex << (void *)bp->addr
+                      << std::endl;
+            hit_breakpoint = bp->addr;
+            step_over_breakpoint(wait_status, *bp, regs);
+            break;
+        }
+
+        if (!WIFSTOPPED(*wait_status)) {
+            exited = true;
+            break;
+        }
+        handler_ns += monotonic_ns() - hit_ns;
+    }
+    uint64_t total_ns = monotonic_ns() - start_ns;
+
+    for (auto it = breakpoints.begin(); it != breakpoints.end();) {
+        if (it->second.kind != BP_TRACE_ENTRY &&
+            it->second.kind != BP_TRACE_RETURN) {
+            ++it;
+            continue;
+        }
+        if (!exited) {
+            poke_byte(it->first, (uint8_t)it->second.original_data);
+        }
+        it = breakpoints.erase(it);
+    }
+
+    size_t events = trace.size();
+    if (!trace.write_chrome_trace(out_path.c_str(), c_pid, names)) {
+        perror("ftrace: write");
+        return;
+    }
+    std::cout << "ftrace: " << std::dec << events << " events written to "
+              << out_path << std::endl;
+    if (events != 0) {
+        std::cout << "ftrace: " << handler_ns / events
+                  << " ns per event in the debugger, " << total_ns / events
+                  << " ns per event in total, "
+                  << (double)syscalls / events << " syscalls per event"
+                  << std::endl;
+    }
+}
+
+std::string Debugger::format_syscall(struct user_regs_struct &regs) {
+    const syscall_desc *desc = syscall_by_nr(regs.orig_rax);
+    std::ostringstream out;
+    if (desc == nullptr) {
+        out << "syscall_" << std::dec << regs.orig_rax;
+    } else {
+        out << desc->name;
+    }
+
+    unsigned long long args[SYSCALL_MAX_ARGS] = {
+        regs.rdi, regs.rsi, regs.rdx, regs.r10, regs.r8, regs.r9};
+    const char *fmt = desc != nullptr && desc->args != nullptr ? desc->args
+                                                               : "xxxxxx";
+    out << '(';
+    for (int i = 0; fmt[i] != '\0' && i < SYSCALL_MAX_ARGS; i++) {
+        if (i != 0) {
+            out << ", ";
+        }
+        switch (fmt[i]) {
+        case 'i':
+            out << std::dec << (long)(int)args[i];
+            break;
+        case 'u':
+            out << std::dec << args[i];
+            break;
+        case 'o':
+            out << '0' << std::oct << args[i];
+            break;
+        case 's': {
+            // Read the string word by word until NUL
+            std::string str;
+            bool done = false;
+            for (uint64_t addr = args[i];
+                 !done && str.size() < SYSCALL_MAX_STR && addr != 0;
+                 addr += sizeof(long)) {
+                errno = 0;
+                long word = ptrace(PTRACE_PEEKDATA, c_pid, (void *)addr, 0);
+                if (errno != 0) {
+                    break;
+                }
+                for (size_t j = 0; j < sizeof(word); j++) {
+                    char c = ((char *)&word)[j];
+                    if (c == '\0') {
+                        done = true;
+                        break;
+                    }
+                    str += c;
+                }
+            }
+            if (args[i] == 0) {
+                out << "NULL";
+            } else {
+                out << '"' << str << (done ? "\"" : "\"...");
+            }
+            break;
+        }
+        default:
+            out << "0x" << std::hex << args[i];
+        }
+    }
+    out << ')';
+    return out.str();
+}
+
+std::string Debugger::format_syscall_result(long ret) {
+    std::ostringstream out;
+    if (ret < 0 && ret > -4096) {
+        out << "-1 " << strerrorname_np(-ret) << " (" << strerror(-ret) << ")";
+    } else if (ret < 0 || ret > 0xffff) {
+        out << "0x" << std::hex << ret;
+    } else {
+        out << std::dec << ret;
+    }
+    return out.str();
+}
+
+bool Debugger::report_syscall_stop(int wait_status) {
+    if (!WIFSTOPPED(wait_status)) {
+        return false;
+    }
+
+    struct user_regs_struct regs;
+    if ((wait_status >> 8) == SECCOMP_STOP_STATUS) {
+        ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+        std::cout << "Catchpoint (call to syscall), " << format_syscall(regs)
+                  << std::endl;
+        in_syscall = true;
+        return true;
+    }
+    if (in_syscall && WSTOPSIG(wait_status) == SYSCALL_STOP_SIG) {
+        ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+        const syscall_desc *desc = syscall_by_nr(regs.orig_rax);
+        std::cout << "Catchpoint (returned from syscall "
+                  << (desc != nullptr ? desc->name : "?")
+                  << ") = " << format_syscall_result(regs.rax) << std::endl;
+        in_syscall = false;
+        return true;
+    }
+    return false;
+}
+
+bool Debugger::parse_syscalls(std::istream &in, std::set<long> &nrs) {
+    std::string name;
+    while (in >> name) {
+        const syscall_desc *desc = syscall_by_name(name);
+        if (desc != nullptr) {
+            nrs.insert(desc->nr);
+        } else if (!name.empty() && isdigit(name[0])) {
+            nrs.insert(std::stol(name));
+        } else {
+            std::cout << "unknown syscall " << name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void Debugger::catch_syscalls() {
+    std::string args, what;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+
+    std::set<long> nrs;
+    if (!(in >> what) || what != "syscall") {
+        std::cout << "usage: catch syscall [name|number]..." << std::endl;
+        return;
+    }
+    if (!parse_syscalls(in, nrs)) {
+        return;
+    }
+    if (nrs.empty()) {
+        nrs.insert(SYSCALL_ALL);
+    }
+
+    syscall_catches.insert(nrs.begin(), nrs.end());
+    std::cout << "Catchpoint set on " << std::dec
+              << (syscall_catches.count(SYSCALL_ALL) ? 0
+                                                      : syscall_catches.size())
+              << " syscalls (0 - all), takes effect on `r`" << std::endl;
+}
+
+void Debugger::strace(int *wait_status) {
+    std::string args;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+
+    std::set<long> nrs;
+    if (!parse_syscalls(in, nrs)) {
+        return;
+    }
+    if (nrs.empty()) {
+        nrs.insert(SYSCALL_ALL);
+    }
+
+    if (nrs != syscall_filter) {
+        if (is_started) {
+            // The filter is fixed at exec time
+            std::cout << MSG_ALREADY_STARTED << std::endl;
+            return;
+        }
+        syscall_catches = nrs;
+        relaunch(wait_status);
+    }
+
+    struct syscall_stat {
+        uint64_t calls, errors, total_ns;
+    };
+    std::map<long, syscall_stat> stats;
+    struct user_regs_struct regs;
+    uint64_t entry_ns = 0;
+    int sig = 0;
+    bool entry = false;
+    is_started = true;
+    in_syscall = false;
+
+    for (;;) {
+        // PTRACE_SYSCALL from a seccomp stop stops at the syscall exit only
+        resume(entry ? PTRACE_SYSCALL : PTRACE_CONT, sig);
+        events->wait_process(c_pid, wait_status);
+        uint64_t now_ns = monotonic_ns();
+        sig = 0;
+
+        if (WIFEXITED(*wait_status)) {
+            std::cout << "+++ exited with " << std::dec
+                      << WEXITSTATUS(*wait_status) << " +++" << std::endl;
+            break;
+        }
+        if (!WIFSTOPPED(*wait_status)) {
+            std::cout << "+++ killed +++" << std::endl;
+            break;
+        }
+
+        if ((*wait_status >> 8) == SECCOMP_STOP_STATUS) {
+            ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+            entry = true;
+            entry_ns = monotonic_ns();
+            continue;
+        }
+        if (entry && WSTOPSIG(*wait_status) == SYSCALL_STOP_SIG) {
+            // Arguments are taken from the entry registers
+            long ret;
+            ret = ptrace(PTRACE_PEEKUSER, c_pid,
+                         offsetof(struct user_regs_struct, rax), 0);
+            uint64_t took_ns = now_ns - entry_ns;
+            std::cout << format_syscall(regs) << " = "
+                      << format_syscall_result(ret) << " <" << std::dec
+                      << took_ns / 1000000000 << '.' << std::setw(9)
+                      << std::setfill('0') << took_ns % 1000000000 << '>'
+                      << std::endl;
+
+            syscall_stat &st = stats[regs.orig_rax];
+            st.calls++;
+            st.errors += ret < 0 && ret > -4096;
+            st.total_ns += took_ns;
+            entry = false;
+            continue;
+        }
+        entry = false;
+
+        int stopsig = WSTOPSIG(*wait_status);
+        if (stopsig == SIGINT) {
+            break;
+        }
+        if (stopsig == SIGTRAP) {
+            struct user_regs_struct bp_regs;
+            ptrace(PTRACE_GETREGS, c_pid, 0, &bp_regs);
+            breakpoint *bp = find_breakpoint(bp_regs.rip - 1);
+            if (bp != nullptr && solib_event(wait_status, *bp, bp_regs)) {
+                if (!WIFSTOPPED(*wait_status)) {
+                    break;
+                }
+                continue;
+            }
+            if (bp != nullptr) {
+                std::cout << "Breakpoint hit at " << std::hex
+                          << (void *)bp->addr << std::endl;
+                step_over_breakpoint(wait_status, *bp, bp_regs);
+            }
+            break;
+        }
+
+        std::cout << "--- " << strsignal(stopsig) << " ---" << std::endl;
+        sig = stopsig;
+    }
+
+    std::cout << std::setfill(' ') << std::setw(10) << "calls" << std::setw(10)
+              << "errors" << std::setw(14) << "usecs" << "  syscall"
+              << std::endl;
+    for (auto &kv: stats) {
+        const syscall_desc *desc = syscall_by_nr(kv.first);
+        std::cout << std::dec << std::setw(10) << kv.second.calls
+                  << std::setw(10) << kv.second.errors << std::setw(14)
+                  << kv.second.total_ns / 1000 << "  "
+                  << (desc != nullptr ? desc->name : "?") << std::endl;
+    }
+}
 
-    // Track using breakpoints
-    breakpoints[breakpoint_count].addr = addr;
-    breakpoints[breakpoint_count].original_data = data;
-    breakpoint_count++;
+void Debugger::coverage(int *wait_status) {
+    std::string args, out_path;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+    if (!(in >> out_path)) {
+        out_path = COVERAGE_DEFAULT_OUTPUT;
+    }
 
-    // Change the real instruction
-    ptrace(PTRACE_POKETEXT, c_pid, (void *)addr, (void *)breakpoint);
+    uint64_t bias = ElfSyms->load_bias(c_pid);
+    uint64_t start_ns = monotonic_ns();
+    std::vector<uint64_t> leaders;
+    for (auto &sym: ElfSyms->functions()) {
+        const uint8_t *code;
+        if (sym.size == 0 || !ElfSyms->code_at(sym.addr, sym.size, code)) {
+            continue;
+        }
+        disaska->find_block_leaders(code, sym.size, sym.addr + bias, leaders);
+    }
+    std::sort(leaders.begin(), leaders.end());
+    leaders.erase(std::unique(leaders.begin(), leaders.end()), leaders.end());
+    // Keep our own breakpoints working as usual
+    leaders.erase(std::remove_if(leaders.begin(), leaders.end(),
+                                 [this](uint64_t addr) {
+                                     return find_breakpoint(addr) != nullptr;
+                                 }),
+                  leaders.end());
+
+    uint64_t link_start, link_end;
+    ElfSyms->load_range(link_start, link_end);
+    Coverage cov(std::move(leaders), link_end + bias);
+    uint64_t found_ns = monotonic_ns();
+    if (!cov.arm(mem_fd)) {
+        perror("coverage: arm");
+        return;
+    }
+    std::cout << "coverage: " << std::dec << cov.blocks() << " blocks found in "
+              << (found_ns - start_ns) / 1000000 << " ms, armed in "
+              << (monotonic_ns() - found_ns) / 1000000 << " ms" << std::endl;
+
+    bool exited = false;
+    int sig = 0;
+    is_started = true;
+    for (;;) {
+        resume(PTRACE_CONT, sig);
+        events->wait_process(c_pid, wait_status);
+        sig = 0;
+
+        if (!WIFSTOPPED(*wait_status)) {
+            exited = true;
+            break;
+        }
+        if (WSTOPSIG(*wait_status) == SIGINT ||
+            report_syscall_stop(*wait_status)) {
+            break;
+        }
+        if (WSTOPSIG(*wait_status) != SIGTRAP) {
+            sig = WSTOPSIG(*wait_status);
+            continue;
+        }
+
+        // Only rip is needed on the fast path
+        uint64_t rip = ptrace(PTRACE_PEEKUSER, c_pid,
+                              offsetof(struct user_regs_struct, rip), 0);
+        if (cov.hit(mem_fd, rip - 1)) {
+            ptrace(PTRACE_POKEUSER, c_pid,
+                   offsetof(struct user_regs_struct, rip), rip - 1);
+            continue;
+        }
+
+        struct user_regs_struct regs;
+        ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+        breakpoint *bp = find_breakpoint(regs.rip - 1);
+        if (bp != nullptr && solib_event(wait_status, *bp, regs)) {
+            if (!WIFSTOPPED(*wait_status)) {
+                exited = true;
+                break;
+            }
+            continue;
+        }
+        if (bp != nullptr) {
+            std::cout << "Breakpoint hit at " << std::hex << (void *)bp->addr
+                      << std::endl;
+            hit_breakpoint = bp->addr;
+            step_over_breakpoint(wait_status, *bp, regs);
+        }
+        break;
+    }
+
+    if (!exited && !cov.disarm(mem_fd)) {
+        perror("coverage: disarm");
+    }
+
+    char module[PATH_MAX];
+    if (realpath(target, module) == nullptr) {
+        strncpy(module, target, sizeof(module) - 1);
+        module[sizeof(module) - 1] = '\0';
+    }
+    if (!cov.write_drcov(out_path.c_str(), module, link_start + bias,
+                         link_end + bias)) {
+        perror("coverage: write");
+        return;
+    }
+    std::cout << "coverage: " << std::dec << cov.covered() << " of "
+              << cov.blocks() << " blocks covered, written to " << out_path
+              << std::endl;
 }
 
-void Debugger::print() {
-    std::string inp;
-    std::cin >> inp;
+/**
+ * @brief Returns the value of a register used in a memory operand.
+ */
+static uint64_t operand_reg(struct user_regs_struct &regs, x86_reg reg) {
+    switch (reg) {
+    case X86_REG_RAX:
+        return regs.rax;
+    case X86_REG_RBX:
+        return regs.rbx;
+    case X86_REG_RCX:
+        return regs.rcx;
+    case X86_REG_RDX:
+        return regs.rdx;
+    case X86_REG_RSI:
+        return regs.rsi;
+    case X86_REG_RDI:
+        return regs.rdi;
+    case X86_REG_RBP:
+        return regs.rbp;
+    case X86_REG_RSP:
+        return regs.rsp;
+    case X86_REG_R8:
+        return regs.r8;
+    case X86_REG_R9:
+        return regs.r9;
+    case X86_REG_R10:
+        return regs.r10;
+    case X86_REG_R11:
+        return regs.r11;
+    case X86_REG_R12:
+        return regs.r12;
+    case X86_REG_R13:
+        return regs.r13;
+    case X86_REG_R14:
+        return regs.r14;
+    case X86_REG_R15:
+        return regs.r15;
+    case X86_REG_FS:
+        return regs.fs_base;
+    case X86_REG_GS:
+        return regs.gs_base;
+    default:
+        return 0;
+    }
+}
+
+bool Debugger::decode_insn(uint64_t addr, record_insn &insn) {
+    ssize_t len = mem_read(insn.code, sizeof(insn.code), addr);
+    if (len <= 0) {
+        return false;
+    }
+    for (ssize_t i = 0; i < len; i++) {
+        breakpoint *bp = find_breakpoint(addr + i);
+        if (bp != nullptr) {
+            insn.code[i] = (uint8_t)bp->original_data;
+        }
+    }
+    insn.is_breakpoint = find_breakpoint(addr) != nullptr;
+    insn.logged = false;
+    return disaska->decode(insn.code, len, addr, insn.info);
+}
+
+void Debugger::record(int *wait_status) {
+    std::string args, word, out_path = TRACELOG_DEFAULT_OUTPUT;
+    uint64_t max_insns = RECORD_DEFAULT_INSNS;
+    bool with_regs = false, with_mem = false;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+    while (in >> word) {
+        if (word == "regs") {
+            with_regs = true;
+        } else if (word == "mem") {
+            with_regs = with_mem = true;
+        } else if (isdigit(word[0])) {
+            max_insns = std::stoull(word, nullptr, 0);
+        } else {
+            out_path = word;
+        }
+    }
+
+    TraceLog log;
+    if (!log.open(out_path.c_str())) {
+        perror("record");
+        return;
+    }
 
+    // Code is not changed while recording, so every instruction is read and
+    // decoded only once
+    std::unordered_map<uint64_t, record_insn> cache;
     struct user_regs_struct regs;
-    if (ptrace(PTRACE_GETREGS, c_pid, 0, &regs) < 0) {
-        perror("ptrace(GETREGS)");
-        exit(EXIT_FAILURE);
+    ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+    uint64_t rip = regs.rip;
+    uint64_t insns = 0;
+    uint64_t start_ns = monotonic_ns();
+    int sig = 0;
+    is_started = true;
+    in_syscall = false;
+
+    while (insns < max_insns) {
+        auto it = cache.find(rip);
+        if (it == cache.end()) {
+            it = cache.emplace(rip, record_insn()).first;
+            if (!decode_insn(rip, it->second)) {
+                cache.erase(it);
+                std::cout << "record: cannot decode instruction at "
+                          << std::hex << (void *)rip << std::endl;
+                break;
+            }
+        }
+        record_insn &insn = it->second;
+
+        uint64_t write_addr = 0;
+        if (with_mem && insn.info.mem_size != 0) {
+            write_addr = insn.info.mem_disp +
+                         operand_reg(regs, insn.info.mem_segment) +
+                         operand_reg(regs, insn.info.mem_index) *
+                             insn.info.mem_scale;
+            write_addr += insn.info.mem_base == X86_REG_RIP
+                              ? rip + insn.info.size
+                              : operand_reg(regs, insn.info.mem_base);
+        }
+
+        if (insn.is_breakpoint) {
+            poke_byte(rip, insn.code[0]);
+        }
+        resume(PTRACE_SINGLESTEP, sig);
+        events->wait_process(c_pid, wait_status);
+        if (insn.is_breakpoint) {
+            poke_byte(rip, TRAP_BYTE);
+        }
+        bool with_signal = sig != 0;
+        sig = 0;
+
+        if (!WIFSTOPPED(*wait_status) || report_syscall_stop(*wait_status) ||
+            WSTOPSIG(*wait_status) == SIGINT) {
+            break;
+        }
+        if (WSTOPSIG(*wait_status) != SIGTRAP) {
+            // The instruction was not executed, deliver the signal
+            sig = WSTOPSIG(*wait_status);
+            continue;
+        }
+
+        if (with_regs) {
+            ptrace(PTRACE_GETREGS, c_pid, 0, &regs);
+        } else {
+            // Only rip is needed on the fast path
+            regs.rip = ptrace(PTRACE_PEEKUSER, c_pid,
+                              offsetof(struct user_regs_struct, rip), 0);
+        }
+        // A handler of the delivered signal is entered before the
+        // instruction runs, the step stops at its first instruction. The
+        // target of an indirect branch is not known, it is taken as run.
+        if (with_signal && regs.rip != rip + insn.info.size &&
+            !(insn.info.rep && regs.rip == rip) &&
+            !(insn.info.branch &&
+              (insn.info.target == 0 || regs.rip == insn.info.target))) {
+            rip = regs.rip;
+            continue;
+        }
+
+        bool logged = log.step(rip, insn.info.size);
+        if (!insn.logged) {
+            logged = logged && log.insn(insn.code, insn.info.size);
+            insn.logged = true;
+        }
+        insns++;
+
+        if (with_regs) {
+            logged = logged && log.regs(regs);
+            uint8_t data[UINT8_MAX];
+            if (write_addr != 0 &&
+                mem_read(data, insn.info.mem_size, write_addr) ==
+                    insn.info.mem_size) {
+                logged = logged && log.mem(write_addr, data, insn.info.mem_size);
+            }
+        }
+
+        if (!logged) {
+            perror("record");
+            break;
+        }
+        // Stop after a breakpoint as `c` does, library loads go on
+        breakpoint *bp = insn.is_breakpoint ? find_breakpoint(rip) : nullptr;
+        if (bp != nullptr && solibs != nullptr &&
+            bp->addr == solibs->break_address()) {
+            update_solibs();
+        }
+        if (bp != nullptr && bp->kind != BP_SOLIB && insns > 1) {
+            std::cout << "Breakpoint hit at " << std::hex << (void *)rip
+                      << std::endl;
+            break;
+        }
+        rip = regs.rip;
     }
 
-    Dwarf_Addr low_pc, high_pc;
-    std::string func_name;
-    DwInfo->get_function_by_rip(regs.rip, func_name, low_pc, high_pc);
-    auto locals = DwInfo->get_local_vars((char *)func_name.c_str());
+    uint64_t elapsed_ns = std::max<uint64_t>(monotonic_ns() - start_ns, 1);
+    size_t log_size = log.size();
+    if (!log.close()) {
+        perror("record");
+    }
+    record_path = out_path;
 
-    if (inp[0] == '*') {
-        long val = ptrace(PTRACE_PEEKDATA, c_pid,
-                          locals[std::string(inp.c_str() + 1)], nullptr);
-        std::cout << (inp.c_str() + 1) << '=' << (void *)val << std::endl;
+    std::cout << "record: " << std::dec << insns << " instructions in "
+              << elapsed_ns / 1000000 << " ms ("
+              << insns * 1000000000ull / elapsed_ns << " insns/s), "
+              << log_size << " bytes written to " << out_path << std::endl;
+}
+
+void Debugger::replay_view() {
+    std::string args;
+    size_t count = REPLAY_DEFAULT_COUNT;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+    in >> count;
+
+    if (record_path.empty()) {
+        std::cout << "nothing recorded" << std::endl;
+        return;
+    }
+
+    std::deque<trace_step> steps;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> code;
+    uint64_t total;
+    if (!TraceLog::read_tail(record_path.c_str(), count, steps, code, total)) {
+        std::cout << "cannot read " << record_path << std::endl;
+        return;
+    }
+
+    std::cout << "last " << std::dec << steps.size() << " of " << total
+              << " instructions:" << std::endl;
+    for (size_t i = steps.size(); i-- > 0;) {
+        trace_step &step = steps[i];
+        std::vector<uint8_t> &bytes = code[step.rip];
+        std::cout << std::dec << "-" << steps.size() - i << "\t";
+        disaska->print_disassembly(bytes.data(), bytes.size(), step.rip);
+
+        for (auto &reg: step.regs) {
+            std::cout << "\t" << trace_reg_name(reg.first) << "=" << std::hex
+                      << reg.second << std::endl;
+        }
+        for (auto &mem: step.mem) {
+            std::cout << "\t[" << std::hex << (void *)mem.addr << "] <-";
+            for (uint8_t byte: mem.data) {
+                std::cout << " " << std::setw(2) << std::setfill('0')
+                          << (int)byte;
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
+pid_t Debugger::inject_fork(pid_t pid, int *child_status) {
+    struct user_regs_struct saved, regs;
+    ptrace(PTRACE_GETREGS, pid, 0, &saved);
+    errno = 0;
+    long code = ptrace(PTRACE_PEEKTEXT, pid, (void *)saved.rip, 0);
+    if (errno != 0) {
+        return -1;
+    }
+
+    regs = saved;
+    regs.rax = SYS_fork;
+    // Not a syscall restart after an interrupted call
+    regs.orig_rax = -1;
+    ptrace(PTRACE_SETREGS, pid, 0, &regs);
+    ptrace(PTRACE_POKETEXT, pid, (void *)saved.rip,
+           (void *)((code & LSB_SYSCALL_MASK) | SYSCALL_INSN));
+    ptrace(PTRACE_SETOPTIONS, pid, 0, trace_options | PTRACE_O_TRACEFORK);
+
+    pid_t child = -1;
+    int status, pending_sig = 0;
+    for (;;) {
+        ptrace(PTRACE_SINGLESTEP, pid, 0, 0);
+        if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) {
+            return -1;
+        }
+        if ((status >> 8) == (SIGTRAP | (PTRACE_EVENT_FORK << 8))) {
+            unsigned long msg;
+            ptrace(PTRACE_GETEVENTMSG, pid, 0, &msg);
+            child = msg;
+        } else if ((status >> 8) == SECCOMP_STOP_STATUS) {
+            // fork is one of the caught calls, let it run
+        } else if (WSTOPSIG(status) == SIGTRAP) {
+            break;
+        } else {
+            pending_sig = WSTOPSIG(status);
+        }
+    }
+
+    ptrace(PTRACE_SETOPTIONS, pid, 0, trace_options);
+    ptrace(PTRACE_SETREGS, pid, 0, &saved);
+    ptrace(PTRACE_POKETEXT, pid, (void *)saved.rip, (void *)code);
+    if (pending_sig != 0) {
+        // Queued again, so it is delivered on the next resume
+        kill(pid, pending_sig);
+    }
+    if (child < 0) {
+        return -1;
+    }
+
+    // The child is stopped right after the fork with the same patched code
+    waitpid(child, child_status, __WALL);
+    ptrace(PTRACE_SETOPTIONS, child, 0, trace_options);
+    ptrace(PTRACE_SETREGS, child, 0, &saved);
+    ptrace(PTRACE_POKETEXT, child, (void *)saved.rip, (void *)code);
+    return child;
+}
+
+void Debugger::make_checkpoint() {
+    if (in_syscall) {
+        std::cout << MSG_IN_SYSCALL << std::endl;
+        return;
+    }
+
+    int status;
+    pid_t pid = inject_fork(c_pid, &status);
+    if (pid < 0) {
+        std::cout << "cannot create a checkpoint" << std::endl;
+        return;
+    }
+
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, pid, 0, &regs);
+    checkpoints.push_back({pid, regs.rip, breakpoints});
+    events->watch(pid);
+    std::cout << "checkpoint " << std::dec << checkpoints.size() - 1
+              << ": process " << pid << " at " << std::hex << (void *)regs.rip
+              << std::endl;
+}
+
+void Debugger::restart(int *wait_status) {
+    size_t n;
+    if (!(cmd_args >> std::dec >> n) || n >= checkpoints.size()) {
+        cmd_args.clear();
+        std::cout << "no such checkpoint" << std::endl;
+        return;
+    }
+
+    // Fork the checkpoint again, so it can be restarted more than once
+    checkpoint &cp = checkpoints[n];
+    int status;
+    pid_t pid = inject_fork(cp.pid, &status);
+    if (pid < 0) {
+        std::cout << "cannot restart checkpoint " << std::dec << n
+                  << std::endl;
+        return;
+    }
+
+    events->unwatch(c_pid);
+    kill(c_pid, SIGKILL);
+    waitpid(c_pid, nullptr, __WALL);
+    switch_process(pid);
+    *wait_status = status;
+    in_syscall = false;
+    is_started = true;
+
+    // Bring the trap bytes in the copy up to date
+    for (auto &kv: cp.breakpoints) {
+        if (find_breakpoint(kv.first) == nullptr) {
+            poke_byte(kv.first, (uint8_t)kv.second.original_data);
+        }
+    }
+    for (auto &kv: breakpoints) {
+        if (cp.breakpoints.find(kv.first) == cp.breakpoints.end()) {
+            poke_byte(kv.first, TRAP_BYTE);
+        }
+    }
+
+    // Libraries loaded after the checkpoint are gone in the copy
+    update_solibs();
+
+    std::cout << "switched to checkpoint " << std::dec << n << ", process "
+              << pid << " at " << std::hex << (void *)cp.rip << std::endl;
+}
+
+void Debugger::gcore() {
+    std::string args, word, out_path = "core." + std::to_string(c_pid);
+    bool skip_ro = false;
+    std::getline(cmd_args, args);
+    std::istringstream in(args);
+    while (in >> word) {
+        if (word == "skip-ro") {
+            skip_ro = true;
+        } else {
+            out_path = word;
+        }
+    }
+
+    CoreDump dump(c_pid);
+    dump.add_thread(c_pid);
+    // The core shows the program, not the trap bytes planted in it
+    for (auto &kv: breakpoints) {
+        dump.add_shadow(kv.first, (uint8_t)kv.second.original_data);
+    }
+
+    // Other threads are not traced, they stay stopped until the memory is
+    // written, so their stacks match their registers
+    std::vector<pid_t> seized;
+    std::string task_path = "/proc/" + std::to_string(c_pid) + "/task";
+    DIR *tasks = opendir(task_path.c_str());
+    struct dirent *entry;
+    while (tasks != nullptr && (entry = readdir(tasks)) != nullptr) {
+        pid_t tid = atoi(entry->d_name);
+        if (tid <= 0 || tid == c_pid ||
+            ptrace(PTRACE_SEIZE, tid, 0, 0) < 0) {
+            continue;
+        }
+        ptrace(PTRACE_INTERRUPT, tid, 0, 0);
+        waitpid(tid, nullptr, __WALL);
+        seized.push_back(tid);
+    }
+    if (tasks != nullptr) {
+        closedir(tasks);
+    }
+    for (pid_t tid: seized) {
+        dump.add_thread(tid);
+    }
+
+    uint64_t start_ns = monotonic_ns();
+    bool written = dump.write(out_path.c_str(), skip_ro);
+    int write_errno = errno;
+    for (pid_t tid: seized) {
+        ptrace(PTRACE_DETACH, tid, 0, 0);
+    }
+    if (!written) {
+        errno = write_errno;
+        perror("gcore");
+        return;
+    }
+    uint64_t elapsed_ns = std::max<uint64_t>(monotonic_ns() - start_ns, 1);
+
+    std::cout << "Saved corefile " << out_path << ": " << std::dec
+              << dump.dumped() / 1024 << " KiB of memory, "
+              << dump.written() / 1024 << " KiB non-zero, in "
+              << elapsed_ns / 1000000 << " ms ("
+              << dump.dumped() * 1000 / elapsed_ns << " MB/s)" << std::endl;
+}
+
+/**
+ * @brief Parses an address range given as hex `start-end` or as the name of
+ * a mapping, an empty string is the whole address space.
+ */
+static bool parse_range(const std::string &range,
+                        const std::vector<proc_map> &maps, uint64_t &start,
+                        uint64_t &end) {
+    start = 0;
+    end = UINT64_MAX;
+    if (range.empty()) {
+        return true;
+    }
+
+    size_t dash = range.find('-');
+    if (dash != std::string::npos && range[0] != '[' && range[0] != '/') {
+        start = strtoull(range.c_str(), nullptr, 16);
+        end = strtoull(range.c_str() + dash + 1, nullptr, 16);
     } else {
-        std::cout << inp << '=' << std::hex << (void *)locals[inp] << std::endl;
+        // All mappings of a file or e.g. [heap]
+        start = UINT64_MAX;
+        end = 0;
+        for (auto &map: maps) {
+            if (map.path == range) {
+                start = std::min(start, map.start);
+                end = std::max(end, map.end);
+            }
+        }
+    }
+    return start < end;
+}
+
+void Debugger::find() {
+    std::string args;
+    std::getline(cmd_args, args);
+
+    // A quoted pattern may contain spaces
+    size_t begin = args.find_first_not_of(" \t"), stop = args.size();
+    if (begin == std::string::npos) {
+        std::cout << "usage: find <\"string\"|value> [start-end|mapping]"
+                  << std::endl;
+        return;
+    }
+    if (args[begin] == '"') {
+        stop = begin + 1;
+        while (stop < args.size() && args[stop] != '"') {
+            stop += args[stop] == '\\' ? 2 : 1;
+        }
+        stop = std::min(stop + 1, args.size());
+    } else {
+        stop = std::min(args.find_first_of(" \t", begin), args.size());
+    }
+
+    std::vector<uint8_t> pattern;
+    if (!parse_pattern(args.substr(begin, stop - begin), pattern)) {
+        std::cout << "bad pattern" << std::endl;
+        return;
+    }
+
+    std::vector<proc_map> maps;
+    read_proc_maps(c_pid, maps);
+    std::string range;
+    std::istringstream(args.substr(stop)) >> range;
+    uint64_t start, end;
+    if (!parse_range(range, maps, start, end)) {
+        std::cout << "bad range" << std::endl;
+        return;
+    }
+
+    int threads = std::min<int>(std::thread::hardware_concurrency(),
+                                MEMSEARCH_MAX_THREADS);
+    MemSearch search(c_pid);
+    std::vector<uint64_t> matches;
+    uint64_t start_ns = monotonic_ns();
+    if (!search.search(pattern, start, end, threads, matches)) {
+        perror("find");
+        return;
+    }
+    uint64_t elapsed_ns = std::max<uint64_t>(monotonic_ns() - start_ns, 1);
+
+    for (size_t i = 0; i < matches.size() && i < FIND_MAX_PRINT; i++) {
+        std::cout << std::hex << (void *)matches[i];
+        auto map = std::upper_bound(
+            maps.begin(), maps.end(), matches[i],
+            [](uint64_t addr, const proc_map &map) {
+                return addr < map.start;
+            });
+        if (map != maps.begin() && !(--map)->path.empty()) {
+            std::cout << " " << map->path;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::dec << matches.size() << " matches";
+    if (matches.size() > FIND_MAX_PRINT) {
+        std::cout << " (first " << FIND_MAX_PRINT << " shown)";
+    }
+    std::cout << ", scanned " << search.scanned() / 1024 << " KiB in "
+              << elapsed_ns / 1000000 << " ms ("
+              << search.scanned() * 1000 / elapsed_ns << " MB/s)" << std::endl;
+}
+
+void Debugger::drop_snapshot() {
+    if (snapshot == nullptr) {
+        return;
+    }
+    events->unwatch(snapshot->copy());
+    kill(snapshot->copy(), SIGKILL);
+    waitpid(snapshot->copy(), nullptr, __WALL);
+    delete snapshot;
+    snapshot = nullptr;
+}
+
+void Debugger::snap() {
+    if (in_syscall) {
+        std::cout << MSG_IN_SYSCALL << std::endl;
+        return;
+    }
+
+    drop_snapshot();
+    int status;
+    pid_t pid = inject_fork(c_pid, &status);
+    if (pid < 0) {
+        std::cout << "cannot take a snapshot" << std::endl;
+        return;
+    }
+
+    snapshot = new MemSnapshot(c_pid, pid);
+    events->watch(pid);
+    if (!snapshot->start()) {
+        perror("snap");
+        drop_snapshot();
+        return;
+    }
+    std::cout << "snapshot taken as process " << std::dec << pid;
+    if (!snapshot->tracks_writes()) {
+        std::cout << ", no soft-dirty support: snapdiff compares all "
+                     "resident pages";
     }
+    std::cout << std::endl;
 }
 
-void Debugger::unknown() { std::cout << "unknown command" << std::endl; }
\ No newline at end of file
+void Debugger::snapdiff() {
+    std::string range;
+    std::getline(cmd_args, range);
+    std::istringstream(range) >> range;
+    if (snapshot == nullptr) {
+        std::cout << "no snapshot, use snap first" << std::endl;
+        return;
+    }
+
+    std::vector<proc_map> maps;
+    read_proc_maps(c_pid, maps);
+    uint64_t start, end;
+    if (!parse_range(range, maps, start, end)) {
+        std::cout << "bad range" << std::endl;
+        return;
+    }
+
+    std::vector<mem_change> changes;
+    uint64_t start_ns = monotonic_ns();
+    if (!snapshot->diff(start, end, changes)) {
+        perror("snapdiff");
+        return;
+    }
+    uint64_t elapsed_ns = monotonic_ns() - start_ns;
+
+    // Trap bytes are not changes of the program
+    for (auto &change: changes) {
+        for (auto &kv: breakpoints) {
+            if (change.in_snapshot && kv.first >= change.addr &&
+                kv.first < change.addr + change.size) {
+                uint8_t orig = kv.second.original_data & 0xff;
+                change.old_data[kv.first - change.addr] = orig;
+                change.new_data[kv.first - change.addr] = orig;
+            }
+        }
+    }
+    changes.erase(std::remove_if(changes.begin(), changes.end(),
+                                 [](const mem_change &change) {
+                                     return change.in_snapshot &&
+                                            change.old_data == change.new_data;
+                                 }),
+                  changes.end());
+
+    uint64_t bias = ElfSyms->load_bias(maps);
+    for (size_t i = 0; i < changes.size() && i < SNAPDIFF_MAX_PRINT; i++) {
+        mem_change &change = changes[i];
+        std::cout << std::hex << (void *)change.addr;
+        const elf_symbol *sym = ElfSyms->find_object(change.addr - bias);
+        if (sym == nullptr) {
+            sym = ElfSyms->find_function(change.addr - bias);
+        }
+        auto map = std::upper_bound(
+            maps.begin(), maps.end(), change.addr,
+            [](uint64_t addr, const proc_map &map) {
+                return addr < map.start;
+            });
+        if (sym != nullptr) {
+            std::cout << " <" << sym->name << "+0x"
+                      << change.addr - bias - sym->addr << ">";
+        } else if (map != maps.begin() && !(--map)->path.empty()) {
+            std::cout << " <" << map->path << "+0x" << change.addr - map->start
+                      << ">";
+        }
+
+        std::cout << ": " << std::dec << change.size << " bytes";
+        if (!change.in_snapshot) {
+            std::cout << " not in the snapshot" << std::endl;
+            continue;
+        }
+        std::cout << std::hex << std::setfill('0');
+        for (size_t j = 0; j < change.size && j < SNAPDIFF_MAX_BYTES; j++) {
+            std::cout << " " << std::setw(2) << (int)change.old_data[j];
+        }
+        std::cout << " ->";
+        for (size_t j = 0; j < change.size && j < SNAPDIFF_MAX_BYTES; j++) {
+            std::cout << " " << std::setw(2) << (int)change.new_data[j];
+        }
+        std::cout << (change.size > SNAPDIFF_MAX_BYTES ? " ..." : "")
+                  << std::setfill(' ') << std::endl;
+    }
+    std::cout << std::dec << changes.size() << " changes";
+    if (changes.size() > SNAPDIFF_MAX_PRINT) {
+        std::cout << " (first " << SNAPDIFF_MAX_PRINT << " shown)";
+    }
+    std::cout << ", " << snapshot->compared() << " pages compared in "
+              << elapsed_ns / 1000 << " us" << std::endl;
+}
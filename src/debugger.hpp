@@ -4,20 +4,52 @@
 #include "cfg.hpp"
 #include "disassm.hpp"
 #include "dwarfinfo.hpp"
+#include "elfinfo.hpp"
+#include "eventloop.hpp"
+#include "fasttrace.hpp"
+#include "gdbserver.hpp"
+#include "mi.hpp"
+#include "script.hpp"
+#include "snapshot.hpp"
+#include "solib.hpp"
+#include "target.hpp"
 #include "utils.hpp"
 
 #include <map>
+#include <set>
+#include <sstream>
 #include <sys/ptrace.h>
 #include <sys/reg.h>
 #include <sys/types.h>
 #include <sys/user.h>
 #include <sys/wait.h>
+#include <unordered_map>
+#include <vector>
 
-#define MAX_BREAKPOINTS 100
-#define MAX_XREAD_K 8
+// Qwords read by `x` at once
+#define XREAD_CHUNK 4096
+// Longer `x` output goes through the pager
+#define XREAD_PAGER_LINES 40
+#define XREAD_DEFAULT_PAGER "less"
+#define RECORD_DEFAULT_INSNS 1000000
+#define REPLAY_DEFAULT_COUNT 20
+#define FIND_MAX_PRINT 32
+#define SNAPDIFF_MAX_PRINT 64
+#define SNAPDIFF_MAX_BYTES 16
+// Breakpointed instructions are executed from a page mapped in the target
+#define DISPLACED_PAGE_SIZE 0x1000
+// Asked below the code, rip-relative operands reach it with 32 bits
+#define DISPLACED_HINT_GAP 0x100000
 
 #define MSG_SHOULD_BE_RUNNED "target not started"
 #define MSG_ALREADY_STARTED "target is already in run"
+#define MSG_NO_FRAME "cannot find the current frame"
+#define MSG_IN_SYSCALL "the target is stopped inside a syscall"
+#define MSG_CORE_ONLY "not available for a core file"
+#define MSG_NOT_RUNNING "the target is gone, not run"
+#define BT_MAX_FRAMES 256
+// The largest `-read-memory` of the machine interface
+#define MI_READ_MAX (1 << 20)
 
 #define expand_regs(regs)                                                      \
     {{"rdi", regs.rdi}, {"rsi", regs.rsi}, {"rdx", regs.rdx},                  \
@@ -50,9 +82,60 @@
 #define run_requirement(is_running, msg)                                       \
     if (!is_running) {                                                         \
         std::cout << msg << std::endl;                                         \
-        continue;                                                              \
+        return CMD_REFUSED;                                                    \
     }
 
+/**
+ * @brief Outcomes of a command.
+ */
+enum command_result {
+    CMD_DONE,    // the command ran, even if it reported a problem
+    CMD_REFUSED, // the target is not in the state the command needs
+    CMD_UNKNOWN, // no such command
+    CMD_EXIT,    // `exit`
+};
+
+/**
+ * @brief What a command needs from the target.
+ */
+enum cmd_requirement {
+    REQ_NONE,
+    REQ_STARTED,     // `r` was run
+    REQ_NOT_STARTED, // `r` was not run yet
+    REQ_STOPPED,     // the process exists and is stopped
+};
+
+class Debugger;
+
+/**
+ * @brief An entry of the command table.
+ */
+struct command_info {
+    /**
+     * @brief What the command needs from the target.
+     */
+    cmd_requirement requirement;
+    /**
+     * @brief Whether the command is available for a core file.
+     */
+    bool on_core;
+    /**
+     * @brief Runs the command, its arguments are in `cmd_args`.
+     */
+    void (*run)(Debugger &dbg, int *wait_status);
+};
+
+/**
+ * @brief Kinds of breakpoints planted by the debugger.
+ */
+enum bp_kind {
+    BP_USER,         // set by `b`/`n`
+    BP_TEMP,         // planted by `finish`/`until` for the command duration
+    BP_TRACE_ENTRY,  // entry of a function traced by `ftrace`
+    BP_TRACE_RETURN, // return address of a traced function
+    BP_SOLIB,        // `_dl_debug_state`, the link map changed
+};
+
 /**
  * @brief Represents a breakpoint in the debugger.
  *
@@ -68,19 +151,126 @@ struct breakpoint {
      * @brief The original data value.
      */
     long original_data;
+    /**
+     * @brief Who planted the breakpoint.
+     */
+    bp_kind kind;
+    /**
+     * @brief Index of the traced function for BP_TRACE_ENTRY, number of
+     * pending frames returning here for BP_TRACE_RETURN.
+     */
+    uint32_t trace_ref;
 };
 
 /**
- * @brief Array of breakpoints.
+ * @brief A place where a run with temporary breakpoints should stop.
  *
- * This static array stores the breakpoints set by the debugger. It has a
- * maximum size of MAX_BREAKPOINTS.
+ * The frame checks make recursion safe: a hit in a deeper frame of the same
+ * function is stepped over instead of stopping.
+ */
+struct temp_stop {
+    /**
+     * @brief The address of the temporary breakpoint.
+     */
+    uint64_t addr;
+    /**
+     * @brief Stop only if rsp at the hit is at least this value (0 - any).
+     */
+    uint64_t min_rsp;
+    /**
+     * @brief Stop only if the CFA of the frame at the hit is at least this
+     * value (0 - any).
+     */
+    uint64_t min_cfa;
+};
+
+/**
+ * @brief A breakpoint on a function of a shared library (`b lib:func`).
+ */
+struct pending_breakpoint {
+    /**
+     * @brief The module name as given to `b`.
+     */
+    std::string module;
+    /**
+     * @brief The function name.
+     */
+    std::string function;
+    /**
+     * @brief The path of the module the breakpoint is resolved in.
+     */
+    std::string path;
+    /**
+     * @brief The run-time address, 0 while the module is not loaded.
+     */
+    uint64_t addr;
+};
+
+/**
+ * @brief A fast tracepoint, a jump to a trampoline patched over the code.
+ */
+struct fast_tracepoint {
+    /**
+     * @brief The traced address.
+     */
+    uint64_t addr;
+    /**
+     * @brief The length of the instructions moved to the trampoline.
+     */
+    uint32_t size;
+    /**
+     * @brief The function name or the address as given to `tp`.
+     */
+    std::string name;
+    /**
+     * @brief Hits drained so far.
+     */
+    uint64_t hits;
+    /**
+     * @brief Whether the process with the tracepoint is still the target.
+     */
+    bool active;
+};
+
+/**
+ * @brief An entry of the decode cache used by `record`.
  */
-static struct breakpoint breakpoints[MAX_BREAKPOINTS];
+struct record_insn {
+    /**
+     * @brief The decoded instruction.
+     */
+    insn_info info;
+    /**
+     * @brief The original bytes of the instruction.
+     */
+    uint8_t code[X86_MAX_INSN_LEN];
+    /**
+     * @brief Whether a breakpoint is set at the instruction.
+     */
+    bool is_breakpoint;
+    /**
+     * @brief Whether the bytes are already in the log.
+     */
+    bool logged;
+};
+
 /**
- * @brief The number of breakpoints set in the debugger.
+ * @brief A stopped copy-on-write copy of the target made by `checkpoint`.
  */
-static int breakpoint_count;
+struct checkpoint {
+    /**
+     * @brief The process ID of the copy.
+     */
+    pid_t pid;
+    /**
+     * @brief The address the copy is stopped at.
+     */
+    uint64_t rip;
+    /**
+     * @brief Breakpoints planted in the copy.
+     */
+    std::unordered_map<uint64_t, breakpoint> breakpoints;
+};
 
 /**
  * @class Debugger
@@ -107,14 +297,169 @@ class Debugger {
      * @brief The target being debugged.
      */
     const char *target;
+    /**
+     * @brief The core file to analyze instead of running the target.
+     */
+    const char *core_path;
     /**
      * @brief Pointer to the DwarfInfo object.
      */
     DwarfInfo *DwInfo;
+    /**
+     * @brief Registers and memory of the live process or the core file.
+     */
+    Target *Tgt;
+    /**
+     * @brief Directories with separate debug info, from `--debug-dir`.
+     */
+    std::vector<std::string> debug_dirs;
     /**
      * @brief Pointer to a Disassm object.
      */
     Disassm *disaska;
+    /**
+     * @brief Pointer to the ElfInfo object with the symbols of the target.
+     */
+    ElfInfo *ElfSyms;
+    /**
+     * @brief Shared libraries of the live target, nullptr if it is static.
+     */
+    SharedLibs *solibs;
+    /**
+     * @brief Breakpoints set in the target, by address.
+     */
+    std::unordered_map<uint64_t, breakpoint> breakpoints;
+    /**
+     * @brief Breakpoints on functions of shared libraries, resolved when
+     * the library is loaded.
+     */
+    std::vector<pending_breakpoint> pending_breakpoints;
+    /**
+     * @brief Every fast tracepoint, the index is the number of it.
+     */
+    std::vector<fast_tracepoint> tracepoints;
+    /**
+     * @brief Tracepoint hits drained from the ring.
+     */
+    std::vector<fasttrace_record> tp_records;
+    /**
+     * @brief The ring of the tracing agent, nullptr if it is not injected.
+     */
+    TraceRing *trace_ring;
+    /**
+     * @brief The address of the ring in the target.
+     */
+    uint64_t agent_ring;
+    /**
+     * @brief The mapping with the trampolines in the target, 0 if none.
+     */
+    uint64_t agent_code;
+    /**
+     * @brief Bytes of `agent_code` in use.
+     */
+    size_t agent_used;
+    /**
+     * @brief `/proc/<pid>/mem` of the target, used to patch single bytes.
+     */
+    int mem_fd;
+    /**
+     * @brief The page for displaced stepping in the target, 0 if not mapped.
+     */
+    uint64_t scratch_page;
+    /**
+     * @brief The breakpoint whose instruction is in the scratch page, 0 if
+     * none.
+     */
+    uint64_t scratch_owner;
+    /**
+     * @brief The copy in the scratch page.
+     */
+    displaced_insn scratch_insn;
+    /**
+     * @brief Whether mapping the scratch page failed for this process.
+     */
+    bool scratch_failed;
+    /**
+     * @brief Where to publish the process ID of the current target.
+     */
+    pid_t *pid_out;
+    /**
+     * @brief System calls requested by `catch syscall`.
+     */
+    std::set<long> syscall_catches;
+    /**
+     * @brief System calls traced by the seccomp filter of the current target.
+     */
+    std::set<long> syscall_filter;
+    /**
+     * @brief Whether the target is stopped at a caught syscall entry.
+     */
+    bool in_syscall;
+    /**
+     * @brief The log written by the last `record`.
+     */
+    std::string record_path;
+    /**
+     * @brief Options set with PTRACE_SETOPTIONS on the current target.
+     */
+    long trace_options;
+    /**
+     * @brief Checkpoints created with `checkpoint`, by number.
+     */
+    std::vector<checkpoint> checkpoints;
+    /**
+     * @brief The memory snapshot taken with `snap` or nullptr.
+     */
+    MemSnapshot *snapshot;
+    /**
+     * @brief Multiplexes the input, signals and the debugged processes.
+     */
+    EventLoop *events;
+    /**
+     * @brief Arguments of the command being run.
+     */
+    std::istringstream cmd_args;
+    /**
+     * @brief Whether the debugger is driven through the machine interface.
+     */
+    bool mi;
+    /**
+     * @brief The Unix socket of the machine interface or nullptr for stdio.
+     */
+    const char *mi_socket;
+    /**
+     * @brief Where machine interface output is written, -1 without it.
+     */
+    int mi_fd;
+    /**
+     * @brief `[host]:port` to serve the GDB remote protocol on or nullptr.
+     */
+    const char *gdbserver_address;
+    /**
+     * @brief Command lines from `-x` and `-ex` run instead of reading the
+     * input.
+     */
+    std::vector<std::string> batch;
+    /**
+     * @brief Command lines by alias name.
+     */
+    std::unordered_map<std::string, std::string> aliases;
+    /**
+     * @brief Command lines run when a breakpoint is hit, by address.
+     */
+    std::unordered_map<uint64_t, std::vector<std::string>> bp_commands;
+    /**
+     * @brief The breakpoint the last `c` stopped at, 0 if none or handled.
+     */
+    uint64_t hit_breakpoint;
+    /**
+     * @brief Whether the command lines of a breakpoint are being run.
+     */
+    bool in_bp_commands;
+    /**
+     * @brief The exit status of the debugger.
+     */
+    int exit_status;
 
   private:
     /**
@@ -125,6 +470,565 @@ class Debugger {
      * @brief Runs the debugger.
      */
     void run_debugger();
+    /**
+     * @brief Waits for the next input line, reporting SIGINT and exits of
+     * the debugged processes meanwhile.
+     *
+     * @param line Filled with the line.
+     * @param wait_status Updated if the target exits, may be nullptr.
+     * @param prompt The prompt to print.
+     * @return false if the input is closed.
+     */
+    bool read_line(std::string &line, int *wait_status, const char *prompt);
+
+    /**
+     * @brief Reads and runs commands until `exit` or the end of the input.
+     *
+     * An empty line repeats the previous command.
+     *
+     * @param wait_status A pointer to the status of the execution, nullptr
+     * for a core file.
+     */
+    void interact(int *wait_status);
+
+    /**
+     * @brief Runs the command lines given with `-x` and `-ex`.
+     *
+     * A failed command sets the exit status to 1 unless `exit` sets it.
+     *
+     * @param wait_status A pointer to the status of the execution, nullptr
+     * for a core file.
+     */
+    void run_batch(int *wait_status);
+
+    /**
+     * @brief Refuses a script line once the target is gone.
+     *
+     * Only `exit` still runs after the target exited with no checkpoint
+     * left, as the interactive loop stops there.
+     *
+     * @param line The command line.
+     * @param wait_status A pointer to the status of the target, nullptr for
+     * a core file.
+     * @return true if the line must not run, the reason is printed.
+     */
+    bool target_gone(const std::string &line, int *wait_status);
+
+    /**
+     * @brief Runs a command line, then the commands of the breakpoint it
+     * stopped at.
+     *
+     * @param line The command line.
+     * @param more Supplies the lines of a block the line starts.
+     * @param wait_status A pointer to the status of the execution, nullptr
+     * for a core file.
+     * @return What became of the command.
+     */
+    command_result run_line(const std::string &line, const line_reader &more,
+                            int *wait_status);
+
+    /**
+     * @brief Runs command lines until one of them fails.
+     *
+     * @param lines The command lines.
+     * @param wait_status A pointer to the status of the execution.
+     * @param failed_line Set to the number of the failed line, may be
+     * nullptr.
+     * @return CMD_DONE or the result of the failed command.
+     */
+    command_result run_lines(const std::vector<std::string> &lines,
+                             int *wait_status, size_t *failed_line = nullptr);
+
+    /**
+     * @brief Runs the command lines of the breakpoints hit until the target
+     * stops elsewhere.
+     *
+     * @param wait_status A pointer to the status of the execution.
+     * @return What became of the last command.
+     */
+    command_result run_bp_commands(int *wait_status);
+
+    /**
+     * @brief Runs a command or a block `n` times (`repeat <n> [command]`).
+     */
+    command_result repeat(const std::string &args, const line_reader &more,
+                          int *wait_status);
+
+    /**
+     * @brief Sets the command lines of a breakpoint (`commands <addr>` ...
+     * `end`).
+     */
+    command_result breakpoint_commands(const std::string &args,
+                                       const line_reader &more);
+
+    /**
+     * @brief Defines or lists aliases (`alias [<name> <command>]`).
+     */
+    void alias(const std::string &args);
+
+    /**
+     * @brief Runs a script file (`source <file>`).
+     */
+    command_result source(const std::string &path, int *wait_status);
+
+    /**
+     * @brief Returns the table of commands by name.
+     */
+    static const std::unordered_map<std::string, command_info> &
+    command_table();
+
+    /**
+     * @brief Runs a command, its arguments are read from `cmd_args`.
+     *
+     * @param cmd The command name.
+     * @param wait_status A pointer to the status of the execution, nullptr
+     * for a core file.
+     * @return What became of the command.
+     */
+    command_result execute(const std::string &cmd, int *wait_status);
+
+    /**
+     * @brief Runs the debugger driven through the machine interface.
+     *
+     * Every request line gets one response line, commands output is
+     * captured and returned in the `console` field. Responses to pipelined
+     * requests are buffered and written together once no more input is
+     * ready. Stops and exits of the target follow as event lines.
+     */
+    void run_mi();
+
+    /**
+     * @brief Runs the target under a GDB remote protocol server.
+     *
+     * The target is started, then one client is accepted and drives it
+     * until it detaches, kills the target or disconnects.
+     */
+    void run_gdbserver();
+
+    /**
+     * @brief Handles one request line of the machine interface.
+     *
+     * @param line The request.
+     * @param wait_status A pointer to the status of the execution.
+     * @param console The stream `std::cout` is captured into.
+     * @param out The output the response and events are appended to.
+     * @return false after `exit`.
+     */
+    bool mi_handle(const std::string &line, int *wait_status,
+                   std::ostringstream &console, std::string &out);
+
+    /**
+     * @brief Runs a structured command of the machine interface, the ones
+     * starting with `-`.
+     *
+     * @param req The request.
+     * @param wait_status The status of the execution.
+     * @param fields The output the result fields are appended to.
+     * @return What became of the command.
+     */
+    command_result mi_command(mi_request &req, int wait_status,
+                              std::string &fields);
+
+    /**
+     * @brief Appends an event for the state of the target.
+     *
+     * @param out The output.
+     * @param name The event name if the target is stopped.
+     * @param wait_status The status of the execution.
+     */
+    void mi_stop_event(std::string &out, const char *name, int wait_status);
+
+    /**
+     * @brief Appends an `exited` event.
+     *
+     * @param out The output.
+     * @param pid The process ID.
+     * @param status The wait status.
+     */
+    void mi_exit_event(std::string &out, pid_t pid, int status);
+
+    /**
+     * @brief Reports the exit of a debugged process and forgets the
+     * checkpoint or the snapshot it was.
+     *
+     * @param pid The process ID.
+     * @param status The wait status.
+     * @param wait_status Updated if it is the target, may be nullptr.
+     */
+    void report_exit(pid_t pid, int status, int *wait_status);
+
+    /**
+     * @brief Reports a debugged process that stopped while another one was
+     * waited for.
+     *
+     * @param pid The process ID.
+     * @param status The wait status.
+     * @param wait_status Updated if it is the target, may be nullptr.
+     */
+    void report_stop(pid_t pid, int status, int *wait_status);
+
+    /**
+     * @brief Runs the debugger on a core file, only inspection commands are
+     * available.
+     */
+    void run_core();
+
+    /**
+     * @brief Forks and execs the target and waits until it stops after exec.
+     *
+     * @param wait_status A pointer to the status of the execution.
+     */
+    void launch(int *wait_status);
+
+    /**
+     * @brief Kills the not yet running target and launches it again, so that
+     * a new seccomp filter is installed. Breakpoints are kept.
+     *
+     * @param wait_status A pointer to the status of the execution.
+     */
+    void relaunch(int *wait_status);
+
+    /**
+     * @brief Makes the given stopped process the debugging target.
+     *
+     * @param pid The process ID of the new target.
+     */
+    void switch_process(pid_t pid);
+
+    /**
+     * @brief Starts following the shared libraries of a new target.
+     *
+     * Plants the BP_SOLIB breakpoint in the dynamic loader. Breakpoints
+     * resolved in the libraries of the previous process are pending again.
+     */
+    void init_solibs();
+
+    /**
+     * @brief Rereads the link map and resolves or unresolves the pending
+     * breakpoints of the loaded and unloaded libraries.
+     */
+    void update_solibs();
+
+    /**
+     * @brief Handles a stop at the BP_SOLIB breakpoint.
+     *
+     * @param wait_status A pointer to the status of the execution.
+     * @param bp The breakpoint hit.
+     * @param regs Registers at the hit.
+     * @return true if the breakpoint is stepped over and the execution
+     * should go on, false if the stop is not a library event or a user
+     * breakpoint shares the address.
+     */
+    bool solib_event(int *wait_status, breakpoint &bp,
+                     struct user_regs_struct &regs);
+
+    /**
+     * @brief Tries to resolve a pending breakpoint in the loaded libraries.
+     *
+     * @param pending The breakpoint.
+     * @return true if the breakpoint is set.
+     */
+    bool resolve_pending(pending_breakpoint &pending);
+
+    /**
+     * @brief Sets a breakpoint on a function of a shared library
+     * (`b lib:func`), pending until the library is loaded.
+     *
+     * @param spec The library and the function.
+     */
+    void break_in_module(const std::string &spec);
+
+    /**
+     * @brief Lists the loaded shared libraries (`libs`).
+     */
+    void list_solibs();
+
+    /**
+     * @brief Sets a fast tracepoint at a function or an address, lists the
+     * tracepoints without arguments (`tp`).
+     *
+     * The instructions under a 5-byte `jmp` are moved to a trampoline that
+     * records the registers into the ring shared with the debugger and
+     * jumps back, the target never stops at a tracepoint.
+     *
+     * @param wait_status A pointer to the status of the target.
+     */
+    void tracepoint(int *wait_status);
+
+    /**
+     * @brief Writes the drained tracepoint hits to a file (`tpdump`).
+     */
+    void tracepoint_dump();
+
+    /**
+     * @brief Prints the page hits and misses of the memory cache
+     * (`memcache`).
+     */
+    void memcache_info();
+
+    /**
+     * @brief Prints where the time of the debugger goes (`stats`), `stats
+     * reset` starts counting anew.
+     */
+    void stats();
+
+    /**
+     * @brief Maps the trampoline code and the shared ring in the target on
+     * the first tracepoint.
+     *
+     * @param near An address the code should be close to.
+     * @return false if the agent can not be injected.
+     */
+    bool init_agent(uint64_t near);
+
+    /**
+     * @brief Moves the drained records of the ring to `tp_records`.
+     */
+    void collect_tracepoints();
+
+    /**
+     * @brief Forgets the agent of the previous process, its records are
+     * kept.
+     */
+    void drop_agent();
+
+    /**
+     * @brief Finds the function containing a run-time address in the
+     * executable or a shared library.
+     *
+     * @param pc The address.
+     * @param bias The load bias of the executable.
+     * @param offset Filled with the offset of the address in the function.
+     * @param module Filled with the library file name, empty for the
+     * executable.
+     * @return The function symbol or nullptr.
+     */
+    const elf_symbol *function_at(uint64_t pc, uint64_t bias,
+                                  uint64_t &offset, std::string &module);
+
+    /**
+     * @brief Makes the stopped process call fork by putting a `syscall`
+     * instruction at rip, the registers and the code of both processes are
+     * restored afterwards.
+     *
+     * @param pid The process to fork.
+     * @param child_status Filled with the status of the stopped child.
+     * @return The process ID of the stopped child or -1.
+     */
+    pid_t inject_fork(pid_t pid, int *child_status);
+
+    /**
+     * @brief Kills the copy of the target kept by the memory snapshot.
+     */
+    void drop_snapshot();
+
+    /**
+     * @brief Reports a stop at a caught syscall entry or exit.
+     *
+     * @param wait_status The status of the stop.
+     * @return true if it was a syscall stop.
+     */
+    bool report_syscall_stop(int wait_status);
+
+    /**
+     * @brief Formats a syscall with its arguments, strace style.
+     *
+     * @param regs Registers at the syscall entry.
+     * @return The formatted call.
+     */
+    std::string format_syscall(struct user_regs_struct &regs);
+
+    /**
+     * @brief Formats the value returned by a syscall.
+     *
+     * @param ret The value of rax at the syscall exit.
+     * @return The formatted value.
+     */
+    std::string format_syscall_result(long ret);
+
+    /**
+     * @brief Reads syscall names or numbers until the end of the stream.
+     *
+     * @param in The stream to read from.
+     * @param nrs Filled with the syscall numbers.
+     * @return false if a name is unknown.
+     */
+    bool parse_syscalls(std::istream &in, std::set<long> &nrs);
+
+    /**
+     * @brief Finds the breakpoint set at the given address.
+     *
+     * @param addr The address of the breakpoint.
+     * @return The breakpoint or nullptr if there is no breakpoint.
+     */
+    breakpoint *find_breakpoint(uint64_t addr);
+
+    /**
+     * @brief Finds the active tracepoint whose jump covers the given address.
+     *
+     * A trap byte there would overwrite the jump.
+     *
+     * @param addr The address.
+     * @return The tracepoint or nullptr.
+     */
+    const fast_tracepoint *find_tracepoint(uint64_t addr);
+
+    /**
+     * @brief Creates a breakpoint and writes the trap byte into the target.
+     *
+     * @param addr The address of the breakpoint.
+     * @param kind Who plants the breakpoint.
+     * @return The new breakpoint.
+     */
+    breakpoint &insert_breakpoint(uint64_t addr, bp_kind kind);
+
+    /**
+     * @brief Restores the original byte and forgets the breakpoint.
+     *
+     * @param addr The address of the breakpoint.
+     */
+    void remove_breakpoint(uint64_t addr);
+
+    /**
+     * @brief Writes a single byte into the target, text pages included.
+     *
+     * @param addr The address to write to.
+     * @param byte The value to write.
+     */
+    void poke_byte(uint64_t addr, uint8_t byte);
+
+    /**
+     * @brief Reads memory of the target through `/proc/<pid>/mem`.
+     *
+     * @param buf The buffer to store the data.
+     * @param size The number of bytes to read.
+     * @param addr The address to read from.
+     * @return The number of bytes read or -1.
+     */
+    ssize_t mem_read(void *buf, size_t size, uint64_t addr);
+
+    /**
+     * @brief Writes memory of the target through `/proc/<pid>/mem`, text
+     * pages included.
+     *
+     * @param buf The data to write.
+     * @param size The number of bytes to write.
+     * @param addr The address to write to.
+     * @return The number of bytes written or -1.
+     */
+    ssize_t mem_write(const void *buf, size_t size, uint64_t addr);
+
+    /**
+     * @brief Resumes the target, memory read in this stop is forgotten.
+     *
+     * @param request PTRACE_CONT, PTRACE_SINGLESTEP or PTRACE_SYSCALL.
+     * @param sig The signal to deliver.
+     */
+    void resume(enum __ptrace_request request, int sig = 0);
+
+    /**
+     * @brief Executes the original instruction under a hit breakpoint.
+     *
+     * The instruction is displaced-stepped if it can be, otherwise the trap
+     * is removed for a single step and put back.
+     *
+     * @param wait_status A pointer to the status of the execution.
+     * @param bp The hit breakpoint.
+     * @param regs Registers of the stopped target, rip points past the trap.
+     * @return Number of ptrace calls made.
+     */
+    int step_over_breakpoint(int *wait_status, breakpoint &bp,
+                             struct user_regs_struct &regs);
+
+    /**
+     * @brief Executes a copy of the instruction under a hit breakpoint in
+     * the scratch page and moves rip back, the trap stays in place.
+     *
+     * @param wait_status A pointer to the status of the execution.
+     * @param bp The hit breakpoint.
+     * @param regs Registers of the stopped target, rip points past the trap.
+     * @return Number of ptrace calls made, 0 if the instruction can not be
+     * displaced and nothing was done.
+     */
+    int displaced_step(int *wait_status, breakpoint &bp,
+                       struct user_regs_struct &regs);
+
+    /**
+     * @brief Retrieves the scratch page, mapping it in the target on the
+     * first use.
+     *
+     * @param near An address the page should be close to.
+     * @return The address of the page, 0 if it can not be mapped.
+     */
+    uint64_t scratch_address(uint64_t near);
+
+    /**
+     * @brief Makes the stopped target run a system call by putting a
+     * `syscall` instruction at rip, the registers and the code are restored
+     * afterwards.
+     *
+     * @param nr The system call number.
+     * @param args The arguments.
+     * @param ret Filled with the return value.
+     * @return false if the target could not run the call.
+     */
+    bool inject_syscall(long nr, const uint64_t (&args)[6], uint64_t &ret);
+
+    /**
+     * @brief Emulates the prologue instructions (`endbr64`, `push rbp`,
+     * `mov rbp, rsp`) under a hit breakpoint, so the target can be resumed
+     * without removing the trap and single-stepping.
+     *
+     * @param bp The hit breakpoint.
+     * @param regs Registers of the stopped target, rip points past the trap.
+     * @return Number of ptrace calls made, 0 if nothing was emulated.
+     */
+    int emulate_prologue(breakpoint &bp, struct user_regs_struct &regs);
+
+    /**
+     * @brief Computes the canonical frame address and the return address of
+     * the frame the target is stopped in.
+     *
+     * Only functions that keep rbp as a frame pointer are handled, i.e. that
+     * start with `[endbr64;] push rbp; mov rbp, rsp`; the frame may be
+     * stopped inside that prologue.
+     *
+     * @param regs Registers of the stopped target.
+     * @param cfa Filled with the value of rsp before the call instruction.
+     * @param ret_addr Filled with the return address of the frame.
+     * @return false if the frame can not be found or the function does not
+     * set up rbp.
+     */
+    bool current_frame(struct user_regs_struct &regs, uint64_t &cfa,
+                       uint64_t &ret_addr);
+
+    /**
+     * @brief Runs the target at full speed until one of the temporary stops
+     * is reached, a user breakpoint is hit or the target exits.
+     *
+     * @param wait_status A pointer to the status of the execution.
+     * @param stops The places to stop at.
+     * @return The address of the reached stop or 0.
+     */
+    uint64_t run_to_temp_stops(int *wait_status,
+                               const std::vector<temp_stop> &stops);
+
+    /**
+     * @brief Reads and decodes the instruction at the given address, the
+     * bytes under breakpoints are replaced by the original ones.
+     *
+     * @param addr The address of the instruction.
+     * @param insn Filled with the decoded instruction.
+     * @return false if the instruction can not be read or decoded.
+     */
+    bool decode_insn(uint64_t addr, record_insn &insn);
+
+    /**
+     * @brief Prints the value returned by the function using its DWARF type.
+     *
+     * @param func_name The name of the function that has returned.
+     */
+    void print_return_value(const char *func_name);
 
   public:
     /**
@@ -138,8 +1042,9 @@ class Debugger {
      * @brief Starts the target process with the given process ID.
      *
      * @param gp A pointer to the process ID of the target process.
+     * @return The exit status of the debugger.
      */
-    void start(pid_t *gp);
+    int start(pid_t *gp);
 
     /**
      * @brief Kills the target process.
@@ -195,10 +1100,17 @@ class Debugger {
     void disassemble();
 
     /**
-     * @brief Reads memory at the specified address.
+     * @brief Reads memory at the specified address (`x <addr> <n>`), long
+     * output is shown with `$PAGER`.
      */
     void x_read();
 
+    /**
+     * @brief Streams a memory range to a file
+     * (`dump <addr> <len> <file> [raw|hex|elf]`).
+     */
+    void dump_memory();
+
     /**
      * @brief Sets memory at the specified address.
      */
@@ -215,6 +1127,117 @@ class Debugger {
      * @brief Prints the value of the current instruction.
      */
     void print();
+
+    /**
+     * @brief Runs until the current frame returns and prints the returned
+     * value.
+     *
+     * @param status A pointer to the status of the execution.
+     */
+    void finish(int *status);
+
+    /**
+     * @brief Runs until the specified address or until the current frame
+     * returns.
+     *
+     * @param status A pointer to the status of the execution.
+     * @param any_frame If true (`advance`), stop at the address in any frame,
+     * otherwise (`until`) only in the current frame or its callers.
+     */
+    void until(int *status, bool any_frame);
+
+    /**
+     * @brief Traces entries and exits of the functions matching a glob and
+     * writes them as a Chrome trace.
+     *
+     * @param status A pointer to the status of the execution.
+     */
+    void ftrace(int *status);
+
+    /**
+     * @brief Sets catchpoints on syscalls (`catch syscall [name]...`).
+     */
+    void catch_syscalls();
+
+    /**
+     * @brief Runs the target printing every syscall from the list (or every
+     * syscall) with its arguments, result and duration.
+     *
+     * @param status A pointer to the status of the execution.
+     */
+    void strace(int *status);
+
+    /**
+     * @brief Runs the target recording which basic blocks are executed and
+     * writes them in drcov format.
+     *
+     * @param status A pointer to the status of the execution.
+     */
+    void coverage(int *status);
+
+    /**
+     * @brief Single-steps the target writing every executed instruction into
+     * an instruction trace log.
+     *
+     * @param status A pointer to the status of the execution.
+     */
+    void record(int *status);
+
+    /**
+     * @brief Shows the last instructions of the recorded trace, most recent
+     * first.
+     */
+    void replay_view();
+
+    /**
+     * @brief Saves the current state of the target as a stopped fork of it.
+     */
+    void make_checkpoint();
+
+    /**
+     * @brief Replaces the target with a copy of the given checkpoint.
+     *
+     * @param status A pointer to the status of the execution.
+     */
+    void restart(int *status);
+
+    /**
+     * @brief Writes an ELF core file of the target (`gcore [file]
+     * [skip-ro]`).
+     */
+    void gcore();
+
+    /**
+     * @brief Prints the call stack following the frame pointer chain.
+     */
+    void backtrace();
+
+    /**
+     * @brief Collects the return addresses of the call stack, innermost
+     * first.
+     *
+     * @param pcs Filled with the addresses.
+     * @param bias Filled with the load bias of the target.
+     * @return false if the registers can not be read.
+     */
+    bool stack_frames(std::vector<uint64_t> &pcs, uint64_t &bias);
+
+    /**
+     * @brief Searches the memory of the target for a string or a value
+     * (`find <"string"|value> [start-end|mapping]`).
+     */
+    void find();
+
+    /**
+     * @brief Takes a memory snapshot of the target for `snapdiff`.
+     */
+    void snap();
+
+    /**
+     * @brief Prints memory changed since the snapshot
+     * (`snapdiff [start-end|mapping]`).
+     */
+    void snapdiff();
 };
 
 #endif
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "disassm.hpp"
+#include "stats.hpp"
 
 #include <capstone/capstone.h>
 #include <cstring>
+#include <limits>
 #include <iostream>
 
 Disassm::Disassm() {
@@ -10,10 +12,13 @@ Disassm::Disassm() {
                   << std::endl;
         return;
     }
+    // Instruction groups and operands are needed to follow control flow
+    cs_option(handle, CS_OPT_DETAIL, CS_OPT_ON);
 }
 
 void Disassm::print_disassembly(uint8_t *code, uint64_t code_size,
                                 uint64_t address) {
+    StatsTimer timer(STATS_DISASM);
     cs_insn *insn;
 
     size_t count = cs_disasm(handle, code, code_size, address, 0, &insn);
@@ -35,6 +40,7 @@ void Disassm::print_disassembly(uint8_t *code, uint64_t code_size,
 
 uint64_t *Disassm::next_instr_addr(uint8_t *code, uint64_t code_size,
                                    uint64_t address) {
+    StatsTimer timer(STATS_DISASM);
     cs_insn *insn;
 
     size_t count = cs_disasm(handle, code, code_size, address, 0, &insn);
@@ -47,4 +53,128 @@ uint64_t *Disassm::next_instr_addr(uint8_t *code, uint64_t code_size,
     }
 
     return nullptr;
-}
\ No newline at end of file
+}
+void Disassm::find_block_leaders(const uint8_t *code, uint64_t code_size,
+                                 uint64_t address,
+                                 std::vector<uint64_t> &leaders) {
+    StatsTimer timer(STATS_DISASM);
+    cs_insn *insn = cs_malloc(handle);
+    uint64_t end = address + code_size;
+    size_t size = code_size;
+    uint64_t next = address;
+
+    leaders.push_back(address);
+    while (cs_disasm_iter(handle, &code, &size, &next, insn)) {
+        bool is_jump = cs_insn_group(handle, insn, CS_GRP_JUMP);
+        if (!is_jump && !cs_insn_group(handle, insn, CS_GRP_CALL) &&
+            !cs_insn_group(handle, insn, CS_GRP_RET)) {
+            continue;
+        }
+
+        if (next < end) {
+            leaders.push_back(next);
+        }
+
+        cs_x86 &x86 = insn->detail->x86;
+        if (is_jump && x86.op_count == 1 &&
+            x86.operands[0].type == X86_OP_IMM) {
+            uint64_t target = x86.operands[0].imm;
+            if (target >= address && target < end) {
+                leaders.push_back(target);
+            }
+        }
+    }
+
+    cs_free(insn, 1);
+}
+
+bool Disassm::decode(const uint8_t *code, uint64_t code_size, uint64_t address,
+                     insn_info &info) {
+    StatsTimer timer(STATS_DISASM);
+    cs_insn *insn = cs_malloc(handle);
+    size_t size = code_size;
+    bool ok = cs_disasm_iter(handle, &code, &size, &address, insn);
+
+    info = {};
+    if (ok) {
+        info.size = insn->size;
+        cs_x86 &x86 = insn->detail->x86;
+        info.branch = cs_insn_group(handle, insn, CS_GRP_JUMP) ||
+                      cs_insn_group(handle, insn, CS_GRP_CALL) ||
+                      cs_insn_group(handle, insn, CS_GRP_RET);
+        info.rep = x86.prefix[0] == X86_PREFIX_REP ||
+                   x86.prefix[0] == X86_PREFIX_REPNE;
+        if (info.branch && x86.op_count == 1 &&
+            x86.operands[0].type == X86_OP_IMM) {
+            info.target = x86.operands[0].imm;
+        }
+        for (int i = 0; i < x86.op_count; i++) {
+            cs_x86_op &op = x86.operands[i];
+            // lea only computes the address
+            if (op.type != X86_OP_MEM || !(op.access & CS_AC_WRITE) ||
+                insn->id == X86_INS_LEA) {
+                continue;
+            }
+            info.mem_size = op.size;
+            info.mem_segment = op.mem.segment;
+            info.mem_base = op.mem.base;
+            info.mem_index = op.mem.index;
+            info.mem_scale = op.mem.scale;
+            info.mem_disp = op.mem.disp;
+            break;
+        }
+    }
+
+    cs_free(insn, 1);
+    return ok;
+}
+
+bool Disassm::relocate(const uint8_t *code, uint64_t code_size, uint64_t from,
+                       uint64_t to, displaced_insn &out) {
+    StatsTimer timer(STATS_DISASM);
+    cs_insn *insn = cs_malloc(handle);
+    size_t size = code_size;
+    uint64_t address = from;
+    bool ok = cs_disasm_iter(handle, &code, &size, &address, insn);
+
+    // syscall leaves rip of the copy in rcx, such instructions stay in place
+    if (ok && (insn->id == X86_INS_SYSCALL || insn->id == X86_INS_SYSENTER ||
+               cs_insn_group(handle, insn, CS_GRP_INT) ||
+               cs_insn_group(handle, insn, CS_GRP_IRET) ||
+               cs_insn_group(handle, insn, CS_GRP_PRIVILEGE))) {
+        ok = false;
+    }
+
+    out = {};
+    if (ok) {
+        memcpy(out.code, insn->bytes, insn->size);
+        out.size = insn->size;
+        bool jump = cs_insn_group(handle, insn, CS_GRP_JUMP);
+        out.call = cs_insn_group(handle, insn, CS_GRP_CALL);
+        cs_x86 &x86 = insn->detail->x86;
+        bool ret = cs_insn_group(handle, insn, CS_GRP_RET);
+        bool direct = x86.op_count == 1 && x86.operands[0].type == X86_OP_IMM;
+        out.branch = jump || out.call || ret;
+        out.relative = !ret && (direct || !out.branch);
+
+        for (int i = 0; i < x86.op_count && ok; i++) {
+            cs_x86_op &op = x86.operands[i];
+            if (op.type != X86_OP_MEM || op.mem.base != X86_REG_RIP) {
+                continue;
+            }
+            int64_t disp = op.mem.disp + (int64_t)(from - to);
+            if (x86.encoding.disp_size != sizeof(int32_t) ||
+                disp < std::numeric_limits<int32_t>::min() ||
+                disp > std::numeric_limits<int32_t>::max()) {
+                ok = false;
+                break;
+            }
+            int32_t disp32 = disp;
+            memcpy(out.code + x86.encoding.disp_offset, &disp32,
+                   sizeof(disp32));
+        }
+    }
+
+    cs_free(insn, 1);
+    return ok;
+}
@@ -3,8 +3,84 @@
 
 #include <capstone/capstone.h>
 #include <cstdint>
+#include <vector>
 
 #define MAX_INSTR_SIZE 16 * 2
+#define X86_MAX_INSN_LEN 15
+
+/**
+ * @brief The length, the control flow and the written memory operand of an
+ * instruction.
+ */
+struct insn_info {
+    /**
+     * @brief The length of the instruction.
+     */
+    uint8_t size;
+    /**
+     * @brief Whether the instruction is a jump, a call or a return.
+     */
+    bool branch;
+    /**
+     * @brief Whether a rep prefix may leave rip at the instruction.
+     */
+    bool rep;
+    /**
+     * @brief The target of a direct branch, 0 for an indirect one.
+     */
+    uint64_t target;
+    /**
+     * @brief The size of the written memory operand, 0 if there is none.
+     */
+    uint8_t mem_size;
+    /**
+     * @brief The segment register of the memory operand.
+     */
+    x86_reg mem_segment;
+    /**
+     * @brief The base register of the memory operand.
+     */
+    x86_reg mem_base;
+    /**
+     * @brief The index register of the memory operand.
+     */
+    x86_reg mem_index;
+    /**
+     * @brief The scale of the index register.
+     */
+    int mem_scale;
+    /**
+     * @brief The displacement of the memory operand.
+     */
+    int64_t mem_disp;
+};
+
+/**
+ * @brief An instruction copied to another address to be executed there.
+ */
+struct displaced_insn {
+    /**
+     * @brief The instruction with rip-relative operands fixed up.
+     */
+    uint8_t code[X86_MAX_INSN_LEN];
+    /**
+     * @brief The length of the instruction.
+     */
+    uint8_t size;
+    /**
+     * @brief Whether rip after the copy is executed is relative to the copy:
+     * true for everything but indirect jumps, indirect calls and returns.
+     */
+    bool relative;
+    /**
+     * @brief Whether the instruction pushes a return address.
+     */
+    bool call;
+    /**
+     * @brief Whether the instruction is a jump, a call or a return.
+     */
+    bool branch;
+};
 
 /**
  * @brief The Disassm class provides functionality for disassembling binary
@@ -33,6 +109,52 @@ class Disassm {
     uint64_t *next_instr_addr(uint8_t *code, uint64_t code_size,
                               uint64_t address);
 
+    /**
+     * @brief Finds the starts of basic blocks in the code of a function.
+     *
+     * A block starts at the function entry, at every direct jump target
+     * inside the function and after every jump, call or return.
+     *
+     * @param code The binary code of the function.
+     * @param code_size The size of the binary code.
+     * @param address The address of the function.
+     * @param leaders Block start addresses are appended here, unsorted.
+     */
+    void find_block_leaders(const uint8_t *code, uint64_t code_size,
+                            uint64_t address, std::vector<uint64_t> &leaders);
+
+    /**
+     * @brief Decodes the instruction at the start of the given code.
+     *
+     * @param code The binary code.
+     * @param code_size The size of the binary code.
+     * @param address The address of the instruction.
+     * @param info Filled with the instruction length, its branch target and
+     * the explicit memory operand it writes to.
+     * @return false if the code is not a valid instruction.
+     */
+    bool decode(const uint8_t *code, uint64_t code_size, uint64_t address,
+                insn_info &info);
+
+    /**
+     * @brief Copies the instruction at the start of the given code to run
+     * at another address.
+     *
+     * rip-relative memory operands get their displacement adjusted, so they
+     * still refer to the same data. Relative branches are copied as is and
+     * the new rip is moved back by the caller.
+     *
+     * @param code The binary code.
+     * @param code_size The size of the binary code.
+     * @param from The address of the instruction.
+     * @param to The address the copy is executed at.
+     * @param out Filled with the copy.
+     * @return false if the code is not a valid instruction, enters the
+     * kernel, or some displacement does not fit in 32 bits at `to`.
+     */
+    bool relocate(const uint8_t *code, uint64_t code_size, uint64_t from,
+                  uint64_t to, displaced_insn &out);
+
   private:
     csh handle;
 };
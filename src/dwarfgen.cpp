@@ -0,0 +1,135 @@
+/*
+    Generates the sources of a synthetic program for DWARF scaling tests:
+
+        dwarfgen <dir> <units> <functions> <depth>
+
+    Every unit is a compile unit with <functions> functions nested <depth>
+    namespaces deep, a class template instantiated twice and an always
+    inlined helper, so compiled with -g it has the kinds of DIEs a large C++
+    binary has. main.cpp calls every unit, nothing is dead code.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/**
+ * @brief Writes one compile unit.
+ */
+static bool write_unit(const std::string &dir, int unit, int functions,
+                       int depth) {
+    std::string path = dir + "/unit_" + std::to_string(unit) + ".cpp";
+    FILE *out = fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        perror(path.c_str());
+        return false;
+    }
+
+    fprintf(out, "// Generated by dwarfgen, do not edit\n");
+    fprintf(out, "namespace stress {\n");
+    for (int i = 0; i < depth; i++) {
+        fprintf(out, "namespace n%d {\n", i);
+    }
+
+    fprintf(out,
+            "template <typename T, int N> struct holder_%d {\n"
+            "    T values[N];\n"
+            "    T sum() const {\n"
+            "        T total = T();\n"
+            "        for (int i = 0; i < N; i++)\n"
+            "            total += values[i];\n"
+            "        return total;\n"
+            "    }\n"
+            "};\n\n",
+            unit);
+    fprintf(out,
+            "static inline __attribute__((always_inline)) int mix_%d(int a, "
+            "int b) {\n"
+            "    int mixed = a * 31 + b;\n"
+            "    return mixed ^ %d;\n"
+            "}\n\n",
+            unit, unit);
+
+    for (int f = 0; f < functions; f++) {
+        fprintf(out,
+                "int fn_%d_%d(int a, int b) {\n"
+                "    int local_a = mix_%d(a, b + %d);\n"
+                "    holder_%d<int, 4> ints = {{a, b, local_a, %d}};\n"
+                "    holder_%d<double, 2> reals = {{a * 0.5, b * 0.25}};\n"
+                "    long total = ints.sum() + (long)reals.sum();\n"
+                "    return (int)total + local_a;\n"
+                "}\n\n",
+                unit, f, unit, f, unit, f, unit);
+    }
+
+    fprintf(out, "int unit_%d(int seed) {\n    int r = seed;\n", unit);
+    for (int f = 0; f < functions; f++) {
+        fprintf(out, "    r += fn_%d_%d(r, %d);\n", unit, f, f);
+    }
+    fprintf(out, "    return r;\n}\n");
+
+    for (int i = 0; i < depth; i++) {
+        fprintf(out, "}\n");
+    }
+    fprintf(out, "}\n\nint stress_unit_%d(int seed) {\n    return stress::",
+            unit);
+    for (int i = 0; i < depth; i++) {
+        fprintf(out, "n%d::", i);
+    }
+    fprintf(out, "unit_%d(seed);\n}\n", unit);
+
+    if (fclose(out) != 0) {
+        perror(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes main.cpp calling every unit.
+ */
+static bool write_main(const std::string &dir, int units) {
+    std::string path = dir + "/main.cpp";
+    FILE *out = fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        perror(path.c_str());
+        return false;
+    }
+
+    fprintf(out, "// Generated by dwarfgen, do not edit\n");
+    for (int u = 0; u < units; u++) {
+        fprintf(out, "int stress_unit_%d(int seed);\n", u);
+    }
+    fprintf(out, "\nint main(int argc, char **argv) {\n    int r = argc;\n");
+    for (int u = 0; u < units; u++) {
+        fprintf(out, "    r = stress_unit_%d(r);\n", u);
+    }
+    fprintf(out, "    return r & 1;\n}\n");
+
+    if (fclose(out) != 0) {
+        perror(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s <dir> <units> <functions> <depth>\n",
+                argv[0]);
+        return 1;
+    }
+    std::string dir = argv[1];
+    int units = atoi(argv[2]), functions = atoi(argv[3]),
+        depth = atoi(argv[4]);
+    if (units <= 0 || functions <= 0 || depth < 0) {
+        fprintf(stderr, "%s: bad sizes\n", argv[0]);
+        return 1;
+    }
+
+    for (int u = 0; u < units; u++) {
+        if (!write_unit(dir, u, functions, depth)) {
+            return 1;
+        }
+    }
+    return write_main(dir, units) ? 0 : 1;
+}
@@ -1,6 +1,9 @@
 #include "dwarfinfo.hpp"
+#include "debugfile.hpp"
+#include "stats.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <iostream>
 #include <stdio.h>
@@ -18,73 +21,272 @@
 #include <string.h>
 #include <string>
 
-void DwarfInfo::dw_init() {
-    if (dwarf_init_path(target, nullptr, 0, DW_GROUPNUMBER_ANY, nullptr,
-                        nullptr, &dbg, &err) != DW_DLV_OK) {
+bool DwarfInfo::resolve() {
+    if (!resolved) {
+        resolved = true;
+        debug_path = find_debug_file(target, debug_dirs);
+        if (debug_path.empty()) {
+            std::cerr << "no debug info for " << target << std::endl;
+        } else {
+            debug_path = uncompressed_debug_file(debug_path);
+        }
+    }
+    return !debug_path.empty();
+}
+
+bool DwarfInfo::dw_init() {
+    // The indexer may still be looking up the debug file
+    if (indexer.joinable()) {
+        indexer.join();
+    }
+    // Reopened for every query, which starts the CU iteration over
+    if (opened) {
+        dwarf_finish(dbg);
+        opened = false;
+    }
+    if (!resolve()) {
+        return false;
+    }
+    if (dwarf_init_path(debug_path.c_str(), nullptr, 0, DW_GROUPNUMBER_ANY,
+                        nullptr, nullptr, &dbg, &err) != DW_DLV_OK) {
         std::cerr << "dwarf_init_path() failed." << std::endl;
+        return false;
+    }
+    opened = true;
+    return true;
+}
+
+DwarfInfo::~DwarfInfo() {
+    if (indexer.joinable()) {
+        indexer.join();
+    }
+    delete index;
+    if (opened) {
+        dwarf_finish(dbg);
+    }
+}
+
+void DwarfInfo::start_indexing() {
+    if (index != nullptr || indexer.joinable() || resolved) {
         return;
     }
-};
+    // Every other method joins the thread before touching the members
+    indexer = std::thread([this]() {
+        if (resolve()) {
+            index = make_index();
+        }
+    });
+}
 
-void DwarfInfo::get_function_by_rip(Dwarf_Addr rip, std::string &ret_string,
-                                    Dwarf_Addr &low_pc, Dwarf_Addr &high_pc) {
-    dw_init();
-    Dwarf_Unsigned cu_header_length, abbrev_offset, next_cu_header,
-        dw_typeoffset, dw_next_cu_header_offset;
+bool DwarfInfo::load_index() {
+    if (indexer.joinable()) {
+        indexer.join();
+    }
+    if (index == nullptr && resolve()) {
+        index = make_index();
+    }
+    return index != nullptr;
+}
+
+SymbolIndex *DwarfInfo::make_index() {
+    auto *result = new SymbolIndex();
+    debug_link_info info;
+    std::string cache, path;
+    if (read_debug_link_info(debug_path, info) && !info.build_id.empty() &&
+        info.build_id.size() < SYMINDEX_BUILD_ID_MAX) {
+        cache = cache_directory();
+    }
+    if (!cache.empty()) {
+        path = cache + "/" + info.build_id + SYMINDEX_SUFFIX;
+        if (result->load(path, info.build_id)) {
+            return result;
+        }
+    }
+
+    build_index(*result);
+    result->finish(info.build_id);
+    if (!path.empty() && !result->save(path)) {
+        std::cerr << "cannot write " << path << std::endl;
+    }
+    return result;
+}
+
+void DwarfInfo::build_index(SymbolIndex &out) {
+    Dwarf_Debug dw;
+    Dwarf_Error error;
+    if (dwarf_init_path(debug_path.c_str(), nullptr, 0, DW_GROUPNUMBER_ANY,
+                        nullptr, nullptr, &dw, &error) != DW_DLV_OK) {
+        std::cerr << "dwarf_init_path() failed." << std::endl;
+        return;
+    }
+
+    // Only the unit headers are read here, the DIEs are left to the workers
+    Dwarf_Unsigned dw_typeoffset, dw_next_cu_header_offset;
     Dwarf_Half dw_version_stamp, dw_address_size, dw_length_size,
         dw_extension_size, dw_header_cu_type;
     Dwarf_Unsigned dw_cu_header_length;
-    Dwarf_Off dw_abbrev_offset;
+    Dwarf_Off dw_abbrev_offset, cu_offset;
     Dwarf_Sig8 dw_type_signature;
-    Dwarf_Die no_die = 0, cu_die, child_die;
+    Dwarf_Die no_die = 0, cu_die;
+    std::vector<Dwarf_Off> units;
 
-    int status = dwarf_next_cu_header_d(
-        dbg, true, &dw_cu_header_length, &dw_version_stamp, &dw_abbrev_offset,
-        &dw_address_size, &dw_length_size, &dw_extension_size,
-        &dw_type_signature, &dw_typeoffset, &dw_next_cu_header_offset,
-        &dw_header_cu_type, &err);
+    while (dwarf_next_cu_header_d(dw, true, &dw_cu_header_length,
+                                  &dw_version_stamp, &dw_abbrev_offset,
+                                  &dw_address_size, &dw_length_size,
+                                  &dw_extension_size, &dw_type_signature,
+                                  &dw_typeoffset, &dw_next_cu_header_offset,
+                                  &dw_header_cu_type, &error) == DW_DLV_OK) {
+        if (dwarf_siblingof_b(dw, no_die, true, &cu_die, &error) ==
+                DW_DLV_OK &&
+            dwarf_dieoffset(cu_die, &cu_offset, &error) == DW_DLV_OK) {
+            units.push_back(cu_offset);
+            dwarf_dealloc_die(cu_die);
+        }
+    }
+    dwarf_finish(dw);
 
-    if (status != DW_DLV_OK) {
-        // We should debug only binaries with debug symbols by task
-        panic("No debug symbols present. Bye");
+    size_t workers = std::min<size_t>(
+        {std::max(std::thread::hardware_concurrency(), 1u), units.size(),
+         DWARF_INDEX_WORKERS_MAX});
+    std::atomic<size_t> next(0);
+    std::vector<SymbolIndex> parts(workers);
+    std::vector<std::thread> pool;
+    for (size_t i = 0; i < workers; i++) {
+        pool.emplace_back(&DwarfInfo::index_units, this, std::cref(units),
+                          std::ref(next), std::ref(parts[i]));
+    }
+    for (size_t i = 0; i < workers; i++) {
+        pool[i].join();
+        out.merge(parts[i]);
     }
+}
 
-    while (status == DW_DLV_OK) {
+void DwarfInfo::index_units(const std::vector<Dwarf_Off> &units,
+                            std::atomic<size_t> &next, SymbolIndex &out) {
+    Dwarf_Debug dw;
+    Dwarf_Error error;
+    if (dwarf_init_path(debug_path.c_str(), nullptr, 0, DW_GROUPNUMBER_ANY,
+                        nullptr, nullptr, &dw, &error) != DW_DLV_OK) {
+        return;
+    }
+    // Units are taken one by one, their sizes vary too much to split evenly
+    for (size_t i = next++; i < units.size(); i = next++) {
+        Dwarf_Die cu_die, child_die;
+        if (dwarf_offdie_b(dw, units[i], true, &cu_die, &error) !=
+            DW_DLV_OK) {
+            continue;
+        }
+        index_lines(dw, cu_die, out);
+        if (dwarf_child(cu_die, &child_die, &error) == DW_DLV_OK) {
+            index_dies(dw, child_die, out);
+        }
+        dwarf_dealloc_die(cu_die);
+    }
+    dwarf_finish(dw);
+}
 
-        if (dwarf_siblingof_b(dbg, no_die, true, &cu_die, &err) == DW_DLV_OK) {
-            if (dwarf_child(cu_die, &child_die, &err) == DW_DLV_OK) {
-                do {
-                    Dwarf_Half tag;
-                    if (dwarf_tag(child_die, &tag, &err) != DW_DLV_OK) {
-                        continue;
-                    }
-                    if (tag == DW_TAG_subprogram) {
-                        dwarf_lowpc(child_die, &low_pc, &err);
-                        Dwarf_Half dw_return_form;
-                        enum Dwarf_Form_Class dw_return_class;
-                        dwarf_highpc_b(child_die, &high_pc, &dw_return_form,
-                                       &dw_return_class, &err);
-                        high_pc += low_pc;
-                        if (rip >= low_pc && rip < high_pc) {
-                            char *name = 0;
-                            if (dwarf_diename(child_die, &name, &err) ==
-                                DW_DLV_OK) {
-                                ret_string = std::string(name);
-                                return;
-                            }
-                        }
-                    }
-                } while (dwarf_siblingof_b(dbg, child_die, true, &child_die,
-                                           &err) == DW_DLV_OK);
+void DwarfInfo::index_dies(Dwarf_Debug dw, Dwarf_Die die, SymbolIndex &out) {
+    Dwarf_Error error;
+    do {
+        Dwarf_Half tag;
+        char *name = 0;
+        Dwarf_Off offset;
+        if (dwarf_tag(die, &tag, &error) != DW_DLV_OK ||
+            dwarf_dieoffset(die, &offset, &error) != DW_DLV_OK) {
+            continue;
+        }
+        bool named = dwarf_diename(die, &name, &error) == DW_DLV_OK;
+
+        if (tag == DW_TAG_subprogram && named) {
+            Dwarf_Addr low_pc, high_pc;
+            Dwarf_Half form;
+            enum Dwarf_Form_Class form_class;
+            if (dwarf_lowpc(die, &low_pc, &error) == DW_DLV_OK &&
+                dwarf_highpc_b(die, &high_pc, &form, &form_class, &error) ==
+                    DW_DLV_OK) {
+                // DWARF 4 and later give the size instead of the end
+                if (form_class == DW_FORM_CLASS_CONSTANT) {
+                    high_pc += low_pc;
+                }
+                out.add_function(name, low_pc, high_pc, offset);
             }
+            continue;
+        }
+
+        Dwarf_Bool declaration = false;
+        dwarf_hasattr(die, DW_AT_declaration, &declaration, &error);
+        bool is_type = tag == DW_TAG_base_type || tag == DW_TAG_typedef ||
+                       tag == DW_TAG_structure_type ||
+                       tag == DW_TAG_class_type ||
+                       tag == DW_TAG_union_type ||
+                       tag == DW_TAG_enumeration_type;
+        if (is_type && named && !declaration) {
+            out.add_type(name, offset);
         }
 
-        status = dwarf_next_cu_header_d(
-            dbg, true, &dw_cu_header_length, &dw_version_stamp,
-            &dw_abbrev_offset, &dw_address_size, &dw_length_size,
-            &dw_extension_size, &dw_type_signature, &dw_typeoffset,
-            &dw_next_cu_header_offset, &dw_header_cu_type, &err);
+        Dwarf_Die child;
+        if ((tag == DW_TAG_namespace || tag == DW_TAG_structure_type ||
+             tag == DW_TAG_class_type || tag == DW_TAG_union_type) &&
+            dwarf_child(die, &child, &error) == DW_DLV_OK) {
+            index_dies(dw, child, out);
+        }
+    } while (dwarf_siblingof_b(dw, die, true, &die, &error) == DW_DLV_OK);
+}
+
+void DwarfInfo::index_lines(Dwarf_Debug dw, Dwarf_Die cu_die,
+                            SymbolIndex &out) {
+    Dwarf_Error error;
+    Dwarf_Unsigned version;
+    Dwarf_Small table_count;
+    Dwarf_Line_Context context;
+    if (dwarf_srclines_b(cu_die, &version, &table_count, &context, &error) !=
+        DW_DLV_OK) {
+        return;
+    }
+
+    Dwarf_Line *lines;
+    Dwarf_Signed count;
+    if (dwarf_srclines_from_linecontext(context, &lines, &count, &error) ==
+        DW_DLV_OK) {
+        for (Dwarf_Signed i = 0; i < count; i++) {
+            Dwarf_Addr addr;
+            Dwarf_Unsigned line;
+            Dwarf_Bool end_sequence;
+            char *file = 0;
+            if (dwarf_lineaddr(lines[i], &addr, &error) != DW_DLV_OK ||
+                dwarf_lineno(lines[i], &line, &error) != DW_DLV_OK ||
+                dwarf_lineendsequence(lines[i], &end_sequence, &error) !=
+                    DW_DLV_OK ||
+                dwarf_linesrc(lines[i], &file, &error) != DW_DLV_OK) {
+                continue;
+            }
+            // Line 0 marks the end of a sequence in the index
+            out.add_line(addr, file, end_sequence ? 0 : line);
+            dwarf_dealloc(dw, file, DW_DLA_STRING);
+        }
     }
+    dwarf_srclines_dealloc_b(context);
+}
+
+void DwarfInfo::get_function_by_rip(Dwarf_Addr rip, std::string &ret_string,
+                                    Dwarf_Addr &low_pc, Dwarf_Addr &high_pc) {
+    StatsTimer timer(STATS_DWARF_QUERY);
+    low_pc = high_pc = 0;
+    if (!load_index()) {
+        return;
+    }
+    const symindex_function *func = index->find_function(rip);
+    if (func != nullptr) {
+        ret_string = index->string_at(func->name);
+        low_pc = func->low;
+        high_pc = func->high;
+    }
+}
+
+bool DwarfInfo::find_line(Dwarf_Addr addr, std::string &file,
+                          uint32_t &line) {
+    StatsTimer timer(STATS_DWARF_QUERY);
+    return load_index() && index->find_line(addr, file, line);
 }
 
 int DwarfInfo::dwarf_get_entry_offset(Dwarf_Loc_Head_c dw_loclist_head,
@@ -168,14 +370,14 @@ void DwarfInfo::traverse_dwarf_tree(Dwarf_Debug dbg, Dwarf_Die die,
             }
 
             struct user_regs_struct regs;
-            if (ptrace(PTRACE_GETREGS, child_pid, 0, &regs) < 0) {
+            if (!program->get_regs(regs)) {
                 perror("ptrace(GETREGS)");
                 exit(EXIT_FAILURE);
             }
 
             unsigned long addr = regs.rbp + 0x10 + offset;
-            long value =
-                ptrace(PTRACE_PEEKDATA, child_pid, (void *)addr, nullptr);
+            long value = 0;
+            program->read_memory(addr, (uint8_t *)&value, sizeof(value));
 
             res[std::string(die_name)] = value;
         }
@@ -200,26 +402,79 @@ void DwarfInfo::traverse_dwarf_tree(Dwarf_Debug dbg, Dwarf_Die die,
 
 // Function to read DWARF info and extract local variables
 std::map<std::string, uint64_t> DwarfInfo::get_local_vars(char *func_name) {
-    dw_init();
-    Dwarf_Unsigned cu_header_length, abbrev_offset, next_cu_header,
-        dw_typeoffset, dw_next_cu_header_offset;
-    Dwarf_Half dw_version_stamp, dw_address_size, dw_length_size,
-        dw_extension_size, dw_header_cu_type;
-    Dwarf_Unsigned dw_cu_header_length;
-    Dwarf_Off dw_abbrev_offset;
-    Dwarf_Sig8 dw_type_signature;
-
+    StatsTimer timer(STATS_DWARF_QUERY);
     std::map<std::string, uint64_t> res;
-    while (dwarf_next_cu_header_d(dbg, true, &dw_cu_header_length,
-                                  &dw_version_stamp, &dw_abbrev_offset,
-                                  &dw_address_size, &dw_length_size,
-                                  &dw_extension_size, &dw_type_signature,
-                                  &dw_typeoffset, &dw_next_cu_header_offset,
-                                  &dw_header_cu_type, &err) == DW_DLV_OK) {
-        Dwarf_Die no_die, cu_die;
-        if (dwarf_siblingof_b(dbg, no_die, true, &cu_die, &err) == DW_DLV_OK) {
-            traverse_dwarf_tree(dbg, cu_die, func_name, res);
-        }
+    // The index leads straight to the function, only its DIEs are walked
+    Dwarf_Die die, child;
+    if (find_subprogram(func_name, die) &&
+        dwarf_child(die, &child, &err) == DW_DLV_OK) {
+        traverse_dwarf_tree(dbg, child, func_name, res);
     }
     return res;
 }
+
+bool DwarfInfo::find_subprogram(const char *func_name, Dwarf_Die &ret_die) {
+    if (!load_index()) {
+        return false;
+    }
+    const symindex_function *func = index->lookup_function(func_name);
+    return func != nullptr && dw_init() &&
+           dwarf_offdie_b(dbg, func->die, true, &ret_die, &err) == DW_DLV_OK;
+}
+
+bool DwarfInfo::get_return_type(const char *func_name, dw_type &type) {
+    StatsTimer timer(STATS_DWARF_QUERY);
+    Dwarf_Die die;
+    if (!find_subprogram(func_name, die)) {
+        return false;
+    }
+
+    type = {"", 0, 0, false};
+
+    Dwarf_Off type_offset;
+    Dwarf_Bool is_info;
+    // No DW_AT_type means that the function returns void
+    if (dwarf_dietype_offset(die, &type_offset, &is_info, &err) != DW_DLV_OK) {
+        return false;
+    }
+
+    // Strip typedefs and cv-qualifiers until we get to the real type
+    while (dwarf_offdie_b(dbg, type_offset, is_info, &die, &err) ==
+           DW_DLV_OK) {
+        Dwarf_Half tag;
+        char *name = 0;
+        if (dwarf_tag(die, &tag, &err) != DW_DLV_OK) {
+            return false;
+        }
+        if (type.name.empty() &&
+            dwarf_diename(die, &name, &err) == DW_DLV_OK) {
+            type.name = name;
+        }
+
+        if (tag == DW_TAG_typedef || tag == DW_TAG_const_type ||
+            tag == DW_TAG_volatile_type) {
+            if (dwarf_dietype_offset(die, &type_offset, &is_info, &err) !=
+                DW_DLV_OK) {
+                return false;
+            }
+            continue;
+        }
+
+        if (tag == DW_TAG_pointer_type || tag == DW_TAG_reference_type ||
+            tag == DW_TAG_rvalue_reference_type) {
+            type.is_pointer = true;
+            type.byte_size = sizeof(uint64_t);
+            if (type.name.empty()) {
+                type.name = "pointer";
+            }
+            return true;
+        }
+
+        dwarf_bytesize(die, &type.byte_size, &err);
+        if (tag == DW_TAG_base_type) {
+            dwarf_attrval_unsigned(die, DW_AT_encoding, &type.encoding, &err);
+        }
+        return true;
+    }
+    return false;
+}
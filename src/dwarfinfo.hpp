@@ -1,12 +1,43 @@
 #ifndef DWARF_INFO
 #define DWARF_INFO
 
+#include "symindex.hpp"
+#include "target.hpp"
+
+#include <atomic>
 #include <cstdint>
 #include <dwarf.h>
 #include <fcntl.h>
 #include <iostream>
 #include <libdwarf.h>
 #include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define DWARF_INDEX_WORKERS_MAX 16
+
+/**
+ * @brief Describes the type of a value, as far as it is needed to print it.
+ */
+struct dw_type {
+    /**
+     * @brief The name of the type (typedefs are resolved).
+     */
+    std::string name;
+    /**
+     * @brief DW_ATE_* encoding for base types, 0 otherwise.
+     */
+    Dwarf_Unsigned encoding;
+    /**
+     * @brief The size of the value in bytes.
+     */
+    Dwarf_Unsigned byte_size;
+    /**
+     * @brief Whether the type is a pointer or a reference.
+     */
+    bool is_pointer;
+};
 
 /**
  * @brief The DwarfInfo class provides functionality to retrieve information
@@ -41,9 +72,18 @@ class DwarfInfo {
      *
      * This function initializes the DWARF information, which is used for
      * debugging purposes. It should be called before any other DWARF-related
-     * functions are used.
+     * functions are used. The debug file is looked up once, the target
+     * itself or separate debug info found by build ID or debug link.
+     *
+     * @return false if there is no debug info.
+     */
+    bool dw_init();
+    /**
+     * @brief Starts loading or building the index in the background.
+     *
+     * Queries made before the index is ready wait for it.
      */
-    void dw_init();
+    void start_indexing();
     /**
      * @brief Retrieves the function information associated with the given
      * instruction pointer (rip).
@@ -65,17 +105,39 @@ class DwarfInfo {
      * @return A map containing the names and values of the local variables.
      */
     std::map<std::string, uint64_t> get_local_vars(char *func_name);
+    /**
+     * @brief Retrieves the return type of a given function.
+     *
+     * @param func_name The name of the function.
+     * @param type Filled with the description of the return type.
+     * @return false if the function is not found or returns void.
+     */
+    bool get_return_type(const char *func_name, dw_type &type);
+    /**
+     * @brief Finds the source line of an address.
+     *
+     * @param addr The address, as in the debug info.
+     * @param file Filled with the source file.
+     * @param line Filled with the line number.
+     * @return false if no line table covers the address.
+     */
+    bool find_line(Dwarf_Addr addr, std::string &file, uint32_t &line);
     /**
      * @brief Constructs a `DwarfInfo` object.
      *
      * This constructor initializes a `DwarfInfo` object with the provided
-     * target and child process ID.
+     * target and the source of its registers and memory.
      *
      * @param target_ The target name or path.
-     * @param child_pid_ The process ID of the child process.
+     * @param program_ The live process or the core file.
+     * @param debug_dirs_ Directories with separate debug info.
      */
-    DwarfInfo(const char *target_, pid_t child_pid_)
-        : target{target_}, child_pid{child_pid_} {}
+    DwarfInfo(const char *target_, Target *program_,
+              const std::vector<std::string> &debug_dirs_ = {})
+        : target{target_}, program{program_}, debug_dirs{debug_dirs_},
+          resolved{false}, opened{false}, index{nullptr} {}
+
+    ~DwarfInfo();
 
   private:
     /**
@@ -105,14 +167,103 @@ class DwarfInfo {
      */
     int dwarf_get_entry_offset(Dwarf_Loc_Head_c dw_loclist_head,
                                Dwarf_Unsigned i, Dwarf_Off &offset);
+    /**
+     * @brief Finds the DIE of the function with the given name.
+     *
+     * @param func_name The name of the function.
+     * @param ret_die Filled with the DW_TAG_subprogram DIE.
+     * @return true if the function is found.
+     */
+    bool find_subprogram(const char *func_name, Dwarf_Die &ret_die);
+    /**
+     * @brief Looks up the debug file once.
+     *
+     * @return false if there is no debug info.
+     */
+    bool resolve();
+    /**
+     * @brief Waits for the index, loading it if it is not started.
+     *
+     * @return false if there is no debug info.
+     */
+    bool load_index();
+    /**
+     * @brief Loads the index of the debug file from the cache, building it
+     * if the cache has none for this build.
+     *
+     * The index is kept in the cache directory as `<build-id>.idx`; debug
+     * files without a build ID are indexed in memory only.
+     *
+     * @return The index, empty if the debug file can not be read.
+     */
+    SymbolIndex *make_index();
+    /**
+     * @brief Indexes the compile units with a pool of workers, each with its
+     * own libdwarf handle, and merges their results.
+     *
+     * @param out The index under construction.
+     */
+    void build_index(SymbolIndex &out);
+    /**
+     * @brief Indexes compile units until there are none left, the body of
+     * a worker.
+     *
+     * @param units Offsets of the compile unit DIEs.
+     * @param next The index of the next unit to take.
+     * @param out The partial index of the worker.
+     */
+    void index_units(const std::vector<Dwarf_Off> &units,
+                     std::atomic<size_t> &next, SymbolIndex &out);
+    /**
+     * @brief Adds the functions and named types among a DIE and its
+     * siblings to the index, descending into namespaces and classes.
+     *
+     * @param dw The libdwarf handle of the worker.
+     * @param die The first DIE.
+     * @param out The partial index.
+     */
+    void index_dies(Dwarf_Debug dw, Dwarf_Die die, SymbolIndex &out);
+    /**
+     * @brief Adds the line table of a compile unit to the index.
+     *
+     * @param dw The libdwarf handle of the worker.
+     * @param cu_die The compile unit DIE.
+     * @param out The partial index.
+     */
+    void index_lines(Dwarf_Debug dw, Dwarf_Die cu_die, SymbolIndex &out);
     /**
      * @brief The target being debugged.
      */
     const char *target;
     /**
-     * @brief The process ID of the child process.
+     * @brief Registers and memory of the debugged program.
+     */
+    Target *program;
+    /**
+     * @brief Directories with separate debug info.
+     */
+    std::vector<std::string> debug_dirs;
+    /**
+     * @brief The file the DWARF is read from, empty if there is none.
+     */
+    std::string debug_path;
+    /**
+     * @brief Whether `debug_path` is looked up already.
+     */
+    bool resolved;
+    /**
+     * @brief Whether `dbg` is initialized.
+     */
+    bool opened;
+    /**
+     * @brief Functions, lines and types of the debug file, nullptr until
+     * the index is loaded.
+     */
+    SymbolIndex *index;
+    /**
+     * @brief The thread loading the index in the background.
      */
-    pid_t child_pid;
+    std::thread indexer;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,248 @@
+#include "elfinfo.hpp"
+#include "procmaps.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <elf.h>
+#include <fcntl.h>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Sorts symbols by address and drops the duplicates.
+ */
+static void sort_symbols(std::vector<elf_symbol> &syms) {
+    // .dynsym duplicates part of .symtab
+    std::sort(syms.begin(), syms.end(),
+              [](const elf_symbol &a, const elf_symbol &b) {
+                  return a.addr < b.addr ||
+                         (a.addr == b.addr && a.name < b.name);
+              });
+    syms.erase(std::unique(syms.begin(), syms.end(),
+                           [](const elf_symbol &a, const elf_symbol &b) {
+                               return a.addr == b.addr && a.name == b.name;
+                           }),
+               syms.end());
+}
+
+/**
+ * @brief Finds the symbol with the given name.
+ */
+static const elf_symbol *lookup_symbol(const std::vector<elf_symbol> &syms,
+                                       const std::string &name) {
+    auto it = std::find_if(
+        syms.begin(), syms.end(),
+        [&](const elf_symbol &sym) { return sym.name == name; });
+    return it == syms.end() ? nullptr : &*it;
+}
+
+/**
+ * @brief Finds the symbol containing the address.
+ */
+static const elf_symbol *find_symbol(const std::vector<elf_symbol> &syms,
+                                     uint64_t addr) {
+    auto it = std::upper_bound(
+        syms.begin(), syms.end(), addr,
+        [](uint64_t addr, const elf_symbol &sym) { return addr < sym.addr; });
+    if (it == syms.begin()) {
+        return nullptr;
+    }
+    --it;
+    // Symbols without size cover everything up to the next one
+    return it->size == 0 || addr < it->addr + it->size ? &*it : nullptr;
+}
+
+ElfInfo::ElfInfo(const char *path_) : path(path_), image(nullptr) {
+    int fd = open(path_, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        std::cerr << "cannot open " << path_ << std::endl;
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+
+    image_size = st.st_size;
+    void *mem = mmap(nullptr, image_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        std::cerr << "cannot map " << path_ << std::endl;
+        return;
+    }
+    image = (uint8_t *)mem;
+
+    auto *ehdr = (Elf64_Ehdr *)image;
+    if (image_size < sizeof(Elf64_Ehdr) ||
+        memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+        ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) > image_size) {
+        std::cerr << path_ << " is not an ELF64 file" << std::endl;
+        return;
+    }
+
+    auto *shdrs = (Elf64_Shdr *)(image + ehdr->e_shoff);
+    for (int i = 0; i < ehdr->e_shnum; i++) {
+        if (shdrs[i].sh_type == SHT_SYMTAB || shdrs[i].sh_type == SHT_DYNSYM) {
+            load_symbols(i);
+        }
+    }
+
+    sort_symbols(funcs);
+    sort_symbols(objects);
+}
+
+ElfInfo::~ElfInfo() {
+    if (image != nullptr) {
+        munmap(image, image_size);
+    }
+}
+
+void ElfInfo::load_symbols(int idx) {
+    auto *ehdr = (Elf64_Ehdr *)image;
+    auto *shdrs = (Elf64_Shdr *)(image + ehdr->e_shoff);
+    Elf64_Shdr &symtab = shdrs[idx];
+    if (symtab.sh_link >= ehdr->e_shnum ||
+        symtab.sh_offset + symtab.sh_size > image_size) {
+        return;
+    }
+    Elf64_Shdr &strtab = shdrs[symtab.sh_link];
+    if (strtab.sh_offset + strtab.sh_size > image_size) {
+        return;
+    }
+
+    auto *syms = (Elf64_Sym *)(image + symtab.sh_offset);
+    const char *strs = (const char *)(image + strtab.sh_offset);
+    size_t count = symtab.sh_size / sizeof(Elf64_Sym);
+
+    for (size_t i = 0; i < count; i++) {
+        int type = ELF64_ST_TYPE(syms[i].st_info);
+        if ((type != STT_FUNC && type != STT_OBJECT) ||
+            syms[i].st_shndx == SHN_UNDEF || syms[i].st_value == 0 ||
+            syms[i].st_name >= strtab.sh_size) {
+            continue;
+        }
+        // Objects without size can not be told apart from padding
+        if (type == STT_OBJECT && syms[i].st_size == 0) {
+            continue;
+        }
+        elf_symbol sym = {strs + syms[i].st_name, syms[i].st_value,
+                          syms[i].st_size};
+        if (type == STT_FUNC) {
+            funcs.push_back(sym);
+        } else {
+            objects.push_back(sym);
+        }
+    }
+}
+
+const std::vector<elf_symbol> &ElfInfo::functions() { return funcs; }
+
+uint64_t ElfInfo::load_bias(pid_t pid) {
+    std::vector<proc_map> maps;
+    read_proc_maps(pid, maps);
+    return load_bias(maps);
+}
+
+uint64_t ElfInfo::load_bias(const std::vector<proc_map> &maps) {
+    if (image == nullptr || ((Elf64_Ehdr *)image)->e_type != ET_DYN) {
+        return 0;
+    }
+
+    // The lowest PT_LOAD is mapped at the start of the first file mapping
+    auto *ehdr = (Elf64_Ehdr *)image;
+    auto *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+    uint64_t first_vaddr = UINT64_MAX;
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD) {
+            first_vaddr = std::min(first_vaddr, phdrs[i].p_vaddr);
+        }
+    }
+    first_vaddr &= ~(uint64_t)(sysconf(_SC_PAGESIZE) - 1);
+
+    char real[PATH_MAX];
+    if (realpath(path.c_str(), real) == nullptr) {
+        return 0;
+    }
+
+    for (auto &map: maps) {
+        if (map.path == real && map.offset == 0) {
+            return map.start - first_vaddr;
+        }
+    }
+    return 0;
+}
+
+bool ElfInfo::code_at(uint64_t addr, uint64_t size, const uint8_t *&code) {
+    if (image == nullptr) {
+        return false;
+    }
+
+    auto *ehdr = (Elf64_Ehdr *)image;
+    auto *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdrs[i].p_type != PT_LOAD || addr < phdrs[i].p_vaddr ||
+            addr + size > phdrs[i].p_vaddr + phdrs[i].p_filesz ||
+            phdrs[i].p_offset + phdrs[i].p_filesz > image_size) {
+            continue;
+        }
+        code = image + phdrs[i].p_offset + (addr - phdrs[i].p_vaddr);
+        return true;
+    }
+    return false;
+}
+
+void ElfInfo::load_range(uint64_t &start, uint64_t &end) {
+    start = UINT64_MAX;
+    end = 0;
+    if (image == nullptr) {
+        start = 0;
+        return;
+    }
+
+    auto *ehdr = (Elf64_Ehdr *)image;
+    auto *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD) {
+            start = std::min(start, phdrs[i].p_vaddr);
+            end = std::max(end, phdrs[i].p_vaddr + phdrs[i].p_memsz);
+        }
+    }
+}
+
+const elf_symbol *ElfInfo::find_function(uint64_t addr) {
+    return find_symbol(funcs, addr);
+}
+
+const elf_symbol *ElfInfo::find_object(uint64_t addr) {
+    return find_symbol(objects, addr);
+}
+
+const elf_symbol *ElfInfo::lookup_function(const std::string &name) {
+    return lookup_symbol(funcs, name);
+}
+
+const elf_symbol *ElfInfo::lookup_object(const std::string &name) {
+    return lookup_symbol(objects, name);
+}
+
+std::string ElfInfo::interpreter() {
+    if (image == nullptr) {
+        return "";
+    }
+
+    auto *ehdr = (Elf64_Ehdr *)image;
+    auto *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdrs[i].p_type != PT_INTERP ||
+            phdrs[i].p_offset + phdrs[i].p_filesz > image_size) {
+            continue;
+        }
+        const char *path = (const char *)(image + phdrs[i].p_offset);
+        return std::string(path, strnlen(path, phdrs[i].p_filesz));
+    }
+    return "";
+}
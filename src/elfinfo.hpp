@@ -0,0 +1,159 @@
+#ifndef ELF_INFO_H
+#define ELF_INFO_H
+
+#include "procmaps.hpp"
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief Represents a function symbol of the ELF file.
+ */
+struct elf_symbol {
+    /**
+     * @brief The name of the symbol.
+     */
+    std::string name;
+    /**
+     * @brief The link-time address of the symbol.
+     */
+    uint64_t addr;
+    /**
+     * @brief The size of the function in bytes.
+     */
+    uint64_t size;
+};
+
+/**
+ * @brief The ElfInfo class provides access to the symbol tables of the
+ * debugged executable.
+ *
+ * The file is memory-mapped, `.symtab` and `.dynsym` are read once on
+ * construction, so the debugging target does not need to have debug info.
+ */
+class ElfInfo {
+  public:
+    /**
+     * @brief Constructs an `ElfInfo` object and loads the symbols.
+     *
+     * @param path The path to the ELF file.
+     */
+    ElfInfo(const char *path);
+
+    ~ElfInfo();
+
+    /**
+     * @brief Retrieves the defined function symbols sorted by address.
+     *
+     * @return The function symbols.
+     */
+    const std::vector<elf_symbol> &functions();
+
+    /**
+     * @brief Computes the difference between run-time and link-time
+     * addresses of the executable in the given process.
+     *
+     * @param pid The process ID of the running target.
+     * @return The load bias, 0 for non-PIE executables.
+     */
+    uint64_t load_bias(pid_t pid);
+
+    /**
+     * @brief Computes the load bias from the given memory mappings.
+     *
+     * @param maps Mappings of the process, only file-backed ones are used.
+     * @return The load bias, 0 for non-PIE executables.
+     */
+    uint64_t load_bias(const std::vector<proc_map> &maps);
+
+    /**
+     * @brief Finds the function containing the given link-time address.
+     *
+     * @param addr The link-time address.
+     * @return The function symbol or nullptr.
+     */
+    const elf_symbol *find_function(uint64_t addr);
+
+    /**
+     * @brief Finds the data object containing the given link-time address.
+     *
+     * @param addr The link-time address.
+     * @return The object symbol or nullptr.
+     */
+    const elf_symbol *find_object(uint64_t addr);
+
+    /**
+     * @brief Finds a function symbol by name.
+     *
+     * @param name The name of the function.
+     * @return The function symbol or nullptr.
+     */
+    const elf_symbol *lookup_function(const std::string &name);
+
+    /**
+     * @brief Finds a data object symbol by name.
+     *
+     * @param name The name of the object.
+     * @return The object symbol or nullptr.
+     */
+    const elf_symbol *lookup_object(const std::string &name);
+
+    /**
+     * @brief Retrieves the program interpreter from PT_INTERP.
+     *
+     * @return The path of the dynamic loader, empty for static executables.
+     */
+    std::string interpreter();
+
+    /**
+     * @brief Finds the file contents of the given link-time address range.
+     *
+     * @param addr The link-time address.
+     * @param size The size of the range.
+     * @param code Filled with a pointer into the mapped file.
+     * @return false if the range is not backed by a loadable segment.
+     */
+    bool code_at(uint64_t addr, uint64_t size, const uint8_t *&code);
+
+    /**
+     * @brief Retrieves the link-time address range of the loadable segments.
+     *
+     * @param start Filled with the lowest address.
+     * @param end Filled with the address past the highest one.
+     */
+    void load_range(uint64_t &start, uint64_t &end);
+
+  private:
+    /**
+     * @brief Reads function and object symbols from the section with the
+     * given index.
+     *
+     * @param idx Index of SHT_SYMTAB or SHT_DYNSYM section.
+     */
+    void load_symbols(int idx);
+
+    /**
+     * @brief The path to the ELF file.
+     */
+    std::string path;
+    /**
+     * @brief The mapped file contents.
+     */
+    uint8_t *image;
+    /**
+     * @brief The size of the mapped file.
+     */
+    size_t image_size;
+    /**
+     * @brief The function symbols sorted by address.
+     */
+    std::vector<elf_symbol> funcs;
+    /**
+     * @brief The data object symbols sorted by address.
+     */
+    std::vector<elf_symbol> objects;
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "eventloop.hpp"
+#include "stats.hpp"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <vector>
+
+sigset_t EventLoop::saved_mask;
+
+EventLoop::EventLoop(int input_fd_)
+    : input_fd(input_fd_), input_pollable(true), input_eof(false),
+      waits(0) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &saved_mask);
+
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = signal_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev);
+
+    // epoll refuses regular files, they are always readable anyway
+    ev.data.fd = input_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, input_fd, &ev) < 0) {
+        input_pollable = false;
+    }
+}
+
+EventLoop::~EventLoop() {
+    for (auto &kv: pidfds) {
+        close(kv.second);
+    }
+    // A SIGINT left pending would kill us once unblocked
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+    }
+    close(signal_fd);
+    close(epoll_fd);
+    sigprocmask(SIG_SETMASK, &saved_mask, nullptr);
+}
+
+void EventLoop::restore_signals() {
+    sigprocmask(SIG_SETMASK, &saved_mask, nullptr);
+}
+
+void EventLoop::watch(pid_t pid) {
+    if (pidfds.count(pid) != 0) {
+        return;
+    }
+    // Without pidfds exits are still noticed through SIGCHLD
+    int fd = syscall(SYS_pidfd_open, pid, 0);
+    if (fd < 0) {
+        return;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    pidfds[pid] = fd;
+}
+
+void EventLoop::unwatch(pid_t pid) {
+    auto it = pidfds.find(pid);
+    if (it == pidfds.end()) {
+        return;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second, nullptr);
+    close(it->second);
+    pidfds.erase(it);
+}
+
+void EventLoop::read_input() {
+    char buf[EVENTLOOP_READ_SIZE];
+    ssize_t n = read(input_fd, buf, sizeof(buf));
+    if (n > 0) {
+        input.append(buf, n);
+    } else if (n == 0 || (errno != EINTR && errno != EAGAIN)) {
+        input_eof = true;
+    }
+}
+
+bool EventLoop::pop_line(std::string &line) {
+    size_t end = input.find('\n');
+    if (end == std::string::npos) {
+        return false;
+    }
+    line = input.substr(0, end);
+    input.erase(0, end + 1);
+    return true;
+}
+
+void EventLoop::read_signals(pid_t forward_to) {
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo != SIGINT) {
+            continue;
+        }
+        if (forward_to < 0) {
+            pending.push_back({EVENT_INTERRUPT, "", -1, 0});
+        } else if (info.ssi_code != SI_KERNEL) {
+            // Ctrl-C from the terminal reaches the process by itself
+            kill(forward_to, SIGINT);
+        }
+    }
+}
+
+void EventLoop::reap_watched(pid_t except) {
+    std::vector<pid_t> exited;
+    for (auto &kv: pidfds) {
+        if (kv.first == except) {
+            continue;
+        }
+        // A consumed status is never lost, stops are kept like exits
+        int status = 0;
+        pid_t got = waitpid(kv.first, &status, WNOHANG | __WALL);
+        if ((got > 0 && (WIFEXITED(status) || WIFSIGNALED(status))) ||
+            (got < 0 && errno == ECHILD)) {
+            pending.push_back({EVENT_EXIT, "", kv.first, status});
+            exited.push_back(kv.first);
+        } else if (got > 0 && WIFSTOPPED(status)) {
+            pending.push_back({EVENT_STOP, "", kv.first, status});
+        }
+    }
+    for (pid_t pid: exited) {
+        unwatch(pid);
+    }
+}
+
+void EventLoop::poll_input(bool enable) {
+    if (!input_pollable) {
+        return;
+    }
+    // Removed rather than masked, a hangup is reported regardless of mask
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = input_fd;
+    epoll_ctl(epoll_fd, enable ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, input_fd,
+              &ev);
+}
+
+void EventLoop::dispatch(pid_t current) {
+    struct epoll_event events[EVENTLOOP_MAX_EVENTS];
+    int n = epoll_wait(epoll_fd, events, EVENTLOOP_MAX_EVENTS, -1);
+    for (int i = 0; i < n; i++) {
+        if (events[i].data.fd == input_fd) {
+            read_input();
+        } else if (events[i].data.fd == signal_fd) {
+            read_signals(current);
+        }
+        // A pidfd is readable once its process exits
+    }
+    reap_watched(current);
+}
+
+void EventLoop::next_event(loop_event &event) {
+    for (;;) {
+        if (!pending.empty()) {
+            event = pending.front();
+            pending.pop_front();
+            return;
+        }
+        if (pop_line(event.line)) {
+            event.type = EVENT_LINE;
+            return;
+        }
+        if (input_eof) {
+            // The last line may have no newline
+            event.type = input.empty() ? EVENT_EOF : EVENT_LINE;
+            event.line.swap(input);
+            input.clear();
+            return;
+        }
+        if (input_pollable) {
+            dispatch(-1);
+        } else {
+            read_input();
+        }
+    }
+}
+
+pid_t EventLoop::wait_process(pid_t pid, int *status) {
+    waits++;
+    uint64_t start = stats_now();
+    poll_input(false);
+    pid_t got = 0;
+    // The stop may have been noticed while another process was waited for
+    for (auto it = pending.begin(); it != pending.end(); ++it) {
+        if (it->type == EVENT_STOP && it->pid == pid) {
+            *status = it->status;
+            got = pid;
+            pending.erase(it);
+            break;
+        }
+    }
+    while (got == 0 && (got = waitpid(pid, status, WNOHANG | __WALL)) == 0) {
+        dispatch(pid);
+    }
+    poll_input(true);
+    global_stats.time(STATS_WAIT, stats_now() - start);
+    global_stats.stopped();
+
+    if (got == pid && (WIFEXITED(*status) || WIFSIGNALED(*status))) {
+        unwatch(pid);
+    }
+    return got;
+}
+
+void EventLoop::resumed(pid_t pid) {
+    for (auto it = pending.begin(); it != pending.end();) {
+        if (it->type == EVENT_STOP && it->pid == pid) {
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool EventLoop::ready() {
+    return !pending.empty() || input_eof ||
+           input.find('\n') != std::string::npos;
+}
@@ -0,0 +1,230 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <cstdint>
+#include <deque>
+#include <signal.h>
+#include <string>
+#include <sys/types.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#define EVENTLOOP_MAX_EVENTS 16
+#define EVENTLOOP_READ_SIZE 4096
+
+/**
+ * @brief Kinds of events reported by the EventLoop.
+ */
+enum event_type {
+    /**
+     * @brief A line of input was read.
+     */
+    EVENT_LINE,
+    /**
+     * @brief The input is closed.
+     */
+    EVENT_EOF,
+    /**
+     * @brief SIGINT was received.
+     */
+    EVENT_INTERRUPT,
+    /**
+     * @brief A watched process exited.
+     */
+    EVENT_EXIT,
+    /**
+     * @brief A watched process stopped while another one was waited for.
+     */
+    EVENT_STOP,
+};
+
+/**
+ * @brief An event reported by the EventLoop.
+ */
+struct loop_event {
+    /**
+     * @brief The kind of the event.
+     */
+    event_type type;
+    /**
+     * @brief The line without the newline for EVENT_LINE.
+     */
+    std::string line;
+    /**
+     * @brief The process for EVENT_EXIT and EVENT_STOP.
+     */
+    pid_t pid;
+    /**
+     * @brief The wait status for EVENT_EXIT and EVENT_STOP.
+     */
+    int status;
+};
+
+/**
+ * @brief The EventLoop class multiplexes the input, SIGINT and SIGCHLD and
+ * the debugged processes on one epoll instance.
+ *
+ * SIGINT and SIGCHLD are blocked and read from a signalfd, so nothing runs
+ * in a signal handler. Every watched process has a pidfd, its exit is
+ * noticed even while nothing waits for it. Processes are only ever waited
+ * for by their process ID, a wait never reaps some other child.
+ */
+class EventLoop {
+  public:
+    /**
+     * @brief Constructs an `EventLoop` object and blocks SIGINT and SIGCHLD.
+     *
+     * @param input_fd_ The file to read commands from.
+     */
+    EventLoop(int input_fd_ = STDIN_FILENO);
+
+    /**
+     * @brief Closes the descriptors and restores the signal mask.
+     */
+    ~EventLoop();
+
+    /**
+     * @brief Restores the signal mask in a forked child before exec.
+     */
+    static void restore_signals();
+
+    /**
+     * @brief Starts watching for the exit of a process.
+     *
+     * @param pid The process ID.
+     */
+    void watch(pid_t pid);
+
+    /**
+     * @brief Stops watching a process.
+     *
+     * @param pid The process ID.
+     */
+    void unwatch(pid_t pid);
+
+    /**
+     * @brief Waits for the next line of input, SIGINT or exit of a watched
+     * process.
+     *
+     * @param event Filled with the event.
+     */
+    void next_event(loop_event &event);
+
+    /**
+     * @brief Waits until the given traced process changes state.
+     *
+     * SIGINT not sent by the terminal, which signals the whole process
+     * group, is forwarded to the process. Exits and stops of other watched
+     * processes are kept for `next_event`, a kept stop of this process is
+     * returned right away. The input is not read meanwhile, it belongs to
+     * the process.
+     *
+     * @param pid The process ID.
+     * @param status Filled with the wait status.
+     * @return The process ID or -1 on error.
+     */
+    pid_t wait_process(pid_t pid, int *status);
+
+    /**
+     * @brief Drops the kept stops of a process that is resumed.
+     *
+     * @param pid The process ID.
+     */
+    void resumed(pid_t pid);
+    /**
+     * @brief Checks whether `next_event` returns without waiting.
+     *
+     * @return true if an event or a complete line is already buffered.
+     */
+    bool ready();
+
+    /**
+     * @brief Returns the number of `wait_process` calls so far.
+     */
+    uint64_t wait_count() { return waits; }
+
+  private:
+    /**
+     * @brief Reads the available input into the line buffer.
+     */
+    void read_input();
+
+    /**
+     * @brief Moves the first complete line out of the buffer.
+     *
+     * @return false if there is no complete line.
+     */
+    bool pop_line(std::string &line);
+
+    /**
+     * @brief Reads the pending signals.
+     *
+     * @param forward_to The process to forward SIGINT to, -1 to report it
+     * as EVENT_INTERRUPT.
+     */
+    void read_signals(pid_t forward_to);
+
+    /**
+     * @brief Reaps watched processes that exited or stopped and queues
+     * EVENT_EXIT or EVENT_STOP.
+     *
+     * @param except A process left to its waiter.
+     */
+    void reap_watched(pid_t except);
+
+    /**
+     * @brief Enables or disables the input on the epoll instance.
+     */
+    void poll_input(bool enable);
+
+    /**
+     * @brief Waits on the epoll instance and handles the ready descriptors.
+     *
+     * @param current The process waited for or -1.
+     */
+    void dispatch(pid_t current);
+
+    /**
+     * @brief The signal mask before the constructor.
+     */
+    static sigset_t saved_mask;
+
+    /**
+     * @brief The file commands are read from.
+     */
+    int input_fd;
+    /**
+     * @brief The epoll instance.
+     */
+    int epoll_fd;
+    /**
+     * @brief The signalfd for SIGINT and SIGCHLD.
+     */
+    int signal_fd;
+    /**
+     * @brief Whether the input can be polled, regular files can not.
+     */
+    bool input_pollable;
+    /**
+     * @brief Whether the input is closed.
+     */
+    bool input_eof;
+    /**
+     * @brief Input read but not yet returned as lines.
+     */
+    std::string input;
+    /**
+     * @brief pidfds of the watched processes by process ID.
+     */
+    std::unordered_map<pid_t, int> pidfds;
+    /**
+     * @brief Events noticed while waiting for something else.
+     */
+    std::deque<loop_event> pending;
+    /**
+     * @brief The number of `wait_process` calls.
+     */
+    uint64_t waits;
+};
+
+#endif
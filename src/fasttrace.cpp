@@ -0,0 +1,170 @@
+#include "fasttrace.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <stddef.h>
+#include <sys/mman.h>
+
+/**
+ * @brief Appends bytes to the code.
+ */
+static void emit(std::vector<uint8_t> &code,
+                 std::initializer_list<uint8_t> bytes) {
+    code.insert(code.end(), bytes);
+}
+
+/**
+ * @brief Appends a little-endian value to the code.
+ */
+template <typename T> static void emit_value(std::vector<uint8_t> &code, T v) {
+    uint8_t bytes[sizeof(T)];
+    memcpy(bytes, &v, sizeof(T));
+    code.insert(code.end(), bytes, bytes + sizeof(T));
+}
+
+/**
+ * @brief Appends `mov [rcx + offset], reg`, the register numbered as in the
+ * ModRM reg field, 8 and above for r8-r15.
+ */
+static void emit_store(std::vector<uint8_t> &code, uint8_t reg,
+                       size_t offset) {
+    emit(code, {(uint8_t)(reg >= 8 ? 0x4c : 0x48), 0x89,
+                (uint8_t)(0x41 | (reg & 7) << 3), (uint8_t)offset});
+}
+
+void fasttrace_record_code(uint64_t ring, uint32_t id,
+                           std::vector<uint8_t> &code) {
+    // lea rsp, [rsp - 128], the red zone may be in use; pushfq; push rax;
+    // push rcx; push rdx
+    emit(code, {0x48, 0x8d, 0x64, 0x24, 0x80, 0x9c, 0x50, 0x51, 0x52});
+    // mov rcx, ring
+    emit(code, {0x48, 0xb9});
+    emit_value<uint64_t>(code, ring);
+    // mov eax, 1; lock xadd [rcx], rax; mov rdx, rax
+    emit(code, {0xb8, 0x01, 0x00, 0x00, 0x00, 0xf0, 0x48, 0x0f, 0xc1, 0x01,
+                0x48, 0x89, 0xc2});
+    // and rax, [rcx + mask]
+    emit(code, {0x48, 0x23, 0x41, offsetof(fasttrace_ring_header, mask)});
+    // imul rax, rax, sizeof(record); lea rcx, [rcx + rax + sizeof(header)]
+    emit(code, {0x48, 0x69, 0xc0});
+    emit_value<uint32_t>(code, sizeof(fasttrace_record));
+    emit(code, {0x48, 0x8d, 0x8c, 0x01});
+    emit_value<uint32_t>(code, sizeof(fasttrace_ring_header));
+    // mov qword [rcx + seq], 0, as in a seqlock the record is marked as
+    // being written before any field changes
+    emit(code, {0x48, 0xc7, 0x41, offsetof(fasttrace_record, seq)});
+    emit_value<uint32_t>(code, 0);
+    // push rdx, the index; rdtsc; shl rdx, 32; or rax, rdx
+    emit(code, {0x52, 0x0f, 0x31, 0x48, 0xc1, 0xe2, 0x20, 0x48, 0x09, 0xd0});
+    emit_store(code, 0, offsetof(fasttrace_record, tsc));
+    // mov qword [rcx + id], imm32
+    emit(code, {0x48, 0xc7, 0x41, offsetof(fasttrace_record, id)});
+    emit_value<uint32_t>(code, id);
+    emit_store(code, 7, offsetof(fasttrace_record, rdi));
+    emit_store(code, 6, offsetof(fasttrace_record, rsi));
+    emit_store(code, 8, offsetof(fasttrace_record, r8));
+    emit_store(code, 9, offsetof(fasttrace_record, r9));
+
+    // The saved rdx, rcx and rax are above the index on the stack
+    const size_t saved[] = {offsetof(fasttrace_record, rdx),
+                            offsetof(fasttrace_record, rcx),
+                            offsetof(fasttrace_record, rax)};
+    for (size_t i = 0; i < 3; i++) {
+        // mov rax, [rsp + 8 * (i + 1)]
+        emit(code, {0x48, 0x8b, 0x44, 0x24, (uint8_t)(8 * (i + 1))});
+        emit_store(code, 0, saved[i]);
+    }
+    // lea rax, [rsp + 168], rsp before the trampoline
+    emit(code, {0x48, 0x8d, 0x84, 0x24});
+    emit_value<uint32_t>(code, 128 + 5 * sizeof(uint64_t));
+    emit_store(code, 0, offsetof(fasttrace_record, rsp));
+
+    // pop rdx; inc rdx; the sequence number goes last, x86 keeps stores
+    // in order, so a reader seeing it sees the whole record
+    emit(code, {0x5a, 0x48, 0xff, 0xc2});
+    emit_store(code, 2, offsetof(fasttrace_record, seq));
+    // pop rdx; pop rcx; pop rax; popfq; lea rsp, [rsp + 128]
+    emit(code, {0x5a, 0x59, 0x58, 0x9d, 0x48, 0x8d, 0xa4, 0x24});
+    emit_value<uint32_t>(code, 128);
+}
+
+void fasttrace_jump_code(uint64_t target, std::vector<uint8_t> &code) {
+    emit(code, {0xff, 0x25, 0x00, 0x00, 0x00, 0x00});
+    emit_value<uint64_t>(code, target);
+}
+
+size_t fasttrace_ring_size(size_t records) {
+    return sizeof(fasttrace_ring_header) + records * sizeof(fasttrace_record);
+}
+
+TraceRing::TraceRing(void *mem, size_t records)
+    : header((fasttrace_ring_header *)mem),
+      slots((fasttrace_record *)(header + 1)), capacity(records), tail(0),
+      lost_records(0), stopping(false) {
+    header->mask = records - 1;
+}
+
+TraceRing::~TraceRing() {
+    stop();
+    munmap(header, fasttrace_ring_size(capacity));
+}
+
+void TraceRing::start() {
+    if (drainer.joinable()) {
+        return;
+    }
+    stopping = false;
+    drainer = std::thread([this]() {
+        while (!stopping) {
+            drain();
+            std::this_thread::sleep_for(
+                std::chrono::microseconds(FASTTRACE_DRAIN_US));
+        }
+    });
+}
+
+void TraceRing::stop() {
+    if (drainer.joinable()) {
+        stopping = true;
+        drainer.join();
+    }
+    drain();
+}
+
+size_t TraceRing::drain() {
+    std::lock_guard<std::mutex> guard(lock);
+    uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+    if (head - tail > capacity) {
+        // Lapped, the oldest records are gone
+        lost_records += head - tail - capacity;
+        tail = head - capacity;
+    }
+
+    size_t count = 0;
+    for (; tail < head; tail++) {
+        fasttrace_record *slot = &slots[tail & (capacity - 1)];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq < tail + 1) {
+            // Still being written
+            break;
+        }
+        fasttrace_record copy = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // A writer lapping the reader zeroes seq before it changes the
+        // record, so a copy torn by it never passes this check
+        if (seq > tail + 1 ||
+            __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq) {
+            lost_records++;
+            continue;
+        }
+        drained.push_back(copy);
+        count++;
+    }
+    return count;
+}
+
+void TraceRing::take(std::vector<fasttrace_record> &out) {
+    std::lock_guard<std::mutex> guard(lock);
+    out.insert(out.end(), drained.begin(), drained.end());
+    drained.clear();
+}
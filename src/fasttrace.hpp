@@ -0,0 +1,188 @@
+#ifndef FASTTRACE_H
+#define FASTTRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records in the ring, a power of two
+#define FASTTRACE_RING_RECORDS (1 << 16)
+// Trampolines of one process live in one mapping
+#define FASTTRACE_CODE_SIZE 0x10000
+// The code mapping is asked this far below the traced code
+#define FASTTRACE_HINT_GAP 0x200000
+// How often the ring is drained
+#define FASTTRACE_DRAIN_US 1000
+#define FASTTRACE_JMP_SIZE 5
+#define FASTTRACE_MEMFD_NAME "debugrik-trace"
+#define FASTTRACE_DEFAULT_OUTPUT "tracepoints.txt"
+
+/**
+ * @brief A tracepoint hit, written by the trampoline.
+ */
+struct fasttrace_record {
+    /**
+     * @brief The index of the record plus one, zeroed before the other
+     * fields are written and set last.
+     */
+    uint64_t seq;
+    /**
+     * @brief The number of the tracepoint.
+     */
+    uint64_t id;
+    /**
+     * @brief The time stamp counter at the hit.
+     */
+    uint64_t tsc;
+    /**
+     * @brief Registers at the hit.
+     */
+    uint64_t rsp, rax, rcx, rdx, rsi, rdi, r8, r9;
+    /**
+     * @brief Padding to 96 bytes.
+     */
+    uint64_t reserved;
+};
+
+/**
+ * @brief The start of the shared ring, the records follow.
+ */
+struct fasttrace_ring_header {
+    /**
+     * @brief The number of reserved records, incremented by trampolines.
+     */
+    uint64_t head;
+    /**
+     * @brief The number of records minus one.
+     */
+    uint64_t mask;
+    /**
+     * @brief Padding to a cache line.
+     */
+    uint64_t reserved[6];
+};
+
+/**
+ * @brief Appends the code recording a hit into the ring.
+ *
+ * The code keeps the red zone and every register and flag intact. Only
+ * rax, rcx, rdx and the flags are touched, and they are saved on the stack.
+ * A record is reserved with `lock xadd` on the head, so threads never wait
+ * for each other.
+ *
+ * @param ring The address of the ring in the process running the code.
+ * @param id The number of the tracepoint.
+ * @param code The code of the trampoline.
+ */
+void fasttrace_record_code(uint64_t ring, uint32_t id,
+                           std::vector<uint8_t> &code);
+
+/**
+ * @brief Appends an absolute jump, `jmp [rip]` followed by the target.
+ *
+ * @param target The address to jump to.
+ * @param code The code of the trampoline.
+ */
+void fasttrace_jump_code(uint64_t target, std::vector<uint8_t> &code);
+
+/**
+ * @brief Retrieves the size of a ring mapping.
+ *
+ * @param records The number of records, a power of two.
+ */
+size_t fasttrace_ring_size(size_t records);
+
+/**
+ * @brief The TraceRing class collects the records of a ring shared with the
+ * traced process.
+ *
+ * The ring is drained by a thread of its own, it only reads the shared
+ * memory and needs nothing of ptrace.
+ */
+class TraceRing {
+  public:
+    /**
+     * @brief Takes over a zeroed ring mapping and sets it up.
+     *
+     * @param mem The mapping, unmapped by the destructor.
+     * @param records The number of records, a power of two.
+     */
+    TraceRing(void *mem, size_t records);
+
+    ~TraceRing();
+
+    /**
+     * @brief Starts the drain thread.
+     */
+    void start();
+
+    /**
+     * @brief Stops the drain thread, the last records are drained.
+     */
+    void stop();
+
+    /**
+     * @brief Moves finished records out of the ring.
+     *
+     * A record still being written stops the drain until the next call.
+     *
+     * @return The number of drained records.
+     */
+    size_t drain();
+
+    /**
+     * @brief Hands over the drained records.
+     *
+     * @param out The records are appended here.
+     */
+    void take(std::vector<fasttrace_record> &out);
+
+    /**
+     * @brief Returns the number of records overwritten before they were
+     * drained.
+     */
+    uint64_t lost() { return lost_records; }
+
+  private:
+    /**
+     * @brief The shared mapping.
+     */
+    fasttrace_ring_header *header;
+    /**
+     * @brief The records of the ring.
+     */
+    fasttrace_record *slots;
+    /**
+     * @brief The number of records.
+     */
+    size_t capacity;
+    /**
+     * @brief The index of the next record to drain.
+     */
+    uint64_t tail;
+    /**
+     * @brief Records overwritten before they were drained.
+     */
+    std::atomic<uint64_t> lost_records;
+    /**
+     * @brief Drained records not taken yet.
+     */
+    std::vector<fasttrace_record> drained;
+    /**
+     * @brief Guards `tail` and `drained`.
+     */
+    std::mutex lock;
+    /**
+     * @brief The drain thread.
+     */
+    std::thread drainer;
+    /**
+     * @brief Tells the drain thread to finish.
+     */
+    std::atomic<bool> stopping;
+};
+
+#endif
@@ -0,0 +1,31 @@
+/*
+    A function with a large struct local, the `il` fixture, and a large
+    buffer for the memory bandwidth benchmark
+*/
+#include <string.h>
+
+#define BENCH_BUFFER_SIZE (64 << 20)
+
+struct bench_big {
+    unsigned long values[4096];
+    char name[256];
+    double weights[512];
+};
+
+volatile unsigned long bench_sink;
+char bench_buffer[BENCH_BUFFER_SIZE];
+
+void bench_stop(unsigned long n) {
+    struct bench_big big;
+    int counter = 42;
+    memset(&big, (int)n, sizeof(big));
+    bench_sink += big.values[n % 4096] + counter;
+}
+
+int main(void) {
+    // Touched, so the whole buffer is mapped
+    memset(bench_buffer, 2, sizeof(bench_buffer));
+    for (unsigned long i = 0;; i++) {
+        bench_stop(i);
+    }
+}
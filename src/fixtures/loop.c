@@ -0,0 +1,12 @@
+/*
+    A tight loop calling a function, the breakpoint and single-step fixture
+*/
+volatile unsigned long bench_sink;
+
+void bench_hit(unsigned long i) { bench_sink += i; }
+
+int main(void) {
+    for (unsigned long i = 0;; i++) {
+        bench_hit(i);
+    }
+}
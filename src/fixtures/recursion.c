@@ -0,0 +1,23 @@
+/*
+    Deep recursion stopping at the bottom, the `dis` and `bt` fixture
+*/
+#define BENCH_DEPTH 10000
+
+volatile unsigned long bench_sink;
+
+void bench_bottom(unsigned long depth) {
+    for (;;) {
+        bench_sink += depth;
+    }
+}
+
+unsigned long bench_recurse(unsigned long depth) {
+    if (depth == 0) {
+        bench_bottom(depth);
+    } else {
+        bench_sink += bench_recurse(depth - 1);
+    }
+    return bench_sink;
+}
+
+int main(void) { return (int)bench_recurse(BENCH_DEPTH); }
@@ -0,0 +1,29 @@
+/*
+    A loop like loop.c next to many spinning threads, which are not traced
+    and never reach the breakpoint
+*/
+#include <pthread.h>
+
+#define BENCH_THREADS 64
+
+volatile unsigned long bench_sink;
+
+void bench_hit(unsigned long i) { bench_sink += i; }
+
+static void *spin(void *arg) {
+    volatile unsigned long n = 0;
+    for (;;) {
+        n++;
+    }
+    return arg;
+}
+
+int main(void) {
+    pthread_t threads[BENCH_THREADS];
+    for (int i = 0; i < BENCH_THREADS; i++) {
+        pthread_create(&threads[i], 0, spin, 0);
+    }
+    for (unsigned long i = 0;; i++) {
+        bench_hit(i);
+    }
+}
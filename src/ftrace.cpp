@@ -0,0 +1,63 @@
+#include "ftrace.hpp"
+#include "mi.hpp"
+
+#include <stdio.h>
+#include <time.h>
+
+uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void TraceBuffer::record(pid_t tid, uint32_t func, char kind) {
+    record(tid, func, kind, monotonic_ns());
+}
+
+void TraceBuffer::record(pid_t tid, uint32_t func, char kind, uint64_t ts) {
+    std::vector<trace_event> &events = threads[tid];
+    if (events.capacity() == 0) {
+        events.reserve(FTRACE_RESERVE_EVENTS);
+    }
+    events.push_back({ts, func, kind});
+}
+
+size_t TraceBuffer::size() {
+    size_t total = 0;
+    for (auto &kv: threads) {
+        total += kv.second.size();
+    }
+    return total;
+}
+
+bool TraceBuffer::write_chrome_trace(const char *path, pid_t pid,
+                                     const std::vector<std::string> &names) {
+    FILE *out = fopen(path, "w");
+    if (out == nullptr) {
+        return false;
+    }
+
+    // Demangled C++ names may hold quotes and backslashes
+    std::vector<std::string> quoted(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        json_string(quoted[i], names[i]);
+    }
+
+    fprintf(out, "{\"traceEvents\":[");
+    bool first = true;
+    for (auto &kv: threads) {
+        for (auto &ev: kv.second) {
+            // Chrome trace timestamps are in microseconds
+            fprintf(out,
+                    "%s\n{\"name\":%s,\"ph\":\"%c\",\"ts\":%llu.%03llu,"
+                    "\"pid\":%d,\"tid\":%d}",
+                    first ? "" : ",", quoted[ev.func].c_str(), ev.kind,
+                    (unsigned long long)(ev.ts / 1000),
+                    (unsigned long long)(ev.ts % 1000), pid, kv.first);
+            first = false;
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    return fclose(out) == 0;
+}
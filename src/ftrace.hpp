@@ -0,0 +1,99 @@
+#ifndef FTRACE_H
+#define FTRACE_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+#define FTRACE_ENTRY 'B'
+#define FTRACE_EXIT 'E'
+#define FTRACE_DEFAULT_OUTPUT "trace.json"
+#define FTRACE_RESERVE_EVENTS (1 << 16)
+
+/**
+ * @brief A single function entry or exit event.
+ */
+struct trace_event {
+    /**
+     * @brief CLOCK_MONOTONIC timestamp in nanoseconds.
+     */
+    uint64_t ts;
+    /**
+     * @brief Index of the traced function.
+     */
+    uint32_t func;
+    /**
+     * @brief FTRACE_ENTRY or FTRACE_EXIT.
+     */
+    char kind;
+};
+
+/**
+ * @brief A frame of a traced function that has not returned yet.
+ */
+struct trace_frame {
+    /**
+     * @brief Index of the traced function.
+     */
+    uint32_t func;
+    /**
+     * @brief The value of rsp right after the function returns.
+     */
+    uint64_t cfa;
+    /**
+     * @brief The return address of the frame.
+     */
+    uint64_t ret_addr;
+};
+
+/**
+ * @brief Returns the current CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t monotonic_ns();
+
+/**
+ * @brief The TraceBuffer class collects function trace events in per-thread
+ * binary buffers and writes them out as a Chrome trace.
+ */
+class TraceBuffer {
+  public:
+    /**
+     * @brief Records an event with the current timestamp.
+     *
+     * @param tid The thread that produced the event.
+     * @param func Index of the traced function.
+     * @param kind FTRACE_ENTRY or FTRACE_EXIT.
+     */
+    void record(pid_t tid, uint32_t func, char kind);
+
+    /**
+     * @brief Records an event with the given timestamp.
+     */
+    void record(pid_t tid, uint32_t func, char kind, uint64_t ts);
+
+    /**
+     * @brief Returns the total number of recorded events.
+     */
+    size_t size();
+
+    /**
+     * @brief Writes the events in Chrome trace (Perfetto) JSON format.
+     *
+     * @param path The output file.
+     * @param pid The process ID stored in the events.
+     * @param names Names of the traced functions indexed by `func`.
+     * @return false if the file can not be written.
+     */
+    bool write_chrome_trace(const char *path, pid_t pid,
+                            const std::vector<std::string> &names);
+
+  private:
+    /**
+     * @brief Events of every traced thread.
+     */
+    std::unordered_map<pid_t, std::vector<trace_event>> threads;
+};
+
+#endif
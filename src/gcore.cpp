@@ -0,0 +1,266 @@
+#include "gcore.hpp"
+
+#include <algorithm>
+#include <elf.h>
+#include <fcntl.h>
+#include <fstream>
+#include <signal.h>
+#include <sstream>
+#include <string.h>
+#include <sys/procfs.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ * @brief Rounds the value up to a multiple of the alignment.
+ */
+static uint64_t align_up(uint64_t value, uint64_t align) {
+    return (value + align - 1) / align * align;
+}
+
+/**
+ * @brief Appends a note with the "CORE" owner.
+ */
+static void add_note(std::vector<uint8_t> &notes, uint32_t type,
+                     const void *desc, size_t size) {
+    Elf64_Nhdr hdr = {sizeof(GCORE_NOTE_NAME), (Elf64_Word)size, type};
+    size_t pos = notes.size();
+    size_t name_size = align_up(sizeof(GCORE_NOTE_NAME), 4);
+    notes.resize(pos + sizeof(hdr) + name_size + align_up(size, 4));
+
+    memcpy(&notes[pos], &hdr, sizeof(hdr));
+    memcpy(&notes[pos + sizeof(hdr)], GCORE_NOTE_NAME,
+           sizeof(GCORE_NOTE_NAME));
+    memcpy(&notes[pos + sizeof(hdr) + name_size], desc, size);
+}
+
+/**
+ * @brief Reads a whole file from procfs.
+ */
+static std::string read_proc_file(pid_t pid, const char *name) {
+    std::ifstream in("/proc/" + std::to_string(pid) + "/" + name);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+/**
+ * @brief Checks whether a page contains only zeros.
+ */
+static bool is_zero_page(const uint8_t *page, size_t size) {
+    auto *words = (const uint64_t *)page;
+    uint64_t acc = 0;
+    for (size_t i = 0; i < size / sizeof(uint64_t); i++) {
+        acc |= words[i];
+    }
+    return acc == 0;
+}
+
+/**
+ * @brief Whether the contents of the mapping go to the core file.
+ */
+static bool is_dumped(const proc_map &map, bool skip_ro_file) {
+    if (map.perms[0] != 'r' || map.path == "[vvar]") {
+        return false;
+    }
+    return !(skip_ro_file && map.is_file() && map.perms[1] != 'w' &&
+             map.anonymous == 0);
+}
+
+CoreDump::CoreDump(pid_t pid_) : pid(pid_), bytes_dumped(0), bytes_written(0) {}
+
+bool CoreDump::add_thread(pid_t tid) {
+    core_thread thread;
+    thread.tid = tid;
+    if (ptrace(PTRACE_GETREGS, tid, 0, &thread.regs) < 0 ||
+        ptrace(PTRACE_GETFPREGS, tid, 0, &thread.fpregs) < 0) {
+        return false;
+    }
+    threads.push_back(thread);
+    return true;
+}
+
+void CoreDump::build_notes(const std::vector<proc_map> &maps,
+                           std::vector<uint8_t> &notes) {
+    struct elf_prpsinfo psinfo;
+    memset(&psinfo, 0, sizeof(psinfo));
+    psinfo.pr_sname = 't';
+    psinfo.pr_pid = pid;
+    std::string comm = read_proc_file(pid, "comm");
+    if (!comm.empty() && comm.back() == '\n') {
+        comm.pop_back();
+    }
+    strncpy(psinfo.pr_fname, comm.c_str(), sizeof(psinfo.pr_fname) - 1);
+    std::string args = read_proc_file(pid, "cmdline");
+    for (char &c: args) {
+        c = c == '\0' ? ' ' : c;
+    }
+    strncpy(psinfo.pr_psargs, args.c_str(), sizeof(psinfo.pr_psargs) - 1);
+
+    // NT_FILE: count, page size, {start, end, page offset}..., names
+    long page_size = sysconf(_SC_PAGESIZE);
+    std::vector<uint64_t> file_hdr = {0, (uint64_t)page_size};
+    std::string file_names;
+    for (auto &map: maps) {
+        if (!map.is_file()) {
+            continue;
+        }
+        file_hdr[0]++;
+        file_hdr.push_back(map.start);
+        file_hdr.push_back(map.end);
+        file_hdr.push_back(map.offset / page_size);
+        file_names.append(map.path.c_str(), map.path.size() + 1);
+    }
+    std::vector<uint8_t> file_note(file_hdr.size() * sizeof(uint64_t) +
+                                   file_names.size());
+    memcpy(file_note.data(), file_hdr.data(),
+           file_hdr.size() * sizeof(uint64_t));
+    memcpy(file_note.data() + file_hdr.size() * sizeof(uint64_t),
+           file_names.data(), file_names.size());
+
+    std::string auxv = read_proc_file(pid, "auxv");
+
+    // The current thread goes first with the process-wide notes
+    for (size_t i = 0; i < threads.size(); i++) {
+        struct elf_prstatus status;
+        memset(&status, 0, sizeof(status));
+        status.pr_pid = threads[i].tid;
+        status.pr_cursig = i == 0 ? SIGSTOP : 0;
+        status.pr_fpvalid = 1;
+        memcpy(&status.pr_reg, &threads[i].regs, sizeof(status.pr_reg));
+        add_note(notes, NT_PRSTATUS, &status, sizeof(status));
+
+        if (i == 0) {
+            add_note(notes, NT_PRPSINFO, &psinfo, sizeof(psinfo));
+            add_note(notes, NT_AUXV, auxv.data(), auxv.size());
+            add_note(notes, NT_FILE, file_note.data(), file_note.size());
+        }
+        add_note(notes, NT_FPREGSET, &threads[i].fpregs,
+                 sizeof(threads[i].fpregs));
+    }
+}
+
+bool CoreDump::copy_memory(int fd, uint64_t addr, uint64_t size,
+                           uint64_t offset, std::vector<uint8_t> &buf) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t end = addr + size;
+
+    while (addr < end) {
+        size_t len = std::min<uint64_t>(buf.size(), end - addr);
+        struct iovec local = {buf.data(), len};
+        struct iovec remote = {(void *)addr, len};
+        ssize_t got = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+        if (got <= 0) {
+            // An unreadable page stays a hole
+            addr += page_size;
+            offset += page_size;
+            continue;
+        }
+
+        // Restore the bytes under breakpoints before zero pages are found
+        for (auto it = shadow.lower_bound(addr);
+             it != shadow.end() && it->first < addr + got; it++) {
+            buf[it->first - addr] = it->second;
+        }
+
+        // Write runs of non-zero pages
+        size_t run = 0;
+        for (size_t pos = 0; pos <= (size_t)got; pos += page_size) {
+            bool is_end = pos == (size_t)got;
+            if (!is_end && !is_zero_page(&buf[pos], page_size)) {
+                continue;
+            }
+            if (pos > run) {
+                size_t bytes = pos - run;
+                if (pwrite(fd, &buf[run], bytes, offset + run) !=
+                    (ssize_t)bytes) {
+                    return false;
+                }
+                bytes_written += bytes;
+            }
+            run = pos + page_size;
+        }
+
+        addr += got;
+        offset += got;
+    }
+    return true;
+}
+
+bool CoreDump::write(const char *path, bool skip_ro_file) {
+    std::vector<proc_map> maps;
+    if (!read_proc_maps(pid, maps, skip_ro_file)) {
+        return false;
+    }
+    // The kernel can not read it for another process
+    for (size_t i = 0; i < maps.size(); i++) {
+        if (maps[i].path == "[vsyscall]") {
+            maps.erase(maps.begin() + i--);
+        }
+    }
+
+    std::vector<uint8_t> notes;
+    build_notes(maps, notes);
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t phnum = maps.size() + 1;
+    uint64_t notes_offset = sizeof(Elf64_Ehdr) + phnum * sizeof(Elf64_Phdr);
+    uint64_t offset = align_up(notes_offset + notes.size(), page_size);
+
+    Elf64_Ehdr ehdr;
+    memset(&ehdr, 0, sizeof(ehdr));
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_NONE;
+    ehdr.e_type = ET_CORE;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_phoff = sizeof(Elf64_Ehdr);
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_phentsize = sizeof(Elf64_Phdr);
+    ehdr.e_phnum = phnum;
+
+    std::vector<Elf64_Phdr> phdrs(phnum);
+    phdrs[0] = {PT_NOTE, 0, notes_offset, 0, 0, notes.size(), 0, 4};
+    for (size_t i = 0; i < maps.size(); i++) {
+        proc_map &map = maps[i];
+        Elf64_Phdr &phdr = phdrs[i + 1];
+        phdr.p_type = PT_LOAD;
+        phdr.p_flags = (map.perms[0] == 'r' ? PF_R : 0) |
+                       (map.perms[1] == 'w' ? PF_W : 0) |
+                       (map.perms[2] == 'x' ? PF_X : 0);
+        phdr.p_offset = offset;
+        phdr.p_vaddr = map.start;
+        phdr.p_paddr = 0;
+        phdr.p_memsz = map.end - map.start;
+        phdr.p_filesz = is_dumped(map, skip_ro_file) ? phdr.p_memsz : 0;
+        phdr.p_align = page_size;
+        offset += phdr.p_filesz;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = pwrite(fd, &ehdr, sizeof(ehdr), 0) == sizeof(ehdr) &&
+              pwrite(fd, phdrs.data(), phnum * sizeof(Elf64_Phdr),
+                     ehdr.e_phoff) == (ssize_t)(phnum * sizeof(Elf64_Phdr)) &&
+              pwrite(fd, notes.data(), notes.size(), notes_offset) ==
+                  (ssize_t)notes.size();
+
+    std::vector<uint8_t> buf(GCORE_CHUNK);
+    bytes_dumped = 0;
+    bytes_written = 0;
+    for (size_t i = 1; ok && i < phnum; i++) {
+        ok = copy_memory(fd, phdrs[i].p_vaddr, phdrs[i].p_filesz,
+                         phdrs[i].p_offset, buf);
+        bytes_dumped += phdrs[i].p_filesz;
+    }
+
+    // Trailing zero pages are holes as well
+    ok = ok && ftruncate(fd, offset) == 0;
+    return close(fd) == 0 && ok;
+}
@@ -0,0 +1,132 @@
+#ifndef GCORE_H
+#define GCORE_H
+
+#include "procmaps.hpp"
+
+#include <cstdint>
+#include <map>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <vector>
+
+#define GCORE_CHUNK (8 << 20)
+#define GCORE_NOTE_NAME "CORE"
+
+/**
+ * @brief Registers of a thread stored in the core file.
+ */
+struct core_thread {
+    /**
+     * @brief The thread ID.
+     */
+    pid_t tid;
+    /**
+     * @brief General purpose registers.
+     */
+    struct user_regs_struct regs;
+    /**
+     * @brief Floating point and SSE registers.
+     */
+    struct user_fpregs_struct fpregs;
+};
+
+/**
+ * @brief The CoreDump class writes an ELF core file of a stopped process.
+ *
+ * Memory is copied with `process_vm_readv` in GCORE_CHUNK pieces. Zero
+ * pages are not written and stay holes in a sparse file. Bytes hidden by
+ * breakpoints are written as they were before the trap was planted.
+ */
+class CoreDump {
+  public:
+    /**
+     * @brief Constructs a `CoreDump` object for the given process.
+     *
+     * @param pid The process ID.
+     */
+    CoreDump(pid_t pid);
+
+    /**
+     * @brief Saves registers of a thread, the thread must be stopped under
+     * ptrace.
+     *
+     * @param tid The thread ID.
+     * @return false if the registers can not be read.
+     */
+    bool add_thread(pid_t tid);
+
+    /**
+     * @brief Sets the byte written at an address instead of the memory
+     * contents, e.g. the original byte under a breakpoint.
+     *
+     * @param addr The address.
+     * @param byte The byte.
+     */
+    void add_shadow(uint64_t addr, uint8_t byte) { shadow[addr] = byte; }
+
+    /**
+     * @brief Writes the core file.
+     *
+     * @param path The output file.
+     * @param skip_ro_file Omit the contents of read-only file mappings that
+     * were not modified, they can be taken from the files.
+     * @return false if the file can not be written.
+     */
+    bool write(const char *path, bool skip_ro_file);
+
+    /**
+     * @brief Returns the size of the memory contents in the core file.
+     */
+    uint64_t dumped() { return bytes_dumped; }
+
+    /**
+     * @brief Returns the number of non-zero memory bytes actually written.
+     */
+    uint64_t written() { return bytes_written; }
+
+  private:
+    /**
+     * @brief Builds the PT_NOTE segment contents.
+     *
+     * @param maps The mappings of the process.
+     * @param notes Filled with the notes.
+     */
+    void build_notes(const std::vector<proc_map> &maps,
+                     std::vector<uint8_t> &notes);
+
+    /**
+     * @brief Copies memory of the process into the file skipping zero pages.
+     *
+     * @param fd The core file.
+     * @param addr The start address.
+     * @param size The number of bytes.
+     * @param offset The offset in the file.
+     * @param buf The chunk buffer.
+     * @return false if the file can not be written.
+     */
+    bool copy_memory(int fd, uint64_t addr, uint64_t size, uint64_t offset,
+                     std::vector<uint8_t> &buf);
+
+    /**
+     * @brief The process ID.
+     */
+    pid_t pid;
+    /**
+     * @brief Threads of the process, the first one is reported as current.
+     */
+    std::vector<core_thread> threads;
+    /**
+     * @brief Bytes replacing the memory contents, by address.
+     */
+    std::map<uint64_t, uint8_t> shadow;
+    /**
+     * @brief Bytes of memory in the core file.
+     */
+    uint64_t bytes_dumped;
+    /**
+     * @brief Bytes of memory actually written.
+     */
+    uint64_t bytes_written;
+};
+
+#endif
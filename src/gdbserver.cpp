@@ -0,0 +1,717 @@
+#include "gdbserver.hpp"
+#include "procmaps.hpp"
+#include "rsp.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/user.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define DEBUG_REG(i) (offsetof(struct user, u_debugreg) + (i) * sizeof(long))
+#define DR6_HITS 0xf
+
+/**
+ * @brief Appends a number as hex.
+ */
+static void put_hex(std::string &out, uint64_t value) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%lx", value);
+    out += buf;
+}
+
+/**
+ * @brief Appends a byte as two hex digits.
+ */
+static void put_byte(std::string &out, int value) {
+    char buf[3];
+    snprintf(buf, sizeof(buf), "%02x", value & 0xff);
+    out += buf;
+}
+
+/**
+ * @brief Appends text escaped for an XML attribute.
+ */
+static void put_xml(std::string &out, const std::string &text) {
+    for (char c: text) {
+        switch (c) {
+        case '&':
+            out += "&amp;";
+            break;
+        case '<':
+            out += "&lt;";
+            break;
+        case '>':
+            out += "&gt;";
+            break;
+        case '"':
+            out += "&quot;";
+            break;
+        default:
+            out += c;
+        }
+    }
+}
+
+GdbServer::GdbServer(pid_t pid_)
+    : pid(pid_), client(-1), status(0), alive(true), ack_mode(true),
+      swbreak(false) {
+    std::string mem_path = "/proc/" + std::to_string(pid) + "/mem";
+    mem_fd = open(mem_path.c_str(), O_RDWR | O_CLOEXEC);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    memset(hw_slots, 0, sizeof(hw_slots));
+}
+
+GdbServer::~GdbServer() {
+    close(mem_fd);
+    close(signal_fd);
+}
+
+int GdbServer::accept_client(const char *address) {
+    const char *colon = strrchr(address, ':');
+    if (colon == nullptr) {
+        errno = EINVAL;
+        return -1;
+    }
+    std::string host(address, colon - address);
+
+    struct addrinfo hints = {}, *info;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), colon + 1, &hints,
+                    &info) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = socket(info->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (fd < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+        bind(fd, info->ai_addr, info->ai_addrlen) < 0 || listen(fd, 1) < 0) {
+        freeaddrinfo(info);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    freeaddrinfo(info);
+    printf("Listening on %s\n", address);
+    fflush(stdout);
+
+    int conn = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    close(fd);
+    if (conn >= 0) {
+        // Replies are complete packets, do not wait to merge them
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return conn;
+}
+
+void GdbServer::serve(int fd, int wait_status) {
+    client = fd;
+    status = wait_status;
+    make_stop_reply();
+
+    std::string packet, reply;
+    while (receive(packet)) {
+        reply.clear();
+        bool more = handle(packet, reply);
+        // `k` and a vanished client end the session without a reply
+        if ((more || !reply.empty()) && !send_reply(reply)) {
+            break;
+        }
+        if (packet == "QStartNoAckMode") {
+            ack_mode = false;
+        }
+        if (!more) {
+            break;
+        }
+    }
+    // Do not leave the process stopped forever
+    if (alive) {
+        kill_process();
+    }
+}
+
+bool GdbServer::receive(std::string &packet) {
+    for (;;) {
+        switch (rsp_next(input, packet)) {
+        case RSP_PACKET:
+            if (ack_mode && write(client, "+", 1) != 1) {
+                return false;
+            }
+            return true;
+        case RSP_BAD_PACKET:
+            // Without acks a bad packet is dropped silently
+            if (ack_mode && write(client, "-", 1) != 1) {
+                return false;
+            }
+            continue;
+        case RSP_NACK:
+            if (!last_reply.empty() &&
+                write(client, last_reply.data(), last_reply.size()) !=
+                    (ssize_t)last_reply.size()) {
+                return false;
+            }
+            continue;
+        case RSP_ACK:
+        case RSP_BREAK:
+            // An interrupt arriving after the stop has nothing to stop
+            continue;
+        case RSP_NONE:
+            break;
+        }
+
+        char buf[GDBSERVER_READ_SIZE];
+        ssize_t n = read(client, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        input.append(buf, n);
+    }
+}
+
+bool GdbServer::send_reply(const std::string &payload) {
+    last_reply.clear();
+    rsp_frame(payload, last_reply);
+    const char *data = last_reply.data();
+    size_t size = last_reply.size();
+    while (size > 0) {
+        ssize_t n = write(client, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool GdbServer::handle(const std::string &packet, std::string &reply) {
+    const char *args = packet.c_str() + 1;
+    uint64_t addr, len;
+    struct user_regs_struct regs;
+    std::vector<uint8_t> data;
+
+    if (packet.empty()) {
+        return true;
+    }
+    if (!alive && strchr("gGmMXZzcCsSp", packet[0]) != nullptr) {
+        reply = "E01";
+        return true;
+    }
+
+    switch (packet[0]) {
+    case '?':
+        reply = stop_reply;
+        break;
+    case 'g':
+        if (ptrace(PTRACE_GETREGS, pid, 0, &regs) != 0) {
+            reply = "E01";
+            break;
+        }
+        rsp_encode_regs(regs, reply);
+        break;
+    case 'G':
+        if (ptrace(PTRACE_GETREGS, pid, 0, &regs) != 0 ||
+            !rsp_decode_regs(packet.substr(1), regs) ||
+            ptrace(PTRACE_SETREGS, pid, 0, &regs) != 0) {
+            reply = "E01";
+            break;
+        }
+        reply = "OK";
+        break;
+    case 'p':
+        if (!rsp_number(args, addr) ||
+            ptrace(PTRACE_GETREGS, pid, 0, &regs) != 0 ||
+            !rsp_encode_reg(regs, addr, reply)) {
+            reply = "E01";
+        }
+        break;
+    case 'm':
+        read_memory(args, reply);
+        break;
+    case 'M':
+    case 'X': {
+        if (!rsp_number(args, addr) || *args++ != ',' ||
+            !rsp_number(args, len) || *args++ != ':') {
+            reply = "E01";
+            break;
+        }
+        size_t size = packet.size() - (args - packet.c_str());
+        bool ok = packet[0] == 'M' ? rsp_unhex(args, size, data)
+                                   : rsp_unescape(args, size, data);
+        if (!ok || data.size() != len ||
+            (len > 0 && !write_memory(addr, data.data(), len))) {
+            reply = "E01";
+            break;
+        }
+        reply = "OK";
+        break;
+    }
+    case 'Z':
+    case 'z':
+        breakpoint(packet[0] == 'Z', args, reply);
+        break;
+    case 'c':
+    case 'C':
+    case 's':
+    case 'S':
+        if (!resume(packet)) {
+            reply = "E01";
+            break;
+        }
+        if (!wait_stop()) {
+            return false;
+        }
+        reply = stop_reply;
+        break;
+    case 'H':
+    case 'T':
+        reply = "OK";
+        break;
+    case 'k':
+        kill_process();
+        return false;
+    case 'D':
+        detach();
+        reply = "OK";
+        return false;
+    case 'q':
+        if (packet.compare(0, 10, "qSupported") == 0) {
+            swbreak = packet.find("swbreak+") != std::string::npos;
+            reply = "PacketSize=";
+            put_hex(reply, RSP_PACKET_SIZE);
+            reply += ";QStartNoAckMode+;qXfer:features:read+"
+                     ";qXfer:libraries:read+;qXfer:threads:read+"
+                     ";swbreak+;hwbreak+;vContSupported+";
+        } else if (packet.compare(0, 6, "qXfer:") == 0) {
+            xfer(packet, reply);
+        } else if (packet == "qC") {
+            reply = "QC";
+            put_hex(reply, pid);
+        } else if (packet == "qAttached") {
+            reply = "0";
+        } else if (packet == "qfThreadInfo") {
+            reply = "m";
+            put_hex(reply, pid);
+        } else if (packet == "qsThreadInfo") {
+            reply = "l";
+        } else if (packet.compare(0, 7, "qSymbol") == 0) {
+            reply = "OK";
+        }
+        break;
+    case 'Q':
+        if (packet == "QStartNoAckMode") {
+            // This packet is still acked, the following ones no longer
+            reply = "OK";
+        }
+        break;
+    case 'v':
+        if (packet == "vCont?") {
+            reply = "vCont;c;C;s;S";
+        } else if (packet.compare(0, 6, "vCont;") == 0) {
+            if (!alive || !resume(packet)) {
+                reply = "E01";
+                break;
+            }
+            if (!wait_stop()) {
+                return false;
+            }
+            reply = stop_reply;
+        } else if (packet.compare(0, 6, "vKill;") == 0) {
+            kill_process();
+            reply = "OK";
+        }
+        break;
+    }
+    return true;
+}
+
+bool GdbServer::resume(const std::string &packet) {
+    char action = packet[0];
+    uint64_t sig = 0;
+    const char *args = packet.c_str() + 1;
+
+    if (action == 'v') {
+        // vCont;<action>[:thread]... the first action for us or for all
+        args = packet.c_str() + 5;
+        action = 0;
+        while (*args == ';' && action == 0) {
+            char candidate = *++args;
+            uint64_t candidate_sig = 0;
+            args++;
+            if ((candidate == 'C' || candidate == 'S') &&
+                !rsp_number(args, candidate_sig)) {
+                return false;
+            }
+            uint64_t tid = pid;
+            if (*args == ':') {
+                args++;
+                if (*args == '-') {
+                    args += 2;
+                } else if (!rsp_number(args, tid)) {
+                    return false;
+                }
+            }
+            if (tid == (uint64_t)pid && strchr("cCsS", candidate) != nullptr) {
+                action = candidate;
+                sig = candidate_sig;
+            }
+            args = strchrnul(args, ';');
+        }
+        if (action == 0) {
+            return false;
+        }
+    } else if (action == 'C' || action == 'S') {
+        if (!rsp_number(args, sig)) {
+            return false;
+        }
+    }
+
+    int host_sig = sig != 0 ? rsp_to_host_signal(sig) : 0;
+    bool step = action == 's' || action == 'S';
+    return ptrace(step ? PTRACE_SINGLESTEP : PTRACE_CONT, pid, 0,
+                  host_sig) == 0;
+}
+
+bool GdbServer::wait_stop() {
+    for (;;) {
+        pid_t got = waitpid(pid, &status, WNOHANG | __WALL);
+        if (got == pid) {
+            break;
+        }
+        if (got < 0) {
+            status = 0;
+            break;
+        }
+
+        struct pollfd fds[2] = {{signal_fd, POLLIN, 0}, {client, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if (fds[0].revents != 0) {
+            struct signalfd_siginfo info;
+            while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            }
+        }
+        if (fds[1].revents != 0) {
+            char buf[GDBSERVER_READ_SIZE];
+            ssize_t n = read(client, buf, sizeof(buf));
+            if (n <= 0) {
+                return false;
+            }
+            if (memchr(buf, RSP_INTERRUPT, n) != nullptr) {
+                kill(pid, SIGINT);
+            }
+            // Acks and packets sent meanwhile are handled after the stop
+            input.append(buf, n);
+        }
+    }
+    make_stop_reply();
+    return true;
+}
+
+bool GdbServer::hit_int3() {
+    // A step landing right past a breakpoint is a TRAP_TRACE, not an int3
+    siginfo_t info;
+    if (ptrace(PTRACE_GETSIGINFO, pid, 0, &info) < 0) {
+        return false;
+    }
+    return info.si_code == SI_KERNEL || info.si_code == TRAP_BRKPT;
+}
+
+void GdbServer::make_stop_reply() {
+    stop_reply.clear();
+    if (WIFEXITED(status)) {
+        alive = false;
+        stop_reply = "W";
+        put_byte(stop_reply, WEXITSTATUS(status));
+        return;
+    }
+    if (WIFSIGNALED(status)) {
+        alive = false;
+        stop_reply = "X";
+        put_byte(stop_reply, rsp_from_host_signal(WTERMSIG(status)));
+        return;
+    }
+
+    int sig = WSTOPSIG(status);
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, pid, 0, &regs);
+
+    std::string reason;
+    if (sig == SIGTRAP) {
+        errno = 0;
+        uint64_t dr6 = ptrace(PTRACE_PEEKUSER, pid, DEBUG_REG(6), 0);
+        if (errno == 0 && (dr6 & DR6_HITS) != 0) {
+            for (int i = 0; i < GDBSERVER_HW_SLOTS; i++) {
+                if ((dr6 & (1 << i)) == 0 || hw_slots[i].type == 0) {
+                    continue;
+                }
+                if (hw_slots[i].type == 1) {
+                    reason = "hwbreak:;";
+                } else {
+                    reason = "watch:";
+                    put_hex(reason, hw_slots[i].addr);
+                    reason += ';';
+                }
+            }
+            ptrace(PTRACE_POKEUSER, pid, DEBUG_REG(6), 0);
+        } else if (swbreak && sw_breakpoints.count(regs.rip - 1) != 0 &&
+                   hit_int3()) {
+            // Report the address of the breakpoint, not the one past int3
+            regs.rip--;
+            ptrace(PTRACE_SETREGS, pid, 0, &regs);
+            reason = "swbreak:;";
+        }
+    }
+
+    stop_reply = "T";
+    put_byte(stop_reply, rsp_from_host_signal(sig));
+    stop_reply += "thread:";
+    put_hex(stop_reply, pid);
+    stop_reply += ';';
+    // The registers gdb needs first come with the stop, saving a `g`
+    for (int regno: {RSP_REG_RBP, RSP_REG_RSP, RSP_REG_RIP}) {
+        put_byte(stop_reply, regno);
+        stop_reply += ':';
+        rsp_encode_reg(regs, regno, stop_reply);
+        stop_reply += ';';
+    }
+    stop_reply += reason;
+}
+
+void GdbServer::read_memory(const char *args, std::string &reply) {
+    uint64_t addr, len;
+    if (!rsp_number(args, addr) || *args++ != ',' || !rsp_number(args, len)) {
+        reply = "E01";
+        return;
+    }
+    len = std::min<uint64_t>(len, RSP_MAX_MEMORY);
+
+    static std::vector<uint8_t> buf(RSP_MAX_MEMORY);
+    ssize_t got = pread(mem_fd, buf.data(), len, addr);
+    if (got <= 0) {
+        reply = len == 0 ? "" : "E14";
+        return;
+    }
+
+    // gdb sees the original bytes under its breakpoints
+    for (auto &bp: sw_breakpoints) {
+        if (bp.first >= addr && bp.first < addr + got) {
+            buf[bp.first - addr] = bp.second;
+        }
+    }
+    rsp_hex(buf.data(), got, reply);
+}
+
+bool GdbServer::write_memory(uint64_t addr, uint8_t *data, size_t size) {
+    // Bytes under a breakpoint go to its shadow, the trap stays
+    for (auto &bp: sw_breakpoints) {
+        if (bp.first >= addr && bp.first < addr + size) {
+            bp.second = data[bp.first - addr];
+            data[bp.first - addr] = GDBSERVER_TRAP_BYTE;
+        }
+    }
+    return pwrite(mem_fd, data, size, addr) == (ssize_t)size;
+}
+
+void GdbServer::breakpoint(bool insert, const char *args, std::string &reply) {
+    char type = *args++;
+    uint64_t addr, kind;
+    if (*args++ != ',' || !rsp_number(args, addr) || *args++ != ',' ||
+        !rsp_number(args, kind)) {
+        reply = "E01";
+        return;
+    }
+
+    if (type == '0') {
+        auto it = sw_breakpoints.find(addr);
+        uint8_t byte;
+        if (insert && it == sw_breakpoints.end()) {
+            uint8_t trap = GDBSERVER_TRAP_BYTE;
+            if (pread(mem_fd, &byte, 1, addr) != 1 ||
+                pwrite(mem_fd, &trap, 1, addr) != 1) {
+                reply = "E01";
+                return;
+            }
+            sw_breakpoints[addr] = byte;
+        } else if (!insert && it != sw_breakpoints.end()) {
+            if (pwrite(mem_fd, &it->second, 1, addr) != 1) {
+                reply = "E01";
+                return;
+            }
+            sw_breakpoints.erase(it);
+        }
+        reply = "OK";
+        return;
+    }
+    if (type != '1' && type != '2') {
+        // Read and access watchpoints are not supported
+        return;
+    }
+
+    int hw_type = type == '1' ? 1 : 2;
+    uint64_t len = hw_type == 1 ? 1 : kind;
+    if ((len != 1 && len != 2 && len != 4 && len != 8) || addr % len != 0) {
+        reply = "E22";
+        return;
+    }
+    int slot = -1;
+    for (int i = 0; i < GDBSERVER_HW_SLOTS && slot < 0; i++) {
+        hw_slot &hw = hw_slots[i];
+        if (insert ? hw.type == 0
+                   : hw.type == hw_type && hw.addr == addr && hw.len == len) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        reply = insert ? "E28" : "OK";
+        return;
+    }
+
+    hw_slots[slot] = insert ? hw_slot{addr, hw_type, len} : hw_slot{0, 0, 0};
+    reply = update_debug_regs(slot) ? "OK" : "E01";
+    if (insert && reply != "OK") {
+        hw_slots[slot] = {0, 0, 0};
+    }
+}
+
+bool GdbServer::update_debug_regs(int slot) {
+    uint64_t dr7 = 0;
+    for (int i = 0; i < GDBSERVER_HW_SLOTS; i++) {
+        hw_slot &hw = hw_slots[i];
+        if (hw.type == 0) {
+            continue;
+        }
+        // R/W 00 - execution, 01 - write; LEN 00/01/11/10 - 1/2/4/8 bytes
+        uint64_t rw = hw.type == 1 ? 0 : 1;
+        uint64_t len = hw.len == 1 ? 0 : hw.len == 2 ? 1 : hw.len == 4 ? 3 : 2;
+        dr7 |= (1ULL << (2 * i)) | rw << (16 + 4 * i) | len << (18 + 4 * i);
+    }
+    // The address first, DR7 checks the enabled ones
+    return ptrace(PTRACE_POKEUSER, pid, DEBUG_REG(slot),
+                  hw_slots[slot].addr) == 0 &&
+           ptrace(PTRACE_POKEUSER, pid, DEBUG_REG(7), dr7) == 0;
+}
+
+void GdbServer::xfer(const std::string &packet, std::string &reply) {
+    // qXfer:<object>:read:<annex>:<offset>,<length>
+    size_t object_end = packet.find(':', 6);
+    if (object_end == std::string::npos ||
+        packet.compare(object_end, 6, ":read:") != 0) {
+        return;
+    }
+    std::string object = packet.substr(6, object_end - 6);
+    size_t annex_start = object_end + 6;
+    size_t annex_end = packet.find(':', annex_start);
+    if (annex_end == std::string::npos) {
+        reply = "E01";
+        return;
+    }
+    std::string annex = packet.substr(annex_start, annex_end - annex_start);
+
+    std::string doc;
+    if (object == "features" && annex == "target.xml") {
+        doc = rsp_target_xml;
+    } else if (object == "libraries" && annex.empty()) {
+        libraries_xml(doc);
+    } else if (object == "threads" && annex.empty()) {
+        threads_xml(doc);
+    } else if (object == "features") {
+        reply = "E00";
+        return;
+    } else {
+        return;
+    }
+    rsp_xfer_slice(doc, packet.c_str() + annex_end + 1, reply);
+}
+
+void GdbServer::libraries_xml(std::string &doc) {
+    std::vector<proc_map> maps;
+    read_proc_maps(pid, maps);
+    std::string exe_link = "/proc/" + std::to_string(pid) + "/exe";
+    char exe[PATH_MAX];
+    ssize_t exe_len = readlink(exe_link.c_str(), exe, sizeof(exe) - 1);
+    exe[std::max<ssize_t>(exe_len, 0)] = '\0';
+
+    doc = "<library-list>";
+    for (auto &map: maps) {
+        // The first mapping of every ELF file but the executable itself
+        char magic[4];
+        if (!map.is_file() || map.offset != 0 || map.path == exe ||
+            pread(mem_fd, magic, sizeof(magic), map.start) != sizeof(magic) ||
+            memcmp(magic, "\177ELF", sizeof(magic)) != 0) {
+            continue;
+        }
+        doc += "<library name=\"";
+        put_xml(doc, map.path);
+        doc += "\"><segment address=\"0x";
+        put_hex(doc, map.start);
+        doc += "\"/></library>";
+    }
+    doc += "</library-list>";
+}
+
+void GdbServer::threads_xml(std::string &doc) {
+    // Only the traced thread, the others can not be controlled
+    std::string name;
+    FILE *comm = fopen(("/proc/" + std::to_string(pid) + "/comm").c_str(), "r");
+    if (comm != nullptr) {
+        char buf[64];
+        if (fgets(buf, sizeof(buf), comm) != nullptr) {
+            name = buf;
+            name.erase(name.find_last_not_of('\n') + 1);
+        }
+        fclose(comm);
+    }
+
+    doc = "<threads><thread id=\"";
+    put_hex(doc, pid);
+    doc += "\" name=\"";
+    put_xml(doc, name);
+    doc += "\"/></threads>";
+}
+
+void GdbServer::detach() {
+    for (auto &bp: sw_breakpoints) {
+        pwrite(mem_fd, &bp.second, 1, bp.first);
+    }
+    sw_breakpoints.clear();
+    ptrace(PTRACE_POKEUSER, pid, DEBUG_REG(7), 0);
+    ptrace(PTRACE_DETACH, pid, 0, 0);
+    alive = false;
+}
+
+void GdbServer::kill_process() {
+    kill(pid, SIGKILL);
+    waitpid(pid, &status, __WALL);
+    alive = false;
+}
@@ -0,0 +1,226 @@
+#ifndef GDBSERVER_H
+#define GDBSERVER_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+
+#define GDBSERVER_HW_SLOTS 4
+#define GDBSERVER_READ_SIZE 65536
+#define GDBSERVER_TRAP_BYTE 0xcc
+
+/**
+ * @brief A debug register used by `Z1` or `Z2`.
+ */
+struct hw_slot {
+    /**
+     * @brief The watched address.
+     */
+    uint64_t addr;
+    /**
+     * @brief 0 - free, 1 - execution, 2 - write.
+     */
+    int type;
+    /**
+     * @brief The watched length, 1 for execution.
+     */
+    uint64_t len;
+};
+
+/**
+ * @brief The GdbServer class serves the GDB remote serial protocol for a
+ * process stopped under ptrace.
+ *
+ * All-stop mode for the traced thread. Register reads and writes are one
+ * PTRACE_GETREGS/SETREGS, memory transfers one pread/pwrite of
+ * `/proc/<pid>/mem` of up to RSP_MAX_MEMORY bytes. Every reply goes out in a
+ * single write together with its ack.
+ */
+class GdbServer {
+  public:
+    /**
+     * @brief Constructs a `GdbServer` object for the given process.
+     *
+     * SIGCHLD must be blocked, stops are noticed through a signalfd.
+     *
+     * @param pid_ The process ID.
+     */
+    GdbServer(pid_t pid_);
+
+    /**
+     * @brief Closes the descriptors.
+     */
+    ~GdbServer();
+
+    /**
+     * @brief Listens on a TCP address and accepts one client.
+     *
+     * @param address `[host]:port`, all interfaces without a host.
+     * @return The connected socket or -1 on error.
+     */
+    static int accept_client(const char *address);
+
+    /**
+     * @brief Serves a client until it kills or detaches the process or
+     * disconnects.
+     *
+     * @param fd The connected client.
+     * @param wait_status The wait status of the stopped process.
+     */
+    void serve(int fd, int wait_status);
+
+  private:
+    /**
+     * @brief Reads the next packet, acking it and resending the last reply
+     * on a nack.
+     *
+     * @return false if the client is gone.
+     */
+    bool receive(std::string &packet);
+
+    /**
+     * @brief Sends a reply.
+     *
+     * @return false if the client is gone.
+     */
+    bool send_reply(const std::string &payload);
+
+    /**
+     * @brief Handles a packet.
+     *
+     * @param packet The packet.
+     * @param reply Filled with the reply.
+     * @return false if the session is over.
+     */
+    bool handle(const std::string &packet, std::string &reply);
+
+    /**
+     * @brief Resumes the process for `c`, `C`, `s`, `S` and `vCont`.
+     *
+     * @return false if the packet is malformed.
+     */
+    bool resume(const std::string &packet);
+
+    /**
+     * @brief Waits until the process stops, forwarding an interrupt from
+     * the client as SIGINT. Other client bytes are kept for `receive`.
+     *
+     * @return false if the client is gone.
+     */
+    bool wait_stop();
+
+    /**
+     * @brief Tells whether the current SIGTRAP comes from an int3.
+     */
+    bool hit_int3();
+
+    /**
+     * @brief Builds the stop reply for the current wait status.
+     */
+    void make_stop_reply();
+
+    /**
+     * @brief Handles `m`.
+     */
+    void read_memory(const char *args, std::string &reply);
+
+    /**
+     * @brief Writes memory keeping the planted breakpoints.
+     *
+     * @return false if not all of it is written.
+     */
+    bool write_memory(uint64_t addr, uint8_t *data, size_t size);
+
+    /**
+     * @brief Handles `Z` and `z`.
+     */
+    void breakpoint(bool insert, const char *args, std::string &reply);
+
+    /**
+     * @brief Writes the debug registers for a changed slot.
+     *
+     * @return false if ptrace fails.
+     */
+    bool update_debug_regs(int slot);
+
+    /**
+     * @brief Handles `qXfer:<object>:read`.
+     */
+    void xfer(const std::string &packet, std::string &reply);
+
+    /**
+     * @brief Builds the library list of the shared objects.
+     */
+    void libraries_xml(std::string &doc);
+
+    /**
+     * @brief Builds the thread list.
+     */
+    void threads_xml(std::string &doc);
+
+    /**
+     * @brief Removes the breakpoints and detaches.
+     */
+    void detach();
+
+    /**
+     * @brief Kills the process.
+     */
+    void kill_process();
+
+    /**
+     * @brief The process ID.
+     */
+    pid_t pid;
+    /**
+     * @brief The connected client.
+     */
+    int client;
+    /**
+     * @brief `/proc/<pid>/mem`.
+     */
+    int mem_fd;
+    /**
+     * @brief The signalfd for SIGCHLD.
+     */
+    int signal_fd;
+    /**
+     * @brief The last wait status.
+     */
+    int status;
+    /**
+     * @brief Whether the process is still there.
+     */
+    bool alive;
+    /**
+     * @brief Whether packets are acked, until `QStartNoAckMode`.
+     */
+    bool ack_mode;
+    /**
+     * @brief Whether the client understands `swbreak` stop reasons.
+     */
+    bool swbreak;
+    /**
+     * @brief Received bytes not yet taken as packets.
+     */
+    std::string input;
+    /**
+     * @brief The last reply, sent again on a nack.
+     */
+    std::string last_reply;
+    /**
+     * @brief The reply to `?` and to resumes.
+     */
+    std::string stop_reply;
+    /**
+     * @brief Original bytes under `Z0` breakpoints, by address.
+     */
+    std::unordered_map<uint64_t, uint8_t> sw_breakpoints;
+    /**
+     * @brief The debug registers DR0-DR3.
+     */
+    hw_slot hw_slots[GDBSERVER_HW_SLOTS];
+};
+
+#endif
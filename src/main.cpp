@@ -12,28 +12,21 @@
 
 #include "cfg.hpp"
 #include "debugger.hpp"
+#include "stats.hpp"
 #include "utils.hpp"
 
 pid_t global_pid = -1;
 
-void dbg_sgh(int sig) {
-    if (sig == SIGINT && global_pid != 0) {
-        std::cout << std::endl
-                  << "Debugger interrupted, stopping child process"
-                  << std::endl;
-        ptrace(PTRACE_INTERRUPT, global_pid, 0, 0);
-    }
-}
-
 int main(int argc, char *argv[]) {
     Configuration cfg(argc, argv);
 
-    signal(SIGINT, dbg_sgh);
-    o_log("registered the signal handler", "SIGINT");
-
+    // SIGINT is read from a signalfd by the event loop of the debugger
     Debugger dbg(cfg);
-    dbg.start(&global_pid);
+    int status = dbg.start(&global_pid);
 
     dbg.kill_target();
-    return 0;
-}
\ No newline at end of file
+    if (cfg.get_stats_json() != nullptr) {
+        global_stats.write_json(cfg.get_stats_json());
+    }
+    return status;
+}
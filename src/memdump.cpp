@@ -0,0 +1,183 @@
+#include "memdump.hpp"
+#include "procmaps.hpp"
+
+#include <algorithm>
+#include <elf.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * @brief Writes the value as a fixed number of hex digits.
+ */
+static char *put_hex(char *out, uint64_t value, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = hex_digits[value & 0xf];
+        value >>= 4;
+    }
+    return out + digits;
+}
+
+bool parse_dump_format(const std::string &name, dump_format &format) {
+    if (name == "raw") {
+        format = DUMP_RAW;
+    } else if (name == "hex") {
+        format = DUMP_HEX;
+    } else if (name == "elf") {
+        format = DUMP_ELF;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+size_t format_hex_line(uint64_t addr, const uint8_t *data, size_t size,
+                       char *out) {
+    char *pos = put_hex(out, addr, 16);
+    *pos++ = ':';
+    *pos++ = ' ';
+    for (size_t i = 0; i < MEMDUMP_HEX_BYTES; i++) {
+        if (i < size) {
+            pos = put_hex(pos, data[i], 2);
+        } else {
+            *pos++ = ' ';
+            *pos++ = ' ';
+        }
+        *pos++ = ' ';
+    }
+    *pos++ = ' ';
+    for (size_t i = 0; i < size; i++) {
+        *pos++ = data[i] >= 0x20 && data[i] < 0x7f ? data[i] : '.';
+    }
+    *pos++ = '\n';
+    return pos - out;
+}
+
+size_t format_qword_line(uint64_t addr, const uint64_t *qwords, size_t count,
+                         char *out) {
+    char *pos = out;
+    *pos++ = '0';
+    *pos++ = 'x';
+    int digits = 1;
+    while (digits < 16 && (addr >> (4 * digits)) != 0) {
+        digits++;
+    }
+    pos = put_hex(pos, addr, digits);
+    *pos++ = ':';
+    for (size_t i = 0; i < count; i++) {
+        *pos++ = ' ';
+        pos = put_hex(pos, qwords[i], 16);
+    }
+    *pos++ = '\n';
+    return pos - out;
+}
+
+MemDump::MemDump(pid_t pid_) : pid(pid_), bytes_copied(0) {}
+
+bool MemDump::write(const char *path, uint64_t addr, uint64_t size,
+                    dump_format format) {
+    bytes_copied = 0;
+    std::vector<proc_map> maps;
+    if (!read_proc_maps(pid, maps)) {
+        return false;
+    }
+
+    // Readable pieces of the range, everything else is a hole
+    std::vector<std::pair<uint64_t, uint64_t>> pieces;
+    uint64_t end = addr + size < addr ? UINT64_MAX : addr + size;
+    for (auto &map: maps) {
+        uint64_t from = std::max(map.start, addr), to = std::min(map.end, end);
+        if (map.perms[0] == 'r' && map.path != "[vvar]" && from < to) {
+            pieces.push_back({from, to});
+        }
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    // ELF: the headers, then the pieces one after another
+    std::vector<uint64_t> offsets;
+    bool ok = true;
+    if (format == DUMP_ELF) {
+        Elf64_Ehdr ehdr;
+        memset(&ehdr, 0, sizeof(ehdr));
+        memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+        ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+        ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+        ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+        ehdr.e_type = ET_CORE;
+        ehdr.e_machine = EM_X86_64;
+        ehdr.e_version = EV_CURRENT;
+        ehdr.e_phoff = sizeof(Elf64_Ehdr);
+        ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+        ehdr.e_phentsize = sizeof(Elf64_Phdr);
+        ehdr.e_phnum = pieces.size();
+
+        std::vector<Elf64_Phdr> phdrs(pieces.size());
+        uint64_t offset =
+            sizeof(Elf64_Ehdr) + phdrs.size() * sizeof(Elf64_Phdr);
+        for (size_t i = 0; i < pieces.size(); i++) {
+            uint64_t piece_size = pieces[i].second - pieces[i].first;
+            phdrs[i] = {PT_LOAD, PF_R, offset, pieces[i].first, 0,
+                        piece_size, piece_size, 1};
+            offsets.push_back(offset);
+            offset += piece_size;
+        }
+        ssize_t phdrs_size = phdrs.size() * sizeof(Elf64_Phdr);
+        ok = pwrite(fd, &ehdr, sizeof(ehdr), 0) == sizeof(ehdr) &&
+             pwrite(fd, phdrs.data(), phdrs_size, ehdr.e_phoff) == phdrs_size;
+    }
+
+    std::vector<uint8_t> buf(MEMDUMP_BUFFER);
+    std::vector<char> text;
+    if (format == DUMP_HEX) {
+        text.resize(MEMDUMP_BUFFER / MEMDUMP_HEX_BYTES * MEMDUMP_HEX_LINE_MAX);
+    }
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    for (size_t i = 0; ok && i < pieces.size(); i++) {
+        uint64_t pos = pieces[i].first;
+        while (ok && pos < pieces[i].second) {
+            size_t len = std::min<uint64_t>(buf.size(), pieces[i].second - pos);
+            struct iovec local = {buf.data(), len};
+            struct iovec remote = {(void *)pos, len};
+            ssize_t got = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+            if (got <= 0) {
+                // An unreadable page is a hole as well
+                pos = std::min<uint64_t>((pos & ~(page_size - 1)) + page_size,
+                                         pieces[i].second);
+                continue;
+            }
+
+            if (format == DUMP_RAW) {
+                ok = pwrite(fd, buf.data(), got, pos - addr) == got;
+            } else if (format == DUMP_ELF) {
+                ok = pwrite(fd, buf.data(), got,
+                            offsets[i] + (pos - pieces[i].first)) == got;
+            } else {
+                size_t text_size = 0;
+                for (ssize_t j = 0; j < got; j += MEMDUMP_HEX_BYTES) {
+                    text_size += format_hex_line(
+                        pos + j, &buf[j],
+                        std::min<size_t>(MEMDUMP_HEX_BYTES, got - j),
+                        &text[text_size]);
+                }
+                ok = ::write(fd, text.data(), text_size) == (ssize_t)text_size;
+            }
+            bytes_copied += got;
+            pos += got;
+        }
+    }
+
+    // A trailing hole of a raw dump still has the size of the range
+    if (ok && format == DUMP_RAW) {
+        ok = ftruncate(fd, size) == 0;
+    }
+    return close(fd) == 0 && ok;
+}
@@ -0,0 +1,112 @@
+#ifndef MEMDUMP_H
+#define MEMDUMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+#define MEMDUMP_BUFFER (4 << 20)
+#define MEMDUMP_HEX_BYTES 16
+// "<addr>: " + 16 * "xx " + " " + 16 chars + "\n"
+#define MEMDUMP_HEX_LINE_MAX (16 + 2 + MEMDUMP_HEX_BYTES * 3 + 1 + 16 + 1)
+// "0x<addr>: " + 2 * "<qword> " + "\n"
+#define MEMDUMP_QWORD_LINE_MAX (2 + 16 + 2 + 2 * 17 + 1)
+
+/**
+ * @brief Output formats of `dump`.
+ */
+enum dump_format {
+    /**
+     * @brief The bytes as is, a hole is left as zeros in a sparse file.
+     */
+    DUMP_RAW,
+    /**
+     * @brief Lines of address, hex bytes and printable characters.
+     */
+    DUMP_HEX,
+    /**
+     * @brief An ELF file with a PT_LOAD segment per mapped piece.
+     */
+    DUMP_ELF,
+};
+
+/**
+ * @brief Parses the name of a dump format.
+ *
+ * @param name `raw`, `hex` or `elf`.
+ * @param format Filled with the format.
+ * @return false if the name is unknown.
+ */
+bool parse_dump_format(const std::string &name, dump_format &format);
+
+/**
+ * @brief Formats a hexdump line.
+ *
+ * @param addr The address of the data.
+ * @param data The data.
+ * @param size The number of bytes, at most MEMDUMP_HEX_BYTES.
+ * @param out The buffer of at least MEMDUMP_HEX_LINE_MAX chars.
+ * @return The length of the line.
+ */
+size_t format_hex_line(uint64_t addr, const uint8_t *data, size_t size,
+                       char *out);
+
+/**
+ * @brief Formats a line of up to two qwords as printed by `x`.
+ *
+ * @param addr The address of the qwords.
+ * @param qwords The qwords.
+ * @param count The number of qwords, 1 or 2.
+ * @param out The buffer of at least MEMDUMP_QWORD_LINE_MAX chars.
+ * @return The length of the line.
+ */
+size_t format_qword_line(uint64_t addr, const uint64_t *qwords, size_t count,
+                         char *out);
+
+/**
+ * @brief The MemDump class streams a memory range of a process to a file.
+ *
+ * Readable mappings intersecting the range are read with
+ * `process_vm_readv` through one MEMDUMP_BUFFER buffer and written with
+ * large writes, so memory use does not depend on the size of the range.
+ * Unmapped holes are skipped.
+ */
+class MemDump {
+  public:
+    /**
+     * @brief Constructs a `MemDump` object for the given process.
+     *
+     * @param pid_ The process ID.
+     */
+    MemDump(pid_t pid_);
+
+    /**
+     * @brief Writes the memory range to a file.
+     *
+     * @param path The output file.
+     * @param addr The start address.
+     * @param size The size of the range.
+     * @param format The output format.
+     * @return false if the mappings can not be read or the file written.
+     */
+    bool write(const char *path, uint64_t addr, uint64_t size,
+               dump_format format);
+
+    /**
+     * @brief Returns the number of bytes copied by the last dump.
+     */
+    uint64_t copied() { return bytes_copied; }
+
+  private:
+    /**
+     * @brief The process ID.
+     */
+    pid_t pid;
+    /**
+     * @brief Bytes copied by the last dump.
+     */
+    uint64_t bytes_copied;
+};
+
+#endif
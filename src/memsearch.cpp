@@ -0,0 +1,256 @@
+#include "memsearch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <ctype.h>
+#include <errno.h>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <thread>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Finds the pattern comparing one position at a time.
+ */
+static const uint8_t *find_scalar(const uint8_t *hay, size_t len,
+                                  const uint8_t *pattern, size_t pattern_len) {
+    const uint8_t *end = hay + len - pattern_len + 1;
+    while (hay < end) {
+        hay = (const uint8_t *)memchr(hay, pattern[0], end - hay);
+        if (hay == nullptr) {
+            return nullptr;
+        }
+        if (memcmp(hay + 1, pattern + 1, pattern_len - 1) == 0) {
+            return hay;
+        }
+        hay++;
+    }
+    return nullptr;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief Checks the candidate positions set in the mask.
+ */
+static const uint8_t *check_candidates(const uint8_t *block, uint32_t mask,
+                                       const uint8_t *pattern,
+                                       size_t pattern_len) {
+    while (mask != 0) {
+        const uint8_t *pos = block + __builtin_ctz(mask);
+        // The first and the last bytes are already equal
+        if (pattern_len <= 2 ||
+            memcmp(pos + 1, pattern + 1, pattern_len - 2) == 0) {
+            return pos;
+        }
+        mask &= mask - 1;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Finds the pattern 16 positions at a time.
+ */
+static const uint8_t *find_sse2(const uint8_t *hay, size_t len,
+                                const uint8_t *pattern, size_t pattern_len) {
+    const __m128i first = _mm_set1_epi8(pattern[0]);
+    const __m128i last = _mm_set1_epi8(pattern[pattern_len - 1]);
+    size_t i = 0;
+    for (; i + pattern_len - 1 + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b =
+            _mm_loadu_si128((const __m128i *)(hay + i + pattern_len - 1));
+        uint32_t mask = _mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        const uint8_t *found =
+            check_candidates(hay + i, mask, pattern, pattern_len);
+        if (found != nullptr) {
+            return found;
+        }
+    }
+    return find_scalar(hay + i, len - i, pattern, pattern_len);
+}
+
+/**
+ * @brief Finds the pattern 32 positions at a time.
+ */
+__attribute__((target("avx2"))) static const uint8_t *
+find_avx2(const uint8_t *hay, size_t len, const uint8_t *pattern,
+          size_t pattern_len) {
+    const __m256i first = _mm256_set1_epi8(pattern[0]);
+    const __m256i last = _mm256_set1_epi8(pattern[pattern_len - 1]);
+    size_t i = 0;
+    for (; i + pattern_len - 1 + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(hay + i));
+        __m256i b =
+            _mm256_loadu_si256((const __m256i *)(hay + i + pattern_len - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        const uint8_t *found =
+            check_candidates(hay + i, mask, pattern, pattern_len);
+        if (found != nullptr) {
+            return found;
+        }
+    }
+    return find_sse2(hay + i, len - i, pattern, pattern_len);
+}
+#endif
+
+const uint8_t *memsearch_find(const uint8_t *hay, size_t len,
+                              const uint8_t *pattern, size_t pattern_len) {
+    if (pattern_len == 0 || len < pattern_len) {
+        return nullptr;
+    }
+#if defined(__x86_64__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2 ? find_avx2(hay, len, pattern, pattern_len)
+                    : find_sse2(hay, len, pattern, pattern_len);
+#else
+    return find_scalar(hay, len, pattern, pattern_len);
+#endif
+}
+
+bool parse_pattern(const std::string &arg, std::vector<uint8_t> &pattern) {
+    pattern.clear();
+    if (arg.size() >= 2 && arg.front() == '"' && arg.back() == '"') {
+        for (size_t i = 1; i + 1 < arg.size(); i++) {
+            if (arg[i] != '\\') {
+                pattern.push_back(arg[i]);
+                continue;
+            }
+            if (++i + 1 >= arg.size()) {
+                return false;
+            }
+            switch (arg[i]) {
+            case 'n':
+                pattern.push_back('\n');
+                break;
+            case 't':
+                pattern.push_back('\t');
+                break;
+            case '0':
+                pattern.push_back('\0');
+                break;
+            case '\\':
+            case '"':
+                pattern.push_back(arg[i]);
+                break;
+            case 'x': {
+                std::string hex = arg.substr(i + 1, 2);
+                if (hex.size() != 2 || !isxdigit(hex[0]) ||
+                    !isxdigit(hex[1])) {
+                    return false;
+                }
+                pattern.push_back(std::stoul(hex, nullptr, 16));
+                i += 2;
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return !pattern.empty();
+    }
+
+    char *end;
+    errno = 0;
+    uint64_t value = strtoull(arg.c_str(), &end, 0);
+    if (arg.empty() || *end != '\0' || errno != 0) {
+        return false;
+    }
+    pattern.resize(sizeof(value));
+    memcpy(pattern.data(), &value, sizeof(value));
+    return true;
+}
+
+MemSearch::MemSearch(pid_t pid_, size_t chunk_)
+    : pid(pid_), chunk(chunk_), bytes_scanned(0) {}
+
+/**
+ * @brief A piece of a mapping scanned by one worker.
+ */
+struct search_chunk {
+    uint64_t addr;
+    // Occurrences starting past it belong to the next chunk
+    uint64_t size;
+    // Up to the pattern size minus one more bytes
+    uint64_t read_size;
+};
+
+bool MemSearch::search(const std::vector<uint8_t> &pattern, uint64_t start,
+                       uint64_t end, int threads,
+                       std::vector<uint64_t> &matches) {
+    matches.clear();
+    bytes_scanned = 0;
+    std::vector<proc_map> maps;
+    if (pattern.empty() || !read_proc_maps(pid, maps)) {
+        return false;
+    }
+
+    std::vector<search_chunk> chunks;
+    for (auto &map: maps) {
+        // [vvar] can not be read by another process
+        if (map.perms[0] != 'r' || map.path == "[vvar]" ||
+            map.path == "[vsyscall]") {
+            continue;
+        }
+        uint64_t from = std::max(map.start, start);
+        uint64_t to = std::min(map.end, end);
+        for (uint64_t addr = from; addr < to; addr += chunk) {
+            uint64_t size = std::min<uint64_t>(chunk, to - addr);
+            uint64_t read_size =
+                std::min<uint64_t>(size + pattern.size() - 1, to - addr);
+            chunks.push_back({addr, size, read_size});
+        }
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> scanned(0);
+    std::mutex lock;
+    auto worker = [&]() {
+        std::vector<uint8_t> buf(chunk + pattern.size() - 1);
+        std::vector<uint64_t> found;
+        for (size_t i = next++; i < chunks.size(); i = next++) {
+            search_chunk &c = chunks[i];
+            struct iovec local = {buf.data(), c.read_size};
+            struct iovec remote = {(void *)c.addr, c.read_size};
+            ssize_t got = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+            if (got <= 0) {
+                continue;
+            }
+            scanned += got;
+
+            const uint8_t *pos = buf.data(), *buf_end = buf.data() + got;
+            while ((pos = memsearch_find(pos, buf_end - pos, pattern.data(),
+                                         pattern.size())) != nullptr &&
+                   (uint64_t)(pos - buf.data()) < c.size &&
+                   found.size() < MEMSEARCH_MAX_MATCHES) {
+                found.push_back(c.addr + (pos - buf.data()));
+                pos++;
+            }
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        matches.insert(matches.end(), found.begin(), found.end());
+    };
+
+    threads = std::max(1, std::min<int>(threads, chunks.size()));
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &t: pool) {
+        t.join();
+    }
+
+    std::sort(matches.begin(), matches.end());
+    if (matches.size() > MEMSEARCH_MAX_MATCHES) {
+        matches.resize(MEMSEARCH_MAX_MATCHES);
+    }
+    bytes_scanned = scanned;
+    return true;
+}
@@ -0,0 +1,96 @@
+#ifndef MEMSEARCH_H
+#define MEMSEARCH_H
+
+#include "procmaps.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#define MEMSEARCH_CHUNK (16 << 20)
+#define MEMSEARCH_MAX_THREADS 8
+// Bounds the memory spent on results of a too generic pattern
+#define MEMSEARCH_MAX_MATCHES (1 << 20)
+
+/**
+ * @brief Finds the first occurrence of a pattern in a buffer.
+ *
+ * The first and the last bytes of the pattern are compared with 32 (AVX2)
+ * or 16 (SSE2) positions at once, only positions where both match are
+ * compared in full.
+ *
+ * @param hay The buffer to search in.
+ * @param len The size of the buffer.
+ * @param pattern The pattern.
+ * @param pattern_len The size of the pattern, must not be 0.
+ * @return The pointer to the occurrence or nullptr.
+ */
+const uint8_t *memsearch_find(const uint8_t *hay, size_t len,
+                              const uint8_t *pattern, size_t pattern_len);
+
+/**
+ * @brief Parses the pattern argument of `find`.
+ *
+ * A quoted string is searched as bytes, `\xNN`, `\n`, `\t`, `\0`, `\\` and
+ * `\"` escapes are allowed. A number is searched as a little-endian qword,
+ * e.g. a pointer value.
+ *
+ * @param arg The argument.
+ * @param pattern Filled with the bytes to search.
+ * @return false if the argument is malformed.
+ */
+bool parse_pattern(const std::string &arg, std::vector<uint8_t> &pattern);
+
+/**
+ * @brief The MemSearch class searches the readable memory of a process.
+ *
+ * Mappings are read with `process_vm_readv` in chunks overlapping by the
+ * pattern size minus one, so occurrences crossing a chunk border are found
+ * exactly once. Chunks are shared between worker threads.
+ */
+class MemSearch {
+  public:
+    /**
+     * @brief Constructs a `MemSearch` object for the given process.
+     *
+     * @param pid_ The process ID.
+     * @param chunk_ The size of a single read.
+     */
+    MemSearch(pid_t pid_, size_t chunk_ = MEMSEARCH_CHUNK);
+
+    /**
+     * @brief Searches the readable mappings intersecting the range.
+     *
+     * @param pattern The bytes to search.
+     * @param start The start of the range.
+     * @param end The end of the range.
+     * @param threads The number of worker threads.
+     * @param matches Filled with the sorted addresses of the occurrences.
+     * @return false if the mappings can not be read.
+     */
+    bool search(const std::vector<uint8_t> &pattern, uint64_t start,
+                uint64_t end, int threads, std::vector<uint64_t> &matches);
+
+    /**
+     * @brief Returns the number of bytes read by the last search.
+     */
+    uint64_t scanned() { return bytes_scanned; }
+
+  private:
+    /**
+     * @brief The process ID.
+     */
+    pid_t pid;
+    /**
+     * @brief The size of a single read.
+     */
+    size_t chunk;
+    /**
+     * @brief Bytes read by the last search.
+     */
+    uint64_t bytes_scanned;
+};
+
+#endif
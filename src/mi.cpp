@@ -0,0 +1,294 @@
+#include "mi.hpp"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char hex_digits[] = "0123456789abcdef";
+
+void json_string(std::string &out, const std::string &value) {
+    out += '"';
+    for (unsigned char c: value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else if (c < 0x20) {
+            out += "\\u00";
+            out += hex_digits[c >> 4];
+            out += hex_digits[c & 0xf];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+void json_hex(std::string &out, uint64_t value) {
+    char buf[16];
+    int len = 0;
+    do {
+        buf[len++] = hex_digits[value & 0xf];
+        value >>= 4;
+    } while (value != 0);
+
+    out += "\"0x";
+    while (len > 0) {
+        out += buf[--len];
+    }
+    out += '"';
+}
+
+/**
+ * @brief Skips whitespace.
+ */
+static void skip_space(const std::string &text, size_t &pos) {
+    while (pos < text.size() && strchr(" \t\r\n", text[pos]) != nullptr) {
+        pos++;
+    }
+}
+
+/**
+ * @brief Appends a code point as UTF-8.
+ */
+static void put_utf8(std::string &out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xc0 | cp >> 6);
+        out += (char)(0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        out += (char)(0xe0 | cp >> 12);
+        out += (char)(0x80 | (cp >> 6 & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    } else {
+        out += (char)(0xf0 | cp >> 18);
+        out += (char)(0x80 | (cp >> 12 & 0x3f));
+        out += (char)(0x80 | (cp >> 6 & 0x3f));
+        out += (char)(0x80 | (cp & 0x3f));
+    }
+}
+
+/**
+ * @brief Reads the four hex digits of a `\u` escape.
+ */
+static bool parse_hex4(const std::string &text, size_t &pos, uint32_t &cp) {
+    if (pos + 4 > text.size()) {
+        return false;
+    }
+    cp = 0;
+    for (int i = 0; i < 4; i++) {
+        const char *digit = strchr(hex_digits, tolower(text[pos++]));
+        if (digit == nullptr || *digit == '\0') {
+            return false;
+        }
+        cp = cp << 4 | (digit - hex_digits);
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a string literal starting at the opening quote.
+ */
+static bool parse_string(const std::string &text, size_t &pos,
+                         std::string &value) {
+    if (pos >= text.size() || text[pos] != '"') {
+        return false;
+    }
+    value.clear();
+    for (pos++; pos < text.size(); pos++) {
+        char c = text[pos];
+        if (c == '"') {
+            pos++;
+            return true;
+        }
+        if (c != '\\') {
+            value += c;
+            continue;
+        }
+        if (++pos >= text.size()) {
+            return false;
+        }
+        uint32_t cp, low;
+        switch (text[pos]) {
+        case 'b':
+            value += '\b';
+            break;
+        case 'f':
+            value += '\f';
+            break;
+        case 'n':
+            value += '\n';
+            break;
+        case 'r':
+            value += '\r';
+            break;
+        case 't':
+            value += '\t';
+            break;
+        case 'u':
+            pos++;
+            if (!parse_hex4(text, pos, cp)) {
+                return false;
+            }
+            // A surrogate pair encodes a code point above the BMP
+            if (cp >= 0xd800 && cp < 0xdc00 &&
+                text.compare(pos, 2, "\\u") == 0) {
+                pos += 2;
+                if (!parse_hex4(text, pos, low)) {
+                    return false;
+                }
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            }
+            put_utf8(value, cp);
+            pos--;
+            break;
+        default:
+            value += text[pos];
+        }
+    }
+    return false;
+}
+
+bool json_parse_object(const std::string &text,
+                       std::map<std::string, std::string> &fields,
+                       std::map<std::string, std::string> *raw) {
+    fields.clear();
+    if (raw != nullptr) {
+        raw->clear();
+    }
+    size_t pos = 0;
+    skip_space(text, pos);
+    if (pos >= text.size() || text[pos++] != '{') {
+        return false;
+    }
+    skip_space(text, pos);
+    if (pos < text.size() && text[pos] == '}') {
+        pos++;
+    } else {
+        for (;;) {
+            std::string key, value;
+            skip_space(text, pos);
+            if (!parse_string(text, pos, key)) {
+                return false;
+            }
+            skip_space(text, pos);
+            if (pos >= text.size() || text[pos++] != ':') {
+                return false;
+            }
+            skip_space(text, pos);
+            size_t start = pos;
+            if (pos < text.size() && text[pos] == '"') {
+                if (!parse_string(text, pos, value)) {
+                    return false;
+                }
+            } else {
+                // A number, true, false or null is kept as written
+                size_t end = text.find_first_of(",} \t\r\n", pos);
+                if (end == std::string::npos || end == pos ||
+                    strchr("{[", text[pos]) != nullptr) {
+                    return false;
+                }
+                value = text.substr(pos, end - pos);
+                pos = end;
+            }
+            fields[key] = value;
+            if (raw != nullptr) {
+                (*raw)[key] = text.substr(start, pos - start);
+            }
+
+            skip_space(text, pos);
+            if (pos >= text.size()) {
+                return false;
+            }
+            char c = text[pos++];
+            if (c == '}') {
+                break;
+            }
+            if (c != ',') {
+                return false;
+            }
+        }
+    }
+    skip_space(text, pos);
+    return pos == text.size();
+}
+
+bool mi_number(const std::string &text, uint64_t &value) {
+    if (text.empty() || !isdigit((unsigned char)text[0])) {
+        return false;
+    }
+    char *end;
+    errno = 0;
+    value = strtoull(text.c_str(), &end, 0);
+    return errno == 0 && *end == '\0';
+}
+
+bool parse_mi_request(const std::string &line, mi_request &req) {
+    req.id = "null";
+    req.cmd.clear();
+    std::map<std::string, std::string> raw;
+    if (!json_parse_object(line, req.fields, &raw)) {
+        return false;
+    }
+
+    // The id comes back exactly as written, clients match responses by it
+    auto id = raw.find("id");
+    if (id != raw.end()) {
+        req.id = id->second;
+    }
+
+    auto cmd = req.fields.find("cmd");
+    if (cmd == req.fields.end() || cmd->second.empty()) {
+        return false;
+    }
+    req.cmd = cmd->second;
+    return true;
+}
+
+bool write_all(int fd, const std::string &data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+int mi_accept(const char *path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, MI_SOCKET_BACKLOG) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    close(fd);
+    return client;
+}
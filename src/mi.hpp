@@ -0,0 +1,98 @@
+#ifndef MI_H
+#define MI_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#define MI_SOCKET_BACKLOG 1
+
+/**
+ * @brief A request of the machine interface.
+ *
+ * A request is one line holding a flat JSON object, e.g.
+ * `{"id":1,"cmd":"b","args":"401136"}`.
+ */
+struct mi_request {
+    /**
+     * @brief The `id` as JSON text, echoed in the response, `null` if absent.
+     */
+    std::string id;
+    /**
+     * @brief The command.
+     */
+    std::string cmd;
+    /**
+     * @brief All fields, strings unescaped, other values as JSON text.
+     */
+    std::map<std::string, std::string> fields;
+};
+
+/**
+ * @brief Appends a string as a JSON string literal.
+ *
+ * @param out The output.
+ * @param value The string.
+ */
+void json_string(std::string &out, const std::string &value);
+
+/**
+ * @brief Appends an address as a JSON string of hex digits with `0x`.
+ *
+ * @param out The output.
+ * @param value The address.
+ */
+void json_hex(std::string &out, uint64_t value);
+
+/**
+ * @brief Parses a JSON object with string, number, boolean and null values.
+ *
+ * Nested objects and arrays are not supported.
+ *
+ * @param text The JSON text.
+ * @param fields Filled with the fields, strings unquoted and unescaped.
+ * @param raw If given, filled with the values as written in the text.
+ * @return false if the text is not such an object.
+ */
+bool json_parse_object(const std::string &text,
+                       std::map<std::string, std::string> &fields,
+                       std::map<std::string, std::string> *raw = nullptr);
+
+/**
+ * @brief Parses a number field, decimal or hex with `0x`.
+ *
+ * @param text The field value.
+ * @param value Filled with the number.
+ * @return false if the text is not a whole number.
+ */
+bool mi_number(const std::string &text, uint64_t &value);
+
+/**
+ * @brief Parses a request line.
+ *
+ * @param line The line.
+ * @param req Filled with the request.
+ * @return false if the line is not an object or has no `cmd` string.
+ */
+bool parse_mi_request(const std::string &line, mi_request &req);
+
+/**
+ * @brief Writes the whole buffer to a file, retrying short writes.
+ *
+ * @param fd The file.
+ * @param data The data.
+ * @return false on error.
+ */
+bool write_all(int fd, const std::string &data);
+
+/**
+ * @brief Listens on a Unix socket and accepts one client.
+ *
+ * A stale socket file is removed first.
+ *
+ * @param path The socket path.
+ * @return The connected socket or -1 on error.
+ */
+int mi_accept(const char *path);
+
+#endif
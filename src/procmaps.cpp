@@ -0,0 +1,44 @@
+#include "procmaps.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+bool read_proc_maps(pid_t pid, std::vector<proc_map> &maps, bool smaps) {
+    std::string maps_path =
+        "/proc/" + std::to_string(pid) + (smaps ? "/smaps" : "/maps");
+    FILE *in = fopen(maps_path.c_str(), "r");
+    if (in == nullptr) {
+        return false;
+    }
+
+    maps.clear();
+    char *line = nullptr;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, in) > 0) {
+        unsigned long long start, end, offset, inode, kb;
+        if (sscanf(line, "Anonymous: %llu kB", &kb) == 1) {
+            if (!maps.empty()) {
+                maps.back().anonymous = kb * 1024;
+            }
+            continue;
+        }
+
+        char perms[8];
+        int path_pos = 0;
+        if (sscanf(line, "%llx-%llx %7s %llx %*x:%*x %llu %n", &start, &end,
+                   perms, &offset, &inode, &path_pos) < 5) {
+            continue;
+        }
+
+        // The path may contain spaces, it takes the rest of the line
+        std::string path = path_pos > 0 ? line + path_pos : "";
+        if (!path.empty() && path.back() == '\n') {
+            path.pop_back();
+        }
+        maps.push_back({start, end, offset, inode, 0, perms, path});
+    }
+
+    free(line);
+    fclose(in);
+    return true;
+}
@@ -0,0 +1,61 @@
+#ifndef PROC_MAPS_H
+#define PROC_MAPS_H
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief A memory mapping of a process as listed in `/proc/<pid>/maps`.
+ */
+struct proc_map {
+    /**
+     * @brief The start address of the mapping.
+     */
+    uint64_t start;
+    /**
+     * @brief The address past the end of the mapping.
+     */
+    uint64_t end;
+    /**
+     * @brief The offset of the mapping in the file.
+     */
+    uint64_t offset;
+    /**
+     * @brief The inode of the file, 0 for anonymous mappings.
+     */
+    uint64_t inode;
+    /**
+     * @brief Bytes of private pages that are no longer shared with the file,
+     * known only when read from `smaps`.
+     */
+    uint64_t anonymous;
+    /**
+     * @brief Access permissions, `rwxp` style.
+     */
+    std::string perms;
+    /**
+     * @brief The mapped file or a pseudo-name like `[stack]`, may be empty.
+     */
+    std::string path;
+
+    /**
+     * @brief Whether the mapping is backed by a file.
+     */
+    bool is_file() const { return inode != 0 && !path.empty(); }
+};
+
+/**
+ * @brief Reads the memory mappings of a process.
+ *
+ * @param pid The process ID.
+ * @param maps Filled with the mappings sorted by address.
+ * @param smaps Read `smaps` instead of `maps` to know the anonymous size,
+ * it is much slower.
+ * @return false if the maps file can not be read.
+ */
+bool read_proc_maps(pid_t pid, std::vector<proc_map> &maps,
+                    bool smaps = false);
+
+#endif
@@ -0,0 +1,338 @@
+#include "rsp.hpp"
+
+#include <algorithm>
+#include <stddef.h>
+#include <string.h>
+
+// clang-format off
+const char rsp_target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target>"
+    "<architecture>i386:x86-64</architecture>"
+    "<osabi>GNU/Linux</osabi>"
+    "<feature name=\"org.gnu.gdb.i386.core\">"
+    "<flags id=\"i386_eflags\" size=\"4\">"
+    "<field name=\"CF\" start=\"0\" end=\"0\"/>"
+    "<field name=\"PF\" start=\"2\" end=\"2\"/>"
+    "<field name=\"AF\" start=\"4\" end=\"4\"/>"
+    "<field name=\"ZF\" start=\"6\" end=\"6\"/>"
+    "<field name=\"SF\" start=\"7\" end=\"7\"/>"
+    "<field name=\"TF\" start=\"8\" end=\"8\"/>"
+    "<field name=\"IF\" start=\"9\" end=\"9\"/>"
+    "<field name=\"DF\" start=\"10\" end=\"10\"/>"
+    "<field name=\"OF\" start=\"11\" end=\"11\"/>"
+    "</flags>"
+    "<reg name=\"rax\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"rbx\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"rcx\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"rdx\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"rsi\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"rdi\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"rbp\" bitsize=\"64\" type=\"data_ptr\"/>"
+    "<reg name=\"rsp\" bitsize=\"64\" type=\"data_ptr\"/>"
+    "<reg name=\"r8\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"r9\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"r10\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"r11\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"r12\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"r13\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"r14\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"r15\" bitsize=\"64\" type=\"int64\"/>"
+    "<reg name=\"rip\" bitsize=\"64\" type=\"code_ptr\"/>"
+    "<reg name=\"eflags\" bitsize=\"32\" type=\"i386_eflags\"/>"
+    "<reg name=\"cs\" bitsize=\"32\" type=\"int32\"/>"
+    "<reg name=\"ss\" bitsize=\"32\" type=\"int32\"/>"
+    "<reg name=\"ds\" bitsize=\"32\" type=\"int32\"/>"
+    "<reg name=\"es\" bitsize=\"32\" type=\"int32\"/>"
+    "<reg name=\"fs\" bitsize=\"32\" type=\"int32\"/>"
+    "<reg name=\"gs\" bitsize=\"32\" type=\"int32\"/>"
+    "<reg name=\"st0\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"st1\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"st2\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"st3\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"st4\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"st5\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"st6\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"st7\" bitsize=\"80\" type=\"i387_ext\"/>"
+    "<reg name=\"fctrl\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "<reg name=\"fstat\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "<reg name=\"ftag\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "<reg name=\"fiseg\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "<reg name=\"fioff\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "<reg name=\"foseg\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "<reg name=\"fooff\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "<reg name=\"fop\" bitsize=\"32\" type=\"int\" group=\"float\"/>"
+    "</feature>"
+    "<feature name=\"org.gnu.gdb.i386.segments\">"
+    "<reg name=\"fs_base\" bitsize=\"64\" type=\"int\"/>"
+    "<reg name=\"gs_base\" bitsize=\"64\" type=\"int\"/>"
+    "</feature>"
+    "<feature name=\"org.gnu.gdb.i386.linux\">"
+    "<reg name=\"orig_rax\" bitsize=\"64\" type=\"int\" group=\"system\"/>"
+    "</feature>"
+    "</target>";
+// clang-format on
+
+#define RSP_NO_REG SIZE_MAX
+#define USER_REG(name) offsetof(struct user_regs_struct, name)
+
+/**
+ * @brief A register of the `g` packet: where it is in user_regs_struct and
+ * its size there.
+ */
+struct rsp_reg {
+    size_t offset;
+    size_t size;
+};
+
+static const rsp_reg rsp_regs[] = {
+    {USER_REG(rax), 8},    {USER_REG(rbx), 8},     {USER_REG(rcx), 8},
+    {USER_REG(rdx), 8},    {USER_REG(rsi), 8},     {USER_REG(rdi), 8},
+    {USER_REG(rbp), 8},    {USER_REG(rsp), 8},     {USER_REG(r8), 8},
+    {USER_REG(r9), 8},     {USER_REG(r10), 8},     {USER_REG(r11), 8},
+    {USER_REG(r12), 8},    {USER_REG(r13), 8},     {USER_REG(r14), 8},
+    {USER_REG(r15), 8},    {USER_REG(rip), 8},     {USER_REG(eflags), 4},
+    {USER_REG(cs), 4},     {USER_REG(ss), 4},      {USER_REG(ds), 4},
+    {USER_REG(es), 4},     {USER_REG(fs), 4},      {USER_REG(gs), 4},
+    {RSP_NO_REG, 10},      {RSP_NO_REG, 10},       {RSP_NO_REG, 10},
+    {RSP_NO_REG, 10},      {RSP_NO_REG, 10},       {RSP_NO_REG, 10},
+    {RSP_NO_REG, 10},      {RSP_NO_REG, 10},       {RSP_NO_REG, 4},
+    {RSP_NO_REG, 4},       {RSP_NO_REG, 4},        {RSP_NO_REG, 4},
+    {RSP_NO_REG, 4},       {RSP_NO_REG, 4},        {RSP_NO_REG, 4},
+    {RSP_NO_REG, 4},       {USER_REG(fs_base), 8}, {USER_REG(gs_base), 8},
+    {USER_REG(orig_rax), 8},
+};
+
+#define RSP_NUM_REGS (sizeof(rsp_regs) / sizeof(rsp_regs[0]))
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * @brief Returns the value of a hex digit or -1.
+ */
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+uint8_t rsp_checksum(const char *data, size_t size) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i++) {
+        sum += (uint8_t)data[i];
+    }
+    return sum;
+}
+
+void rsp_frame(const std::string &payload, std::string &out) {
+    uint8_t sum = rsp_checksum(payload.data(), payload.size());
+    out += '$';
+    out += payload;
+    out += '#';
+    out += hex_digits[sum >> 4];
+    out += hex_digits[sum & 0xf];
+}
+
+rsp_input rsp_next(std::string &input, std::string &packet) {
+    size_t pos = 0;
+    while (pos < input.size()) {
+        char c = input[pos];
+        if (c == '+' || c == '-' || c == RSP_INTERRUPT) {
+            input.erase(0, pos + 1);
+            return c == '+' ? RSP_ACK : c == '-' ? RSP_NACK : RSP_BREAK;
+        }
+        if (c == '$') {
+            break;
+        }
+        pos++;
+    }
+    input.erase(0, pos);
+    if (input.empty()) {
+        return RSP_NONE;
+    }
+
+    size_t end = input.find('#');
+    if (end == std::string::npos || end + 3 > input.size()) {
+        return RSP_NONE;
+    }
+    int high = hex_value(input[end + 1]), low = hex_value(input[end + 2]);
+    bool good = high >= 0 && low >= 0 &&
+                rsp_checksum(input.data() + 1, end - 1) == (high << 4 | low);
+    packet.assign(input, 1, end - 1);
+    input.erase(0, end + 3);
+    return good ? RSP_PACKET : RSP_BAD_PACKET;
+}
+
+void rsp_hex(const uint8_t *data, size_t size, std::string &out) {
+    size_t start = out.size();
+    out.resize(start + 2 * size);
+    for (size_t i = 0; i < size; i++) {
+        out[start + 2 * i] = hex_digits[data[i] >> 4];
+        out[start + 2 * i + 1] = hex_digits[data[i] & 0xf];
+    }
+}
+
+bool rsp_unhex(const char *text, size_t size, std::vector<uint8_t> &out) {
+    if (size % 2 != 0) {
+        return false;
+    }
+    out.resize(size / 2);
+    for (size_t i = 0; i < size / 2; i++) {
+        int high = hex_value(text[2 * i]), low = hex_value(text[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        out[i] = high << 4 | low;
+    }
+    return true;
+}
+
+void rsp_escape(const char *data, size_t size, std::string &out) {
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        if (c == '#' || c == '$' || c == '}' || c == '*') {
+            out += '}';
+            c ^= 0x20;
+        }
+        out += c;
+    }
+}
+
+bool rsp_unescape(const char *data, size_t size, std::vector<uint8_t> &out) {
+    out.clear();
+    out.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != '}') {
+            out.push_back(data[i]);
+        } else if (++i < size) {
+            out.push_back(data[i] ^ 0x20);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool rsp_number(const char *&text, uint64_t &value) {
+    const char *start = text;
+    value = 0;
+    int digit;
+    while ((digit = hex_value(*text)) >= 0) {
+        value = value << 4 | digit;
+        text++;
+    }
+    return text != start;
+}
+
+/**
+ * @brief Appends a register in target byte order, `x`s if unavailable.
+ */
+static void encode_reg(const struct user_regs_struct &regs,
+                       const rsp_reg &reg, std::string &out) {
+    if (reg.offset == RSP_NO_REG) {
+        out.append(2 * reg.size, 'x');
+        return;
+    }
+    // user_regs_struct holds 8 bytes per register, little endian
+    rsp_hex((const uint8_t *)&regs + reg.offset, reg.size, out);
+}
+
+void rsp_encode_regs(const struct user_regs_struct &regs, std::string &out) {
+    out.reserve(out.size() + 2 * RSP_REGS_SIZE);
+    for (auto &reg: rsp_regs) {
+        encode_reg(regs, reg, out);
+    }
+}
+
+bool rsp_encode_reg(const struct user_regs_struct &regs, int regno,
+                    std::string &out) {
+    if (regno < 0 || (size_t)regno >= RSP_NUM_REGS) {
+        return false;
+    }
+    encode_reg(regs, rsp_regs[regno], out);
+    return true;
+}
+
+bool rsp_decode_regs(const std::string &hex, struct user_regs_struct &regs) {
+    if (hex.size() < 2 * RSP_REGS_SIZE) {
+        return false;
+    }
+    size_t pos = 0;
+    std::vector<uint8_t> bytes;
+    for (auto &reg: rsp_regs) {
+        const char *text = hex.data() + pos;
+        pos += 2 * reg.size;
+        if (reg.offset == RSP_NO_REG || text[0] == 'x') {
+            continue;
+        }
+        if (!rsp_unhex(text, 2 * reg.size, bytes)) {
+            return false;
+        }
+        // 32-bit registers are zero extended
+        uint64_t value = 0;
+        memcpy(&value, bytes.data(), reg.size);
+        memcpy((uint8_t *)&regs + reg.offset, &value, sizeof(value));
+    }
+    return true;
+}
+
+/**
+ * @brief Linux signals whose gdb numbers differ, as {linux, gdb}.
+ */
+static const int signal_map[][2] = {
+    {7, 10},   // SIGBUS
+    {10, 30},  // SIGUSR1
+    {12, 31},  // SIGUSR2
+    {17, 20},  // SIGCHLD
+    {18, 19},  // SIGCONT
+    {19, 17},  // SIGSTOP
+    {20, 18},  // SIGTSTP
+    {23, 16},  // SIGURG
+    {29, 23},  // SIGIO
+    {30, 32},  // SIGPWR
+    {31, 12},  // SIGSYS
+};
+
+int rsp_from_host_signal(int sig) {
+    for (auto &entry: signal_map) {
+        if (entry[0] == sig) {
+            return entry[1];
+        }
+    }
+    return sig;
+}
+
+int rsp_to_host_signal(int sig) {
+    for (auto &entry: signal_map) {
+        if (entry[1] == sig) {
+            return entry[0];
+        }
+    }
+    // gdb numbers these the same way, the rest has no Linux signal
+    return sig <= 32 && sig != 7 && sig != 10 && sig != 12 ? sig : 0;
+}
+
+void rsp_xfer_slice(const std::string &document, const char *args,
+                    std::string &out) {
+    uint64_t offset, length;
+    if (!rsp_number(args, offset) || *args++ != ',' ||
+        !rsp_number(args, length)) {
+        out += "E01";
+        return;
+    }
+    if (offset >= document.size()) {
+        out += 'l';
+        return;
+    }
+    size_t size = std::min<uint64_t>(length, document.size() - offset);
+    out += offset + size == document.size() ? 'l' : 'm';
+    rsp_escape(document.data() + offset, size, out);
+}
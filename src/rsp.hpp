@@ -0,0 +1,159 @@
+#ifndef RSP_H
+#define RSP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/user.h>
+#include <vector>
+
+// Largest packet accepted and advertised, `m` and `X` are sized after it
+#define RSP_PACKET_SIZE 0x40000
+#define RSP_MAX_MEMORY ((RSP_PACKET_SIZE - 16) / 2)
+#define RSP_INTERRUPT 0x03
+// Bytes of the `g` packet: see `rsp_target_xml`
+#define RSP_REGS_SIZE 300
+// Register numbers expedited in stop replies
+#define RSP_REG_RBP 6
+#define RSP_REG_RSP 7
+#define RSP_REG_RIP 16
+
+/**
+ * @brief What `rsp_next` found in the input.
+ */
+enum rsp_input {
+    /**
+     * @brief Nothing complete yet.
+     */
+    RSP_NONE,
+    /**
+     * @brief A packet with a correct checksum.
+     */
+    RSP_PACKET,
+    /**
+     * @brief A packet with a wrong checksum.
+     */
+    RSP_BAD_PACKET,
+    /**
+     * @brief The interrupt byte, 0x03.
+     */
+    RSP_BREAK,
+    /**
+     * @brief `+`.
+     */
+    RSP_ACK,
+    /**
+     * @brief `-`, the last reply should be sent again.
+     */
+    RSP_NACK,
+};
+
+/**
+ * @brief The target description sent for `qXfer:features:read:target.xml`.
+ *
+ * The general registers are followed by the x87 ones gdb requires in the
+ * core feature, fs_base/gs_base and orig_rax. The x87 ones are reported as
+ * unavailable, so `g` needs only PTRACE_GETREGS.
+ */
+extern const char rsp_target_xml[];
+
+/**
+ * @brief Computes the checksum of a packet.
+ */
+uint8_t rsp_checksum(const char *data, size_t size);
+
+/**
+ * @brief Appends `$<payload>#<checksum>`.
+ *
+ * @param payload The payload, binary data already escaped.
+ * @param out The output.
+ */
+void rsp_frame(const std::string &payload, std::string &out);
+
+/**
+ * @brief Takes the next packet or control byte off the input.
+ *
+ * Garbage before a packet is dropped.
+ *
+ * @param input The received bytes, consumed ones are removed.
+ * @param packet Filled with the payload for RSP_PACKET.
+ * @return What was found.
+ */
+rsp_input rsp_next(std::string &input, std::string &packet);
+
+/**
+ * @brief Appends bytes as hex.
+ */
+void rsp_hex(const uint8_t *data, size_t size, std::string &out);
+
+/**
+ * @brief Decodes hex into bytes.
+ *
+ * @return false on an odd length or a non-hex character.
+ */
+bool rsp_unhex(const char *text, size_t size, std::vector<uint8_t> &out);
+
+/**
+ * @brief Appends binary data escaping `#`, `$`, `}` and `*`.
+ */
+void rsp_escape(const char *data, size_t size, std::string &out);
+
+/**
+ * @brief Decodes escaped binary data.
+ *
+ * @return false if the data ends inside an escape.
+ */
+bool rsp_unescape(const char *data, size_t size, std::vector<uint8_t> &out);
+
+/**
+ * @brief Parses a hex number up to a delimiter.
+ *
+ * @param text The text, advanced past the number.
+ * @param value Filled with the number.
+ * @return false if there are no hex digits.
+ */
+bool rsp_number(const char *&text, uint64_t &value);
+
+/**
+ * @brief Appends the `g` packet payload for the registers.
+ */
+void rsp_encode_regs(const struct user_regs_struct &regs, std::string &out);
+
+/**
+ * @brief Applies a `G` packet payload, unavailable registers are skipped.
+ *
+ * @return false if the payload is too short or not hex.
+ */
+bool rsp_decode_regs(const std::string &hex, struct user_regs_struct &regs);
+
+/**
+ * @brief Appends the hex value of one register of the `g` layout, `x`s if
+ * it is unavailable.
+ *
+ * @return false for an unknown register.
+ */
+bool rsp_encode_reg(const struct user_regs_struct &regs, int regno,
+                    std::string &out);
+
+/**
+ * @brief Converts a Linux signal number to a gdb one.
+ */
+int rsp_from_host_signal(int sig);
+
+/**
+ * @brief Converts a gdb signal number to a Linux one, 0 if it has none.
+ */
+int rsp_to_host_signal(int sig);
+
+/**
+ * @brief Replies to a `qXfer:<object>:read` request with a slice of the
+ * document.
+ *
+ * @param document The whole document.
+ * @param args `<offset>,<length>`.
+ * @param out The output, `m<data>` or `l<data>` or an error.
+ */
+void rsp_xfer_slice(const std::string &document, const char *args,
+                    std::string &out);
+
+#endif
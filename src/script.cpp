@@ -0,0 +1,70 @@
+#include "script.hpp"
+
+#include <fstream>
+#include <sstream>
+
+bool split_command(const std::string &line, std::string &cmd,
+                   std::string &args) {
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == SCRIPT_COMMENT) {
+        return false;
+    }
+    size_t end = line.find_first_of(" \t\r", start);
+    cmd = line.substr(start, end - start);
+
+    size_t rest = end == std::string::npos
+                      ? std::string::npos
+                      : line.find_first_not_of(" \t\r", end);
+    args = rest == std::string::npos ? "" : line.substr(rest);
+    return true;
+}
+
+void expand_alias(const std::unordered_map<std::string, std::string> &aliases,
+                  std::string &cmd, std::string &args) {
+    auto it = aliases.find(cmd);
+    std::string alias_args;
+    if (it == aliases.end() || !split_command(it->second, cmd, alias_args)) {
+        return;
+    }
+    if (!alias_args.empty()) {
+        args = args.empty() ? alias_args : alias_args + " " + args;
+    }
+}
+
+bool opens_block(const std::string &line) {
+    std::istringstream in(line);
+    std::string word, arg, extra;
+    in >> word;
+    if (word == "commands") {
+        return true;
+    }
+    return word == "repeat" && (in >> arg) && !(in >> extra);
+}
+
+bool read_block(const line_reader &more, std::vector<std::string> &body) {
+    int depth = 1;
+    std::string line, cmd, args;
+    while (more(line)) {
+        if (split_command(line, cmd, args) && cmd == SCRIPT_BLOCK_END &&
+            --depth == 0) {
+            return true;
+        }
+        if (opens_block(line)) {
+            depth++;
+        }
+        body.push_back(line);
+    }
+    return false;
+}
+
+bool read_script(const char *path, std::vector<std::string> &lines) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        lines.push_back(line);
+    }
+    return !file.bad();
+}
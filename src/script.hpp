@@ -0,0 +1,66 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define SCRIPT_BLOCK_END "end"
+#define SCRIPT_COMMENT '#'
+
+/**
+ * @brief Supplies the next line of a script or of the terminal.
+ *
+ * Returns false when there are no more lines.
+ */
+typedef std::function<bool(std::string &line)> line_reader;
+
+/**
+ * @brief Splits a command line into the command and its arguments.
+ *
+ * @param line The line.
+ * @param cmd Filled with the first word.
+ * @param args Filled with the rest without leading whitespace.
+ * @return false for a blank line or a comment.
+ */
+bool split_command(const std::string &line, std::string &cmd,
+                   std::string &args);
+
+/**
+ * @brief Replaces an alias with its command line, once.
+ *
+ * @param aliases Command lines by alias name.
+ * @param cmd The command, replaced with the first word of the alias.
+ * @param args The arguments, appended to the rest of the alias.
+ */
+void expand_alias(const std::unordered_map<std::string, std::string> &aliases,
+                  std::string &cmd, std::string &args);
+
+/**
+ * @brief Checks whether a line starts a block closed by `end`.
+ *
+ * `commands <addr>` and `repeat <n>` without a command do.
+ */
+bool opens_block(const std::string &line);
+
+/**
+ * @brief Reads the lines of a block up to its `end`, nested blocks are kept
+ * whole.
+ *
+ * @param more The source of the lines.
+ * @param body Filled with the lines without the `end`.
+ * @return false if the lines end first.
+ */
+bool read_block(const line_reader &more, std::vector<std::string> &body);
+
+/**
+ * @brief Reads a script file.
+ *
+ * @param path The file.
+ * @param lines Filled with the lines.
+ * @return false if the file can not be read.
+ */
+bool read_script(const char *path, std::vector<std::string> &lines);
+
+#endif
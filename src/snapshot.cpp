@@ -0,0 +1,191 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <string>
+#include <sys/uio.h>
+#include <unistd.h>
+
+void diff_memory(uint64_t addr, const uint8_t *old_data,
+                 const uint8_t *new_data, size_t size,
+                 std::vector<mem_change> &changes) {
+    if (memcmp(old_data, new_data, size) == 0) {
+        return;
+    }
+
+    size_t i = 0;
+    while (i < size) {
+        if (old_data[i] == new_data[i]) {
+            i++;
+            continue;
+        }
+        // Extend the change while the next difference is close enough
+        size_t end = i + 1, same = 0;
+        for (size_t j = end; j < size && same < SNAPSHOT_MERGE_GAP; j++) {
+            if (old_data[j] != new_data[j]) {
+                end = j + 1;
+                same = 0;
+            } else {
+                same++;
+            }
+        }
+        changes.push_back({addr + i, end - i, true,
+                           std::vector<uint8_t>(old_data + i, old_data + end),
+                           std::vector<uint8_t>(new_data + i, new_data + end)});
+        i = end;
+    }
+}
+
+/**
+ * @brief Whether the memory of the mapping can be read by another process.
+ */
+static bool is_comparable(const proc_map &map) {
+    return map.perms[0] == 'r' && map.path != "[vvar]" &&
+           map.path != "[vsyscall]";
+}
+
+/**
+ * @brief Reads memory of a process.
+ */
+static bool read_memory(pid_t pid, uint64_t addr, uint8_t *buf, size_t size) {
+    struct iovec local = {buf, size};
+    struct iovec remote = {(void *)addr, size};
+    return process_vm_readv(pid, &local, 1, &remote, 1, 0) == (ssize_t)size;
+}
+
+MemSnapshot::MemSnapshot(pid_t pid_, pid_t copy_pid_)
+    : pid(pid_), copy_pid(copy_pid_), soft_dirty(false), pages_compared(0),
+      page_size(sysconf(_SC_PAGESIZE)) {}
+
+bool MemSnapshot::start() {
+    std::string proc = "/proc/" + std::to_string(pid);
+    std::vector<proc_map> maps;
+    int fd = open((proc + "/pagemap").c_str(), O_RDONLY);
+    if (fd < 0 || !read_proc_maps(pid, maps)) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    // Pages are soft-dirty until the first clear, none means no support
+    soft_dirty = false;
+    std::vector<uint64_t> pages;
+    for (size_t i = 0; i < maps.size() && !soft_dirty; i++) {
+        if (is_comparable(maps[i]) &&
+            scan_pagemap(fd, maps[i].start, maps[i].end, PAGEMAP_SOFT_DIRTY,
+                         pages)) {
+            soft_dirty = !pages.empty();
+        }
+    }
+    close(fd);
+
+    fd = open((proc + "/clear_refs").c_str(), O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write(fd, "4", 1) == 1;
+    close(fd);
+    return ok;
+}
+
+bool MemSnapshot::scan_pagemap(int fd, uint64_t start, uint64_t end,
+                               uint64_t mask, std::vector<uint64_t> &pages) {
+    uint64_t entries[PAGEMAP_BATCH];
+    uint64_t first = start / page_size, last = (end - 1) / page_size + 1;
+
+    for (uint64_t page = first; page < last; page += PAGEMAP_BATCH) {
+        size_t count = std::min<uint64_t>(PAGEMAP_BATCH, last - page);
+        ssize_t size = count * sizeof(uint64_t);
+        if (pread(fd, entries, size, page * sizeof(uint64_t)) != size) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (entries[i] & mask) {
+                pages.push_back((page + i) * page_size);
+            }
+        }
+    }
+    return true;
+}
+
+void MemSnapshot::compare_pages(uint64_t addr, size_t count,
+                                std::vector<mem_change> &changes) {
+    size_t size = count * page_size;
+    std::vector<uint8_t> old_data(size), new_data(size);
+    pages_compared += count;
+
+    if (read_memory(pid, addr, new_data.data(), size) &&
+        read_memory(copy_pid, addr, old_data.data(), size)) {
+        diff_memory(addr, old_data.data(), new_data.data(), size, changes);
+        return;
+    }
+
+    // Some of the pages are new or gone, go one page at a time
+    for (size_t i = 0; i < count; i++) {
+        uint64_t page = addr + i * page_size;
+        if (!read_memory(pid, page, new_data.data(), page_size)) {
+            continue;
+        }
+        if (read_memory(copy_pid, page, old_data.data(), page_size)) {
+            diff_memory(page, old_data.data(), new_data.data(), page_size,
+                        changes);
+        } else if (!changes.empty() && !changes.back().in_snapshot &&
+                   changes.back().addr + changes.back().size == page) {
+            changes.back().size += page_size;
+        } else {
+            changes.push_back({page, page_size, false, {}, {}});
+        }
+    }
+}
+
+bool MemSnapshot::diff(uint64_t start, uint64_t end,
+                       std::vector<mem_change> &changes) {
+    changes.clear();
+    pages_compared = 0;
+    std::vector<proc_map> maps;
+    int fd = open(("/proc/" + std::to_string(pid) + "/pagemap").c_str(),
+                  O_RDONLY);
+    if (fd < 0 || !read_proc_maps(pid, maps)) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    uint64_t mask =
+        soft_dirty ? PAGEMAP_SOFT_DIRTY : PAGEMAP_PRESENT | PAGEMAP_SWAPPED;
+    std::vector<uint64_t> pages;
+    for (auto &map: maps) {
+        uint64_t from = std::max(map.start, start & ~(page_size - 1));
+        uint64_t to = std::min(map.end, end);
+        if (!is_comparable(map) || from >= to) {
+            continue;
+        }
+        if (!scan_pagemap(fd, from, to, mask, pages)) {
+            close(fd);
+            return false;
+        }
+    }
+    close(fd);
+
+    // Runs of consecutive pages are read with one call
+    for (size_t i = 0; i < pages.size();) {
+        size_t count = 1;
+        while (i + count < pages.size() && count < SNAPSHOT_READ_PAGES &&
+               pages[i + count] == pages[i] + count * page_size) {
+            count++;
+        }
+        compare_pages(pages[i], count, changes);
+        i += count;
+    }
+
+    // Drop the changes in the edge pages outside the range
+    std::vector<mem_change> in_range;
+    for (auto &change: changes) {
+        if (change.addr < end && change.addr + change.size > start) {
+            in_range.push_back(std::move(change));
+        }
+    }
+    changes.swap(in_range);
+    return true;
+}
@@ -0,0 +1,157 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "procmaps.hpp"
+
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+#define PAGEMAP_PRESENT (1ull << 63)
+#define PAGEMAP_SWAPPED (1ull << 62)
+#define PAGEMAP_SOFT_DIRTY (1ull << 55)
+// Entries read from pagemap at once
+#define PAGEMAP_BATCH 4096
+// Pages read from both processes at once
+#define SNAPSHOT_READ_PAGES 64
+// Changed bytes closer than this are reported as one change
+#define SNAPSHOT_MERGE_GAP 8
+
+/**
+ * @brief A changed memory range.
+ */
+struct mem_change {
+    /**
+     * @brief The start address.
+     */
+    uint64_t addr;
+    /**
+     * @brief The size of the range.
+     */
+    uint64_t size;
+    /**
+     * @brief Whether the memory existed when the snapshot was taken.
+     */
+    bool in_snapshot;
+    /**
+     * @brief The contents in the snapshot, empty if not `in_snapshot`.
+     */
+    std::vector<uint8_t> old_data;
+    /**
+     * @brief The current contents, empty if not `in_snapshot`.
+     */
+    std::vector<uint8_t> new_data;
+};
+
+/**
+ * @brief Compares two buffers and appends the changed ranges.
+ *
+ * @param addr The address of the buffers in the process.
+ * @param old_data The contents in the snapshot.
+ * @param new_data The current contents.
+ * @param size The size of the buffers.
+ * @param changes The changes are appended to it.
+ */
+void diff_memory(uint64_t addr, const uint8_t *old_data,
+                 const uint8_t *new_data, size_t size,
+                 std::vector<mem_change> &changes);
+
+/**
+ * @brief The MemSnapshot class finds memory changed since a snapshot.
+ *
+ * The snapshot is a stopped copy-on-write fork of the process, so taking
+ * it copies nothing. Soft-dirty bits of the process are cleared at the
+ * same time, a diff reads `/proc/<pid>/pagemap` and fetches only the pages
+ * written since then from both processes. Without soft-dirty support in
+ * the kernel every resident page is compared.
+ */
+class MemSnapshot {
+  public:
+    /**
+     * @brief Constructs a `MemSnapshot` object.
+     *
+     * @param pid_ The process ID of the process.
+     * @param copy_pid_ The process ID of its copy made at the snapshot.
+     */
+    MemSnapshot(pid_t pid_, pid_t copy_pid_);
+
+    /**
+     * @brief Starts tracking writes of the process, must be called right
+     * after the copy is made.
+     *
+     * @return false if the soft-dirty bits can not be cleared.
+     */
+    bool start();
+
+    /**
+     * @brief Finds memory of the process changed since the snapshot.
+     *
+     * @param start The start of the range to compare.
+     * @param end The end of the range to compare.
+     * @param changes Filled with the changes sorted by address.
+     * @return false if the mappings or pagemap can not be read.
+     */
+    bool diff(uint64_t start, uint64_t end, std::vector<mem_change> &changes);
+
+    /**
+     * @brief Whether only pages written since the snapshot are compared.
+     */
+    bool tracks_writes() { return soft_dirty; }
+
+    /**
+     * @brief Returns the number of pages compared by the last diff.
+     */
+    uint64_t compared() { return pages_compared; }
+
+    /**
+     * @brief Returns the process ID of the copy.
+     */
+    pid_t copy() { return copy_pid; }
+
+  private:
+    /**
+     * @brief Collects pages of the mapping having any of the pagemap bits.
+     *
+     * @param fd The opened pagemap.
+     * @param start The start of the range.
+     * @param end The end of the range.
+     * @param mask The pagemap bits.
+     * @param pages The page addresses are appended to it.
+     * @return false if pagemap can not be read.
+     */
+    bool scan_pagemap(int fd, uint64_t start, uint64_t end, uint64_t mask,
+                      std::vector<uint64_t> &pages);
+
+    /**
+     * @brief Compares a run of consecutive pages.
+     *
+     * @param addr The address of the first page.
+     * @param count The number of pages.
+     * @param changes The changes are appended to it.
+     */
+    void compare_pages(uint64_t addr, size_t count,
+                       std::vector<mem_change> &changes);
+
+    /**
+     * @brief The process ID of the process.
+     */
+    pid_t pid;
+    /**
+     * @brief The process ID of the copy.
+     */
+    pid_t copy_pid;
+    /**
+     * @brief Whether the kernel tracks soft-dirty pages.
+     */
+    bool soft_dirty;
+    /**
+     * @brief Pages compared by the last diff.
+     */
+    uint64_t pages_compared;
+    /**
+     * @brief The page size.
+     */
+    size_t page_size;
+};
+
+#endif
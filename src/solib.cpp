@@ -0,0 +1,175 @@
+#include "solib.hpp"
+
+#include <algorithm>
+#include <link.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief Reads a NUL-terminated string of the process.
+ */
+static bool read_string(Target &program, uint64_t addr, std::string &str) {
+    static const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    char buf[256];
+    str.clear();
+    while (str.size() < SOLIB_NAME_MAX) {
+        // Never across a page, the next one may be unmapped
+        size_t size =
+            std::min<uint64_t>(sizeof(buf), page_size - addr % page_size);
+        if (!program.read_memory(addr, (uint8_t *)buf, size)) {
+            return false;
+        }
+        size_t len = strnlen(buf, size);
+        str.append(buf, len);
+        if (len < size) {
+            return true;
+        }
+        addr += size;
+    }
+    return false;
+}
+
+SharedLibs::SharedLibs() : interp_elf(nullptr), r_debug_addr(0), brk_addr(0) {}
+
+SharedLibs::~SharedLibs() {
+    for (so_module *module: mods) {
+        delete module->elf;
+        delete module;
+    }
+    delete interp_elf;
+}
+
+bool SharedLibs::attach(const std::string &interp,
+                        const std::vector<proc_map> &maps) {
+    if (interp.empty()) {
+        return false;
+    }
+    ElfInfo *elf = new ElfInfo(interp.c_str());
+    uint64_t bias = elf->load_bias(maps);
+    const elf_symbol *brk = elf->lookup_function(SOLIB_BREAK_FUNCTION);
+    const elf_symbol *r_debug = elf->lookup_object(SOLIB_RDEBUG_SYMBOL);
+    if (bias == 0 || brk == nullptr || r_debug == nullptr) {
+        delete elf;
+        return false;
+    }
+
+    delete interp_elf;
+    interp_elf = elf;
+    interp_path = interp;
+    brk_addr = brk->addr + bias;
+    r_debug_addr = r_debug->addr + bias;
+    return true;
+}
+
+bool SharedLibs::update(Target &program, std::vector<so_module *> &added,
+                        std::vector<std::string> &removed) {
+    added.clear();
+    removed.clear();
+    struct r_debug debug;
+    if (r_debug_addr == 0 ||
+        !program.read_memory(r_debug_addr, (uint8_t *)&debug, sizeof(debug)) ||
+        debug.r_state != r_debug::RT_CONSISTENT) {
+        return false;
+    }
+
+    std::vector<so_module> current;
+    uint64_t entry = (uint64_t)debug.r_map;
+    for (size_t i = 0; entry != 0 && i < SOLIB_MAX_MODULES; i++) {
+        struct link_map map;
+        std::string name;
+        if (!program.read_memory(entry, (uint8_t *)&map, sizeof(map)) ||
+            !read_string(program, (uint64_t)map.l_name, name)) {
+            return false;
+        }
+        // The executable has an empty name and the vDSO has no file
+        if (name.find('/') != std::string::npos) {
+            current.push_back({name, map.l_addr, entry, nullptr});
+        }
+        entry = (uint64_t)map.l_next;
+    }
+
+    // Modules are the same if nothing of their entry changed
+    auto same = [](const so_module &a, const so_module &b) {
+        return a.entry == b.entry && a.bias == b.bias && a.path == b.path;
+    };
+    std::vector<so_module *> kept;
+    for (so_module *module: mods) {
+        bool found = std::any_of(
+            current.begin(), current.end(),
+            [&](const so_module &other) { return same(*module, other); });
+        if (found) {
+            kept.push_back(module);
+            continue;
+        }
+        removed.push_back(module->path);
+        delete module->elf;
+        delete module;
+    }
+
+    mods.clear();
+    for (auto &info: current) {
+        auto it = std::find_if(kept.begin(), kept.end(), [&](so_module *m) {
+            return same(*m, info);
+        });
+        if (it != kept.end()) {
+            mods.push_back(*it);
+            continue;
+        }
+        so_module *module = new so_module(info);
+        if (module->path == interp_path) {
+            // Already read by attach
+            module->elf = interp_elf;
+            interp_elf = nullptr;
+        }
+        mods.push_back(module);
+        added.push_back(module);
+    }
+    return true;
+}
+
+so_module *SharedLibs::find_module(const std::string &name) {
+    for (so_module *module: mods) {
+        if (module->path == name) {
+            return module;
+        }
+        size_t slash = module->path.rfind('/');
+        std::string base = module->path.substr(slash + 1);
+        if (base == name || (base.size() > name.size() &&
+                             base.compare(0, name.size(), name) == 0 &&
+                             base[name.size()] == '.')) {
+            return module;
+        }
+    }
+    return nullptr;
+}
+
+so_module *SharedLibs::module_at(uint64_t addr) {
+    so_module *best = nullptr;
+    for (so_module *module: mods) {
+        if (module->bias <= addr &&
+            (best == nullptr || module->bias > best->bias)) {
+            best = module;
+        }
+    }
+    if (best == nullptr) {
+        return nullptr;
+    }
+
+    uint64_t start, end;
+    symbols(*best)->load_range(start, end);
+    return addr >= start + best->bias && addr < end + best->bias ? best
+                                                                 : nullptr;
+}
+
+ElfInfo *SharedLibs::symbols(so_module &module) {
+    if (module.elf == nullptr) {
+        module.elf = new ElfInfo(module.path.c_str());
+    }
+    return module.elf;
+}
+
+size_t SharedLibs::loaded() {
+    return std::count_if(mods.begin(), mods.end(), [](so_module *module) {
+        return module->elf != nullptr;
+    });
+}
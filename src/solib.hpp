@@ -0,0 +1,145 @@
+#ifndef SOLIB_H
+#define SOLIB_H
+
+#include "elfinfo.hpp"
+#include "procmaps.hpp"
+#include "target.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Bounds the link_map walk, a corrupted list may be circular
+#define SOLIB_MAX_MODULES 4096
+#define SOLIB_NAME_MAX 4096
+#define SOLIB_BREAK_FUNCTION "_dl_debug_state"
+#define SOLIB_RDEBUG_SYMBOL "_r_debug"
+
+/**
+ * @brief A shared object loaded by the dynamic loader.
+ */
+struct so_module {
+    /**
+     * @brief The path from the link map.
+     */
+    std::string path;
+    /**
+     * @brief The difference between run-time and link-time addresses.
+     */
+    uint64_t bias;
+    /**
+     * @brief The address of the link_map entry of the module.
+     */
+    uint64_t entry;
+    /**
+     * @brief The symbols, nullptr until the first query.
+     */
+    ElfInfo *elf;
+};
+
+/**
+ * @brief The SharedLibs class follows the shared objects of a process
+ * through the r_debug interface of the dynamic loader.
+ *
+ * The loader calls `_dl_debug_state` before and after every change of its
+ * link map, a breakpoint there and `update` keep the module list current.
+ * Only the link map itself is read on an update, the ELF file of a module
+ * is opened the first time its symbols are needed.
+ */
+class SharedLibs {
+  public:
+    /**
+     * @brief Constructs an empty `SharedLibs` object.
+     */
+    SharedLibs();
+
+    ~SharedLibs();
+
+    /**
+     * @brief Finds the r_debug structure and the breakpoint address in the
+     * dynamic loader of a process.
+     *
+     * @param interp The program interpreter of the executable.
+     * @param maps Mappings of the process.
+     * @return false if the loader is not mapped or has no such symbols.
+     */
+    bool attach(const std::string &interp, const std::vector<proc_map> &maps);
+
+    /**
+     * @brief Returns the address of `_dl_debug_state`, 0 before `attach`.
+     */
+    uint64_t break_address() { return brk_addr; }
+
+    /**
+     * @brief Reads the link map and updates the module list.
+     *
+     * @param program The process.
+     * @param added Filled with the modules loaded since the last update.
+     * @param removed Filled with the paths of the unloaded modules.
+     * @return false if the link map is being changed or can not be read.
+     */
+    bool update(Target &program, std::vector<so_module *> &added,
+                std::vector<std::string> &removed);
+
+    /**
+     * @brief Finds a module by name.
+     *
+     * @param name The path, the file name or the file name without the
+     * version suffix, e.g. `libc.so` for `/usr/lib/libc.so.6`.
+     * @return The module or nullptr.
+     */
+    so_module *find_module(const std::string &name);
+
+    /**
+     * @brief Finds the module containing the given run-time address.
+     *
+     * Only the module with the nearest base below the address is opened.
+     *
+     * @param addr The run-time address.
+     * @return The module or nullptr.
+     */
+    so_module *module_at(uint64_t addr);
+
+    /**
+     * @brief Retrieves the symbols of a module, loading them if needed.
+     *
+     * @param module The module.
+     * @return The symbols.
+     */
+    ElfInfo *symbols(so_module &module);
+
+    /**
+     * @brief Retrieves the modules in the link map order.
+     */
+    const std::vector<so_module *> &modules() { return mods; }
+
+    /**
+     * @brief Returns the number of modules with loaded symbols.
+     */
+    size_t loaded();
+
+  private:
+    /**
+     * @brief The program interpreter.
+     */
+    std::string interp_path;
+    /**
+     * @brief Symbols of the interpreter read by `attach`, handed to its
+     * module once it appears in the link map.
+     */
+    ElfInfo *interp_elf;
+    /**
+     * @brief The address of `_r_debug`.
+     */
+    uint64_t r_debug_addr;
+    /**
+     * @brief The address of `_dl_debug_state`.
+     */
+    uint64_t brk_addr;
+    /**
+     * @brief The modules in the link map order.
+     */
+    std::vector<so_module *> mods;
+};
+
+#endif
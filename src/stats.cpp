@@ -0,0 +1,280 @@
+#include "stats.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sys/ptrace.h>
+#include <time.h>
+
+Stats global_stats;
+
+/**
+ * @brief Names of the timed activities.
+ */
+static const char *timer_names[STATS_TIMERS] = {"wait", "stop-to-prompt",
+                                                "dwarf-query", "disassembly"};
+
+/**
+ * @brief Names of the ptrace requests the debugger makes.
+ */
+static const struct {
+    long request;
+    const char *name;
+} ptrace_names[] = {
+    {PTRACE_TRACEME, "TRACEME"},
+    {PTRACE_PEEKTEXT, "PEEKTEXT"},
+    {PTRACE_PEEKDATA, "PEEKDATA"},
+    {PTRACE_PEEKUSER, "PEEKUSER"},
+    {PTRACE_POKETEXT, "POKETEXT"},
+    {PTRACE_POKEDATA, "POKEDATA"},
+    {PTRACE_POKEUSER, "POKEUSER"},
+    {PTRACE_CONT, "CONT"},
+    {PTRACE_KILL, "KILL"},
+    {PTRACE_SINGLESTEP, "SINGLESTEP"},
+    {PTRACE_GETREGS, "GETREGS"},
+    {PTRACE_SETREGS, "SETREGS"},
+    {PTRACE_GETFPREGS, "GETFPREGS"},
+    {PTRACE_SETFPREGS, "SETFPREGS"},
+    {PTRACE_ATTACH, "ATTACH"},
+    {PTRACE_DETACH, "DETACH"},
+    {PTRACE_SYSCALL, "SYSCALL"},
+    {PTRACE_SETOPTIONS, "SETOPTIONS"},
+    {PTRACE_GETEVENTMSG, "GETEVENTMSG"},
+    {PTRACE_GETSIGINFO, "GETSIGINFO"},
+    {PTRACE_SETSIGINFO, "SETSIGINFO"},
+    {PTRACE_GETREGSET, "GETREGSET"},
+    {PTRACE_SETREGSET, "SETREGSET"},
+    {PTRACE_SEIZE, "SEIZE"},
+    {PTRACE_INTERRUPT, "INTERRUPT"},
+    {PTRACE_LISTEN, "LISTEN"},
+};
+
+/**
+ * @brief Returns the slot counting a ptrace request, -1 if it has none.
+ */
+static int ptrace_slot(long request) {
+    if (request >= 0 && request < STATS_PTRACE_SLOTS / 2) {
+        return request;
+    }
+    if (request >= STATS_PTRACE_EXT_BASE &&
+        request < STATS_PTRACE_EXT_BASE + STATS_PTRACE_SLOTS / 2) {
+        return STATS_PTRACE_SLOTS / 2 + (request - STATS_PTRACE_EXT_BASE);
+    }
+    return -1;
+}
+
+uint64_t stats_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+const char *stats_ptrace_name(size_t slot) {
+    for (auto &entry: ptrace_names) {
+        if (ptrace_slot(entry.request) == (int)slot) {
+            return entry.name;
+        }
+    }
+    return nullptr;
+}
+
+void stats_histogram::add(uint64_t ns) {
+    count++;
+    total_ns += ns;
+    if (ns > max_ns) {
+        max_ns = ns;
+    }
+    buckets[63 - __builtin_clzll(ns | 1)]++;
+}
+
+uint64_t stats_histogram::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(fraction * (count - 1)) + 1, seen = 0;
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            // No bucket bound is above the longest duration
+            uint64_t bound = i < STATS_BUCKETS - 1 ? (2ull << i) - 1 : ~0ull;
+            return bound < max_ns ? bound : max_ns;
+        }
+    }
+    return max_ns;
+}
+
+Stats::Stats() { reset(); }
+
+void Stats::reset() {
+    memset(ptrace_calls, 0, sizeof(ptrace_calls));
+    ptrace_other = 0;
+    bytes_read = bytes_written = 0;
+    memset(timers, 0, sizeof(timers));
+    command_times.clear();
+    last_stop = 0;
+}
+
+void Stats::ptrace_call(long request) {
+    int slot = ptrace_slot(request);
+    if (slot < 0) {
+        ptrace_other++;
+    } else {
+        ptrace_calls[slot]++;
+    }
+
+    switch (request) {
+    case PTRACE_PEEKTEXT:
+    case PTRACE_PEEKDATA:
+        bytes_read += sizeof(long);
+        break;
+    case PTRACE_POKETEXT:
+    case PTRACE_POKEDATA:
+        bytes_written += sizeof(long);
+        break;
+    default:
+        break;
+    }
+}
+
+uint64_t Stats::ptrace_count(long request) {
+    int slot = ptrace_slot(request);
+    return slot < 0 ? 0 : ptrace_calls[slot];
+}
+
+void Stats::time_command(const std::string &cmd, uint64_t ns) {
+    auto it = command_times.find(cmd);
+    if (it == command_times.end()) {
+        it = command_times.emplace(cmd, stats_histogram()).first;
+    }
+    it->second.add(ns);
+}
+
+void Stats::prompt() {
+    if (last_stop != 0) {
+        time(STATS_STOP_TO_PROMPT, stats_now() - last_stop);
+        last_stop = 0;
+    }
+}
+
+/**
+ * @brief Prints a row of the duration table, times in microseconds.
+ */
+static void print_histogram(const std::string &name,
+                            const stats_histogram &hist) {
+    std::cout << "  " << std::left << std::setw(18) << name << std::right
+              << std::setw(10) << hist.count << std::fixed
+              << std::setprecision(1);
+    if (hist.count == 0) {
+        std::cout << std::endl;
+        return;
+    }
+    const double us = 1000.0;
+    std::cout << std::setw(12) << hist.total_ns / hist.count / us
+              << std::setw(12) << hist.percentile(0.5) / us << std::setw(12)
+              << hist.percentile(0.99) / us << std::setw(12)
+              << hist.max_ns / us << std::endl;
+}
+
+void Stats::print() {
+    std::cout << std::dec << "ptrace calls:" << std::endl;
+    uint64_t total = ptrace_other;
+    for (size_t slot = 0; slot < STATS_PTRACE_SLOTS; slot++) {
+        if (ptrace_calls[slot] == 0) {
+            continue;
+        }
+        total += ptrace_calls[slot];
+        const char *name = stats_ptrace_name(slot);
+        std::cout << "  " << std::left << std::setw(18)
+                  << (name != nullptr ? name : std::to_string(slot))
+                  << std::right << std::setw(10) << ptrace_calls[slot]
+                  << std::endl;
+    }
+    if (ptrace_other != 0) {
+        std::cout << "  " << std::left << std::setw(18) << "other"
+                  << std::right << std::setw(10) << ptrace_other << std::endl;
+    }
+    std::cout << "  " << std::left << std::setw(18) << "total" << std::right
+              << std::setw(10) << total << std::endl;
+    std::cout << "memory: " << bytes_read << " bytes read, " << bytes_written
+              << " bytes written" << std::endl;
+
+    std::cout << "times (us):" << std::left << std::setw(11) << ""
+              << std::right << std::setw(10) << "count" << std::setw(12)
+              << "mean" << std::setw(12) << "p50" << std::setw(12) << "p99"
+              << std::setw(12) << "max" << std::endl;
+    for (int i = 0; i < STATS_TIMERS; i++) {
+        print_histogram(timer_names[i], timers[i]);
+    }
+    for (auto &entry: command_times) {
+        print_histogram("cmd " + entry.first, entry.second);
+    }
+}
+
+/**
+ * @brief Writes a histogram as a JSON object, buckets past the last used
+ * one are left out.
+ */
+static void write_histogram(FILE *out, const stats_histogram &hist) {
+    fprintf(out,
+            "{\"count\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,"
+            "\"p50_ns\":%llu,\"p99_ns\":%llu,\"buckets\":[",
+            (unsigned long long)hist.count, (unsigned long long)hist.total_ns,
+            (unsigned long long)hist.max_ns,
+            (unsigned long long)hist.percentile(0.5),
+            (unsigned long long)hist.percentile(0.99));
+    int used = STATS_BUCKETS;
+    while (used > 0 && hist.buckets[used - 1] == 0) {
+        used--;
+    }
+    for (int i = 0; i < used; i++) {
+        fprintf(out, "%s%llu", i == 0 ? "" : ",",
+                (unsigned long long)hist.buckets[i]);
+    }
+    fprintf(out, "]}");
+}
+
+bool Stats::write_json(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == nullptr) {
+        perror(path);
+        return false;
+    }
+
+    fprintf(out, "{\"ptrace\":{");
+    bool first = true;
+    for (size_t slot = 0; slot < STATS_PTRACE_SLOTS; slot++) {
+        if (ptrace_calls[slot] == 0) {
+            continue;
+        }
+        const char *name = stats_ptrace_name(slot);
+        std::string key = name != nullptr ? name : std::to_string(slot);
+        fprintf(out, "%s\"%s\":%llu", first ? "" : ",", key.c_str(),
+                (unsigned long long)ptrace_calls[slot]);
+        first = false;
+    }
+    fprintf(out, "%s\"other\":%llu},", first ? "" : ",",
+            (unsigned long long)ptrace_other);
+    fprintf(out, "\"bytes_read\":%llu,\"bytes_written\":%llu,\"timers\":{",
+            (unsigned long long)bytes_read,
+            (unsigned long long)bytes_written);
+    for (int i = 0; i < STATS_TIMERS; i++) {
+        fprintf(out, "%s\"%s\":", i == 0 ? "" : ",", timer_names[i]);
+        write_histogram(out, timers[i]);
+    }
+    // Command names are those of the command table, nothing to escape
+    fprintf(out, "},\"commands\":{");
+    first = true;
+    for (auto &entry: command_times) {
+        fprintf(out, "%s\"%s\":", first ? "" : ",", entry.first.c_str());
+        write_histogram(out, entry.second);
+        first = false;
+    }
+    fprintf(out, "}}\n");
+
+    if (fclose(out) != 0) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,236 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Bucket i of a histogram counts durations of [2^i, 2^(i+1)) nanoseconds
+#define STATS_BUCKETS 64
+// Requests 0-31 count in their own slot, 0x4200-0x421f in the next 32
+#define STATS_PTRACE_SLOTS 64
+#define STATS_PTRACE_EXT_BASE 0x4200
+
+/**
+ * @brief The timed activities of the debugger.
+ */
+enum stats_timer {
+    STATS_WAIT,
+    STATS_STOP_TO_PROMPT,
+    STATS_DWARF_QUERY,
+    STATS_DISASM,
+    STATS_TIMERS
+};
+
+/**
+ * @brief A histogram of durations with power of two buckets.
+ */
+struct stats_histogram {
+    /**
+     * @brief The number of durations.
+     */
+    uint64_t count;
+    /**
+     * @brief The sum of the durations in nanoseconds.
+     */
+    uint64_t total_ns;
+    /**
+     * @brief The longest duration in nanoseconds.
+     */
+    uint64_t max_ns;
+    /**
+     * @brief The number of durations in each bucket.
+     */
+    uint64_t buckets[STATS_BUCKETS];
+
+    /**
+     * @brief Adds a duration.
+     *
+     * @param ns The duration in nanoseconds.
+     */
+    void add(uint64_t ns);
+
+    /**
+     * @brief Estimates a percentile, the upper bound of the bucket holding
+     * it.
+     *
+     * @param fraction The percentile as a fraction, e.g. 0.99.
+     * @return The duration in nanoseconds, 0 if there are none.
+     */
+    uint64_t percentile(double fraction) const;
+};
+
+/**
+ * @brief Reads the monotonic clock, served by the vDSO without a syscall.
+ *
+ * @return The time in nanoseconds.
+ */
+uint64_t stats_now();
+
+/**
+ * @brief Returns the name of a ptrace request counted in the given slot,
+ * nullptr for slots of unknown requests.
+ */
+const char *stats_ptrace_name(size_t slot);
+
+/**
+ * @brief The Stats class counts where the time of the debugger goes.
+ *
+ * Counters and histograms are fixed arrays, recording is a clock read and
+ * a few increments, so the statistics are always collected. Only the
+ * thread controlling the target records.
+ */
+class Stats {
+  public:
+    Stats();
+
+    /**
+     * @brief Forgets everything recorded.
+     */
+    void reset();
+
+    /**
+     * @brief Counts a ptrace call, with the bytes a peek or poke moves.
+     *
+     * @param request The ptrace request.
+     */
+    void ptrace_call(long request);
+
+    /**
+     * @brief Counts bytes read from the target.
+     */
+    void read_bytes(uint64_t size) { bytes_read += size; }
+
+    /**
+     * @brief Counts bytes written to the target.
+     */
+    void written_bytes(uint64_t size) { bytes_written += size; }
+
+    /**
+     * @brief Records a duration of a timed activity.
+     *
+     * @param timer The activity.
+     * @param ns The duration in nanoseconds.
+     */
+    void time(stats_timer timer, uint64_t ns) { timers[timer].add(ns); }
+
+    /**
+     * @brief Records how long a command took.
+     *
+     * @param cmd The command name.
+     * @param ns The duration in nanoseconds.
+     */
+    void time_command(const std::string &cmd, uint64_t ns);
+
+    /**
+     * @brief Notes that the target stopped.
+     */
+    void stopped() { last_stop = stats_now(); }
+
+    /**
+     * @brief Records the latency from the last stop to the prompt, if the
+     * target stopped since the previous prompt.
+     */
+    void prompt();
+
+    /**
+     * @brief Prints the statistics.
+     */
+    void print();
+
+    /**
+     * @brief Writes the statistics as a JSON object.
+     *
+     * @param path The output file.
+     * @return false if the file could not be written.
+     */
+    bool write_json(const char *path);
+
+    /**
+     * @brief Returns the number of calls of a ptrace request.
+     */
+    uint64_t ptrace_count(long request);
+
+    /**
+     * @brief Returns the number of bytes read from the target.
+     */
+    uint64_t read_total() { return bytes_read; }
+
+    /**
+     * @brief Returns the number of bytes written to the target.
+     */
+    uint64_t written_total() { return bytes_written; }
+
+    /**
+     * @brief Returns the histogram of a timed activity.
+     */
+    const stats_histogram &timer(stats_timer timer) { return timers[timer]; }
+
+    /**
+     * @brief Returns the histograms of the commands by name.
+     */
+    const std::map<std::string, stats_histogram> &commands() {
+        return command_times;
+    }
+
+  private:
+    /**
+     * @brief ptrace calls by request slot.
+     */
+    uint64_t ptrace_calls[STATS_PTRACE_SLOTS];
+    /**
+     * @brief ptrace calls of requests without a slot.
+     */
+    uint64_t ptrace_other;
+    /**
+     * @brief Bytes read from the target.
+     */
+    uint64_t bytes_read;
+    /**
+     * @brief Bytes written to the target.
+     */
+    uint64_t bytes_written;
+    /**
+     * @brief Histograms of the timed activities.
+     */
+    stats_histogram timers[STATS_TIMERS];
+    /**
+     * @brief Histograms of the commands, one per command name.
+     */
+    std::map<std::string, stats_histogram> command_times;
+    /**
+     * @brief When the target last stopped, 0 if it is reported already.
+     */
+    uint64_t last_stop;
+};
+
+/**
+ * @brief The statistics of the debugger.
+ */
+extern Stats global_stats;
+
+/**
+ * @brief The StatsTimer class times its own lifetime.
+ */
+class StatsTimer {
+  public:
+    /**
+     * @brief Starts timing an activity.
+     */
+    StatsTimer(stats_timer timer_) : timer(timer_), start(stats_now()) {}
+
+    ~StatsTimer() { global_stats.time(timer, stats_now() - start); }
+
+  private:
+    /**
+     * @brief The timed activity.
+     */
+    stats_timer timer;
+    /**
+     * @brief When the timing started.
+     */
+    uint64_t start;
+};
+
+#endif
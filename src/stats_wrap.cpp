@@ -0,0 +1,60 @@
+/*
+    Counting wrappers of the calls reaching into the target. The executable
+    is linked with -Wl,--wrap=ptrace,--wrap=process_vm_readv,
+    --wrap=process_vm_writev, so every call in every module lands here
+    without touching the call sites.
+*/
+#include "stats.hpp"
+
+#include <cstdarg>
+#include <sys/ptrace.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+extern "C" {
+long __real_ptrace(enum __ptrace_request request, ...);
+ssize_t __real_process_vm_readv(pid_t pid, const struct iovec *local,
+                                unsigned long liovcnt,
+                                const struct iovec *remote,
+                                unsigned long riovcnt, unsigned long flags);
+ssize_t __real_process_vm_writev(pid_t pid, const struct iovec *local,
+                                 unsigned long liovcnt,
+                                 const struct iovec *remote,
+                                 unsigned long riovcnt, unsigned long flags);
+
+long __wrap_ptrace(enum __ptrace_request request, ...) {
+    va_list args;
+    va_start(args, request);
+    pid_t pid = va_arg(args, pid_t);
+    void *addr = va_arg(args, void *);
+    void *data = va_arg(args, void *);
+    va_end(args);
+
+    global_stats.ptrace_call(request);
+    return __real_ptrace(request, pid, addr, data);
+}
+
+ssize_t __wrap_process_vm_readv(pid_t pid, const struct iovec *local,
+                                unsigned long liovcnt,
+                                const struct iovec *remote,
+                                unsigned long riovcnt, unsigned long flags) {
+    ssize_t got =
+        __real_process_vm_readv(pid, local, liovcnt, remote, riovcnt, flags);
+    if (got > 0) {
+        global_stats.read_bytes(got);
+    }
+    return got;
+}
+
+ssize_t __wrap_process_vm_writev(pid_t pid, const struct iovec *local,
+                                 unsigned long liovcnt,
+                                 const struct iovec *remote,
+                                 unsigned long riovcnt, unsigned long flags) {
+    ssize_t put =
+        __real_process_vm_writev(pid, local, liovcnt, remote, riovcnt, flags);
+    if (put > 0) {
+        global_stats.written_bytes(put);
+    }
+    return put;
+}
+}
@@ -0,0 +1,321 @@
+#include "symindex.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * @brief Rounds the offset up to 8 bytes, the alignment of every table.
+ */
+static uint64_t align8(uint64_t offset) { return (offset + 7) & ~7ul; }
+
+/**
+ * @brief Computes the checksum of everything after the header.
+ */
+static uint32_t image_checksum(const uint8_t *data, size_t size) {
+    uLong sum = crc32(0, Z_NULL, 0);
+    const uint8_t *pos = data + sizeof(symindex_header);
+    size_t left = size - sizeof(symindex_header);
+    // crc32 takes a 32-bit length
+    while (left > 0) {
+        uInt len = std::min<size_t>(left, 1u << 30);
+        sum = crc32(sum, pos, len);
+        pos += len;
+        left -= len;
+    }
+    return sum;
+}
+
+SymbolIndex::SymbolIndex() : mapped(nullptr), mapped_size(0), header(nullptr) {}
+
+SymbolIndex::~SymbolIndex() { release(); }
+
+void SymbolIndex::release() {
+    if (mapped != nullptr) {
+        munmap((void *)mapped, mapped_size);
+    }
+    mapped = nullptr;
+    mapped_size = 0;
+    header = nullptr;
+    owned.clear();
+}
+
+uint32_t SymbolIndex::intern(const std::string &str) {
+    auto it = string_offsets.find(str);
+    if (it != string_offsets.end()) {
+        return it->second;
+    }
+    uint32_t offset = strings.size();
+    strings.append(str.c_str(), str.size() + 1);
+    string_offsets.emplace(str, offset);
+    return offset;
+}
+
+void SymbolIndex::add_function(const std::string &name, uint64_t low,
+                               uint64_t high, uint64_t die) {
+    functions.push_back({low, high, die, intern(name), 0});
+}
+
+void SymbolIndex::add_line(uint64_t addr, const std::string &file,
+                           uint32_t line) {
+    lines.push_back({addr, intern(file), line});
+}
+
+void SymbolIndex::add_type(const std::string &name, uint64_t die) {
+    types.push_back({die, intern(name), 0});
+}
+
+void SymbolIndex::merge(SymbolIndex &other) {
+    const char *names = other.strings.c_str();
+    for (auto &func: other.functions) {
+        add_function(names + func.name, func.low, func.high, func.die);
+    }
+    for (auto &row: other.lines) {
+        add_line(row.addr, names + row.file, row.line);
+    }
+    for (auto &type: other.types) {
+        add_type(names + type.name, type.die);
+    }
+    other.functions.clear();
+    other.lines.clear();
+    other.types.clear();
+    other.strings.clear();
+    other.string_offsets.clear();
+}
+
+void SymbolIndex::finish(const std::string &build_id) {
+    release();
+    const char *names = strings.c_str();
+    auto by_name = [names](uint32_t a, uint32_t b) {
+        return strcmp(names + a, names + b) < 0;
+    };
+
+    std::sort(functions.begin(), functions.end(),
+              [](const symindex_function &a, const symindex_function &b) {
+                  return a.low < b.low;
+              });
+    std::vector<symindex_name> name_table(functions.size());
+    for (size_t i = 0; i < functions.size(); i++) {
+        name_table[i] = {functions[i].name, (uint32_t)i};
+    }
+    std::stable_sort(name_table.begin(), name_table.end(),
+                     [&](const symindex_name &a, const symindex_name &b) {
+                         return by_name(a.name, b.name);
+                     });
+    // The end of a sequence goes first, the row starting there wins
+    std::stable_sort(lines.begin(), lines.end(),
+                     [](const symindex_line &a, const symindex_line &b) {
+                         return a.addr < b.addr ||
+                                (a.addr == b.addr && a.line == 0 &&
+                                 b.line != 0);
+                     });
+    std::stable_sort(types.begin(), types.end(),
+                     [&](const symindex_type &a, const symindex_type &b) {
+                         return by_name(a.name, b.name);
+                     });
+
+    symindex_header hdr = {};
+    memcpy(hdr.magic, SYMINDEX_MAGIC, SYMINDEX_MAGIC_SIZE);
+    hdr.version = SYMINDEX_VERSION;
+    strncpy(hdr.build_id, build_id.c_str(), SYMINDEX_BUILD_ID_MAX - 1);
+
+    uint64_t offset = align8(sizeof(hdr));
+    auto place = [&](symindex_table &table, size_t count, size_t record) {
+        table = {offset, count};
+        offset = align8(offset + count * record);
+    };
+    place(hdr.functions, functions.size(), sizeof(symindex_function));
+    place(hdr.names, name_table.size(), sizeof(symindex_name));
+    place(hdr.lines, lines.size(), sizeof(symindex_line));
+    place(hdr.types, types.size(), sizeof(symindex_type));
+    place(hdr.strings, strings.size(), 1);
+    hdr.size = offset;
+
+    owned.assign(hdr.size, 0);
+    memcpy(&owned[hdr.functions.offset], functions.data(),
+           functions.size() * sizeof(symindex_function));
+    memcpy(&owned[hdr.names.offset], name_table.data(),
+           name_table.size() * sizeof(symindex_name));
+    memcpy(&owned[hdr.lines.offset], lines.data(),
+           lines.size() * sizeof(symindex_line));
+    memcpy(&owned[hdr.types.offset], types.data(),
+           types.size() * sizeof(symindex_type));
+    memcpy(&owned[hdr.strings.offset], strings.data(), strings.size());
+    hdr.checksum = image_checksum(owned.data(), owned.size());
+    memcpy(owned.data(), &hdr, sizeof(hdr));
+
+    functions.clear();
+    lines.clear();
+    types.clear();
+    strings.clear();
+    string_offsets.clear();
+    attach(owned.data(), owned.size());
+}
+
+bool SymbolIndex::save(const std::string &path) {
+    if (header == nullptr) {
+        return false;
+    }
+    // Renamed into place, a reader never maps a partial file
+    std::string tmp_path = path + "." + std::to_string(getpid());
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const uint8_t *pos = (const uint8_t *)header;
+    size_t left = header->size;
+    while (left > 0) {
+        ssize_t got = write(fd, pos, left);
+        if (got <= 0) {
+            break;
+        }
+        pos += got;
+        left -= got;
+    }
+    bool ok = close(fd) == 0 && left == 0 &&
+              rename(tmp_path.c_str(), path.c_str()) == 0;
+    if (!ok) {
+        unlink(tmp_path.c_str());
+    }
+    return ok;
+}
+
+bool SymbolIndex::load(const std::string &path, const std::string &build_id) {
+    release();
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 ||
+        (size_t)st.st_size < sizeof(symindex_header)) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    mapped = (const uint8_t *)mem;
+    mapped_size = st.st_size;
+
+    auto *hdr = (const symindex_header *)mapped;
+    bool ok = memcmp(hdr->magic, SYMINDEX_MAGIC, SYMINDEX_MAGIC_SIZE) == 0 &&
+              hdr->version == SYMINDEX_VERSION && hdr->size == mapped_size &&
+              strncmp(hdr->build_id, build_id.c_str(),
+                      SYMINDEX_BUILD_ID_MAX) == 0 &&
+              hdr->checksum == image_checksum(mapped, mapped_size) &&
+              attach(mapped, mapped_size);
+    if (!ok) {
+        release();
+    }
+    return ok;
+}
+
+bool SymbolIndex::attach(const uint8_t *data, size_t size) {
+    auto *hdr = (const symindex_header *)data;
+    auto fits = [size](const symindex_table &table, size_t record) {
+        return table.offset % 8 == 0 && table.offset <= size &&
+               table.count <= (size - table.offset) / record;
+    };
+    if (!fits(hdr->functions, sizeof(symindex_function)) ||
+        !fits(hdr->names, sizeof(symindex_name)) ||
+        !fits(hdr->lines, sizeof(symindex_line)) ||
+        !fits(hdr->types, sizeof(symindex_type)) || !fits(hdr->strings, 1) ||
+        (hdr->strings.count != 0 &&
+         data[hdr->strings.offset + hdr->strings.count - 1] != '\0')) {
+        return false;
+    }
+    header = hdr;
+    return true;
+}
+
+const char *SymbolIndex::string_at(uint32_t offset) {
+    if (header == nullptr || offset >= header->strings.count) {
+        return "";
+    }
+    return (const char *)header + header->strings.offset + offset;
+}
+
+const symindex_function *SymbolIndex::find_function(uint64_t addr) {
+    if (header == nullptr) {
+        return nullptr;
+    }
+    auto *begin = (const symindex_function *)((const uint8_t *)header +
+                                              header->functions.offset);
+    auto *end = begin + header->functions.count;
+    auto *it = std::upper_bound(
+        begin, end, addr,
+        [](uint64_t addr, const symindex_function &f) { return addr < f.low; });
+    if (it == begin) {
+        return nullptr;
+    }
+    --it;
+    return addr < it->high ? it : nullptr;
+}
+
+const symindex_function *
+SymbolIndex::lookup_function(const std::string &name) {
+    if (header == nullptr) {
+        return nullptr;
+    }
+    auto *begin = (const symindex_name *)((const uint8_t *)header +
+                                          header->names.offset);
+    auto *end = begin + header->names.count;
+    auto *it = std::lower_bound(begin, end, name,
+                                [this](const symindex_name &entry,
+                                       const std::string &name) {
+                                    return name.compare(string_at(entry.name)) >
+                                           0;
+                                });
+    if (it == end || name != string_at(it->name) ||
+        it->function >= header->functions.count) {
+        return nullptr;
+    }
+    return (const symindex_function *)((const uint8_t *)header +
+                                       header->functions.offset) +
+           it->function;
+}
+
+bool SymbolIndex::find_line(uint64_t addr, std::string &file,
+                            uint32_t &line) {
+    if (header == nullptr) {
+        return false;
+    }
+    auto *begin = (const symindex_line *)((const uint8_t *)header +
+                                          header->lines.offset);
+    auto *end = begin + header->lines.count;
+    auto *it = std::upper_bound(begin, end, addr,
+                                [](uint64_t addr, const symindex_line &row) {
+                                    return addr < row.addr;
+                                });
+    if (it == begin || (it - 1)->line == 0) {
+        return false;
+    }
+    --it;
+    file = string_at(it->file);
+    line = it->line;
+    return true;
+}
+
+bool SymbolIndex::lookup_type(const std::string &name, uint64_t &die) {
+    if (header == nullptr) {
+        return false;
+    }
+    auto *begin = (const symindex_type *)((const uint8_t *)header +
+                                          header->types.offset);
+    auto *end = begin + header->types.count;
+    auto *it = std::lower_bound(
+        begin, end, name,
+        [this](const symindex_type &type, const std::string &name) {
+            return name.compare(string_at(type.name)) > 0;
+        });
+    if (it == end || name != string_at(it->name)) {
+        return false;
+    }
+    die = it->die;
+    return true;
+}
@@ -0,0 +1,337 @@
+#ifndef SYMINDEX_H
+#define SYMINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define SYMINDEX_MAGIC "DRKINDEX"
+#define SYMINDEX_MAGIC_SIZE 8
+#define SYMINDEX_VERSION 1
+#define SYMINDEX_BUILD_ID_MAX 64
+#define SYMINDEX_SUFFIX ".idx"
+
+/**
+ * @brief A function with code, from a DW_TAG_subprogram.
+ */
+struct symindex_function {
+    /**
+     * @brief The first address of the function.
+     */
+    uint64_t low;
+    /**
+     * @brief The address past the function.
+     */
+    uint64_t high;
+    /**
+     * @brief The offset of the DIE in `.debug_info`.
+     */
+    uint64_t die;
+    /**
+     * @brief The name, an offset in the string table.
+     */
+    uint32_t name;
+    /**
+     * @brief Padding to keep the records 8-byte aligned.
+     */
+    uint32_t reserved;
+};
+
+/**
+ * @brief An entry of the function name table.
+ */
+struct symindex_name {
+    /**
+     * @brief The name, an offset in the string table.
+     */
+    uint32_t name;
+    /**
+     * @brief The index of the function in the function table.
+     */
+    uint32_t function;
+};
+
+/**
+ * @brief A row of a line table.
+ */
+struct symindex_line {
+    /**
+     * @brief The first address of the row.
+     */
+    uint64_t addr;
+    /**
+     * @brief The source file, an offset in the string table.
+     */
+    uint32_t file;
+    /**
+     * @brief The line number, 0 for the end of a sequence.
+     */
+    uint32_t line;
+};
+
+/**
+ * @brief A named type.
+ */
+struct symindex_type {
+    /**
+     * @brief The offset of the DIE in `.debug_info`.
+     */
+    uint64_t die;
+    /**
+     * @brief The name, an offset in the string table.
+     */
+    uint32_t name;
+    /**
+     * @brief Padding to keep the records 8-byte aligned.
+     */
+    uint32_t reserved;
+};
+
+/**
+ * @brief The location of a table in the index file.
+ */
+struct symindex_table {
+    /**
+     * @brief The offset from the start of the file.
+     */
+    uint64_t offset;
+    /**
+     * @brief The number of records, or bytes for the string table.
+     */
+    uint64_t count;
+};
+
+/**
+ * @brief The header of the index file.
+ */
+struct symindex_header {
+    /**
+     * @brief SYMINDEX_MAGIC.
+     */
+    char magic[SYMINDEX_MAGIC_SIZE];
+    /**
+     * @brief SYMINDEX_VERSION.
+     */
+    uint32_t version;
+    /**
+     * @brief CRC32 of everything after the header.
+     */
+    uint32_t checksum;
+    /**
+     * @brief The size of the whole file.
+     */
+    uint64_t size;
+    /**
+     * @brief The build ID the index is made for, NUL-padded.
+     */
+    char build_id[SYMINDEX_BUILD_ID_MAX];
+    /**
+     * @brief Functions sorted by address.
+     */
+    symindex_table functions;
+    /**
+     * @brief Function names sorted by name.
+     */
+    symindex_table names;
+    /**
+     * @brief Line table rows sorted by address.
+     */
+    symindex_table lines;
+    /**
+     * @brief Types sorted by name.
+     */
+    symindex_table types;
+    /**
+     * @brief NUL-terminated strings.
+     */
+    symindex_table strings;
+};
+
+/**
+ * @brief The SymbolIndex class holds the function, line and type indexes of
+ * a debug file in one flat image.
+ *
+ * Records refer to each other and to strings by offsets, so an index file
+ * written by `save` is used right after `mmap` without deserialization.
+ * An index is built with the `add_*` methods and `finish`, or loaded from
+ * the cache with `load`; queries work the same for both.
+ */
+class SymbolIndex {
+  public:
+    /**
+     * @brief Constructs an empty `SymbolIndex` object.
+     */
+    SymbolIndex();
+
+    ~SymbolIndex();
+
+    /**
+     * @brief Adds a function.
+     *
+     * @param name The name of the function.
+     * @param low The first address.
+     * @param high The address past the function.
+     * @param die The offset of the DIE.
+     */
+    void add_function(const std::string &name, uint64_t low, uint64_t high,
+                      uint64_t die);
+
+    /**
+     * @brief Adds a row of a line table.
+     *
+     * @param addr The first address of the row.
+     * @param file The source file.
+     * @param line The line number, 0 for the end of a sequence.
+     */
+    void add_line(uint64_t addr, const std::string &file, uint32_t line);
+
+    /**
+     * @brief Adds a named type.
+     *
+     * @param name The name of the type.
+     * @param die The offset of the DIE.
+     */
+    void add_type(const std::string &name, uint64_t die);
+
+    /**
+     * @brief Adds everything of another index under construction.
+     *
+     * @param other The index, left empty.
+     */
+    void merge(SymbolIndex &other);
+
+    /**
+     * @brief Sorts the added records into the index image.
+     *
+     * @param build_id The build ID the index is made for.
+     */
+    void finish(const std::string &build_id);
+
+    /**
+     * @brief Writes the index image to a file.
+     *
+     * @param path The file, replaced atomically.
+     * @return false if the file can not be written.
+     */
+    bool save(const std::string &path);
+
+    /**
+     * @brief Maps an index file and checks it.
+     *
+     * @param path The file.
+     * @param build_id The build ID the index must be made for.
+     * @return false if the file is missing, of another version or build, or
+     * its checksum does not match.
+     */
+    bool load(const std::string &path, const std::string &build_id);
+
+    /**
+     * @brief Finds the function containing an address.
+     *
+     * @param addr The address.
+     * @return The function or nullptr.
+     */
+    const symindex_function *find_function(uint64_t addr);
+
+    /**
+     * @brief Finds a function by name.
+     *
+     * @param name The name.
+     * @return The function or nullptr.
+     */
+    const symindex_function *lookup_function(const std::string &name);
+
+    /**
+     * @brief Finds the source line of an address.
+     *
+     * @param addr The address.
+     * @param file Filled with the source file.
+     * @param line Filled with the line number.
+     * @return false if no line table covers the address.
+     */
+    bool find_line(uint64_t addr, std::string &file, uint32_t &line);
+
+    /**
+     * @brief Finds a type by name.
+     *
+     * @param name The name.
+     * @param die Filled with the offset of the DIE.
+     * @return false if there is no such type.
+     */
+    bool lookup_type(const std::string &name, uint64_t &die);
+
+    /**
+     * @brief Retrieves a string of the index.
+     *
+     * @param offset The offset in the string table.
+     * @return The string.
+     */
+    const char *string_at(uint32_t offset);
+
+    /**
+     * @brief Returns the number of functions.
+     */
+    size_t function_count() { return header ? header->functions.count : 0; }
+
+  private:
+    /**
+     * @brief Adds a string to the string table under construction.
+     *
+     * @return The offset of the string.
+     */
+    uint32_t intern(const std::string &str);
+
+    /**
+     * @brief Points the tables at an image.
+     *
+     * @return false if a table is out of the image.
+     */
+    bool attach(const uint8_t *data, size_t size);
+
+    /**
+     * @brief Unmaps the loaded file and forgets the image.
+     */
+    void release();
+
+    /**
+     * @brief Functions under construction.
+     */
+    std::vector<symindex_function> functions;
+    /**
+     * @brief Line rows under construction.
+     */
+    std::vector<symindex_line> lines;
+    /**
+     * @brief Types under construction.
+     */
+    std::vector<symindex_type> types;
+    /**
+     * @brief Strings under construction.
+     */
+    std::string strings;
+    /**
+     * @brief Offsets of the strings under construction.
+     */
+    std::unordered_map<std::string, uint32_t> string_offsets;
+
+    /**
+     * @brief The image made by `finish`.
+     */
+    std::vector<uint8_t> owned;
+    /**
+     * @brief The mapped index file.
+     */
+    const uint8_t *mapped;
+    /**
+     * @brief The size of the mapped file.
+     */
+    size_t mapped_size;
+    /**
+     * @brief The header of the image, nullptr without one.
+     */
+    const symindex_header *header;
+};
+
+#endif
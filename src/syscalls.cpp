@@ -0,0 +1,430 @@
+#include "syscalls.hpp"
+
+#include <algorithm>
+#include <linux/audit.h>
+#include <linux/seccomp.h>
+#include <stddef.h>
+#include <sys/syscall.h>
+
+/*
+    x86_64 system calls. Argument formats: i - signed decimal, u - unsigned
+    decimal, x - hex, o - octal, s - string pointer; nullptr - six hex values
+*/
+static const syscall_desc syscall_table[] = {
+    {SYS_read, "read", "ixu"},
+    {SYS_write, "write", "ixu"},
+    {SYS_open, "open", "sxo"},
+    {SYS_close, "close", "i"},
+    {SYS_stat, "stat", "sx"},
+    {SYS_fstat, "fstat", "ix"},
+    {SYS_lstat, "lstat", "sx"},
+    {SYS_poll, "poll", "xui"},
+    {SYS_lseek, "lseek", "iii"},
+    {SYS_mmap, "mmap", "xuxxix"},
+    {SYS_mprotect, "mprotect", "xux"},
+    {SYS_munmap, "munmap", "xu"},
+    {SYS_brk, "brk", "x"},
+    {SYS_rt_sigaction, "rt_sigaction", "ixxu"},
+    {SYS_rt_sigprocmask, "rt_sigprocmask", "ixxu"},
+    {SYS_rt_sigreturn, "rt_sigreturn", ""},
+    {SYS_ioctl, "ioctl", "ixx"},
+    {SYS_pread64, "pread64", "ixui"},
+    {SYS_pwrite64, "pwrite64", "ixui"},
+    {SYS_readv, "readv", "ixi"},
+    {SYS_writev, "writev", "ixi"},
+    {SYS_access, "access", "so"},
+    {SYS_pipe, "pipe", "x"},
+    {SYS_select, "select", "ixxxx"},
+    {SYS_sched_yield, "sched_yield", ""},
+    {SYS_mremap, "mremap", "xuuxx"},
+    {SYS_msync, "msync", nullptr},
+    {SYS_mincore, "mincore", nullptr},
+    {SYS_madvise, "madvise", "xui"},
+    {SYS_shmget, "shmget", nullptr},
+    {SYS_shmat, "shmat", nullptr},
+    {SYS_shmctl, "shmctl", nullptr},
+    {SYS_dup, "dup", "i"},
+    {SYS_dup2, "dup2", "ii"},
+    {SYS_pause, "pause", nullptr},
+    {SYS_nanosleep, "nanosleep", "xx"},
+    {SYS_getitimer, "getitimer", nullptr},
+    {SYS_alarm, "alarm", nullptr},
+    {SYS_setitimer, "setitimer", nullptr},
+    {SYS_getpid, "getpid", ""},
+    {SYS_sendfile, "sendfile", nullptr},
+    {SYS_socket, "socket", "iii"},
+    {SYS_connect, "connect", "ixu"},
+    {SYS_accept, "accept", "ixx"},
+    {SYS_sendto, "sendto", "ixuixu"},
+    {SYS_recvfrom, "recvfrom", "ixuixx"},
+    {SYS_sendmsg, "sendmsg", "ixx"},
+    {SYS_recvmsg, "recvmsg", "ixx"},
+    {SYS_shutdown, "shutdown", "ii"},
+    {SYS_bind, "bind", "ixu"},
+    {SYS_listen, "listen", "ii"},
+    {SYS_getsockname, "getsockname", nullptr},
+    {SYS_getpeername, "getpeername", nullptr},
+    {SYS_socketpair, "socketpair", nullptr},
+    {SYS_setsockopt, "setsockopt", nullptr},
+    {SYS_getsockopt, "getsockopt", nullptr},
+    {SYS_clone, "clone", "xxxxx"},
+    {SYS_fork, "fork", ""},
+    {SYS_vfork, "vfork", ""},
+    {SYS_execve, "execve", "sxx"},
+    {SYS_exit, "exit", "i"},
+    {SYS_wait4, "wait4", "ixix"},
+    {SYS_kill, "kill", "ii"},
+    {SYS_uname, "uname", "x"},
+    {SYS_semget, "semget", nullptr},
+    {SYS_semop, "semop", nullptr},
+    {SYS_semctl, "semctl", nullptr},
+    {SYS_shmdt, "shmdt", nullptr},
+    {SYS_msgget, "msgget", nullptr},
+    {SYS_msgsnd, "msgsnd", nullptr},
+    {SYS_msgrcv, "msgrcv", nullptr},
+    {SYS_msgctl, "msgctl", nullptr},
+    {SYS_fcntl, "fcntl", "iix"},
+    {SYS_flock, "flock", nullptr},
+    {SYS_fsync, "fsync", "i"},
+    {SYS_fdatasync, "fdatasync", "i"},
+    {SYS_truncate, "truncate", "si"},
+    {SYS_ftruncate, "ftruncate", "ii"},
+    {SYS_getdents, "getdents", nullptr},
+    {SYS_getcwd, "getcwd", "xu"},
+    {SYS_chdir, "chdir", "s"},
+    {SYS_fchdir, "fchdir", "i"},
+    {SYS_rename, "rename", "ss"},
+    {SYS_mkdir, "mkdir", "so"},
+    {SYS_rmdir, "rmdir", "s"},
+    {SYS_creat, "creat", "so"},
+    {SYS_link, "link", "ss"},
+    {SYS_unlink, "unlink", "s"},
+    {SYS_symlink, "symlink", "ss"},
+    {SYS_readlink, "readlink", "sxu"},
+    {SYS_chmod, "chmod", "so"},
+    {SYS_fchmod, "fchmod", "io"},
+    {SYS_chown, "chown", nullptr},
+    {SYS_fchown, "fchown", nullptr},
+    {SYS_lchown, "lchown", nullptr},
+    {SYS_umask, "umask", "o"},
+    {SYS_gettimeofday, "gettimeofday", "xx"},
+    {SYS_getrlimit, "getrlimit", "ix"},
+    {SYS_getrusage, "getrusage", nullptr},
+    {SYS_sysinfo, "sysinfo", "x"},
+    {SYS_times, "times", nullptr},
+    {SYS_ptrace, "ptrace", "iixx"},
+    {SYS_getuid, "getuid", ""},
+    {SYS_syslog, "syslog", nullptr},
+    {SYS_getgid, "getgid", ""},
+    {SYS_setuid, "setuid", nullptr},
+    {SYS_setgid, "setgid", nullptr},
+    {SYS_geteuid, "geteuid", ""},
+    {SYS_getegid, "getegid", ""},
+    {SYS_setpgid, "setpgid", nullptr},
+    {SYS_getppid, "getppid", ""},
+    {SYS_getpgrp, "getpgrp", nullptr},
+    {SYS_setsid, "setsid", ""},
+    {SYS_setreuid, "setreuid", nullptr},
+    {SYS_setregid, "setregid", nullptr},
+    {SYS_getgroups, "getgroups", nullptr},
+    {SYS_setgroups, "setgroups", nullptr},
+    {SYS_setresuid, "setresuid", nullptr},
+    {SYS_getresuid, "getresuid", nullptr},
+    {SYS_setresgid, "setresgid", nullptr},
+    {SYS_getresgid, "getresgid", nullptr},
+    {SYS_getpgid, "getpgid", nullptr},
+    {SYS_setfsuid, "setfsuid", nullptr},
+    {SYS_setfsgid, "setfsgid", nullptr},
+    {SYS_getsid, "getsid", nullptr},
+    {SYS_capget, "capget", nullptr},
+    {SYS_capset, "capset", nullptr},
+    {SYS_rt_sigpending, "rt_sigpending", nullptr},
+    {SYS_rt_sigtimedwait, "rt_sigtimedwait", nullptr},
+    {SYS_rt_sigqueueinfo, "rt_sigqueueinfo", nullptr},
+    {SYS_rt_sigsuspend, "rt_sigsuspend", nullptr},
+    {SYS_sigaltstack, "sigaltstack", nullptr},
+    {SYS_utime, "utime", nullptr},
+    {SYS_mknod, "mknod", nullptr},
+    {SYS_uselib, "uselib", nullptr},
+    {SYS_personality, "personality", nullptr},
+    {SYS_ustat, "ustat", nullptr},
+    {SYS_statfs, "statfs", nullptr},
+    {SYS_fstatfs, "fstatfs", nullptr},
+    {SYS_sysfs, "sysfs", nullptr},
+    {SYS_getpriority, "getpriority", nullptr},
+    {SYS_setpriority, "setpriority", nullptr},
+    {SYS_sched_setparam, "sched_setparam", nullptr},
+    {SYS_sched_getparam, "sched_getparam", nullptr},
+    {SYS_sched_setscheduler, "sched_setscheduler", nullptr},
+    {SYS_sched_getscheduler, "sched_getscheduler", nullptr},
+    {SYS_sched_get_priority_max, "sched_get_priority_max", nullptr},
+    {SYS_sched_get_priority_min, "sched_get_priority_min", nullptr},
+    {SYS_sched_rr_get_interval, "sched_rr_get_interval", nullptr},
+    {SYS_mlock, "mlock", nullptr},
+    {SYS_munlock, "munlock", nullptr},
+    {SYS_mlockall, "mlockall", nullptr},
+    {SYS_munlockall, "munlockall", nullptr},
+    {SYS_vhangup, "vhangup", nullptr},
+    {SYS_modify_ldt, "modify_ldt", nullptr},
+    {SYS_pivot_root, "pivot_root", nullptr},
+    {SYS__sysctl, "_sysctl", nullptr},
+    {SYS_prctl, "prctl", "ixxxx"},
+    {SYS_arch_prctl, "arch_prctl", "xx"},
+    {SYS_adjtimex, "adjtimex", nullptr},
+    {SYS_setrlimit, "setrlimit", "ix"},
+    {SYS_chroot, "chroot", nullptr},
+    {SYS_sync, "sync", nullptr},
+    {SYS_acct, "acct", nullptr},
+    {SYS_settimeofday, "settimeofday", nullptr},
+    {SYS_mount, "mount", nullptr},
+    {SYS_umount2, "umount2", nullptr},
+    {SYS_swapon, "swapon", nullptr},
+    {SYS_swapoff, "swapoff", nullptr},
+    {SYS_reboot, "reboot", nullptr},
+    {SYS_sethostname, "sethostname", nullptr},
+    {SYS_setdomainname, "setdomainname", nullptr},
+    {SYS_iopl, "iopl", nullptr},
+    {SYS_ioperm, "ioperm", nullptr},
+    {SYS_create_module, "create_module", nullptr},
+    {SYS_init_module, "init_module", nullptr},
+    {SYS_delete_module, "delete_module", nullptr},
+    {SYS_get_kernel_syms, "get_kernel_syms", nullptr},
+    {SYS_query_module, "query_module", nullptr},
+    {SYS_quotactl, "quotactl", nullptr},
+    {SYS_nfsservctl, "nfsservctl", nullptr},
+    {SYS_getpmsg, "getpmsg", nullptr},
+    {SYS_putpmsg, "putpmsg", nullptr},
+    {SYS_afs_syscall, "afs_syscall", nullptr},
+    {SYS_tuxcall, "tuxcall", nullptr},
+    {SYS_security, "security", nullptr},
+    {SYS_gettid, "gettid", ""},
+    {SYS_readahead, "readahead", nullptr},
+    {SYS_setxattr, "setxattr", nullptr},
+    {SYS_lsetxattr, "lsetxattr", nullptr},
+    {SYS_fsetxattr, "fsetxattr", nullptr},
+    {SYS_getxattr, "getxattr", nullptr},
+    {SYS_lgetxattr, "lgetxattr", nullptr},
+    {SYS_fgetxattr, "fgetxattr", nullptr},
+    {SYS_listxattr, "listxattr", nullptr},
+    {SYS_llistxattr, "llistxattr", nullptr},
+    {SYS_flistxattr, "flistxattr", nullptr},
+    {SYS_removexattr, "removexattr", nullptr},
+    {SYS_lremovexattr, "lremovexattr", nullptr},
+    {SYS_fremovexattr, "fremovexattr", nullptr},
+    {SYS_tkill, "tkill", "ii"},
+    {SYS_time, "time", nullptr},
+    {SYS_futex, "futex", "xixxxi"},
+    {SYS_sched_setaffinity, "sched_setaffinity", nullptr},
+    {SYS_sched_getaffinity, "sched_getaffinity", "iux"},
+    {SYS_set_thread_area, "set_thread_area", nullptr},
+    {SYS_io_setup, "io_setup", nullptr},
+    {SYS_io_destroy, "io_destroy", nullptr},
+    {SYS_io_getevents, "io_getevents", nullptr},
+    {SYS_io_submit, "io_submit", nullptr},
+    {SYS_io_cancel, "io_cancel", nullptr},
+    {SYS_get_thread_area, "get_thread_area", nullptr},
+    {SYS_lookup_dcookie, "lookup_dcookie", nullptr},
+    {SYS_epoll_create, "epoll_create", nullptr},
+    {SYS_epoll_ctl_old, "epoll_ctl_old", nullptr},
+    {SYS_epoll_wait_old, "epoll_wait_old", nullptr},
+    {SYS_remap_file_pages, "remap_file_pages", nullptr},
+    {SYS_getdents64, "getdents64", "ixu"},
+    {SYS_set_tid_address, "set_tid_address", "x"},
+    {SYS_restart_syscall, "restart_syscall", nullptr},
+    {SYS_semtimedop, "semtimedop", nullptr},
+    {SYS_fadvise64, "fadvise64", nullptr},
+    {SYS_timer_create, "timer_create", nullptr},
+    {SYS_timer_settime, "timer_settime", nullptr},
+    {SYS_timer_gettime, "timer_gettime", nullptr},
+    {SYS_timer_getoverrun, "timer_getoverrun", nullptr},
+    {SYS_timer_delete, "timer_delete", nullptr},
+    {SYS_clock_settime, "clock_settime", nullptr},
+    {SYS_clock_gettime, "clock_gettime", "ix"},
+    {SYS_clock_getres, "clock_getres", nullptr},
+    {SYS_clock_nanosleep, "clock_nanosleep", "iixx"},
+    {SYS_exit_group, "exit_group", "i"},
+    {SYS_epoll_wait, "epoll_wait", "ixii"},
+    {SYS_epoll_ctl, "epoll_ctl", "iiix"},
+    {SYS_tgkill, "tgkill", "iii"},
+    {SYS_utimes, "utimes", nullptr},
+    {SYS_vserver, "vserver", nullptr},
+    {SYS_mbind, "mbind", nullptr},
+    {SYS_set_mempolicy, "set_mempolicy", nullptr},
+    {SYS_get_mempolicy, "get_mempolicy", nullptr},
+    {SYS_mq_open, "mq_open", nullptr},
+    {SYS_mq_unlink, "mq_unlink", nullptr},
+    {SYS_mq_timedsend, "mq_timedsend", nullptr},
+    {SYS_mq_timedreceive, "mq_timedreceive", nullptr},
+    {SYS_mq_notify, "mq_notify", nullptr},
+    {SYS_mq_getsetattr, "mq_getsetattr", nullptr},
+    {SYS_kexec_load, "kexec_load", nullptr},
+    {SYS_waitid, "waitid", nullptr},
+    {SYS_add_key, "add_key", nullptr},
+    {SYS_request_key, "request_key", nullptr},
+    {SYS_keyctl, "keyctl", nullptr},
+    {SYS_ioprio_set, "ioprio_set", nullptr},
+    {SYS_ioprio_get, "ioprio_get", nullptr},
+    {SYS_inotify_init, "inotify_init", nullptr},
+    {SYS_inotify_add_watch, "inotify_add_watch", nullptr},
+    {SYS_inotify_rm_watch, "inotify_rm_watch", nullptr},
+    {SYS_migrate_pages, "migrate_pages", nullptr},
+    {SYS_openat, "openat", "isxo"},
+    {SYS_mkdirat, "mkdirat", "iso"},
+    {SYS_mknodat, "mknodat", nullptr},
+    {SYS_fchownat, "fchownat", nullptr},
+    {SYS_futimesat, "futimesat", nullptr},
+    {SYS_newfstatat, "newfstatat", "isxx"},
+    {SYS_unlinkat, "unlinkat", "isx"},
+    {SYS_renameat, "renameat", "isis"},
+    {SYS_linkat, "linkat", nullptr},
+    {SYS_symlinkat, "symlinkat", nullptr},
+    {SYS_readlinkat, "readlinkat", "isxu"},
+    {SYS_fchmodat, "fchmodat", nullptr},
+    {SYS_faccessat, "faccessat", "iso"},
+    {SYS_pselect6, "pselect6", nullptr},
+    {SYS_ppoll, "ppoll", nullptr},
+    {SYS_unshare, "unshare", nullptr},
+    {SYS_set_robust_list, "set_robust_list", "xu"},
+    {SYS_get_robust_list, "get_robust_list", nullptr},
+    {SYS_splice, "splice", nullptr},
+    {SYS_tee, "tee", nullptr},
+    {SYS_sync_file_range, "sync_file_range", nullptr},
+    {SYS_vmsplice, "vmsplice", nullptr},
+    {SYS_move_pages, "move_pages", nullptr},
+    {SYS_utimensat, "utimensat", nullptr},
+    {SYS_epoll_pwait, "epoll_pwait", "ixiix"},
+    {SYS_signalfd, "signalfd", nullptr},
+    {SYS_timerfd_create, "timerfd_create", "ix"},
+    {SYS_eventfd, "eventfd", nullptr},
+    {SYS_fallocate, "fallocate", nullptr},
+    {SYS_timerfd_settime, "timerfd_settime", nullptr},
+    {SYS_timerfd_gettime, "timerfd_gettime", nullptr},
+    {SYS_accept4, "accept4", "ixxx"},
+    {SYS_signalfd4, "signalfd4", "ixux"},
+    {SYS_eventfd2, "eventfd2", "ux"},
+    {SYS_epoll_create1, "epoll_create1", "x"},
+    {SYS_dup3, "dup3", "iii"},
+    {SYS_pipe2, "pipe2", "xx"},
+    {SYS_inotify_init1, "inotify_init1", nullptr},
+    {SYS_preadv, "preadv", nullptr},
+    {SYS_pwritev, "pwritev", nullptr},
+    {SYS_rt_tgsigqueueinfo, "rt_tgsigqueueinfo", nullptr},
+    {SYS_perf_event_open, "perf_event_open", nullptr},
+    {SYS_recvmmsg, "recvmmsg", nullptr},
+    {SYS_fanotify_init, "fanotify_init", nullptr},
+    {SYS_fanotify_mark, "fanotify_mark", nullptr},
+    {SYS_prlimit64, "prlimit64", "iixx"},
+    {SYS_name_to_handle_at, "name_to_handle_at", nullptr},
+    {SYS_open_by_handle_at, "open_by_handle_at", nullptr},
+    {SYS_clock_adjtime, "clock_adjtime", nullptr},
+    {SYS_syncfs, "syncfs", nullptr},
+    {SYS_sendmmsg, "sendmmsg", nullptr},
+    {SYS_setns, "setns", nullptr},
+    {SYS_getcpu, "getcpu", nullptr},
+    {SYS_process_vm_readv, "process_vm_readv", "ixuxux"},
+    {SYS_process_vm_writev, "process_vm_writev", "ixuxux"},
+    {SYS_kcmp, "kcmp", nullptr},
+    {SYS_finit_module, "finit_module", nullptr},
+    {SYS_sched_setattr, "sched_setattr", nullptr},
+    {SYS_sched_getattr, "sched_getattr", nullptr},
+    {SYS_renameat2, "renameat2", nullptr},
+    {SYS_seccomp, "seccomp", "uux"},
+    {SYS_getrandom, "getrandom", "xux"},
+    {SYS_memfd_create, "memfd_create", "sx"},
+    {SYS_kexec_file_load, "kexec_file_load", nullptr},
+    {SYS_bpf, "bpf", nullptr},
+    {SYS_execveat, "execveat", nullptr},
+    {SYS_userfaultfd, "userfaultfd", nullptr},
+    {SYS_membarrier, "membarrier", nullptr},
+    {SYS_mlock2, "mlock2", nullptr},
+    {SYS_copy_file_range, "copy_file_range", nullptr},
+    {SYS_preadv2, "preadv2", nullptr},
+    {SYS_pwritev2, "pwritev2", nullptr},
+    {SYS_pkey_mprotect, "pkey_mprotect", nullptr},
+    {SYS_pkey_alloc, "pkey_alloc", nullptr},
+    {SYS_pkey_free, "pkey_free", nullptr},
+    {SYS_statx, "statx", "isxxx"},
+    {SYS_io_pgetevents, "io_pgetevents", nullptr},
+    {SYS_rseq, "rseq", "xuix"},
+    {SYS_pidfd_send_signal, "pidfd_send_signal", nullptr},
+    {SYS_io_uring_setup, "io_uring_setup", nullptr},
+    {SYS_io_uring_enter, "io_uring_enter", nullptr},
+    {SYS_io_uring_register, "io_uring_register", nullptr},
+    {SYS_open_tree, "open_tree", nullptr},
+    {SYS_move_mount, "move_mount", nullptr},
+    {SYS_fsopen, "fsopen", nullptr},
+    {SYS_fsconfig, "fsconfig", nullptr},
+    {SYS_fsmount, "fsmount", nullptr},
+    {SYS_fspick, "fspick", nullptr},
+    {SYS_pidfd_open, "pidfd_open", "ix"},
+    {SYS_clone3, "clone3", nullptr},
+    {SYS_close_range, "close_range", "uux"},
+    {SYS_openat2, "openat2", nullptr},
+    {SYS_pidfd_getfd, "pidfd_getfd", nullptr},
+    {SYS_faccessat2, "faccessat2", "isox"},
+    {SYS_process_madvise, "process_madvise", nullptr},
+    {SYS_epoll_pwait2, "epoll_pwait2", nullptr},
+    {SYS_mount_setattr, "mount_setattr", nullptr},
+    {SYS_quotactl_fd, "quotactl_fd", nullptr},
+    {SYS_landlock_create_ruleset, "landlock_create_ruleset", nullptr},
+    {SYS_landlock_add_rule, "landlock_add_rule", nullptr},
+    {SYS_landlock_restrict_self, "landlock_restrict_self", nullptr},
+    {SYS_memfd_secret, "memfd_secret", nullptr},
+    {SYS_process_mrelease, "process_mrelease", nullptr},
+    {SYS_futex_waitv, "futex_waitv", nullptr},
+    {SYS_set_mempolicy_home_node, "set_mempolicy_home_node", nullptr},
+};
+
+#define SYSCALL_TABLE_SIZE (sizeof(syscall_table) / sizeof(syscall_table[0]))
+
+const syscall_desc *syscall_by_nr(long nr) {
+    auto it = std::lower_bound(
+        syscall_table, syscall_table + SYSCALL_TABLE_SIZE, nr,
+        [](const syscall_desc &desc, long nr) { return desc.nr < nr; });
+    if (it == syscall_table + SYSCALL_TABLE_SIZE || it->nr != nr) {
+        return nullptr;
+    }
+    return it;
+}
+
+const syscall_desc *syscall_by_name(const std::string &name) {
+    for (size_t i = 0; i < SYSCALL_TABLE_SIZE; i++) {
+        if (name == syscall_table[i].name) {
+            return &syscall_table[i];
+        }
+    }
+    return nullptr;
+}
+
+std::vector<sock_filter> build_seccomp_filter(const std::set<long> &nrs) {
+    // Offsets of the conditional jumps are 8-bit, too long lists trace all
+    if (nrs.count(SYSCALL_ALL) != 0 ||
+        nrs.size() + SYSCALL_FILTER_HEADER > SYSCALL_FILTER_MAX_JUMP) {
+        return {BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE)};
+    }
+
+    // Other ABIs number the calls differently, they are all traced rather
+    // than let through unseen
+    uint8_t n = nrs.size();
+    std::vector<sock_filter> prog = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, arch)),
+        // Foreign architecture - index n + 5 is RET_TRACE
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0,
+                 (uint8_t)(n + 3)),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(seccomp_data, nr)),
+        // x32 calls share the arch, they have the x32 bit set
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, __X32_SYSCALL_BIT,
+                 (uint8_t)(n + 1), 0),
+    };
+
+    uint8_t left = n;
+    for (long nr: nrs) {
+        // Jump over the rest of comparisons and RET_ALLOW to RET_TRACE
+        prog.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)nr, left, 0));
+        left--;
+    }
+
+    prog.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+    prog.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+    return prog;
+}
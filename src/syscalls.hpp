@@ -0,0 +1,68 @@
+#ifndef SYSCALLS_H
+#define SYSCALLS_H
+
+#include <linux/filter.h>
+#include <set>
+#include <signal.h>
+#include <string>
+#include <sys/ptrace.h>
+#include <vector>
+
+#define SYSCALL_ALL -1
+#define SYSCALL_FILTER_MAX_JUMP 255
+// Jump over the x32 check, the comparisons and RET_ALLOW from the arch check
+#define SYSCALL_FILTER_HEADER 3
+#define SYSCALL_MAX_ARGS 6
+#define SYSCALL_MAX_STR 48
+
+// `status >> 8` of a PTRACE_EVENT_SECCOMP stop
+#define SECCOMP_STOP_STATUS (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))
+// WSTOPSIG of a syscall-exit-stop with PTRACE_O_TRACESYSGOOD
+#define SYSCALL_STOP_SIG (SIGTRAP | 0x80)
+
+/**
+ * @brief Describes a system call of x86_64.
+ */
+struct syscall_desc {
+    /**
+     * @brief The system call number.
+     */
+    long nr;
+    /**
+     * @brief The name of the system call.
+     */
+    const char *name;
+    /**
+     * @brief One character per argument (i, u, x, o, s) or nullptr if the
+     * arguments are unknown.
+     */
+    const char *args;
+};
+
+/**
+ * @brief Finds a system call by its number.
+ *
+ * @param nr The system call number.
+ * @return The description or nullptr if the number is unknown.
+ */
+const syscall_desc *syscall_by_nr(long nr);
+
+/**
+ * @brief Finds a system call by its name.
+ *
+ * @param name The name of the system call.
+ * @return The description or nullptr if the name is unknown.
+ */
+const syscall_desc *syscall_by_name(const std::string &name);
+
+/**
+ * @brief Builds a seccomp BPF program that returns SECCOMP_RET_TRACE for the
+ * given system calls and SECCOMP_RET_ALLOW for all other x86_64 calls.
+ * Calls of other architectures and x32 calls are always traced.
+ *
+ * @param nrs The system call numbers, SYSCALL_ALL traces every call.
+ * @return The BPF program.
+ */
+std::vector<sock_filter> build_seccomp_filter(const std::set<long> &nrs);
+
+#endif
@@ -0,0 +1,332 @@
+#include "target.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/procfs.h>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+bool LiveTarget::get_regs(struct user_regs_struct &regs) {
+    return ptrace(PTRACE_GETREGS, pid, 0, &regs) == 0;
+}
+
+bool LiveTarget::read_memory(uint64_t addr, uint8_t *buf, size_t size) {
+    if (size == 0) {
+        return true;
+    }
+    uint64_t first = addr & ~(uint64_t)(TARGET_PAGE_SIZE - 1);
+    uint64_t last = (addr + size - 1) & ~(uint64_t)(TARGET_PAGE_SIZE - 1);
+    if (last < first ||
+        (last - first) / TARGET_PAGE_SIZE >= TARGET_CACHE_PAGES_MAX) {
+        return read_direct(addr, buf, size);
+    }
+
+    fetch(first, last);
+    for (uint64_t page = first; page <= last; page += TARGET_PAGE_SIZE) {
+        uint64_t start = std::max(addr, page);
+        uint64_t end = std::min(addr + size, page + TARGET_PAGE_SIZE);
+        auto it = pages.find(page);
+        if (it != pages.end()) {
+            memcpy(buf + (start - addr), it->second.data() + (start - page),
+                   end - start);
+        } else if (!read_direct(start, buf + (start - addr), end - start)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LiveTarget::fetch(uint64_t first, uint64_t last) {
+    if (pages.size() + (last - first) / TARGET_PAGE_SIZE >=
+        TARGET_CACHE_PAGES_MAX) {
+        pages.clear();
+    }
+
+    std::vector<uint64_t> missing;
+    for (uint64_t page = first; page <= last; page += TARGET_PAGE_SIZE) {
+        if (pages.count(page) != 0) {
+            hits++;
+        } else {
+            misses++;
+            if (unreadable.count(page) == 0) {
+                missing.push_back(page);
+            }
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+
+    std::vector<struct iovec> local(missing.size()), remote(missing.size());
+    for (size_t i = 0; i < missing.size(); i++) {
+        std::vector<uint8_t> &data = pages[missing[i]];
+        data.resize(TARGET_PAGE_SIZE);
+        local[i] = {data.data(), TARGET_PAGE_SIZE};
+        remote[i] = {(void *)missing[i], TARGET_PAGE_SIZE};
+    }
+
+    // A transfer stops at the first page it can not read, the rest is
+    // fetched again past that page
+    size_t done = 0;
+    while (done < missing.size()) {
+        ssize_t len = process_vm_readv(pid, &local[done],
+                                       missing.size() - done, &remote[done],
+                                       missing.size() - done, 0);
+        if (len < 0 && errno != EFAULT) {
+            // The process is gone, nothing is readable
+            for (; done < missing.size(); done++) {
+                pages.erase(missing[done]);
+            }
+            break;
+        }
+        done += len > 0 ? len / TARGET_PAGE_SIZE : 0;
+        if (done < missing.size()) {
+            unreadable.insert(missing[done]);
+            pages.erase(missing[done]);
+            done++;
+        }
+    }
+}
+
+void LiveTarget::flush() {
+    pages.clear();
+    unreadable.clear();
+}
+
+void LiveTarget::wrote(uint64_t addr, const uint8_t *buf, size_t size) {
+    uint64_t end = addr + size;
+    uint64_t page = addr & ~(uint64_t)(TARGET_PAGE_SIZE - 1);
+    for (; page < end; page += TARGET_PAGE_SIZE) {
+        auto it = pages.find(page);
+        if (it == pages.end()) {
+            continue;
+        }
+        uint64_t start = std::max(addr, page);
+        uint64_t stop = std::min(end, page + TARGET_PAGE_SIZE);
+        memcpy(it->second.data() + (start - page), buf + (start - addr),
+               stop - start);
+    }
+}
+
+bool LiveTarget::read_direct(uint64_t addr, uint8_t *buf, size_t size) {
+    struct iovec local = {buf, size};
+    struct iovec remote = {(void *)addr, size};
+    if (process_vm_readv(pid, &local, 1, &remote, 1, 0) == (ssize_t)size) {
+        return true;
+    }
+
+    // Pages without read permission are still readable with ptrace
+    size_t aligned = size & ~(sizeof(long) - 1);
+    if (!read_process_memory(pid, addr, buf, aligned)) {
+        return false;
+    }
+    if (aligned < size) {
+        long word = ptrace(PTRACE_PEEKDATA, pid, addr + aligned, nullptr);
+        memcpy(buf + aligned, &word, size - aligned);
+    }
+    return true;
+}
+
+/**
+ * @brief Maps a whole file read-only.
+ */
+static uint8_t *map_file(const char *path, size_t &size) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+        if (fd >= 0)
+            close(fd);
+        return nullptr;
+    }
+
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return nullptr;
+    }
+    size = st.st_size;
+    return (uint8_t *)mem;
+}
+
+CoreTarget::CoreTarget(const char *path)
+    : image(nullptr), image_size(0), regs(), has_regs(false), core_pid(0),
+      core_signal(0) {
+    uint8_t *mem = map_file(path, image_size);
+    if (mem == nullptr) {
+        std::cerr << "cannot open " << path << std::endl;
+        return;
+    }
+    image = mem;
+
+    auto *ehdr = (Elf64_Ehdr *)image;
+    if (image_size < sizeof(Elf64_Ehdr) ||
+        memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 || ehdr->e_type != ET_CORE ||
+        ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf64_Phdr) > image_size) {
+        std::cerr << path << " is not an ELF64 core file" << std::endl;
+        return;
+    }
+
+    auto *phdrs = (Elf64_Phdr *)(image + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        Elf64_Phdr phdr = phdrs[i];
+        if (phdr.p_offset + phdr.p_filesz > image_size) {
+            // A truncated core, keep what is there
+            phdr.p_filesz = phdr.p_offset < image_size
+                                ? image_size - phdr.p_offset
+                                : 0;
+        }
+        if (phdr.p_type == PT_LOAD) {
+            segments.push_back({phdr.p_vaddr, phdr.p_memsz,
+                                std::min(phdr.p_filesz, phdr.p_memsz),
+                                phdr.p_offset});
+        } else if (phdr.p_type == PT_NOTE) {
+            parse_notes(image + phdr.p_offset, phdr.p_filesz);
+        }
+    }
+
+    std::sort(segments.begin(), segments.end(),
+              [](const core_segment &a, const core_segment &b) {
+                  return a.vaddr < b.vaddr;
+              });
+    if (!has_regs) {
+        std::cerr << path << " has no NT_PRSTATUS note" << std::endl;
+    }
+}
+
+CoreTarget::~CoreTarget() {
+    for (auto &file: files) {
+        if (file.image != nullptr) {
+            munmap(file.image, file.image_size);
+        }
+    }
+    if (image != nullptr) {
+        munmap(image, image_size);
+    }
+}
+
+void CoreTarget::parse_notes(const uint8_t *notes, size_t size) {
+    size_t pos = 0;
+    while (pos + sizeof(Elf64_Nhdr) <= size) {
+        auto *nhdr = (const Elf64_Nhdr *)(notes + pos);
+        size_t desc_pos = pos + sizeof(*nhdr) + ((nhdr->n_namesz + 3) & ~3);
+        size_t next = desc_pos + ((nhdr->n_descsz + 3) & ~3);
+        if (desc_pos + nhdr->n_descsz > size) {
+            break;
+        }
+        const uint8_t *desc = notes + desc_pos;
+
+        // The first NT_PRSTATUS is the thread that got the signal
+        if (nhdr->n_type == NT_PRSTATUS && !has_regs &&
+            nhdr->n_descsz >= sizeof(struct elf_prstatus)) {
+            auto *status = (const struct elf_prstatus *)desc;
+            memcpy(&regs, &status->pr_reg, sizeof(regs));
+            core_pid = status->pr_pid;
+            core_signal = status->pr_cursig;
+            has_regs = true;
+        } else if (nhdr->n_type == NT_FILE &&
+                   nhdr->n_descsz >= 2 * sizeof(uint64_t)) {
+            auto *words = (const uint64_t *)desc;
+            uint64_t count = words[0], page_size = words[1];
+            // The entries must fit in the note, a corrupt count is not
+            // trusted; divided to keep 3 * count from overflowing
+            if (count > (nhdr->n_descsz / sizeof(uint64_t) - 2) / 3) {
+                pos = next;
+                continue;
+            }
+            const char *name = (const char *)(words + 2 + 3 * count);
+            const char *end = (const char *)desc + nhdr->n_descsz;
+            for (uint64_t i = 0; i < count && name < end; i++) {
+                const uint64_t *entry = words + 2 + 3 * i;
+                files.push_back({entry[0], entry[1], entry[2] * page_size,
+                                 std::string(name, strnlen(name, end - name)),
+                                 nullptr, 0});
+                name += files.back().path.size() + 1;
+            }
+        }
+        pos = next;
+    }
+}
+
+bool CoreTarget::get_regs(struct user_regs_struct &regs_) {
+    regs_ = regs;
+    return has_regs;
+}
+
+const core_segment *CoreTarget::find_segment(uint64_t addr) {
+    auto it = std::upper_bound(
+        segments.begin(), segments.end(), addr,
+        [](uint64_t addr, const core_segment &seg) { return addr < seg.vaddr; });
+    if (it == segments.begin()) {
+        return nullptr;
+    }
+    --it;
+    return addr < it->vaddr + it->memsz ? &*it : nullptr;
+}
+
+void CoreTarget::mappings(std::vector<proc_map> &maps) {
+    maps.clear();
+    for (auto &file: files) {
+        // The inode is not saved, any non-zero value marks a file mapping
+        maps.push_back({file.start, file.end, file.offset, 1, 0, "r--p",
+                        file.path});
+    }
+}
+
+const uint8_t *CoreTarget::memory_at(uint64_t addr, size_t size) {
+    const core_segment *seg = find_segment(addr);
+    if (seg == nullptr || addr + size > seg->vaddr + seg->filesz) {
+        return nullptr;
+    }
+    return image + seg->offset + (addr - seg->vaddr);
+}
+
+void CoreTarget::read_unsaved(uint64_t addr, uint8_t *buf, size_t size) {
+    memset(buf, 0, size);
+    for (auto &file: files) {
+        if (addr < file.start || addr >= file.end) {
+            continue;
+        }
+        if (file.image == nullptr) {
+            file.image = map_file(file.path.c_str(), file.image_size);
+        }
+        uint64_t pos = file.offset + (addr - file.start);
+        if (file.image != nullptr && pos < file.image_size) {
+            memcpy(buf, file.image + pos,
+                   std::min<uint64_t>(size, file.image_size - pos));
+        }
+        return;
+    }
+}
+
+bool CoreTarget::read_memory(uint64_t addr, uint8_t *buf, size_t size) {
+    while (size > 0) {
+        const core_segment *seg = find_segment(addr);
+        if (seg == nullptr) {
+            return false;
+        }
+
+        uint64_t seg_pos = addr - seg->vaddr;
+        size_t len = std::min<uint64_t>(size, seg->memsz - seg_pos);
+        size_t saved = seg_pos < seg->filesz
+                           ? std::min<uint64_t>(len, seg->filesz - seg_pos)
+                           : 0;
+        memcpy(buf, image + seg->offset + seg_pos, saved);
+        if (saved < len) {
+            read_unsaved(addr + saved, buf + saved, len - saved);
+        }
+
+        addr += len;
+        buf += len;
+        size -= len;
+    }
+    return true;
+}
@@ -0,0 +1,307 @@
+#ifndef TARGET_H
+#define TARGET_H
+
+#include "procmaps.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#define TARGET_PAGE_SIZE 0x1000
+// Reads spanning more pages bypass the cache, which holds at most as many
+#define TARGET_CACHE_PAGES_MAX 256
+
+/**
+ * @brief The Target class is the interface to registers and memory of the
+ * debugged program, a live process or a core file.
+ */
+class Target {
+  public:
+    virtual ~Target() {}
+
+    /**
+     * @brief Retrieves the registers of the current thread.
+     *
+     * @param regs Filled with the registers.
+     * @return false if the registers are not available.
+     */
+    virtual bool get_regs(struct user_regs_struct &regs) = 0;
+
+    /**
+     * @brief Reads memory of the program.
+     *
+     * @param addr The address to read from.
+     * @param buf The buffer to store the data.
+     * @param size The number of bytes to read.
+     * @return false if some of the bytes are not mapped.
+     */
+    virtual bool read_memory(uint64_t addr, uint8_t *buf, size_t size) = 0;
+
+    /**
+     * @brief Forgets the memory read so far, the program is about to run.
+     */
+    virtual void flush() {}
+
+    /**
+     * @brief Keeps the memory read so far in line with a write of the
+     * debugger.
+     *
+     * @param addr The address written to.
+     * @param buf The written data.
+     * @param size The number of bytes written.
+     */
+    virtual void wrote(uint64_t addr, const uint8_t *buf, size_t size) {}
+};
+
+/**
+ * @brief A process stopped under ptrace.
+ *
+ * Memory is read a page at a time and the pages are kept until the process
+ * runs again, so unwinding, printing locals and disassembling in one stop
+ * cost a few `process_vm_readv` calls. Pages missing for a read are fetched
+ * together by one call.
+ */
+class LiveTarget : public Target {
+  public:
+    /**
+     * @brief Constructs a `LiveTarget` object for the given process.
+     *
+     * @param pid_ The process ID.
+     */
+    LiveTarget(pid_t pid_) : pid(pid_), hits(0), misses(0) {}
+
+    bool get_regs(struct user_regs_struct &regs) override;
+
+    bool read_memory(uint64_t addr, uint8_t *buf, size_t size) override;
+
+    void flush() override;
+
+    void wrote(uint64_t addr, const uint8_t *buf, size_t size) override;
+
+    /**
+     * @brief Returns the number of page reads served from the cache.
+     */
+    uint64_t cache_hits() { return hits; }
+
+    /**
+     * @brief Returns the number of page reads that went to the process.
+     */
+    uint64_t cache_misses() { return misses; }
+
+  private:
+    /**
+     * @brief Fetches the missing pages of a range into the cache.
+     *
+     * @param first The first page.
+     * @param last The last page.
+     */
+    void fetch(uint64_t first, uint64_t last);
+
+    /**
+     * @brief Reads memory past the cache, with ptrace for pages without read
+     * permission.
+     *
+     * @param addr The address to read from.
+     * @param buf The buffer to store the data.
+     * @param size The number of bytes to read.
+     * @return false if some of the bytes are not mapped.
+     */
+    bool read_direct(uint64_t addr, uint8_t *buf, size_t size);
+
+    /**
+     * @brief The process ID.
+     */
+    pid_t pid;
+    /**
+     * @brief Pages read since the process stopped, by address.
+     */
+    std::unordered_map<uint64_t, std::vector<uint8_t>> pages;
+    /**
+     * @brief Pages `process_vm_readv` failed to read since the process
+     * stopped.
+     */
+    std::unordered_set<uint64_t> unreadable;
+    /**
+     * @brief Page reads served from the cache.
+     */
+    uint64_t hits;
+    /**
+     * @brief Page reads that went to the process.
+     */
+    uint64_t misses;
+};
+
+/**
+ * @brief A loadable segment of a core file.
+ */
+struct core_segment {
+    /**
+     * @brief The address of the segment.
+     */
+    uint64_t vaddr;
+    /**
+     * @brief The size of the segment in memory.
+     */
+    uint64_t memsz;
+    /**
+     * @brief The number of bytes saved in the core file.
+     */
+    uint64_t filesz;
+    /**
+     * @brief The offset of the saved bytes in the core file.
+     */
+    uint64_t offset;
+};
+
+/**
+ * @brief A file mapping listed in the NT_FILE note of a core file.
+ */
+struct core_file {
+    /**
+     * @brief The start address of the mapping.
+     */
+    uint64_t start;
+    /**
+     * @brief The address past the end of the mapping.
+     */
+    uint64_t end;
+    /**
+     * @brief The offset of the mapping in the file.
+     */
+    uint64_t offset;
+    /**
+     * @brief The path of the file.
+     */
+    std::string path;
+    /**
+     * @brief The mapped file, nullptr until the first read.
+     */
+    uint8_t *image;
+    /**
+     * @brief The size of the mapped file.
+     */
+    size_t image_size;
+};
+
+/**
+ * @brief An ELF core file.
+ *
+ * The file is memory-mapped and reads are served straight from the mapping
+ * through a sorted index of PT_LOAD segments, so opening a core does not
+ * depend on its size. Contents not saved in the core (e.g. skipped
+ * read-only file mappings) are taken from the mapped files listed in
+ * NT_FILE.
+ */
+class CoreTarget : public Target {
+  public:
+    /**
+     * @brief Constructs a `CoreTarget` object and indexes the core file.
+     *
+     * @param path The path to the core file.
+     */
+    CoreTarget(const char *path);
+
+    ~CoreTarget();
+
+    /**
+     * @brief Whether the core file is loaded.
+     */
+    bool loaded() { return image != nullptr && has_regs; }
+
+    bool get_regs(struct user_regs_struct &regs) override;
+
+    bool read_memory(uint64_t addr, uint8_t *buf, size_t size) override;
+
+    /**
+     * @brief Returns a pointer to memory saved in the core without copying.
+     *
+     * @param addr The address of the memory.
+     * @param size The number of bytes.
+     * @return The pointer into the mapped core or nullptr if the range is not
+     * saved in one segment.
+     */
+    const uint8_t *memory_at(uint64_t addr, size_t size);
+
+    /**
+     * @brief Retrieves the file mappings of the dumped process.
+     *
+     * @param maps Filled with the mappings listed in NT_FILE.
+     */
+    void mappings(std::vector<proc_map> &maps);
+
+    /**
+     * @brief Returns the process ID of the dumped process.
+     */
+    pid_t pid() { return core_pid; }
+
+    /**
+     * @brief Returns the signal that stopped the dumped process.
+     */
+    int signal() { return core_signal; }
+
+  private:
+    /**
+     * @brief Reads the PT_NOTE segment: registers of the first thread and
+     * the file mappings.
+     *
+     * @param notes The contents of the segment.
+     * @param size The size of the segment.
+     */
+    void parse_notes(const uint8_t *notes, size_t size);
+
+    /**
+     * @brief Finds the segment containing the given address.
+     *
+     * @return The segment or nullptr.
+     */
+    const core_segment *find_segment(uint64_t addr);
+
+    /**
+     * @brief Fills memory not saved in the core from the mapped files.
+     *
+     * @param addr The address to read from.
+     * @param buf The buffer to store the data.
+     * @param size The number of bytes to read.
+     */
+    void read_unsaved(uint64_t addr, uint8_t *buf, size_t size);
+
+    /**
+     * @brief The mapped core file.
+     */
+    uint8_t *image;
+    /**
+     * @brief The size of the mapped core file.
+     */
+    size_t image_size;
+    /**
+     * @brief PT_LOAD segments sorted by address.
+     */
+    std::vector<core_segment> segments;
+    /**
+     * @brief File mappings from NT_FILE.
+     */
+    std::vector<core_file> files;
+    /**
+     * @brief Registers of the first thread.
+     */
+    struct user_regs_struct regs;
+    /**
+     * @brief Whether NT_PRSTATUS was found.
+     */
+    bool has_regs;
+    /**
+     * @brief The process ID of the dumped process.
+     */
+    pid_t core_pid;
+    /**
+     * @brief The signal that stopped the dumped process.
+     */
+    int core_signal;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "arch.hpp"
+#include "coverage.hpp"
+#include <chrono>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define TEST_MEM_SIZE (4 << 20)
+#define TEST_FILL_BYTE 0x90
+
+/*
+    A temporary file stands in for /proc/<pid>/mem: offsets are addresses
+*/
+class CoverageTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        char path[] = "/tmp/debugrik_coverage_XXXXXX";
+        fd = mkstemp(path);
+        unlink(path);
+        std::vector<uint8_t> mem(TEST_MEM_SIZE, TEST_FILL_BYTE);
+        ASSERT_EQ(pwrite(fd, mem.data(), mem.size(), 0), TEST_MEM_SIZE);
+    }
+
+    void TearDown() { close(fd); }
+
+    uint8_t byte_at(uint64_t addr) {
+        uint8_t byte;
+        pread(fd, &byte, 1, addr);
+        return byte;
+    }
+
+    int fd;
+};
+
+TEST_F(CoverageTest, ArmHitDisarm) {
+    Coverage cov({0x10, 0x20, 0x30}, 0x40);
+
+    ASSERT_TRUE(cov.arm(fd));
+    EXPECT_EQ(byte_at(0x10), TRAP_BYTE);
+    EXPECT_EQ(byte_at(0x20), TRAP_BYTE);
+    EXPECT_EQ(byte_at(0x11), TEST_FILL_BYTE);
+
+    ASSERT_TRUE(cov.hit(fd, 0x20));
+    EXPECT_EQ(byte_at(0x20), TEST_FILL_BYTE);
+    // one-shot: the second hit is not ours
+    ASSERT_FALSE(cov.hit(fd, 0x20));
+    ASSERT_FALSE(cov.hit(fd, 0x21));
+    EXPECT_EQ(cov.covered(), 1);
+
+    ASSERT_TRUE(cov.disarm(fd));
+    EXPECT_EQ(byte_at(0x10), TEST_FILL_BYTE);
+    EXPECT_EQ(byte_at(0x30), TEST_FILL_BYTE);
+}
+
+TEST_F(CoverageTest, FarBlocksArePatched) {
+    Coverage cov({0x100, 0x100 + 2 * COVERAGE_MAX_GAP},
+                 0x200 + 2 * COVERAGE_MAX_GAP);
+
+    ASSERT_TRUE(cov.arm(fd));
+    EXPECT_EQ(byte_at(0x100), TRAP_BYTE);
+    EXPECT_EQ(byte_at(0x100 + 2 * COVERAGE_MAX_GAP), TRAP_BYTE);
+    EXPECT_EQ(byte_at(0x100 + COVERAGE_MAX_GAP), TEST_FILL_BYTE);
+}
+
+TEST_F(CoverageTest, Arm500kBlocksFast) {
+    std::vector<uint64_t> leaders;
+    for (uint64_t addr = 0; leaders.size() < 500000; addr += 8) {
+        leaders.push_back(addr);
+    }
+    Coverage cov(leaders, leaders.back() + 8);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(cov.arm(fd));
+    ASSERT_TRUE(cov.disarm(fd));
+    auto took = std::chrono::steady_clock::now() - start;
+
+    EXPECT_LT(took, std::chrono::milliseconds(500));
+    EXPECT_EQ(byte_at(0x8), TEST_FILL_BYTE);
+}
+
+TEST_F(CoverageTest, WriteDrcov) {
+    Coverage cov({0x1010, 0x1020, 0x1030}, 0x1040);
+    ASSERT_TRUE(cov.arm(fd));
+    ASSERT_TRUE(cov.hit(fd, 0x1020));
+
+    const char *path = "/tmp/debugrik_test.drcov";
+    ASSERT_TRUE(cov.write_drcov(path, "/bin/target", 0x1000, 0x2000));
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string output = ss.str();
+    unlink(path);
+
+    ASSERT_TRUE(output.find("DRCOV VERSION: 2\n") == 0);
+    ASSERT_TRUE(output.find("/bin/target\nBB Table: 1 bbs\n") !=
+                std::string::npos);
+    // start offset 0x20, size 0x10, module 0
+    std::string bb("\x20\x00\x00\x00\x10\x00\x00\x00", 8);
+    ASSERT_EQ(output.substr(output.size() - 8), bb);
+}
@@ -0,0 +1,188 @@
+#include "debugfile.hpp"
+#include <elf.h>
+#include <fstream>
+#include <ftw.h>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define TEST_DEBUG_INFO "debugrik debug info contents"
+
+/**
+ * @brief A section of a generated ELF file.
+ */
+struct test_section {
+    std::string name;
+    uint32_t type;
+    uint64_t flags;
+    std::vector<uint8_t> data;
+};
+
+/*
+    ELF files with just the sections the lookup looks at
+*/
+class DebugFileTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        char tmpl[] = "/tmp/debugrik_debugfile_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir = tmpl;
+    }
+
+    void TearDown() {
+        nftw(
+            dir.c_str(),
+            [](const char *path, const struct stat *, int, struct FTW *) {
+                return remove(path);
+            },
+            16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    static test_section build_id_note(uint8_t last_byte) {
+        std::vector<uint8_t> note(sizeof(Elf64_Nhdr) + 8);
+        Elf64_Nhdr nhdr = {4, 4, NT_GNU_BUILD_ID};
+        memcpy(note.data(), &nhdr, sizeof(nhdr));
+        memcpy(&note[sizeof(nhdr)], "GNU", 4);
+        uint8_t id[] = {0xde, 0xad, 0xbe, last_byte};
+        memcpy(&note[sizeof(nhdr) + 4], id, sizeof(id));
+        return {".note.gnu.build-id", SHT_NOTE, SHF_ALLOC, note};
+    }
+
+    static test_section debuglink(const char *name, uint32_t crc) {
+        std::vector<uint8_t> data((strlen(name) + 4) & ~3u);
+        memcpy(data.data(), name, strlen(name));
+        data.resize(data.size() + sizeof(crc));
+        memcpy(&data[data.size() - sizeof(crc)], &crc, sizeof(crc));
+        return {".gnu_debuglink", SHT_PROGBITS, 0, data};
+    }
+
+    static test_section debug_info(bool compressed) {
+        std::vector<uint8_t> data(TEST_DEBUG_INFO,
+                                  TEST_DEBUG_INFO + sizeof(TEST_DEBUG_INFO));
+        if (!compressed) {
+            return {".debug_info", SHT_PROGBITS, 0, data};
+        }
+        uLongf len = compressBound(data.size());
+        std::vector<uint8_t> out(sizeof(Elf64_Chdr) + len);
+        Elf64_Chdr chdr = {ELFCOMPRESS_ZLIB, 0, data.size(), 1};
+        memcpy(out.data(), &chdr, sizeof(chdr));
+        compress(&out[sizeof(chdr)], &len, data.data(), data.size());
+        out.resize(sizeof(chdr) + len);
+        return {".debug_info", SHT_PROGBITS, SHF_COMPRESSED, out};
+    }
+
+    std::string write_elf(const std::string &name,
+                          std::vector<test_section> sections) {
+        std::string names(1, '\0'), image(sizeof(Elf64_Ehdr), '\0');
+        std::vector<Elf64_Shdr> shdrs(1);
+        sections.push_back({".shstrtab", SHT_STRTAB, 0, {}});
+        for (auto &section: sections) {
+            Elf64_Shdr shdr = {};
+            shdr.sh_name = names.size();
+            shdr.sh_type = section.type;
+            shdr.sh_flags = section.flags;
+            shdr.sh_addralign = 1;
+            names += section.name + '\0';
+            if (section.type == SHT_STRTAB) {
+                section.data.assign(names.begin(), names.end());
+            }
+            shdr.sh_offset = image.size();
+            shdr.sh_size = section.data.size();
+            image.append(section.data.begin(), section.data.end());
+            shdrs.push_back(shdr);
+        }
+        image.resize((image.size() + 7) & ~7ul);
+
+        Elf64_Ehdr ehdr = {};
+        memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+        ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+        ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+        ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+        ehdr.e_type = ET_EXEC;
+        ehdr.e_machine = EM_X86_64;
+        ehdr.e_version = EV_CURRENT;
+        ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+        ehdr.e_shentsize = sizeof(Elf64_Shdr);
+        ehdr.e_shnum = shdrs.size();
+        ehdr.e_shstrndx = shdrs.size() - 1;
+        ehdr.e_shoff = image.size();
+        memcpy(&image[0], &ehdr, sizeof(ehdr));
+        image.append((const char *)shdrs.data(),
+                     shdrs.size() * sizeof(Elf64_Shdr));
+
+        std::string path = dir + "/" + name;
+        std::ofstream(path, std::ios::binary) << image;
+        return path;
+    }
+
+    std::string dir;
+};
+
+TEST_F(DebugFileTest, ReadsBuildIdAndLink) {
+    std::string exe = write_elf(
+        "prog", {build_id_note(0xef), debuglink("prog.debug", 0x12345678)});
+    debug_link_info info;
+    ASSERT_TRUE(read_debug_link_info(exe, info));
+    ASSERT_EQ(info.build_id, "deadbeef");
+    ASSERT_EQ(info.debuglink, "prog.debug");
+    ASSERT_EQ(info.crc, 0x12345678u);
+    ASSERT_FALSE(info.has_debug_info);
+    ASSERT_FALSE(read_debug_link_info(dir, info));
+}
+
+TEST_F(DebugFileTest, FindsByBuildId) {
+    std::string exe = write_elf("prog", {build_id_note(0xef)});
+    ASSERT_EQ(mkdir((dir + "/.build-id").c_str(), 0700), 0);
+    ASSERT_EQ(mkdir((dir + "/.build-id/de").c_str(), 0700), 0);
+
+    // Another build is not taken
+    write_elf(".build-id/de/adbeef.debug",
+              {build_id_note(0xee), debug_info(false)});
+    ASSERT_EQ(find_debug_file(exe, {dir}), "");
+
+    std::string debug = write_elf(".build-id/de/adbeef.debug",
+                                  {build_id_note(0xef), debug_info(false)});
+    ASSERT_EQ(find_debug_file(exe, {"/nonexistent", dir}), debug);
+    ASSERT_EQ(find_debug_file(debug, {dir}), debug);
+}
+
+TEST_F(DebugFileTest, FindsByDebuglinkCrc) {
+    std::string debug = write_elf("prog.dbg", {debug_info(false)});
+    uint32_t crc;
+    ASSERT_TRUE(file_crc32(debug, crc));
+
+    std::string exe = write_elf("prog", {debuglink("prog.dbg", crc + 1)});
+    ASSERT_EQ(find_debug_file(exe, {}), "");
+    exe = write_elf("prog", {debuglink("prog.dbg", crc)});
+    ASSERT_EQ(find_debug_file(exe, {}), debug);
+}
+
+TEST_F(DebugFileTest, DecompressesOncePerBuild) {
+    setenv("XDG_CACHE_HOME", dir.c_str(), 1);
+    std::string debug =
+        write_elf("prog.debug", {build_id_note(0xef), debug_info(true)});
+    debug_link_info info;
+    ASSERT_TRUE(read_debug_link_info(debug, info));
+    ASSERT_TRUE(info.compressed);
+
+    std::string cached = uncompressed_debug_file(debug);
+    ASSERT_EQ(cached, dir + "/debugrik/deadbeef.debug");
+    ASSERT_TRUE(read_debug_link_info(cached, info));
+    ASSERT_TRUE(info.has_debug_info);
+    ASSERT_FALSE(info.compressed);
+    std::ifstream in(cached, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    ASSERT_NE(contents.find(TEST_DEBUG_INFO), std::string::npos);
+
+    // The second session takes the copy as is
+    struct stat before, after;
+    ASSERT_EQ(stat(cached.c_str(), &before), 0);
+    ASSERT_EQ(uncompressed_debug_file(debug), cached);
+    ASSERT_EQ(stat(cached.c_str(), &after), 0);
+    ASSERT_EQ(before.st_ino, after.st_ino);
+    unsetenv("XDG_CACHE_HOME");
+}
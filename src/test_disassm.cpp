@@ -1,4 +1,6 @@
 #include "disassm.hpp"
+#include <algorithm>
+#include <cstring>
 #include <gtest/gtest.h>
 
 TEST(DisassmTest, ValidCodeDisassembly) {
@@ -58,3 +60,113 @@ TEST(DisassmTest, CurrInstructionIsCall) {
 
     ASSERT_NE(next_addr, nullptr);
 }
+
+TEST(DisassmTest, BlockLeadersOfLoop) {
+    Disassm disassm;
+
+    // 0x1000: xor eax, eax
+    // 0x1002: inc eax
+    // 0x1004: cmp eax, 10
+    // 0x1007: jne 0x1002
+    // 0x1009: call 0x100f
+    // 0x100e: ret
+    // 0x100f: ret
+    uint8_t code[] = {0x31, 0xc0, 0xff, 0xc0, 0x83, 0xf8, 0x0a, 0x75,
+                      0xf9, 0xe8, 0x01, 0x00, 0x00, 0x00, 0xc3, 0xc3};
+    std::vector<uint64_t> leaders;
+
+    disassm.find_block_leaders(code, sizeof(code), 0x1000, leaders);
+    std::sort(leaders.begin(), leaders.end());
+    leaders.erase(std::unique(leaders.begin(), leaders.end()), leaders.end());
+
+    std::vector<uint64_t> expected = {0x1000, 0x1002, 0x1009, 0x100e, 0x100f};
+    ASSERT_EQ(leaders, expected);
+}
+
+TEST(DisassmTest, DecodeMemoryWrite) {
+    Disassm disassm;
+    insn_info info;
+
+    // mov qword ptr [rbp - 8], rax
+    uint8_t store[] = {0x48, 0x89, 0x45, 0xf8, 0x90};
+    ASSERT_TRUE(disassm.decode(store, sizeof(store), 0x1000, info));
+    ASSERT_EQ(info.size, 4);
+    ASSERT_EQ(info.mem_size, 8);
+    ASSERT_EQ(info.mem_base, X86_REG_RBP);
+    ASSERT_EQ(info.mem_index, X86_REG_INVALID);
+    ASSERT_EQ(info.mem_disp, -8);
+
+    // mov rax, qword ptr [rbp - 8]
+    uint8_t load[] = {0x48, 0x8b, 0x45, 0xf8};
+    ASSERT_TRUE(disassm.decode(load, sizeof(load), 0x1000, info));
+    ASSERT_EQ(info.size, 4);
+    ASSERT_EQ(info.mem_size, 0);
+}
+
+TEST(DisassmTest, DecodeBranches) {
+    Disassm disassm;
+    insn_info info;
+
+    // call 0x1100
+    uint8_t call[] = {0xe8, 0xfb, 0x00, 0x00, 0x00};
+    ASSERT_TRUE(disassm.decode(call, sizeof(call), 0x1000, info));
+    ASSERT_TRUE(info.branch);
+    ASSERT_EQ(info.target, 0x1100u);
+
+    // jmp rax
+    uint8_t jmp[] = {0xff, 0xe0};
+    ASSERT_TRUE(disassm.decode(jmp, sizeof(jmp), 0x1000, info));
+    ASSERT_TRUE(info.branch);
+    ASSERT_EQ(info.target, 0u);
+
+    // rep movsb byte ptr [rdi], byte ptr [rsi]
+    uint8_t movs[] = {0xf3, 0xa4};
+    ASSERT_TRUE(disassm.decode(movs, sizeof(movs), 0x1000, info));
+    ASSERT_FALSE(info.branch);
+    ASSERT_TRUE(info.rep);
+}
+
+TEST(DisassmTest, RelocateRipRelative) {
+    Disassm disassm;
+    displaced_insn insn;
+
+    // lea rax, [rip + 0x10]
+    uint8_t lea[] = {0x48, 0x8d, 0x05, 0x10, 0x00, 0x00, 0x00};
+    ASSERT_TRUE(disassm.relocate(lea, sizeof(lea), 0x401000, 0x400000, insn));
+    ASSERT_EQ(insn.size, sizeof(lea));
+    ASSERT_TRUE(insn.relative);
+    ASSERT_FALSE(insn.call);
+    int32_t disp;
+    memcpy(&disp, insn.code + 3, sizeof(disp));
+    ASSERT_EQ(disp, 0x1010);
+
+    // Out of reach of a 32-bit displacement
+    ASSERT_FALSE(
+        disassm.relocate(lea, sizeof(lea), 0x7f0000000000, 0x400000, insn));
+}
+
+TEST(DisassmTest, RelocateBranches) {
+    Disassm disassm;
+    displaced_insn insn;
+
+    // call 0x1100, copied as is
+    uint8_t call[] = {0xe8, 0xfb, 0x00, 0x00, 0x00};
+    ASSERT_TRUE(disassm.relocate(call, sizeof(call), 0x1000, 0x9000, insn));
+    ASSERT_TRUE(insn.call);
+    ASSERT_TRUE(insn.relative);
+    ASSERT_EQ(memcmp(insn.code, call, sizeof(call)), 0);
+
+    // ret and jmp rax leave rip absolute
+    uint8_t ret[] = {0xc3};
+    ASSERT_TRUE(disassm.relocate(ret, sizeof(ret), 0x1000, 0x9000, insn));
+    ASSERT_FALSE(insn.relative);
+    uint8_t jmp_rax[] = {0xff, 0xe0};
+    ASSERT_TRUE(
+        disassm.relocate(jmp_rax, sizeof(jmp_rax), 0x1000, 0x9000, insn));
+    ASSERT_FALSE(insn.relative);
+
+    // syscall is not displaced
+    uint8_t syscall[] = {0x0f, 0x05};
+    ASSERT_FALSE(
+        disassm.relocate(syscall, sizeof(syscall), 0x1000, 0x9000, insn));
+}
@@ -0,0 +1,184 @@
+#include "dwarfinfo.hpp"
+#include "elfinfo.hpp"
+#include "stats.hpp"
+#include "target.hpp"
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/ptrace.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define TEST_CACHE_TEMPLATE "/tmp/debugrik_scale_XXXXXX"
+#define TEST_SAMPLES 2000
+#define TEST_LOCALS_SAMPLES 200
+
+// Budgets, per compile unit where the cost grows with the binary, so they
+// hold at any DEBUGRIK_STRESS_UNITS
+#define BUDGET_BUILD_BASE_US 500000
+#define BUDGET_BUILD_UNIT_US 5000
+#define BUDGET_LOAD_BASE_US 50000
+#define BUDGET_LOAD_UNIT_US 50
+#define BUDGET_RSS_BASE_KB (64 * 1024)
+#define BUDGET_RSS_UNIT_KB 256
+#define BUDGET_FUNCTION_US 20
+#define BUDGET_LINE_US 20
+#define BUDGET_LOCALS_US 5000
+
+/*
+    The stress binary is generated by dwarfgen at build time, its size is
+    set by DWARF_STRESS_UNITS and DWARF_STRESS_FUNCTIONS. The index is built
+    once for the suite into an empty cache, the tests share it.
+*/
+class DwarfScaleTest : public ::testing::Test {
+  protected:
+    static void SetUpTestSuite() {
+        char dir[] = TEST_CACHE_TEMPLATE;
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        cache_dir = dir;
+        setenv("XDG_CACHE_HOME", cache_dir.c_str(), 1);
+
+        // A stopped process for local resolution, rbp is 0 right after exec
+        // so values are not read, only the DIEs are walked
+        pid = fork();
+        if (pid == 0) {
+            ptrace(PTRACE_TRACEME, 0, 0, 0);
+            execl(DWARF_STRESS_BINARY, DWARF_STRESS_BINARY, nullptr);
+            _exit(127);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFSTOPPED(status));
+        live = new LiveTarget(pid);
+
+        ElfInfo elf(DWARF_STRESS_BINARY);
+        for (auto &sym: elf.functions()) {
+            if (sym.name.find("fn_") != std::string::npos) {
+                functions.push_back(sym);
+            }
+        }
+
+        struct rusage before, after;
+        getrusage(RUSAGE_SELF, &before);
+        uint64_t start = stats_now();
+        info = new DwarfInfo(DWARF_STRESS_BINARY, live);
+        info->start_indexing();
+        std::string file;
+        uint32_t line;
+        info->find_line(functions[0].addr, file, line);
+        build_us = (stats_now() - start) / 1000;
+        getrusage(RUSAGE_SELF, &after);
+        rss_kb = after.ru_maxrss - before.ru_maxrss;
+
+        // A second session maps the saved index
+        start = stats_now();
+        DwarfInfo cached(DWARF_STRESS_BINARY, live);
+        cached.find_line(functions[0].addr, file, line);
+        load_us = (stats_now() - start) / 1000;
+    }
+
+    static void TearDownTestSuite() {
+        delete info;
+        delete live;
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        unsetenv("XDG_CACHE_HOME");
+        std::string rm = "rm -rf " + cache_dir;
+        system(rm.c_str());
+    }
+
+    /**
+     * @brief Returns every n-th function, up to `count` of them.
+     */
+    static std::vector<elf_symbol> sample(size_t count) {
+        std::vector<elf_symbol> out;
+        size_t step = std::max<size_t>(functions.size() / count, 1);
+        for (size_t i = 0; i < functions.size() && out.size() < count;
+             i += step) {
+            out.push_back(functions[i]);
+        }
+        return out;
+    }
+
+    static std::string cache_dir;
+    static pid_t pid;
+    static LiveTarget *live;
+    static DwarfInfo *info;
+    static std::vector<elf_symbol> functions;
+    static uint64_t build_us, load_us;
+    static long rss_kb;
+};
+
+std::string DwarfScaleTest::cache_dir;
+pid_t DwarfScaleTest::pid;
+LiveTarget *DwarfScaleTest::live;
+DwarfInfo *DwarfScaleTest::info;
+std::vector<elf_symbol> DwarfScaleTest::functions;
+uint64_t DwarfScaleTest::build_us, DwarfScaleTest::load_us;
+long DwarfScaleTest::rss_kb;
+
+TEST_F(DwarfScaleTest, IndexBuildWithinBudget) {
+    ASSERT_EQ(functions.size(),
+              (size_t)DWARF_STRESS_UNITS * DWARF_STRESS_FUNCTIONS);
+    RecordProperty("build_us", std::to_string(build_us));
+    RecordProperty("rss_kb", std::to_string(rss_kb));
+    EXPECT_LE(build_us,
+              BUDGET_BUILD_BASE_US + BUDGET_BUILD_UNIT_US * DWARF_STRESS_UNITS);
+    EXPECT_LE(rss_kb,
+              BUDGET_RSS_BASE_KB + BUDGET_RSS_UNIT_KB * DWARF_STRESS_UNITS);
+}
+
+TEST_F(DwarfScaleTest, CachedIndexLoadWithinBudget) {
+    RecordProperty("load_us", std::to_string(load_us));
+    EXPECT_LE(load_us,
+              BUDGET_LOAD_BASE_US + BUDGET_LOAD_UNIT_US * DWARF_STRESS_UNITS);
+}
+
+TEST_F(DwarfScaleTest, FunctionLookupWithinBudget) {
+    std::vector<elf_symbol> funcs = sample(TEST_SAMPLES);
+    uint64_t start = stats_now();
+    for (auto &sym: funcs) {
+        std::string name;
+        Dwarf_Addr low_pc, high_pc;
+        info->get_function_by_rip(sym.addr + 1, name, low_pc, high_pc);
+        ASSERT_NE(sym.name.find(name), std::string::npos) << sym.name;
+        ASSERT_EQ(low_pc, sym.addr);
+    }
+    uint64_t per_lookup = (stats_now() - start) / 1000 / funcs.size();
+    RecordProperty("function_us", std::to_string(per_lookup));
+    EXPECT_LE(per_lookup, BUDGET_FUNCTION_US);
+}
+
+TEST_F(DwarfScaleTest, LineLookupWithinBudget) {
+    std::vector<elf_symbol> funcs = sample(TEST_SAMPLES);
+    uint64_t start = stats_now();
+    for (auto &sym: funcs) {
+        std::string file;
+        uint32_t line;
+        ASSERT_TRUE(info->find_line(sym.addr, file, line)) << sym.name;
+        ASSERT_NE(file.find("unit_"), std::string::npos);
+        ASSERT_GT(line, 0u);
+    }
+    uint64_t per_lookup = (stats_now() - start) / 1000 / funcs.size();
+    RecordProperty("line_us", std::to_string(per_lookup));
+    EXPECT_LE(per_lookup, BUDGET_LINE_US);
+}
+
+TEST_F(DwarfScaleTest, LocalsWithinBudget) {
+    std::vector<elf_symbol> funcs = sample(TEST_LOCALS_SAMPLES);
+    uint64_t start = stats_now();
+    for (auto &sym: funcs) {
+        std::string name;
+        Dwarf_Addr low_pc, high_pc;
+        info->get_function_by_rip(sym.addr, name, low_pc, high_pc);
+        auto locals = info->get_local_vars((char *)name.c_str());
+        ASSERT_EQ(locals.count("local_a"), 1u) << name;
+        ASSERT_EQ(locals.count("total"), 1u) << name;
+    }
+    uint64_t per_lookup = (stats_now() - start) / 1000 / funcs.size();
+    RecordProperty("locals_us", std::to_string(per_lookup));
+    EXPECT_LE(per_lookup, BUDGET_LOCALS_US);
+}
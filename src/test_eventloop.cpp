@@ -0,0 +1,178 @@
+#include "eventloop.hpp"
+#include <gtest/gtest.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+/**
+ * @brief Forks a child that sleeps until killed.
+ */
+static pid_t fork_sleeper() {
+    pid_t pid = fork();
+    if (pid == 0) {
+        EventLoop::restore_signals();
+        for (;;) {
+            pause();
+        }
+    }
+    return pid;
+}
+
+class EventLoopTest : public ::testing::Test {
+  protected:
+    void SetUp() { ASSERT_EQ(pipe(fds), 0); }
+
+    void TearDown() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    int fds[2];
+};
+
+TEST_F(EventLoopTest, ReadsLines) {
+    EventLoop loop(fds[0]);
+    const char text[] = "b 401000\n\nx 7ffc 2\nexit";
+    ASSERT_EQ(write(fds[1], text, strlen(text)), strlen(text));
+    close(fds[1]);
+    fds[1] = -1;
+
+    loop_event event;
+    std::vector<std::string> lines;
+    for (loop.next_event(event); event.type == EVENT_LINE;
+         loop.next_event(event)) {
+        lines.push_back(event.line);
+    }
+    ASSERT_EQ(event.type, EVENT_EOF);
+    ASSERT_EQ(lines, std::vector<std::string>(
+                         {"b 401000", "", "x 7ffc 2", "exit"}));
+}
+
+TEST_F(EventLoopTest, InterruptIsForwarded) {
+    EventLoop loop(fds[0]);
+    pid_t pid = fork_sleeper();
+    loop.watch(pid);
+
+    // Not from the terminal, so the waited process gets it
+    kill(getpid(), SIGINT);
+    int status;
+    ASSERT_EQ(loop.wait_process(pid, &status), pid);
+    ASSERT_TRUE(WIFSIGNALED(status));
+    ASSERT_EQ(WTERMSIG(status), SIGINT);
+}
+
+TEST_F(EventLoopTest, ReportsExitsWhileWaitingForInput) {
+    EventLoop loop(fds[0]);
+    pid_t pid = fork_sleeper();
+    loop.watch(pid);
+    kill(pid, SIGKILL);
+
+    loop_event event;
+    loop.next_event(event);
+    ASSERT_EQ(event.type, EVENT_EXIT);
+    ASSERT_EQ(event.pid, pid);
+    ASSERT_TRUE(WIFSIGNALED(event.status));
+
+    // SIGINT at the prompt is an event as well
+    kill(getpid(), SIGINT);
+    loop.next_event(event);
+    ASSERT_EQ(event.type, EVENT_INTERRUPT);
+}
+
+TEST_F(EventLoopTest, WaitDoesNotReapOtherChildren) {
+    EventLoop loop(fds[0]);
+    pid_t other = fork_sleeper(), waited = fork_sleeper();
+    loop.watch(other);
+    loop.watch(waited);
+    kill(other, SIGKILL);
+    // Give the first exit a chance to be noticed first
+    usleep(10000);
+    kill(waited, SIGKILL);
+
+    int status;
+    ASSERT_EQ(loop.wait_process(waited, &status), waited);
+    loop_event event;
+    loop.next_event(event);
+    ASSERT_EQ(event.type, EVENT_EXIT);
+    ASSERT_EQ(event.pid, other);
+}
+
+/**
+ * @brief Forks a traced child, its signals are ptrace stops.
+ */
+static pid_t fork_traced() {
+    pid_t pid = fork();
+    if (pid == 0) {
+        EventLoop::restore_signals();
+        ptrace(PTRACE_TRACEME, 0, 0, 0);
+        for (;;) {
+            pause();
+        }
+    }
+    return pid;
+}
+
+TEST_F(EventLoopTest, KeepsStopsOfOtherProcesses) {
+    EventLoop loop(fds[0]);
+    pid_t other = fork_traced();
+    // Exits on its own, so the stop comes while it is waited for
+    pid_t waited = fork();
+    if (waited == 0) {
+        usleep(100000);
+        _exit(0);
+    }
+    loop.watch(other);
+    loop.watch(waited);
+    usleep(10000);
+    kill(other, SIGUSR1);
+
+    int status;
+    ASSERT_EQ(loop.wait_process(waited, &status), waited);
+    ASSERT_TRUE(loop.ready());
+    loop_event event;
+    loop.next_event(event);
+    ASSERT_EQ(event.type, EVENT_STOP);
+    ASSERT_EQ(event.pid, other);
+    ASSERT_TRUE(WIFSTOPPED(event.status));
+    ASSERT_EQ(WSTOPSIG(event.status), SIGUSR1);
+
+    kill(other, SIGKILL);
+    ASSERT_EQ(loop.wait_process(other, &status), other);
+}
+
+TEST_F(EventLoopTest, WaitTakesKeptStop) {
+    EventLoop loop(fds[0]);
+    pid_t other = fork_traced(), waited = fork_sleeper();
+    loop.watch(other);
+    loop.watch(waited);
+    usleep(10000);
+    kill(other, SIGUSR1);
+    usleep(10000);
+    kill(waited, SIGKILL);
+
+    int status;
+    ASSERT_EQ(loop.wait_process(waited, &status), waited);
+    // The stop was consumed by the first wait, the second one gets it
+    ASSERT_EQ(loop.wait_process(other, &status), other);
+    ASSERT_TRUE(WIFSTOPPED(status));
+    ASSERT_EQ(WSTOPSIG(status), SIGUSR1);
+    ASSERT_FALSE(loop.ready());
+
+    kill(other, SIGKILL);
+    ASSERT_EQ(loop.wait_process(other, &status), other);
+}
+
+TEST_F(EventLoopTest, ready_with_buffered_lines) {
+    EventLoop loop(fds[0]);
+    ASSERT_FALSE(loop.ready());
+
+    // Both lines arrive in one read, the second one is buffered
+    ASSERT_EQ(write(fds[1], "a\nb\n", 4), 4);
+    loop_event event;
+    loop.next_event(event);
+    ASSERT_EQ(event.line, "a");
+    ASSERT_TRUE(loop.ready());
+    loop.next_event(event);
+    ASSERT_EQ(event.line, "b");
+    ASSERT_FALSE(loop.ready());
+}
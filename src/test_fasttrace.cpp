@@ -0,0 +1,120 @@
+#include "fasttrace.hpp"
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+
+typedef long (*traced_fn)(long, long, long);
+
+/*
+    Trampolines run in the test process itself: the recording code, a
+    relocated `mov rax, rdx` and a jump to a `ret`
+*/
+class FastTraceTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        page = (uint8_t *)mmap(nullptr, 0x1000,
+                               PROT_READ | PROT_WRITE | PROT_EXEC,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ASSERT_NE(page, MAP_FAILED);
+    }
+
+    void TearDown() { munmap(page, 0x1000); }
+
+    TraceRing *make_ring(size_t records) {
+        ring_mem = mmap(nullptr, fasttrace_ring_size(records),
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+                        -1, 0);
+        EXPECT_NE(ring_mem, MAP_FAILED);
+        return new TraceRing(ring_mem, records);
+    }
+
+    traced_fn make_trampoline(uint32_t id) {
+        std::vector<uint8_t> code;
+        fasttrace_record_code((uint64_t)ring_mem, id, code);
+        code.insert(code.end(), {0x48, 0x89, 0xd0});
+        fasttrace_jump_code((uint64_t)page + 0x800, code);
+        memcpy(page, code.data(), code.size());
+        page[0x800] = 0xc3;
+        return (traced_fn)page;
+    }
+
+    uint8_t *page;
+    void *ring_mem;
+};
+
+TEST_F(FastTraceTest, RecordsHits) {
+    TraceRing *ring = make_ring(16);
+    traced_fn fn = make_trampoline(7);
+
+    for (long i = 0; i < 3; i++) {
+        // rdx survives the recording code
+        ASSERT_EQ(fn(0x11, 0x22, i), i);
+    }
+    ASSERT_EQ(ring->drain(), 3u);
+    std::vector<fasttrace_record> records;
+    ring->take(records);
+    ASSERT_EQ(records.size(), 3u);
+    for (size_t i = 0; i < records.size(); i++) {
+        ASSERT_EQ(records[i].seq, i + 1);
+        ASSERT_EQ(records[i].id, 7u);
+        ASSERT_EQ(records[i].rdi, 0x11u);
+        ASSERT_EQ(records[i].rsi, 0x22u);
+        ASSERT_EQ(records[i].rdx, i);
+        ASSERT_NE(records[i].rsp, 0u);
+    }
+    ASSERT_GE(records[2].tsc, records[0].tsc);
+    ASSERT_EQ(ring->lost(), 0u);
+    delete ring;
+}
+
+TEST_F(FastTraceTest, CountsLappedRecords) {
+    TraceRing *ring = make_ring(4);
+    traced_fn fn = make_trampoline(1);
+
+    for (long i = 0; i < 6; i++) {
+        fn(i, 0, 0);
+    }
+    ASSERT_EQ(ring->drain(), 4u);
+    ASSERT_EQ(ring->lost(), 2u);
+    std::vector<fasttrace_record> records;
+    ring->take(records);
+    ASSERT_EQ(records.front().rdi, 2u);
+    ASSERT_EQ(records.back().rdi, 5u);
+    delete ring;
+}
+
+TEST_F(FastTraceTest, SkipsRecordBeingRewritten) {
+    TraceRing *ring = make_ring(4);
+    traced_fn fn = make_trampoline(3);
+
+    for (long i = 0; i < 4; i++) {
+        fn(i, 0, 0);
+    }
+    // The trampoline marks a reused slot before it writes the fields, here
+    // a fifth hit has just started on the first slot
+    auto *header = (fasttrace_ring_header *)ring_mem;
+    auto *slots = (fasttrace_record *)(header + 1);
+    header->head++;
+    slots[0].seq = 0;
+    slots[0].rdi = 0x55;
+
+    ASSERT_EQ(ring->drain(), 3u);
+    std::vector<fasttrace_record> records;
+    ring->take(records);
+    for (auto &record: records) {
+        ASSERT_NE(record.rdi, 0x55u);
+    }
+    delete ring;
+}
+
+TEST_F(FastTraceTest, DrainsInBackground) {
+    TraceRing *ring = make_ring(16);
+    traced_fn fn = make_trampoline(2);
+    ring->start();
+    fn(1, 2, 3);
+    ring->stop();
+    std::vector<fasttrace_record> records;
+    ring->take(records);
+    ASSERT_EQ(records.size(), 1u);
+    ASSERT_EQ(records[0].rdi, 1u);
+    delete ring;
+}
@@ -0,0 +1,63 @@
+#include "ftrace.hpp"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <unistd.h>
+
+#define TEST_TRACE_PATH "/tmp/debugrik_test_trace.json"
+
+static std::string read_file(const char *path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST(FtraceTest, MonotonicClockGoesForward) {
+    uint64_t a = monotonic_ns();
+    uint64_t b = monotonic_ns();
+    ASSERT_LE(a, b);
+}
+
+TEST(FtraceTest, EventsArePerThread) {
+    TraceBuffer trace;
+    trace.record(1, 0, FTRACE_ENTRY);
+    trace.record(2, 0, FTRACE_ENTRY);
+    trace.record(1, 0, FTRACE_EXIT);
+    ASSERT_EQ(trace.size(), 3);
+}
+
+TEST(FtraceTest, WriteChromeTrace) {
+    TraceBuffer trace;
+    trace.record(42, 1, FTRACE_ENTRY, 1500);
+    trace.record(42, 1, FTRACE_EXIT, 2000250);
+
+    ASSERT_TRUE(trace.write_chrome_trace(TEST_TRACE_PATH, 7, {"main", "foo"}));
+    std::string output = read_file(TEST_TRACE_PATH);
+    unlink(TEST_TRACE_PATH);
+
+    ASSERT_TRUE(output.find("{\"traceEvents\":[") == 0);
+    ASSERT_TRUE(output.find("{\"name\":\"foo\",\"ph\":\"B\",\"ts\":1.500,"
+                            "\"pid\":7,\"tid\":42}") != std::string::npos);
+    ASSERT_TRUE(output.find("{\"name\":\"foo\",\"ph\":\"E\",\"ts\":2000.250,"
+                            "\"pid\":7,\"tid\":42}") != std::string::npos);
+    ASSERT_TRUE(output.find("main") == std::string::npos);
+}
+
+TEST(FtraceTest, NamesAreEscaped) {
+    TraceBuffer trace;
+    trace.record(1, 0, FTRACE_ENTRY, 1000);
+
+    ASSERT_TRUE(trace.write_chrome_trace(TEST_TRACE_PATH, 1,
+                                         {"operator\"\"_km(char const*)"}));
+    std::string output = read_file(TEST_TRACE_PATH);
+    unlink(TEST_TRACE_PATH);
+
+    ASSERT_TRUE(output.find("{\"name\":\"operator\\\"\\\"_km(char const*)\","
+                            "\"ph\":\"B\"") != std::string::npos);
+}
+
+TEST(FtraceTest, WriteToBadPathFails) {
+    TraceBuffer trace;
+    ASSERT_FALSE(trace.write_chrome_trace("/k/a/c/trace.json", 1, {}));
+}
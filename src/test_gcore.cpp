@@ -0,0 +1,168 @@
+#include "gcore.hpp"
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/procfs.h>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_CORE_PATH "/tmp/debugrik_test.core"
+#define TEST_ZERO_SIZE (32 << 20)
+
+static char pattern[] = "debugrik core pattern";
+char test_zeros[TEST_ZERO_SIZE];
+
+/*
+    Only its address is used, a breakpoint is planted there in the child
+*/
+__attribute__((noinline)) int gcore_test_function(int x) { return x * 3; }
+
+/*
+    A stopped fork of the test has the same addresses as the test itself
+*/
+class GcoreTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        pid = fork();
+        if (pid == 0) {
+            ptrace(PTRACE_TRACEME, 0, 0, 0);
+            raise(SIGSTOP);
+            _exit(test_zeros[0]);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFSTOPPED(status));
+    }
+
+    void TearDown() {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        unlink(TEST_CORE_PATH);
+    }
+
+    std::vector<uint8_t> read_core() {
+        int fd = open(TEST_CORE_PATH, O_RDONLY);
+        struct stat st;
+        fstat(fd, &st);
+        std::vector<uint8_t> core(st.st_size);
+        pread(fd, core.data(), core.size(), 0);
+        close(fd);
+        return core;
+    }
+
+    pid_t pid;
+};
+
+TEST_F(GcoreTest, WritesMemoryAndNotes) {
+    CoreDump dump(pid);
+    ASSERT_TRUE(dump.add_thread(pid));
+    ASSERT_TRUE(dump.write(TEST_CORE_PATH, false));
+
+    std::vector<uint8_t> core = read_core();
+    auto *ehdr = (Elf64_Ehdr *)core.data();
+    ASSERT_EQ(memcmp(ehdr->e_ident, ELFMAG, SELFMAG), 0);
+    ASSERT_EQ(ehdr->e_type, ET_CORE);
+
+    auto *phdrs = (Elf64_Phdr *)(core.data() + ehdr->e_phoff);
+    bool found_pattern = false;
+    std::vector<uint32_t> note_types;
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        Elf64_Phdr &phdr = phdrs[i];
+        uint64_t addr = (uint64_t)pattern;
+        if (phdr.p_type == PT_LOAD && addr >= phdr.p_vaddr &&
+            addr + sizeof(pattern) <= phdr.p_vaddr + phdr.p_filesz) {
+            found_pattern =
+                memcmp(&core[phdr.p_offset + addr - phdr.p_vaddr], pattern,
+                       sizeof(pattern)) == 0;
+        }
+        if (phdr.p_type != PT_NOTE) {
+            continue;
+        }
+
+        size_t pos = phdr.p_offset;
+        while (pos < phdr.p_offset + phdr.p_filesz) {
+            auto *nhdr = (Elf64_Nhdr *)&core[pos];
+            size_t desc = pos + sizeof(*nhdr) + ((nhdr->n_namesz + 3) & ~3);
+            note_types.push_back(nhdr->n_type);
+            if (nhdr->n_type == NT_PRSTATUS) {
+                ASSERT_EQ(((struct elf_prstatus *)&core[desc])->pr_pid, pid);
+            }
+            pos = desc + ((nhdr->n_descsz + 3) & ~3);
+        }
+    }
+
+    ASSERT_TRUE(found_pattern);
+    ASSERT_EQ(note_types[0], NT_PRSTATUS);
+    ASSERT_NE(std::find(note_types.begin(), note_types.end(), NT_AUXV),
+              note_types.end());
+    ASSERT_NE(std::find(note_types.begin(), note_types.end(), NT_FILE),
+              note_types.end());
+    ASSERT_NE(std::find(note_types.begin(), note_types.end(), NT_FPREGSET),
+              note_types.end());
+}
+
+TEST_F(GcoreTest, ZeroPagesAreHoles) {
+    CoreDump dump(pid);
+    ASSERT_TRUE(dump.add_thread(pid));
+    ASSERT_TRUE(dump.write(TEST_CORE_PATH, false));
+
+    struct stat st;
+    ASSERT_EQ(stat(TEST_CORE_PATH, &st), 0);
+    ASSERT_GE(dump.dumped(), TEST_ZERO_SIZE);
+    ASSERT_LE(dump.written() + TEST_ZERO_SIZE, dump.dumped());
+    ASSERT_LT((uint64_t)st.st_blocks * 512, (uint64_t)st.st_size);
+}
+
+TEST_F(GcoreTest, SkipReadOnlyFileMappings) {
+    CoreDump full(pid);
+    ASSERT_TRUE(full.add_thread(pid));
+    ASSERT_TRUE(full.write(TEST_CORE_PATH, false));
+
+    CoreDump lite(pid);
+    ASSERT_TRUE(lite.add_thread(pid));
+    ASSERT_TRUE(lite.write(TEST_CORE_PATH, true));
+
+    ASSERT_LT(lite.dumped(), full.dumped());
+}
+
+TEST_F(GcoreTest, BreakpointsShowOriginalBytes) {
+    uint64_t addr = (uint64_t)&gcore_test_function;
+    errno = 0;
+    long data = ptrace(PTRACE_PEEKTEXT, pid, addr, 0);
+    ASSERT_EQ(errno, 0);
+    ASSERT_NE(data & 0xff, 0xcc);
+    long trapped = (data & ~0xffL) | 0xcc;
+    ASSERT_EQ(ptrace(PTRACE_POKETEXT, pid, addr, trapped), 0);
+
+    CoreDump dump(pid);
+    ASSERT_TRUE(dump.add_thread(pid));
+    dump.add_shadow(addr, (uint8_t)data);
+    ASSERT_TRUE(dump.write(TEST_CORE_PATH, false));
+
+    std::vector<uint8_t> core = read_core();
+    auto *ehdr = (Elf64_Ehdr *)core.data();
+    auto *phdrs = (Elf64_Phdr *)(core.data() + ehdr->e_phoff);
+    bool found = false;
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        Elf64_Phdr &phdr = phdrs[i];
+        if (phdr.p_type == PT_LOAD && addr >= phdr.p_vaddr &&
+            addr + sizeof(data) <= phdr.p_vaddr + phdr.p_filesz) {
+            ASSERT_EQ(memcmp(&core[phdr.p_offset + addr - phdr.p_vaddr],
+                             &data, sizeof(data)),
+                      0);
+            found = true;
+        }
+    }
+    ASSERT_TRUE(found);
+}
+
+TEST_F(GcoreTest, BadPathFails) {
+    CoreDump dump(pid);
+    ASSERT_TRUE(dump.add_thread(pid));
+    ASSERT_FALSE(dump.write("/k/a/c/core", false));
+}
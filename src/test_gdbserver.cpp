@@ -0,0 +1,370 @@
+#include "gdbserver.hpp"
+#include "rsp.hpp"
+
+#include <functional>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+static volatile uint64_t watched;
+
+__attribute__((noinline)) static void bump() {
+    watched++;
+    asm volatile("" ::: "memory");
+}
+
+/**
+ * @brief Reads reply payloads until `count` of them came.
+ */
+static std::vector<std::string> read_replies(int fd, size_t count) {
+    std::vector<std::string> replies;
+    std::string input, packet;
+    while (replies.size() < count) {
+        rsp_input got = rsp_next(input, packet);
+        if (got == RSP_PACKET) {
+            replies.push_back(packet);
+            continue;
+        }
+        if (got != RSP_NONE) {
+            continue;
+        }
+        char buf[4096];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0) {
+            replies.push_back("<closed>");
+            break;
+        }
+        input.append(buf, n);
+    }
+    return replies;
+}
+
+/**
+ * @brief A stand-in for gdb: sends a packet and returns the reply payload.
+ */
+static std::string request(int fd, const std::string &payload) {
+    std::string frame;
+    rsp_frame(payload, frame);
+    if (write(fd, frame.data(), frame.size()) != (ssize_t)frame.size()) {
+        return "<write failed>";
+    }
+    return read_replies(fd, 1)[0];
+}
+
+/**
+ * @brief Returns the little endian hex of a value as in packets.
+ */
+static std::string le_hex(uint64_t value) {
+    std::string out;
+    rsp_hex((const uint8_t *)&value, sizeof(value), out);
+    return out;
+}
+
+/**
+ * @brief Forks a child that stops under ptrace and then runs `body`.
+ *
+ * SIGCHLD is blocked first, the server takes it from a signalfd.
+ *
+ * @param body The code of the child, it exits with 0 when `body` returns.
+ * @param mask Filled with the blocked signals.
+ * @param status Filled with the wait status of the stop.
+ * @return The process ID of the child.
+ */
+static pid_t fork_stopped(const std::function<void()> &body, sigset_t &mask,
+                          int &status) {
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, 0, 0);
+        raise(SIGSTOP);
+        body();
+        _exit(0);
+    }
+    waitpid(pid, &status, 0);
+    return pid;
+}
+
+TEST(GdbServerTestSuite, serves_scripted_session) {
+    sigset_t mask;
+    int status;
+    pid_t pid = fork_stopped(
+        [] {
+            for (int i = 0; i < 3; i++) {
+                bump();
+            }
+            _exit(7);
+        },
+        mask, status);
+    ASSERT_TRUE(WIFSTOPPED(status));
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::vector<std::string> replies;
+    uint64_t bump_addr = (uint64_t)&bump, watched_addr = (uint64_t)&watched;
+    char addr[64];
+
+    // The tracer is this thread, so gdb is played by another one
+    std::thread client([&] {
+        replies.push_back(request(fds[1], "qSupported:swbreak+"));
+        replies.push_back(request(fds[1], "QStartNoAckMode"));
+        replies.push_back(request(fds[1], "g"));
+        snprintf(addr, sizeof(addr), "%lx", bump_addr);
+        replies.push_back(request(fds[1], std::string("Z0,") + addr + ",1"));
+        replies.push_back(request(fds[1], "vCont;c"));
+        replies.push_back(request(fds[1], std::string("m") + addr + ",1"));
+        replies.push_back(request(fds[1], std::string("z0,") + addr + ",1"));
+        snprintf(addr, sizeof(addr), "%lx", watched_addr);
+        replies.push_back(request(fds[1], std::string("M") + addr + ",8:" +
+                                              le_hex(0x100)));
+        replies.push_back(request(fds[1], std::string("m") + addr + ",8"));
+        replies.push_back(
+            request(fds[1], "qXfer:features:read:target.xml:0,15"));
+        replies.push_back(request(fds[1], "qXfer:threads:read::0,1000"));
+        replies.push_back(request(fds[1], "qXfer:libraries:read::0,10000"));
+        replies.push_back(request(fds[1], "vCont;c"));
+        close(fds[1]);
+    });
+
+    GdbServer server(pid);
+    server.serve(fds[0], status);
+    close(fds[0]);
+    client.join();
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+
+    ASSERT_EQ(replies.size(), 13u);
+    ASSERT_NE(replies[0].find("PacketSize=40000"), std::string::npos);
+    ASSERT_NE(replies[0].find("qXfer:features:read+"), std::string::npos);
+    ASSERT_EQ(replies[1], "OK");
+    ASSERT_EQ(replies[2].size(), 2u * RSP_REGS_SIZE);
+    ASSERT_EQ(replies[3], "OK");
+
+    // The breakpoint stop reports the address of the breakpoint
+    ASSERT_EQ(replies[4].substr(0, 3), "T05");
+    ASSERT_NE(replies[4].find("10:" + le_hex(bump_addr)), std::string::npos);
+    ASSERT_NE(replies[4].find("swbreak:;"), std::string::npos);
+    // The trap is hidden from memory reads
+    ASSERT_NE(replies[5], "cc");
+    ASSERT_EQ(replies[6], "OK");
+
+    ASSERT_EQ(replies[7], "OK");
+    ASSERT_EQ(replies[8], le_hex(0x100));
+    ASSERT_EQ(replies[9], "m<?xml version=\"1.0\"?>");
+    ASSERT_NE(replies[10].find("<thread id=\""), std::string::npos);
+    ASSERT_EQ(replies[11].substr(0, 15), "l<library-list>");
+    ASSERT_NE(replies[11].find("libc"), std::string::npos);
+
+    ASSERT_EQ(replies[12], "W07");
+}
+
+TEST(GdbServerTestSuite, watchpoint_reports_address) {
+    sigset_t mask;
+    int status;
+    pid_t pid = fork_stopped(bump, mask, status);
+    ASSERT_TRUE(WIFSTOPPED(status));
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::vector<std::string> replies;
+    char addr[64];
+    snprintf(addr, sizeof(addr), "%lx", (uint64_t)&watched);
+
+    std::thread client([&] {
+        replies.push_back(request(fds[1], std::string("Z2,") + addr + ",8"));
+        replies.push_back(request(fds[1], "c"));
+        replies.push_back(request(fds[1], std::string("z2,") + addr + ",8"));
+        replies.push_back(request(fds[1], "k"));
+        close(fds[1]);
+    });
+
+    GdbServer server(pid);
+    server.serve(fds[0], status);
+    close(fds[0]);
+    client.join();
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+
+    ASSERT_EQ(replies[0], "OK");
+    ASSERT_EQ(replies[1].substr(0, 3), "T05");
+    ASSERT_NE(replies[1].find(std::string("watch:") + addr + ";"),
+              std::string::npos);
+    ASSERT_EQ(replies[2], "OK");
+    ASSERT_EQ(replies[3], "<closed>");
+}
+
+TEST(GdbServerTestSuite, step_past_breakpoint_keeps_rip) {
+    // jmp over the nop with the breakpoint, the step lands right past it
+    static const uint8_t code[] = {0xeb, 0x01, 0x90, 0x90, 0xc3};
+    uint8_t *page = (uint8_t *)mmap(nullptr, 0x1000,
+                                    PROT_READ | PROT_WRITE | PROT_EXEC,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(page, MAP_FAILED);
+    memcpy(page, code, sizeof(code));
+
+    sigset_t mask;
+    int status;
+    pid_t pid = fork_stopped([page] { ((void (*)())page)(); }, mask, status);
+    ASSERT_TRUE(WIFSTOPPED(status));
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::vector<std::string> replies;
+    char start[64], nop[64];
+    snprintf(start, sizeof(start), "%lx", (uint64_t)page);
+    snprintf(nop, sizeof(nop), "%lx", (uint64_t)page + 2);
+
+    std::thread client([&] {
+        request(fds[1], "qSupported:swbreak+");
+        replies.push_back(request(fds[1], std::string("Z0,") + start + ",1"));
+        replies.push_back(request(fds[1], "vCont;c"));
+        replies.push_back(request(fds[1], std::string("z0,") + start + ",1"));
+        replies.push_back(request(fds[1], std::string("Z0,") + nop + ",1"));
+        replies.push_back(request(fds[1], "vCont;s"));
+        replies.push_back(request(fds[1], "k"));
+        close(fds[1]);
+    });
+
+    GdbServer server(pid);
+    server.serve(fds[0], status);
+    close(fds[0]);
+    client.join();
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+    munmap(page, 0x1000);
+
+    ASSERT_NE(replies[1].find("10:" + le_hex((uint64_t)page)),
+              std::string::npos);
+    ASSERT_NE(replies[1].find("swbreak:;"), std::string::npos);
+    // The step is not a hit of the breakpoint just before the new rip
+    ASSERT_EQ(replies[4].substr(0, 3), "T05");
+    ASSERT_NE(replies[4].find("10:" + le_hex((uint64_t)page + 3)),
+              std::string::npos);
+    ASSERT_EQ(replies[4].find("swbreak"), std::string::npos);
+}
+
+TEST(GdbServerTestSuite, runs_dynamic_target_past_loader) {
+    sigset_t mask;
+    int status;
+    pid_t pid = fork_stopped(
+        [] {
+            execl("/bin/true", "/bin/true", nullptr);
+            _exit(127);
+        },
+        mask, status);
+    ASSERT_TRUE(WIFSTOPPED(status));
+    // Stopped at exec, before ld.so has mapped any library
+    ASSERT_EQ(ptrace(PTRACE_CONT, pid, 0, 0), 0);
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFSTOPPED(status));
+    ASSERT_EQ(WSTOPSIG(status), SIGTRAP);
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::vector<std::string> replies;
+
+    std::thread client([&] {
+        replies.push_back(request(fds[1], "qXfer:libraries:read::0,10000"));
+        replies.push_back(request(fds[1], "vCont;c"));
+        close(fds[1]);
+    });
+
+    GdbServer server(pid);
+    server.serve(fds[0], status);
+    close(fds[0]);
+    client.join();
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+
+    ASSERT_EQ(replies[0].substr(0, 15), "l<library-list>");
+    ASSERT_EQ(replies[0].find("libc"), std::string::npos);
+    // Loading the libraries raises no stop the client did not ask for
+    ASSERT_EQ(replies[1], "W00");
+}
+
+TEST(GdbServerTestSuite, keeps_packets_sent_while_running) {
+    sigset_t mask;
+    int status;
+    pid_t pid = fork_stopped(
+        [] {
+            usleep(100000);
+            bump();
+        },
+        mask, status);
+    ASSERT_TRUE(WIFSTOPPED(status));
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::vector<std::string> replies;
+    char addr[64];
+    snprintf(addr, sizeof(addr), "%lx", (uint64_t)&bump);
+
+    std::thread client([&] {
+        replies.push_back(request(fds[1], std::string("Z0,") + addr + ",1"));
+        std::string cont, read_mem;
+        rsp_frame("c", cont);
+        write(fds[1], cont.data(), cont.size());
+        // The read arrives while the process runs and waits for the stop
+        usleep(20000);
+        rsp_frame(std::string("m") + addr + ",1", read_mem);
+        write(fds[1], read_mem.data(), read_mem.size());
+        for (auto &reply: read_replies(fds[1], 2)) {
+            replies.push_back(reply);
+        }
+        replies.push_back(request(fds[1], "k"));
+        close(fds[1]);
+    });
+
+    GdbServer server(pid);
+    server.serve(fds[0], status);
+    close(fds[0]);
+    client.join();
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+
+    ASSERT_EQ(replies.size(), 4u);
+    ASSERT_EQ(replies[0], "OK");
+    ASSERT_EQ(replies[1].substr(0, 3), "T05");
+    ASSERT_EQ(replies[2].size(), 2u);
+    ASSERT_NE(replies[2], "cc");
+}
+
+TEST(GdbServerTestSuite, no_ack_mode_drops_bad_packets) {
+    sigset_t mask;
+    int status;
+    pid_t pid = fork_stopped([] {}, mask, status);
+    ASSERT_TRUE(WIFSTOPPED(status));
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::string no_ack, raw;
+
+    std::thread client([&] {
+        no_ack = request(fds[1], "QStartNoAckMode");
+        // A wrong checksum followed by a good packet
+        std::string frames = "$g#00";
+        rsp_frame("?", frames);
+        write(fds[1], frames.data(), frames.size());
+        char buf[4096];
+        ssize_t n = read(fds[1], buf, sizeof(buf));
+        if (n > 0) {
+            raw.assign(buf, n);
+        }
+        request(fds[1], "k");
+        close(fds[1]);
+    });
+
+    GdbServer server(pid);
+    server.serve(fds[0], status);
+    close(fds[0]);
+    client.join();
+    sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+
+    ASSERT_EQ(no_ack, "OK");
+    ASSERT_FALSE(raw.empty());
+    ASSERT_EQ(raw[0], '$');
+    ASSERT_EQ(raw.find('-'), std::string::npos);
+}
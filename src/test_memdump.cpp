@@ -0,0 +1,117 @@
+#include "memdump.hpp"
+#include <elf.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TEST_DUMP_PATH "/tmp/debugrik_test_dump"
+
+/**
+ * @brief Reads a whole file.
+ */
+static std::string read_file(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+class MemDumpTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        page_size = sysconf(_SC_PAGESIZE);
+        // Three pages with an inaccessible one in the middle
+        area = (uint8_t *)mmap(nullptr, 3 * page_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        ASSERT_NE(area, MAP_FAILED);
+        for (size_t i = 0; i < 3 * page_size; i++) {
+            area[i] = i * 7;
+        }
+        mprotect(area + page_size, page_size, PROT_NONE);
+    }
+
+    void TearDown() {
+        munmap(area, 3 * page_size);
+        unlink(TEST_DUMP_PATH);
+    }
+
+    size_t page_size;
+    uint8_t *area;
+};
+
+TEST(MemDumpFormatTest, Lines) {
+    char line[MEMDUMP_HEX_LINE_MAX];
+    uint8_t data[] = {'A', 0x00, 0xff};
+    size_t len = format_hex_line(0x401000, data, sizeof(data), line);
+    ASSERT_EQ(std::string(line, len),
+              "0000000000401000: 41 00 ff " + std::string(13 * 3, ' ') +
+                  " A..\n");
+
+    char qline[MEMDUMP_QWORD_LINE_MAX];
+    uint64_t qwords[] = {0xcafebabe, UINT64_MAX};
+    len = format_qword_line(0x7ffd1000, qwords, 2, qline);
+    ASSERT_EQ(std::string(qline, len),
+              "0x7ffd1000: 00000000cafebabe ffffffffffffffff\n");
+    len = format_qword_line(0, qwords, 1, qline);
+    ASSERT_EQ(std::string(qline, len), "0x0: 00000000cafebabe\n");
+
+    dump_format format;
+    ASSERT_TRUE(parse_dump_format("elf", format));
+    ASSERT_EQ(format, DUMP_ELF);
+    ASSERT_FALSE(parse_dump_format("txt", format));
+}
+
+TEST_F(MemDumpTest, RawSkipsHoles) {
+    MemDump dump(getpid());
+    ASSERT_TRUE(dump.write(TEST_DUMP_PATH, (uint64_t)area, 3 * page_size,
+                           DUMP_RAW));
+    ASSERT_EQ(dump.copied(), 2 * page_size);
+
+    std::string data = read_file(TEST_DUMP_PATH);
+    ASSERT_EQ(data.size(), 3 * page_size);
+    ASSERT_EQ(memcmp(data.data(), area, page_size), 0);
+    ASSERT_EQ(data.substr(page_size, page_size), std::string(page_size, '\0'));
+    ASSERT_EQ(memcmp(data.data() + 2 * page_size, area + 2 * page_size,
+                     page_size),
+              0);
+}
+
+TEST_F(MemDumpTest, HexLines) {
+    MemDump dump(getpid());
+    ASSERT_TRUE(
+        dump.write(TEST_DUMP_PATH, (uint64_t)area, page_size + 32, DUMP_HEX));
+
+    std::istringstream in(read_file(TEST_DUMP_PATH));
+    std::string line, last;
+    size_t count = 0;
+    while (std::getline(in, line)) {
+        count++;
+        last = line;
+    }
+    ASSERT_EQ(count, page_size / MEMDUMP_HEX_BYTES);
+    char expected[MEMDUMP_HEX_LINE_MAX];
+    size_t len = format_hex_line((uint64_t)area + page_size - 16,
+                                 area + page_size - 16, 16, expected);
+    ASSERT_EQ(last + "\n", std::string(expected, len));
+}
+
+TEST_F(MemDumpTest, ElfSegments) {
+    MemDump dump(getpid());
+    ASSERT_TRUE(dump.write(TEST_DUMP_PATH, (uint64_t)area + 16,
+                           3 * page_size - 16, DUMP_ELF));
+
+    std::string data = read_file(TEST_DUMP_PATH);
+    auto *ehdr = (const Elf64_Ehdr *)data.data();
+    ASSERT_EQ(memcmp(ehdr->e_ident, ELFMAG, SELFMAG), 0);
+    ASSERT_EQ(ehdr->e_phnum, 2);
+    auto *phdrs = (const Elf64_Phdr *)(data.data() + ehdr->e_phoff);
+    ASSERT_EQ(phdrs[0].p_vaddr, (uint64_t)area + 16);
+    ASSERT_EQ(phdrs[0].p_filesz, page_size - 16);
+    ASSERT_EQ(phdrs[1].p_vaddr, (uint64_t)area + 2 * page_size);
+    ASSERT_EQ(memcmp(data.data() + phdrs[1].p_offset, area + 2 * page_size,
+                     page_size),
+              0);
+}
@@ -0,0 +1,105 @@
+#include "memsearch.hpp"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief Finds the pattern the obvious way.
+ */
+static const uint8_t *naive_find(const uint8_t *hay, size_t len,
+                                 const uint8_t *pattern, size_t pattern_len) {
+    for (size_t i = 0; i + pattern_len <= len; i++) {
+        if (memcmp(hay + i, pattern, pattern_len) == 0) {
+            return hay + i;
+        }
+    }
+    return nullptr;
+}
+
+TEST(MemSearchTest, FindMatchesNaive) {
+    std::mt19937 rng(1);
+    // A small alphabet gives many partial matches
+    std::vector<uint8_t> hay(4096);
+    for (auto &b: hay) {
+        b = rng() % 3;
+    }
+
+    for (size_t pattern_len = 1; pattern_len <= 40; pattern_len++) {
+        for (int round = 0; round < 20; round++) {
+            std::vector<uint8_t> pattern(pattern_len);
+            for (auto &b: pattern) {
+                b = rng() % 3;
+            }
+            size_t offset = rng() % 64, len = rng() % (hay.size() - offset);
+            ASSERT_EQ(memsearch_find(&hay[offset], len, pattern.data(),
+                                     pattern_len),
+                      naive_find(&hay[offset], len, pattern.data(),
+                                 pattern_len));
+        }
+    }
+}
+
+TEST(MemSearchTest, FindAtTheEnd) {
+    uint8_t hay[100] = {};
+    uint8_t pattern[] = {1, 2, 3};
+    memcpy(hay + sizeof(hay) - sizeof(pattern), pattern, sizeof(pattern));
+    ASSERT_EQ(memsearch_find(hay, sizeof(hay), pattern, sizeof(pattern)),
+              hay + sizeof(hay) - sizeof(pattern));
+    ASSERT_EQ(memsearch_find(hay, sizeof(hay) - 1, pattern, sizeof(pattern)),
+              nullptr);
+    ASSERT_EQ(memsearch_find(hay, 2, pattern, sizeof(pattern)), nullptr);
+}
+
+TEST(MemSearchTest, ParsePattern) {
+    std::vector<uint8_t> pattern;
+    ASSERT_TRUE(parse_pattern("\"ab\\x00\\n\"", pattern));
+    ASSERT_EQ(pattern, std::vector<uint8_t>({'a', 'b', 0, '\n'}));
+
+    ASSERT_TRUE(parse_pattern("0x1122334455667788", pattern));
+    ASSERT_EQ(pattern, std::vector<uint8_t>(
+                           {0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11}));
+
+    ASSERT_FALSE(parse_pattern("\"\"", pattern));
+    ASSERT_FALSE(parse_pattern("\"\\x4\"", pattern));
+    ASSERT_FALSE(parse_pattern("0x12zz", pattern));
+}
+
+TEST(MemSearchTest, SearchAcrossChunkBorders) {
+    // Occurrences crossing borders of small chunks
+    size_t chunk = 4096;
+    std::vector<uint8_t> area(4 * chunk, 0xaa);
+    uint8_t pattern[] = {'d', 'b', 'g', 'r', 'i', 'k', 0x13, 0x37};
+    std::vector<uint64_t> expected;
+    for (size_t border = chunk; border < area.size(); border += chunk) {
+        size_t pos = border - 1 - (border / chunk) * 2;
+        memcpy(&area[pos], pattern, sizeof(pattern));
+        expected.push_back((uint64_t)&area[pos]);
+    }
+
+    MemSearch search(getpid(), chunk);
+    std::vector<uint64_t> matches;
+    uint64_t start = (uint64_t)area.data();
+    ASSERT_TRUE(search.search(
+        std::vector<uint8_t>(pattern, pattern + sizeof(pattern)), start,
+        start + area.size(), 4, matches));
+    ASSERT_EQ(matches, expected);
+    ASSERT_GE(search.scanned(), area.size());
+}
+
+TEST(MemSearchTest, SearchFindsPointer) {
+    int *heap = new int(42);
+    int **holder = new int *(heap);
+
+    std::vector<uint8_t> pattern;
+    ASSERT_TRUE(parse_pattern(std::to_string((uint64_t)heap), pattern));
+    MemSearch search(getpid());
+    std::vector<uint64_t> matches;
+    ASSERT_TRUE(search.search(pattern, 0, UINT64_MAX, 2, matches));
+    ASSERT_NE(std::find(matches.begin(), matches.end(), (uint64_t)holder),
+              matches.end());
+
+    delete holder;
+    delete heap;
+}
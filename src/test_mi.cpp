@@ -0,0 +1,115 @@
+#include "mi.hpp"
+
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+TEST(MiTestSuite, json_string_escapes) {
+    std::string out;
+    json_string(out, "a\"b\\c\nd\x01");
+    ASSERT_EQ(out, "\"a\\\"b\\\\c\\nd\\u0001\"");
+
+    out.clear();
+    json_hex(out, 0x401136);
+    ASSERT_EQ(out, "\"0x401136\"");
+}
+
+TEST(MiTestSuite, parse_object_values) {
+    std::map<std::string, std::string> fields;
+    ASSERT_TRUE(json_parse_object(
+        " {\"id\": 7, \"s\":\"x\\ty\\u00e9\\ud83d\\ude00\", \"f\":false} ",
+        fields));
+    ASSERT_EQ(fields["id"], "7");
+    ASSERT_EQ(fields["s"], "x\ty\xc3\xa9\xf0\x9f\x98\x80");
+    ASSERT_EQ(fields["f"], "false");
+
+    ASSERT_TRUE(json_parse_object("{}", fields));
+    ASSERT_TRUE(fields.empty());
+
+    ASSERT_FALSE(json_parse_object("{\"a\":[1]}", fields));
+    ASSERT_FALSE(json_parse_object("{\"a\":1", fields));
+    ASSERT_FALSE(json_parse_object("{\"a\":1} x", fields));
+    ASSERT_FALSE(json_parse_object("b 401136", fields));
+}
+
+TEST(MiTestSuite, parse_request) {
+    mi_request req;
+    ASSERT_TRUE(parse_mi_request("{\"id\":3,\"cmd\":\"b\",\"args\":\"4011\"}",
+                                 req));
+    ASSERT_EQ(req.id, "3");
+    ASSERT_EQ(req.cmd, "b");
+    ASSERT_EQ(req.fields["args"], "4011");
+
+    ASSERT_TRUE(parse_mi_request("{\"id\":\"q\\\"1\",\"cmd\":\"-regs\"}", req));
+    ASSERT_EQ(req.id, "\"q\\\"1\"");
+
+    ASSERT_FALSE(parse_mi_request("{\"id\":4}", req));
+    ASSERT_EQ(req.id, "4");
+}
+
+TEST(MiTestSuite, id_echoed_as_written) {
+    mi_request req;
+    // A string of digits stays a string
+    ASSERT_TRUE(parse_mi_request("{\"id\":\"42\",\"cmd\":\"c\"}", req));
+    ASSERT_EQ(req.id, "\"42\"");
+    ASSERT_TRUE(parse_mi_request("{\"id\":1.5,\"cmd\":\"c\"}", req));
+    ASSERT_EQ(req.id, "1.5");
+    ASSERT_TRUE(parse_mi_request("{\"id\":-7,\"cmd\":\"c\"}", req));
+    ASSERT_EQ(req.id, "-7");
+    ASSERT_TRUE(parse_mi_request("{\"id\":null,\"cmd\":\"c\"}", req));
+    ASSERT_EQ(req.id, "null");
+    ASSERT_TRUE(parse_mi_request("{\"id\":true,\"cmd\":\"c\"}", req));
+    ASSERT_EQ(req.id, "true");
+    ASSERT_TRUE(
+        parse_mi_request("{\"id\":\"a\\u0041\",\"cmd\":\"c\"}", req));
+    ASSERT_EQ(req.id, "\"a\\u0041\"");
+    // Without an id the response has a null one
+    ASSERT_TRUE(parse_mi_request("{\"cmd\":\"c\"}", req));
+    ASSERT_EQ(req.id, "null");
+}
+
+TEST(MiTestSuite, parse_numbers) {
+    uint64_t value;
+    ASSERT_TRUE(mi_number("0x401136", value));
+    ASSERT_EQ(value, 0x401136u);
+    ASSERT_TRUE(mi_number("64", value));
+    ASSERT_EQ(value, 64u);
+    ASSERT_FALSE(mi_number("-1", value));
+    ASSERT_FALSE(mi_number("12z", value));
+    ASSERT_FALSE(mi_number("", value));
+}
+
+TEST(MiTestSuite, socket_accepts_client) {
+    std::string path = "/tmp/mi_test_" + std::to_string(getpid()) + ".sock";
+    int client = -1;
+    std::thread connector([&] {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        for (int i = 0; i < 1000 && client < 0; i++) {
+            int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+                client = fd;
+            } else {
+                close(fd);
+                usleep(1000);
+            }
+        }
+    });
+
+    int server = mi_accept(path.c_str());
+    connector.join();
+    ASSERT_GE(server, 0);
+    ASSERT_GE(client, 0);
+
+    ASSERT_TRUE(write_all(server, "{\"ok\":true}\n"));
+    char buf[32] = {};
+    ASSERT_EQ(read(client, buf, sizeof(buf)), 12);
+    ASSERT_STREQ(buf, "{\"ok\":true}\n");
+
+    close(client);
+    close(server);
+    unlink(path.c_str());
+}
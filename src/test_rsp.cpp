@@ -0,0 +1,101 @@
+#include "rsp.hpp"
+
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <string.h>
+
+TEST(RspTestSuite, frame_and_parse) {
+    std::string out;
+    rsp_frame("OK", out);
+    ASSERT_EQ(out, "$OK#9a");
+
+    std::string input = "+junk$qC#b4\x03-$m0,1#00", packet;
+    ASSERT_EQ(rsp_next(input, packet), RSP_ACK);
+    ASSERT_EQ(rsp_next(input, packet), RSP_PACKET);
+    ASSERT_EQ(packet, "qC");
+    ASSERT_EQ(rsp_next(input, packet), RSP_BREAK);
+    ASSERT_EQ(rsp_next(input, packet), RSP_NACK);
+    ASSERT_EQ(rsp_next(input, packet), RSP_BAD_PACKET);
+    ASSERT_TRUE(input.empty());
+
+    // A packet split between reads waits for the rest
+    input = "$g#6";
+    ASSERT_EQ(rsp_next(input, packet), RSP_NONE);
+    input += "7";
+    ASSERT_EQ(rsp_next(input, packet), RSP_PACKET);
+    ASSERT_EQ(packet, "g");
+}
+
+TEST(RspTestSuite, binary_escapes) {
+    const char raw[] = {'a', '#', '$', '}', '*', 0};
+    std::string escaped;
+    rsp_escape(raw, sizeof(raw), escaped);
+    ASSERT_EQ(escaped, std::string("a}\x03}\x04}]}\x0a\0", 10));
+
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(rsp_unescape(escaped.data(), escaped.size(), data));
+    ASSERT_EQ(data.size(), sizeof(raw));
+    ASSERT_EQ(memcmp(data.data(), raw, sizeof(raw)), 0);
+    ASSERT_FALSE(rsp_unescape("a}", 2, data));
+
+    std::string hex;
+    rsp_hex(data.data(), 2, hex);
+    ASSERT_EQ(hex, "6123");
+    ASSERT_TRUE(rsp_unhex("ff00", 4, data));
+    ASSERT_EQ(data, std::vector<uint8_t>({0xff, 0x00}));
+    ASSERT_FALSE(rsp_unhex("f", 1, data));
+    ASSERT_FALSE(rsp_unhex("zz", 2, data));
+}
+
+TEST(RspTestSuite, registers_round_trip) {
+    struct user_regs_struct regs, back;
+    memset(&regs, 0, sizeof(regs));
+    regs.rax = 0x1122334455667788;
+    regs.rip = 0x401136;
+    regs.eflags = 0x246;
+    regs.fs_base = 0x7f0000001000;
+    regs.orig_rax = (uint64_t)-1;
+
+    std::string hex;
+    rsp_encode_regs(regs, hex);
+    ASSERT_EQ(hex.size(), 2u * RSP_REGS_SIZE);
+    ASSERT_EQ(hex.substr(0, 16), "8877665544332211");
+    // st0 follows the 24 general and segment registers, unavailable
+    ASSERT_EQ(hex.substr(2 * 164, 20), std::string(20, 'x'));
+
+    memset(&back, 0, sizeof(back));
+    ASSERT_TRUE(rsp_decode_regs(hex, back));
+    ASSERT_EQ(memcmp(&regs, &back, sizeof(regs)), 0);
+    ASSERT_FALSE(rsp_decode_regs(hex.substr(10), back));
+
+    std::string rip;
+    ASSERT_TRUE(rsp_encode_reg(regs, RSP_REG_RIP, rip));
+    ASSERT_EQ(rip, "3611400000000000");
+}
+
+TEST(RspTestSuite, signals_and_numbers) {
+    ASSERT_EQ(rsp_from_host_signal(SIGTRAP), 5);
+    ASSERT_EQ(rsp_from_host_signal(SIGSEGV), 11);
+    ASSERT_EQ(rsp_from_host_signal(SIGUSR1), 30);
+    ASSERT_EQ(rsp_to_host_signal(30), SIGUSR1);
+    ASSERT_EQ(rsp_to_host_signal(2), SIGINT);
+    ASSERT_EQ(rsp_to_host_signal(7), 0);
+
+    const char *text = "4011a6,10";
+    uint64_t value;
+    ASSERT_TRUE(rsp_number(text, value));
+    ASSERT_EQ(value, 0x4011a6u);
+    ASSERT_EQ(*text, ',');
+}
+
+TEST(RspTestSuite, xfer_slices) {
+    std::string out;
+    rsp_xfer_slice("abcdef", "0,4", out);
+    ASSERT_EQ(out, "mabcd");
+    out.clear();
+    rsp_xfer_slice("abcdef", "4,100", out);
+    ASSERT_EQ(out, "lef");
+    out.clear();
+    rsp_xfer_slice("abcdef", "6,4", out);
+    ASSERT_EQ(out, "l");
+}
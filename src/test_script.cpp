@@ -0,0 +1,87 @@
+#include "script.hpp"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/**
+ * @brief Returns a reader over the given lines.
+ */
+static line_reader reader(const std::vector<std::string> &lines, size_t &pos) {
+    return [&lines, &pos](std::string &line) {
+        if (pos >= lines.size()) {
+            return false;
+        }
+        line = lines[pos++];
+        return true;
+    };
+}
+
+TEST(ScriptTestSuite, split_lines) {
+    std::string cmd, args;
+    ASSERT_TRUE(split_command("  x  401000 4\r", cmd, args));
+    ASSERT_EQ(cmd, "x");
+    ASSERT_EQ(args, "401000 4\r");
+
+    ASSERT_TRUE(split_command("c", cmd, args));
+    ASSERT_EQ(cmd, "c");
+    ASSERT_EQ(args, "");
+
+    ASSERT_FALSE(split_command("   ", cmd, args));
+    ASSERT_FALSE(split_command("  # b 401000", cmd, args));
+}
+
+TEST(ScriptTestSuite, aliases_expand_once) {
+    std::unordered_map<std::string, std::string> aliases = {
+        {"continue", "c"}, {"xs", "x 7ffe0000"}, {"loop", "loop"}};
+    std::string cmd = "continue", args;
+    expand_alias(aliases, cmd, args);
+    ASSERT_EQ(cmd, "c");
+
+    cmd = "xs";
+    args = "8";
+    expand_alias(aliases, cmd, args);
+    ASSERT_EQ(cmd, "x");
+    ASSERT_EQ(args, "7ffe0000 8");
+
+    cmd = "loop";
+    expand_alias(aliases, cmd, args);
+    ASSERT_EQ(cmd, "loop");
+}
+
+TEST(ScriptTestSuite, blocks_nest) {
+    ASSERT_TRUE(opens_block("commands 401136"));
+    ASSERT_TRUE(opens_block("repeat 3"));
+    ASSERT_FALSE(opens_block("repeat 3 s"));
+    ASSERT_FALSE(opens_block("c"));
+
+    std::vector<std::string> lines = {"ir", "repeat 2", "s", "end",
+                                      "end", "after"};
+    size_t pos = 0;
+    std::vector<std::string> body;
+    ASSERT_TRUE(read_block(reader(lines, pos), body));
+    ASSERT_EQ(body.size(), 4u);
+    ASSERT_EQ(body[3], "end");
+    ASSERT_EQ(lines[pos], "after");
+
+    lines = {"ir", "c"};
+    pos = 0;
+    body.clear();
+    ASSERT_FALSE(read_block(reader(lines, pos), body));
+}
+
+TEST(ScriptTestSuite, read_file) {
+    char path[] = "/tmp/script_testXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "b 401000\nr\n\nbt", 14), 14);
+    close(fd);
+
+    std::vector<std::string> lines;
+    ASSERT_TRUE(read_script(path, lines));
+    ASSERT_EQ(lines.size(), 4u);
+    ASSERT_EQ(lines[3], "bt");
+    unlink(path);
+
+    ASSERT_FALSE(read_script("/nonexistent/script.dbg", lines));
+}
@@ -0,0 +1,104 @@
+#include "snapshot.hpp"
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @brief Forks a copy of the test process that waits to be killed.
+ */
+static pid_t fork_copy() {
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (;;) {
+            pause();
+        }
+    }
+    return pid;
+}
+
+/**
+ * @brief Kills the copy made by `fork_copy`.
+ */
+static void kill_copy(pid_t pid) {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+TEST(SnapshotTest, DiffMemory) {
+    uint8_t old_data[64] = {}, new_data[64] = {};
+    new_data[1] = 1;
+    // Close enough to be merged with the first one
+    new_data[5] = 2;
+    new_data[40] = 3;
+
+    std::vector<mem_change> changes;
+    diff_memory(0x1000, old_data, new_data, sizeof(old_data), changes);
+    ASSERT_EQ(changes.size(), 2);
+    ASSERT_EQ(changes[0].addr, 0x1001);
+    ASSERT_EQ(changes[0].size, 5);
+    ASSERT_EQ(changes[0].new_data, std::vector<uint8_t>({1, 0, 0, 0, 2}));
+    ASSERT_EQ(changes[1].addr, 0x1028);
+    ASSERT_EQ(changes[1].size, 1);
+    ASSERT_EQ(changes[1].old_data, std::vector<uint8_t>({0}));
+
+    changes.clear();
+    diff_memory(0x1000, old_data, old_data, sizeof(old_data), changes);
+    ASSERT_TRUE(changes.empty());
+}
+
+TEST(SnapshotTest, FindsWrites) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    auto *area = (uint8_t *)aligned_alloc(page_size, 8 * page_size);
+    memset(area, 0x11, 8 * page_size);
+
+    pid_t copy = fork_copy();
+    MemSnapshot snap(getpid(), copy);
+    ASSERT_TRUE(snap.start());
+
+    area[5] = 0x22;
+    memset(area + 3 * page_size - 2, 0x33, 4);
+
+    std::vector<mem_change> changes;
+    uint64_t start = (uint64_t)area;
+    ASSERT_TRUE(snap.diff(start, start + 8 * page_size, changes));
+    kill_copy(copy);
+
+    ASSERT_EQ(changes.size(), 2);
+    ASSERT_EQ(changes[0].addr, start + 5);
+    ASSERT_EQ(changes[0].old_data, std::vector<uint8_t>({0x11}));
+    ASSERT_EQ(changes[0].new_data, std::vector<uint8_t>({0x22}));
+    // A write crossing a page border is one change
+    ASSERT_EQ(changes[1].addr, start + 3 * page_size - 2);
+    ASSERT_EQ(changes[1].size, 4);
+    if (snap.tracks_writes()) {
+        ASSERT_LE(snap.compared(), 3);
+    }
+    free(area);
+}
+
+TEST(SnapshotTest, NewMappingIsReported) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    pid_t copy = fork_copy();
+    MemSnapshot snap(getpid(), copy);
+    ASSERT_TRUE(snap.start());
+
+    auto *mem = (uint8_t *)mmap(nullptr, 2 * page_size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_NE(mem, MAP_FAILED);
+    memset(mem, 1, 2 * page_size);
+
+    std::vector<mem_change> changes;
+    uint64_t start = (uint64_t)mem;
+    ASSERT_TRUE(snap.diff(start, start + 2 * page_size, changes));
+    kill_copy(copy);
+
+    ASSERT_EQ(changes.size(), 1);
+    ASSERT_FALSE(changes[0].in_snapshot);
+    ASSERT_EQ(changes[0].addr, start);
+    ASSERT_EQ(changes[0].size, 2 * page_size);
+    munmap(mem, 2 * page_size);
+}
@@ -0,0 +1,76 @@
+#include "elfinfo.hpp"
+#include "procmaps.hpp"
+#include "solib.hpp"
+#include "target.hpp"
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+    A stopped fork of the test has the same link map as the test itself
+*/
+class SolibTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        pid = fork();
+        if (pid == 0) {
+            ptrace(PTRACE_TRACEME, 0, 0, 0);
+            raise(SIGSTOP);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFSTOPPED(status));
+
+        ElfInfo exe("/proc/self/exe");
+        std::vector<proc_map> maps;
+        ASSERT_TRUE(read_proc_maps(pid, maps));
+        ASSERT_TRUE(libs.attach(exe.interpreter(), maps));
+    }
+
+    void TearDown() {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+
+    pid_t pid;
+    SharedLibs libs;
+};
+
+TEST_F(SolibTest, ReadsLinkMap) {
+    LiveTarget live(pid);
+    std::vector<so_module *> added;
+    std::vector<std::string> removed;
+    ASSERT_NE(libs.break_address(), 0);
+    ASSERT_TRUE(libs.update(live, added, removed));
+    ASSERT_FALSE(added.empty());
+    ASSERT_TRUE(removed.empty());
+    ASSERT_EQ(added.size(), libs.modules().size());
+
+    // Nothing changed, nothing is reported
+    ASSERT_TRUE(libs.update(live, added, removed));
+    ASSERT_TRUE(added.empty());
+    ASSERT_TRUE(removed.empty());
+}
+
+TEST_F(SolibTest, LoadsSymbolsLazily) {
+    LiveTarget live(pid);
+    std::vector<so_module *> added;
+    std::vector<std::string> removed;
+    ASSERT_TRUE(libs.update(live, added, removed));
+    // Only the loader was read to find r_debug
+    ASSERT_LE(libs.loaded(), 1);
+
+    so_module *libc = libs.find_module("libc.so");
+    ASSERT_NE(libc, nullptr);
+    ASSERT_EQ(libs.find_module("libc.s"), nullptr);
+    const elf_symbol *sym = libs.symbols(*libc)->lookup_function("getpid");
+    ASSERT_NE(sym, nullptr);
+    ASSERT_EQ(sym->addr + libc->bias, (uint64_t)&getpid);
+    ASSERT_LE(libs.loaded(), 2);
+
+    ASSERT_EQ(libs.module_at((uint64_t)&getpid), libc);
+    ASSERT_EQ(libs.module_at((uint64_t)&pid), nullptr);
+}
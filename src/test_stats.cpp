@@ -0,0 +1,91 @@
+#include "stats.hpp"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <sstream>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_JSON_PATH "/tmp/debugrik_test_stats.json"
+
+static long stats_test_value = 0x1122334455667788;
+
+TEST(StatsTest, HistogramBuckets) {
+    stats_histogram hist = {};
+    hist.add(0);
+    hist.add(1);
+    hist.add(1000);
+    hist.add(1500);
+    ASSERT_EQ(hist.count, 4u);
+    ASSERT_EQ(hist.total_ns, 2501u);
+    ASSERT_EQ(hist.max_ns, 1500u);
+    ASSERT_EQ(hist.buckets[0], 2u);
+    // 1000 falls in [512, 1024), 1500 in [1024, 2048)
+    ASSERT_EQ(hist.buckets[9], 1u);
+    ASSERT_EQ(hist.buckets[10], 1u);
+
+    // Percentiles are bucket bounds, never above the maximum
+    ASSERT_EQ(hist.percentile(0.5), 1u);
+    ASSERT_EQ(hist.percentile(1), 1500u);
+    ASSERT_EQ(stats_histogram{}.percentile(0.5), 0u);
+}
+
+TEST(StatsTest, CountsTargetAccess) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, 0, 0);
+        raise(SIGSTOP);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFSTOPPED(status));
+
+    global_stats.reset();
+    long word = ptrace(PTRACE_PEEKDATA, pid, &stats_test_value, 0);
+    ASSERT_EQ(word, stats_test_value);
+    long copy;
+    struct iovec local = {&copy, sizeof(copy)};
+    struct iovec remote = {&stats_test_value, sizeof(copy)};
+    ASSERT_EQ(process_vm_readv(pid, &local, 1, &remote, 1, 0),
+              (ssize_t)sizeof(copy));
+    ptrace(PTRACE_KILL, pid, 0, 0);
+    waitpid(pid, nullptr, 0);
+
+    ASSERT_EQ(global_stats.ptrace_count(PTRACE_PEEKDATA), 1u);
+    ASSERT_EQ(global_stats.ptrace_count(PTRACE_KILL), 1u);
+    ASSERT_EQ(global_stats.read_total(), 2 * sizeof(long));
+    ASSERT_EQ(global_stats.written_total(), 0u);
+    ASSERT_STREQ(stats_ptrace_name(PTRACE_PEEKDATA), "PEEKDATA");
+}
+
+TEST(StatsTest, TimersAndJson) {
+    global_stats.reset();
+    {
+        StatsTimer timer(STATS_DWARF_QUERY);
+    }
+    global_stats.stopped();
+    global_stats.prompt();
+    // Reported once per stop
+    global_stats.prompt();
+    global_stats.time_command("bt", 2000);
+    global_stats.ptrace_call(PTRACE_GETREGS);
+
+    ASSERT_EQ(global_stats.timer(STATS_DWARF_QUERY).count, 1u);
+    ASSERT_EQ(global_stats.timer(STATS_STOP_TO_PROMPT).count, 1u);
+    ASSERT_EQ(global_stats.commands().at("bt").max_ns, 2000u);
+
+    ASSERT_TRUE(global_stats.write_json(TEST_JSON_PATH));
+    std::ifstream in(TEST_JSON_PATH);
+    std::stringstream text;
+    text << in.rdbuf();
+    unlink(TEST_JSON_PATH);
+    std::string json = text.str();
+    ASSERT_EQ(json.front(), '{');
+    ASSERT_NE(json.find("\"GETREGS\":1"), std::string::npos);
+    ASSERT_NE(json.find("\"commands\":{\"bt\":{\"count\":1,\"total_ns\":2000"),
+              std::string::npos);
+    ASSERT_NE(json.find("\"stop-to-prompt\":{\"count\":1"), std::string::npos);
+}
@@ -0,0 +1,116 @@
+#include "symindex.hpp"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+    A small index with two compile units worth of records
+*/
+class SymbolIndexTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        char tmpl[] = "/tmp/debugrik_symindex_XXXXXX";
+        int fd = mkstemp(tmpl);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path = tmpl;
+    }
+
+    void TearDown() { unlink(path.c_str()); }
+
+    static void fill(SymbolIndex &index) {
+        index.add_function("main", 0x1100, 0x1180, 0x40);
+        index.add_function("helper", 0x1000, 0x1050, 0x80);
+        index.add_line(0x1000, "helper.c", 3);
+        index.add_line(0x1010, "helper.c", 4);
+        index.add_line(0x1050, "helper.c", 0);
+        index.add_line(0x1100, "main.c", 10);
+        index.add_line(0x1180, "main.c", 0);
+        index.add_type("point", 0xc0);
+    }
+
+    std::string path;
+};
+
+TEST_F(SymbolIndexTest, QueriesBuiltIndex) {
+    SymbolIndex index;
+    fill(index);
+    index.finish("deadbeef");
+    ASSERT_EQ(index.function_count(), 2u);
+
+    auto *func = index.find_function(0x1120);
+    ASSERT_NE(func, nullptr);
+    ASSERT_STREQ(index.string_at(func->name), "main");
+    ASSERT_EQ(index.find_function(0x1060), nullptr);
+    ASSERT_EQ(index.find_function(0xfff), nullptr);
+
+    func = index.lookup_function("helper");
+    ASSERT_NE(func, nullptr);
+    ASSERT_EQ(func->low, 0x1000u);
+    ASSERT_EQ(index.lookup_function("missing"), nullptr);
+
+    std::string file;
+    uint32_t line;
+    ASSERT_TRUE(index.find_line(0x1014, file, line));
+    ASSERT_EQ(file, "helper.c");
+    ASSERT_EQ(line, 4u);
+    ASSERT_FALSE(index.find_line(0x1060, file, line));
+
+    uint64_t die;
+    ASSERT_TRUE(index.lookup_type("point", die));
+    ASSERT_EQ(die, 0xc0u);
+    ASSERT_FALSE(index.lookup_type("line", die));
+}
+
+TEST_F(SymbolIndexTest, MergesPartialIndexes) {
+    SymbolIndex index, part;
+    index.add_function("main", 0x1100, 0x1180, 0x40);
+    part.add_function("helper", 0x1000, 0x1050, 0x80);
+    part.add_line(0x1000, "helper.c", 3);
+    index.merge(part);
+    index.finish("");
+
+    std::string file;
+    uint32_t line;
+    ASSERT_NE(index.lookup_function("helper"), nullptr);
+    ASSERT_NE(index.lookup_function("main"), nullptr);
+    ASSERT_TRUE(index.find_line(0x1000, file, line));
+    ASSERT_EQ(file, "helper.c");
+}
+
+TEST_F(SymbolIndexTest, LoadsSavedIndex) {
+    {
+        SymbolIndex index;
+        fill(index);
+        index.finish("deadbeef");
+        ASSERT_TRUE(index.save(path));
+    }
+    SymbolIndex index;
+    ASSERT_FALSE(index.load(path, "deadbeee"));
+    ASSERT_TRUE(index.load(path, "deadbeef"));
+    auto *func = index.find_function(0x1010);
+    ASSERT_NE(func, nullptr);
+    ASSERT_STREQ(index.string_at(func->name), "helper");
+    ASSERT_EQ(func->die, 0x80u);
+}
+
+TEST_F(SymbolIndexTest, RejectsCorruptIndex) {
+    {
+        SymbolIndex index;
+        fill(index);
+        index.finish("deadbeef");
+        ASSERT_TRUE(index.save(path));
+    }
+    // Flip the last byte of the string table
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(-2, std::ios::end);
+    char byte = file.get();
+    file.seekp(-2, std::ios::end);
+    file.put(byte ^ 1);
+    file.close();
+
+    SymbolIndex index;
+    ASSERT_FALSE(index.load(path, "deadbeef"));
+    ASSERT_EQ(index.function_count(), 0u);
+}
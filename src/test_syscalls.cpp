@@ -0,0 +1,80 @@
+#include "syscalls.hpp"
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+TEST(SyscallsTest, LookupByNumber) {
+    ASSERT_NE(syscall_by_nr(SYS_openat), nullptr);
+    EXPECT_STREQ(syscall_by_nr(SYS_openat)->name, "openat");
+    EXPECT_STREQ(syscall_by_nr(SYS_openat)->args, "isxo");
+    EXPECT_EQ(syscall_by_nr(100000), nullptr);
+}
+
+TEST(SyscallsTest, LookupByName) {
+    ASSERT_NE(syscall_by_name("write"), nullptr);
+    EXPECT_EQ(syscall_by_name("write")->nr, SYS_write);
+    EXPECT_EQ(syscall_by_name("no_such_syscall"), nullptr);
+}
+
+TEST(SyscallsTest, FilterForAllSyscalls) {
+    auto prog = build_seccomp_filter({SYSCALL_ALL});
+    ASSERT_EQ(prog.size(), 1);
+    EXPECT_EQ(prog[0].k, SECCOMP_RET_TRACE);
+}
+
+TEST(SyscallsTest, FilterLayout) {
+    auto prog = build_seccomp_filter({SYS_read, SYS_write});
+    // arch check, nr load, x32 check, two comparisons, allow, trace
+    ASSERT_EQ(prog.size(), 8);
+    EXPECT_EQ(prog[6].k, SECCOMP_RET_ALLOW);
+    EXPECT_EQ(prog[7].k, SECCOMP_RET_TRACE);
+    // every comparison jumps to RET_TRACE on match
+    EXPECT_EQ(4 + 1 + prog[4].jt, 7);
+    EXPECT_EQ(5 + 1 + prog[5].jt, 7);
+    // foreign architectures and x32 calls jump to RET_TRACE
+    EXPECT_EQ(1 + 1 + prog[1].jf, 7);
+    EXPECT_EQ(prog[3].k, __X32_SYSCALL_BIT);
+    EXPECT_EQ(3 + 1 + prog[3].jt, 7);
+}
+
+TEST(SyscallsTest, FilterFitsJumpOffsets) {
+    std::set<long> nrs;
+    for (long nr = 0; nr < SYSCALL_FILTER_MAX_JUMP - SYSCALL_FILTER_HEADER;
+         nr++) {
+        nrs.insert(nr);
+    }
+    auto prog = build_seccomp_filter(nrs);
+    EXPECT_EQ(1 + 1 + prog[1].jf, prog.size() - 1);
+
+    // One more does not fit, every call is traced
+    nrs.insert(SYSCALL_FILTER_MAX_JUMP);
+    ASSERT_EQ(build_seccomp_filter(nrs).size(), 1);
+}
+
+TEST(SyscallsTest, FilterTracesOnlySelectedSyscalls) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        auto prog = build_seccomp_filter({SYS_getpid});
+        struct sock_fprog fprog = {(unsigned short)prog.size(), prog.data()};
+        prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+        if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &fprog) != 0) {
+            _exit(2);
+        }
+        // Without a tracer RET_TRACE fails the call with ENOSYS
+        bool traced = syscall(SYS_getpid) == -1 && errno == ENOSYS;
+        bool allowed = syscall(SYS_getppid) > 0;
+        // So is an x32 call of an allowed syscall
+        bool x32_traced = syscall(__X32_SYSCALL_BIT | SYS_getppid) == -1 &&
+                          errno == ENOSYS;
+        _exit(traced && allowed && x32_traced ? 0 : 1);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+}
@@ -0,0 +1,198 @@
+#include "gcore.hpp"
+#include "target.hpp"
+#include <elf.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/ptrace.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#define TEST_CORE_PATH "/tmp/debugrik_test_target.core"
+#define TEST_CODE_SIZE 64
+
+static char pattern[] = "debugrik target pattern";
+alignas(TARGET_PAGE_SIZE) static char two_pages[2 * TARGET_PAGE_SIZE] =
+    "debugrik two pages";
+
+int target_test_code(int x) { return x * 3 + 1; }
+
+/*
+    A stopped fork of the test has the same addresses as the test itself
+*/
+class TargetTest : public ::testing::Test {
+  protected:
+    void SetUp() {
+        pid = fork();
+        if (pid == 0) {
+            ptrace(PTRACE_TRACEME, 0, 0, 0);
+            raise(SIGSTOP);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        ASSERT_TRUE(WIFSTOPPED(status));
+    }
+
+    void TearDown() {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        unlink(TEST_CORE_PATH);
+    }
+
+    void write_core(bool skip_ro) {
+        CoreDump dump(pid);
+        ASSERT_TRUE(dump.add_thread(pid));
+        ASSERT_TRUE(dump.write(TEST_CORE_PATH, skip_ro));
+    }
+
+    pid_t pid;
+};
+
+TEST_F(TargetTest, LiveReadsMemory) {
+    LiveTarget live(pid);
+    char buf[sizeof(pattern)];
+    ASSERT_TRUE(live.read_memory((uint64_t)pattern, (uint8_t *)buf,
+                                 sizeof(buf)));
+    ASSERT_STREQ(buf, pattern);
+    ASSERT_FALSE(live.read_memory(0, (uint8_t *)buf, sizeof(buf)));
+}
+
+TEST_F(TargetTest, LiveCachesPagesUntilFlush) {
+    LiveTarget live(pid);
+    char buf[sizeof(pattern)];
+    ASSERT_TRUE(live.read_memory((uint64_t)pattern, (uint8_t *)buf,
+                                 sizeof(buf)));
+    ASSERT_TRUE(live.read_memory((uint64_t)pattern, (uint8_t *)buf,
+                                 sizeof(buf)));
+    ASSERT_GE(live.cache_hits(), 1u);
+
+    // Changed behind the back of the cache, as if the process ran
+    char changed = 'D';
+    struct iovec local = {&changed, 1};
+    struct iovec remote = {pattern, 1};
+    ASSERT_EQ(process_vm_writev(pid, &local, 1, &remote, 1, 0), 1);
+    ASSERT_TRUE(live.read_memory((uint64_t)pattern, (uint8_t *)buf, 1));
+    ASSERT_EQ(buf[0], pattern[0]);
+
+    live.flush();
+    uint64_t misses = live.cache_misses();
+    ASSERT_TRUE(live.read_memory((uint64_t)pattern, (uint8_t *)buf, 1));
+    ASSERT_EQ(buf[0], changed);
+    ASSERT_EQ(live.cache_misses(), misses + 1);
+}
+
+TEST_F(TargetTest, LiveCacheFollowsWrites) {
+    LiveTarget live(pid);
+    char buf[sizeof(pattern)];
+    ASSERT_TRUE(live.read_memory((uint64_t)pattern, (uint8_t *)buf,
+                                 sizeof(buf)));
+
+    const char word[] = "DEBUGRIK";
+    live.wrote((uint64_t)pattern, (const uint8_t *)word, strlen(word));
+    ASSERT_TRUE(live.read_memory((uint64_t)pattern, (uint8_t *)buf,
+                                 sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, word, strlen(word)), 0);
+    ASSERT_STREQ(buf + strlen(word), pattern + strlen(word));
+}
+
+TEST_F(TargetTest, LiveReadsAcrossPages) {
+    LiveTarget live(pid);
+    uint64_t addr = (uint64_t)two_pages + TARGET_PAGE_SIZE - 16;
+    uint8_t buf[32];
+    ASSERT_TRUE(live.read_memory(addr, buf, sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, (void *)addr, sizeof(buf)), 0);
+    ASSERT_EQ(live.cache_misses(), 2u);
+    ASSERT_EQ(live.cache_hits(), 0u);
+}
+
+TEST_F(TargetTest, CoreMatchesLive) {
+    write_core(false);
+    CoreTarget core(TEST_CORE_PATH);
+    LiveTarget live(pid);
+    ASSERT_TRUE(core.loaded());
+    ASSERT_EQ(core.pid(), pid);
+
+    struct user_regs_struct core_regs, live_regs;
+    ASSERT_TRUE(core.get_regs(core_regs));
+    ASSERT_TRUE(live.get_regs(live_regs));
+    ASSERT_EQ(core_regs.rip, live_regs.rip);
+    ASSERT_EQ(core_regs.rsp, live_regs.rsp);
+
+    uint8_t core_stack[256], live_stack[256];
+    ASSERT_TRUE(core.read_memory(live_regs.rsp, core_stack, sizeof(core_stack)));
+    ASSERT_TRUE(live.read_memory(live_regs.rsp, live_stack, sizeof(live_stack)));
+    ASSERT_EQ(memcmp(core_stack, live_stack, sizeof(core_stack)), 0);
+
+    const uint8_t *mem = core.memory_at((uint64_t)pattern, sizeof(pattern));
+    ASSERT_NE(mem, nullptr);
+    ASSERT_STREQ((const char *)mem, pattern);
+
+    uint8_t byte;
+    ASSERT_FALSE(core.read_memory(0, &byte, 1));
+}
+
+TEST_F(TargetTest, SkippedCodeIsReadFromFile) {
+    write_core(true);
+    CoreTarget core(TEST_CORE_PATH);
+    ASSERT_TRUE(core.loaded());
+
+    // Code of the test is not in the core, but in the executable
+    uint64_t code = (uint64_t)&target_test_code;
+    ASSERT_EQ(core.memory_at(code, TEST_CODE_SIZE), nullptr);
+    uint8_t buf[TEST_CODE_SIZE];
+    ASSERT_TRUE(core.read_memory(code, buf, sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, (void *)code, sizeof(buf)), 0);
+}
+
+TEST_F(TargetTest, CorruptFileNoteIsIgnored) {
+    write_core(false);
+
+    // An entry count so large that 3 * count wraps around to 0
+    FILE *core = fopen(TEST_CORE_PATH, "r+b");
+    ASSERT_NE(core, nullptr);
+    Elf64_Ehdr ehdr;
+    ASSERT_EQ(fread(&ehdr, sizeof(ehdr), 1, core), 1u);
+    bool patched = false;
+    for (int i = 0; i < ehdr.e_phnum && !patched; i++) {
+        Elf64_Phdr phdr;
+        fseek(core, ehdr.e_phoff + i * sizeof(phdr), SEEK_SET);
+        ASSERT_EQ(fread(&phdr, sizeof(phdr), 1, core), 1u);
+        if (phdr.p_type != PT_NOTE) {
+            continue;
+        }
+        std::vector<uint8_t> notes(phdr.p_filesz);
+        fseek(core, phdr.p_offset, SEEK_SET);
+        ASSERT_EQ(fread(notes.data(), notes.size(), 1, core), 1u);
+        size_t pos = 0;
+        while (pos + sizeof(Elf64_Nhdr) <= notes.size()) {
+            auto *nhdr = (Elf64_Nhdr *)(notes.data() + pos);
+            size_t desc = pos + sizeof(*nhdr) + ((nhdr->n_namesz + 3) & ~3);
+            if (nhdr->n_type == NT_FILE) {
+                uint64_t count = 1ull << 61;
+                fseek(core, phdr.p_offset + desc, SEEK_SET);
+                ASSERT_EQ(fwrite(&count, sizeof(count), 1, core), 1u);
+                patched = true;
+                break;
+            }
+            pos = desc + ((nhdr->n_descsz + 3) & ~3);
+        }
+    }
+    fclose(core);
+    ASSERT_TRUE(patched);
+
+    CoreTarget corrupt(TEST_CORE_PATH);
+    ASSERT_TRUE(corrupt.loaded());
+    std::vector<proc_map> maps;
+    corrupt.mappings(maps);
+    ASSERT_TRUE(maps.empty());
+}
+
+TEST(CoreTargetTest, NotACoreFile) {
+    CoreTarget exe("/proc/self/exe");
+    ASSERT_FALSE(exe.loaded());
+    CoreTarget missing("/k/a/c/core");
+    ASSERT_FALSE(missing.loaded());
+}
@@ -0,0 +1,106 @@
+#include "tracelog.hpp"
+#include <gtest/gtest.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_LOG_PATH "/tmp/debugrik_test_record.trace"
+
+TEST(TraceLogTest, RoundTrip) {
+    uint8_t push[] = {0x55};
+    uint8_t mov[] = {0x48, 0x89, 0xe5};
+    uint8_t store[] = {0x48, 0x89, 0x45, 0xf8};
+    uint8_t value[] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+    TraceLog log;
+    ASSERT_TRUE(log.open(TEST_LOG_PATH));
+    ASSERT_TRUE(log.step(0x401000, sizeof(push)));
+    ASSERT_TRUE(log.insn(push, sizeof(push)));
+    ASSERT_TRUE(log.step(0x401001, sizeof(mov)));
+    ASSERT_TRUE(log.insn(mov, sizeof(mov)));
+
+    struct user_regs_struct regs;
+    memset(&regs, 0, sizeof(regs));
+    regs.rbp = 0x7ffc0000;
+    ASSERT_TRUE(log.regs(regs));
+    ASSERT_TRUE(log.step(0x401004, sizeof(store)));
+    ASSERT_TRUE(log.insn(store, sizeof(store)));
+    ASSERT_TRUE(log.mem(0x7ffbfff8, value, sizeof(value)));
+    // A jump back
+    ASSERT_TRUE(log.step(0x401000, sizeof(push)));
+    ASSERT_TRUE(log.close());
+
+    std::deque<trace_step> steps;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> code;
+    uint64_t total;
+    ASSERT_TRUE(TraceLog::read_tail(TEST_LOG_PATH, 10, steps, code, total));
+    unlink(TEST_LOG_PATH);
+
+    ASSERT_EQ(total, 4);
+    ASSERT_EQ(steps.size(), 4);
+    ASSERT_EQ(steps[0].rip, 0x401000);
+    ASSERT_EQ(steps[1].rip, 0x401001);
+    ASSERT_EQ(steps[2].rip, 0x401004);
+    ASSERT_EQ(steps[3].rip, 0x401000);
+    ASSERT_EQ(code[0x401004], std::vector<uint8_t>(store, store + 4));
+
+    ASSERT_EQ(steps[1].regs.size(), 1);
+    ASSERT_STREQ(trace_reg_name(steps[1].regs[0].first), "rbp");
+    ASSERT_EQ(steps[1].regs[0].second, 0x7ffc0000);
+
+    ASSERT_EQ(steps[2].mem.size(), 1);
+    ASSERT_EQ(steps[2].mem[0].addr, 0x7ffbfff8);
+    ASSERT_EQ(steps[2].mem[0].data, std::vector<uint8_t>(value, value + 8));
+}
+
+TEST(TraceLogTest, SequentialStepsTakeOneByte) {
+    uint8_t nop[] = {0x90};
+    TraceLog log;
+    ASSERT_TRUE(log.open(TEST_LOG_PATH));
+    ASSERT_TRUE(log.step(0x401000, 1));
+    ASSERT_TRUE(log.insn(nop, 1));
+
+    size_t before = log.size();
+    for (int i = 1; i <= 1000; i++) {
+        ASSERT_TRUE(log.step(0x401000 + i, 1));
+        ASSERT_TRUE(log.insn(nop, 1));
+    }
+    // One byte for the step and two for the instruction bytes
+    ASSERT_EQ(log.size() - before, 1000 * 3);
+    ASSERT_TRUE(log.close());
+    unlink(TEST_LOG_PATH);
+}
+
+TEST(TraceLogTest, TailKeepsLastSteps) {
+    uint8_t nop[] = {0x90};
+    TraceLog log;
+    ASSERT_TRUE(log.open(TEST_LOG_PATH));
+    ASSERT_TRUE(log.step(0x1000, 1));
+    ASSERT_TRUE(log.insn(nop, 1));
+    // A loop over a single instruction, more than the initial mapping
+    for (int i = 0; i < (TRACELOG_GROW + 10); i++) {
+        ASSERT_TRUE(log.step(0x1000, 1));
+    }
+    ASSERT_TRUE(log.close());
+
+    std::deque<trace_step> steps;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> code;
+    uint64_t total;
+    ASSERT_TRUE(TraceLog::read_tail(TEST_LOG_PATH, 3, steps, code, total));
+    unlink(TEST_LOG_PATH);
+
+    ASSERT_EQ(total, TRACELOG_GROW + 11);
+    ASSERT_EQ(steps.size(), 3);
+    ASSERT_EQ(steps.back().rip, 0x1000);
+}
+
+TEST(TraceLogTest, BadFilesFail) {
+    std::deque<trace_step> steps;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> code;
+    uint64_t total;
+    TraceLog log;
+
+    ASSERT_FALSE(log.open("/k/a/c/record.trace"));
+    ASSERT_FALSE(
+        TraceLog::read_tail("/k/a/c/record.trace", 1, steps, code, total));
+    ASSERT_FALSE(TraceLog::read_tail("/proc/self/exe", 1, steps, code, total));
+}
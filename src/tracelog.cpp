@@ -0,0 +1,231 @@
+#include "tracelog.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// In the order of the fields of user_regs_struct
+static const char *reg_names[] = {
+    "r15", "r14", "r13", "r12", "rbp", "rbx", "r11", "r10", "r9",
+    "r8", "rax", "rcx", "rdx", "rsi", "rdi", "orig_rax", "rip", "cs",
+    "efl", "rsp", "ss", "fs_base", "gs_base", "ds", "es", "fs", "gs"};
+
+const char *trace_reg_name(unsigned idx) {
+    return idx < sizeof(reg_names) / sizeof(*reg_names) ? reg_names[idx] : "?";
+}
+
+TraceLog::TraceLog()
+    : fd(-1), buf(nullptr), used(0), capacity(0), next_rip(0), last_regs() {}
+
+TraceLog::~TraceLog() { close(); }
+
+bool TraceLog::open(const char *path) {
+    close();
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    used = 0;
+    next_rip = 0;
+    memset(last_regs, 0, sizeof(last_regs));
+    if (!grow(TRACELOG_MAGIC_SIZE)) {
+        return false;
+    }
+    memcpy(buf, TRACELOG_MAGIC, TRACELOG_MAGIC_SIZE);
+    used = TRACELOG_MAGIC_SIZE;
+    return true;
+}
+
+bool TraceLog::grow(size_t bytes) {
+    size_t new_capacity = capacity + TRACELOG_GROW;
+    while (used + bytes > new_capacity) {
+        new_capacity += TRACELOG_GROW;
+    }
+    if (ftruncate(fd, new_capacity) < 0) {
+        return false;
+    }
+
+    void *mem = buf == nullptr ? mmap(nullptr, new_capacity,
+                                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                               : mremap(buf, capacity, new_capacity,
+                                        MREMAP_MAYMOVE);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+    buf = (uint8_t *)mem;
+    capacity = new_capacity;
+    return true;
+}
+
+bool TraceLog::insn(const uint8_t *code, uint8_t len) {
+    if (!reserve(sizeof(uint64_t) + len)) {
+        return false;
+    }
+    put_varint(((uint64_t)len << TRACELOG_TAG_BITS) | TRACELOG_INSN);
+    memcpy(buf + used, code, len);
+    used += len;
+    return true;
+}
+
+bool TraceLog::regs(const struct user_regs_struct &regs) {
+    auto *values = (const uint64_t *)&regs;
+    uint64_t changed = 0;
+    for (size_t i = 0; i < TRACELOG_NREGS; i++) {
+        if (values[i] != last_regs[i]) {
+            changed |= 1ull << i;
+        }
+    }
+    if (changed == 0) {
+        return true;
+    }
+
+    if (!reserve((TRACELOG_NREGS + 1) * (sizeof(uint64_t) + 2))) {
+        return false;
+    }
+    put_varint((changed << TRACELOG_TAG_BITS) | TRACELOG_REGS);
+    for (size_t i = 0; i < TRACELOG_NREGS; i++) {
+        if (changed & (1ull << i)) {
+            put_varint(zigzag(values[i] - last_regs[i]));
+            last_regs[i] = values[i];
+        }
+    }
+    return true;
+}
+
+bool TraceLog::mem(uint64_t addr, const uint8_t *data, uint8_t size) {
+    if (!reserve(2 * (sizeof(uint64_t) + 2) + size)) {
+        return false;
+    }
+    put_varint(((uint64_t)size << TRACELOG_TAG_BITS) | TRACELOG_MEM);
+    put_varint(addr);
+    memcpy(buf + used, data, size);
+    used += size;
+    return true;
+}
+
+bool TraceLog::close() {
+    if (fd < 0) {
+        return true;
+    }
+
+    bool ok = buf != nullptr;
+    if (buf != nullptr) {
+        munmap(buf, capacity);
+    }
+    ok = ftruncate(fd, used) == 0 && ok;
+    ok = ::close(fd) == 0 && ok;
+
+    fd = -1;
+    buf = nullptr;
+    capacity = 0;
+    return ok;
+}
+
+/**
+ * @brief Reads an unsigned LEB128 value, returns false at the end of data.
+ */
+static bool get_varint(const uint8_t *&pos, const uint8_t *end,
+                       uint64_t &value) {
+    value = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7) {
+        uint8_t byte = *pos++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t unzigzag(uint64_t value) { return (value >> 1) ^ -(value & 1); }
+
+bool TraceLog::read_tail(
+    const char *path, size_t count, std::deque<trace_step> &steps,
+    std::unordered_map<uint64_t, std::vector<uint8_t>> &code,
+    uint64_t &total) {
+    int log_fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (log_fd < 0 || fstat(log_fd, &st) < 0 ||
+        (size_t)st.st_size < TRACELOG_MAGIC_SIZE) {
+        if (log_fd >= 0)
+            ::close(log_fd);
+        return false;
+    }
+    void *mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, log_fd, 0);
+    ::close(log_fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    const uint8_t *pos = (const uint8_t *)mem;
+    const uint8_t *end = pos + st.st_size;
+    bool ok = memcmp(pos, TRACELOG_MAGIC, TRACELOG_MAGIC_SIZE) == 0;
+    pos += TRACELOG_MAGIC_SIZE;
+
+    uint64_t regs[TRACELOG_NREGS] = {};
+    uint64_t rip = 0;
+    total = 0;
+    steps.clear();
+    code.clear();
+
+    uint64_t header;
+    while (ok && pos < end && (ok = get_varint(pos, end, header))) {
+        uint64_t payload = header >> TRACELOG_TAG_BITS;
+        switch (header & ((1 << TRACELOG_TAG_BITS) - 1)) {
+        case TRACELOG_STEP: {
+            auto it = code.find(rip);
+            uint64_t next = total == 0 || it == code.end()
+                                ? 0
+                                : rip + it->second.size();
+            rip = next + unzigzag(payload);
+            total++;
+            if (count == 0) {
+                break;
+            }
+            if (steps.size() == count) {
+                steps.pop_front();
+            }
+            steps.push_back({rip, {}, {}});
+            break;
+        }
+        case TRACELOG_INSN:
+            ok = (uint64_t)(end - pos) >= payload;
+            if (ok) {
+                code[rip].assign(pos, pos + payload);
+                pos += payload;
+            }
+            break;
+        case TRACELOG_REGS:
+            for (size_t i = 0; ok && i < TRACELOG_NREGS; i++) {
+                uint64_t delta;
+                if (!(payload & (1ull << i))) {
+                    continue;
+                }
+                ok = get_varint(pos, end, delta);
+                regs[i] += unzigzag(delta);
+                if (!steps.empty()) {
+                    steps.back().regs.push_back({(uint8_t)i, regs[i]});
+                }
+            }
+            break;
+        case TRACELOG_MEM: {
+            uint64_t addr;
+            ok = get_varint(pos, end, addr) && (uint64_t)(end - pos) >= payload;
+            if (ok) {
+                if (!steps.empty()) {
+                    steps.back().mem.push_back(
+                        {addr, std::vector<uint8_t>(pos, pos + payload)});
+                }
+                pos += payload;
+            }
+            break;
+        }
+        }
+    }
+
+    munmap(mem, st.st_size);
+    return ok;
+}
@@ -0,0 +1,215 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <sys/user.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define TRACELOG_DEFAULT_OUTPUT "record.trace"
+#define TRACELOG_MAGIC "DRIKTRC1"
+#define TRACELOG_MAGIC_SIZE 8
+#define TRACELOG_GROW (1 << 20)
+#define TRACELOG_NREGS (sizeof(struct user_regs_struct) / sizeof(uint64_t))
+
+// Every record starts with a varint, its low bits are the record type
+#define TRACELOG_TAG_BITS 2
+#define TRACELOG_STEP 0
+#define TRACELOG_INSN 1
+#define TRACELOG_REGS 2
+#define TRACELOG_MEM 3
+
+/**
+ * @brief A memory write done by a recorded instruction.
+ */
+struct trace_mem {
+    /**
+     * @brief The written address.
+     */
+    uint64_t addr;
+    /**
+     * @brief The memory contents after the write.
+     */
+    std::vector<uint8_t> data;
+};
+
+/**
+ * @brief A recorded instruction as read back from the log.
+ */
+struct trace_step {
+    /**
+     * @brief The address of the instruction.
+     */
+    uint64_t rip;
+    /**
+     * @brief Registers changed by the instruction, as indexes into
+     * `user_regs_struct` and new values.
+     */
+    std::vector<std::pair<uint8_t, uint64_t>> regs;
+    /**
+     * @brief Memory written by the instruction.
+     */
+    std::vector<trace_mem> mem;
+};
+
+/**
+ * @brief Returns the name of the register with the given index into
+ * `user_regs_struct`.
+ */
+const char *trace_reg_name(unsigned idx);
+
+/**
+ * @brief The TraceLog class writes an instruction trace into a
+ * memory-mapped file.
+ *
+ * Addresses are stored as zigzag varints of the difference from the
+ * fall-through address, so a sequential instruction takes a single byte.
+ * The bytes of each instruction are stored once, the first time it is
+ * executed, which makes the log readable without the target.
+ */
+class TraceLog {
+  public:
+    TraceLog();
+
+    ~TraceLog();
+
+    /**
+     * @brief Creates the log file.
+     *
+     * @param path The output file.
+     * @return false if the file can not be created.
+     */
+    bool open(const char *path);
+
+    /**
+     * @brief Records an executed instruction.
+     *
+     * @param rip The address of the instruction.
+     * @param len The length of the instruction.
+     * @return false if the log can not grow.
+     */
+    bool step(uint64_t rip, uint8_t len) {
+        if (!reserve(sizeof(uint64_t) + 2)) {
+            return false;
+        }
+        uint64_t delta = rip - next_rip;
+        put_varint((zigzag(delta) << TRACELOG_TAG_BITS) | TRACELOG_STEP);
+        next_rip = rip + len;
+        return true;
+    }
+
+    /**
+     * @brief Records the bytes of the last stepped instruction.
+     *
+     * @param code The instruction bytes.
+     * @param len The length of the instruction.
+     * @return false if the log can not grow.
+     */
+    bool insn(const uint8_t *code, uint8_t len);
+
+    /**
+     * @brief Records the registers that changed since the previous call.
+     *
+     * @param regs The current registers.
+     * @return false if the log can not grow.
+     */
+    bool regs(const struct user_regs_struct &regs);
+
+    /**
+     * @brief Records a memory write of the last stepped instruction.
+     *
+     * @param addr The written address.
+     * @param data The memory contents after the write.
+     * @param size The size of the write.
+     * @return false if the log can not grow.
+     */
+    bool mem(uint64_t addr, const uint8_t *data, uint8_t size);
+
+    /**
+     * @brief Returns the number of bytes written so far.
+     */
+    size_t size() { return used; }
+
+    /**
+     * @brief Truncates the file to the written size and closes it.
+     *
+     * @return false if the file can not be written.
+     */
+    bool close();
+
+    /**
+     * @brief Reads the last instructions of a log.
+     *
+     * @param path The log file.
+     * @param count The number of instructions to keep.
+     * @param steps Filled with the last instructions, oldest first.
+     * @param code Filled with the bytes of every recorded instruction.
+     * @param total Filled with the number of instructions in the log.
+     * @return false if the file is not a valid log.
+     */
+    static bool
+    read_tail(const char *path, size_t count, std::deque<trace_step> &steps,
+              std::unordered_map<uint64_t, std::vector<uint8_t>> &code,
+              uint64_t &total);
+
+  private:
+    /**
+     * @brief Makes room for a record of the given size, growing the file.
+     */
+    bool reserve(size_t bytes) {
+        return used + bytes <= capacity || grow(bytes);
+    }
+
+    /**
+     * @brief Extends the file and remaps it.
+     */
+    bool grow(size_t bytes);
+
+    /**
+     * @brief Appends an unsigned LEB128 value.
+     */
+    void put_varint(uint64_t value) {
+        while (value >= 0x80) {
+            buf[used++] = (uint8_t)value | 0x80;
+            value >>= 7;
+        }
+        buf[used++] = (uint8_t)value;
+    }
+
+    /**
+     * @brief Maps signed differences to small unsigned values.
+     */
+    static uint64_t zigzag(uint64_t value) {
+        return (value << 1) ^ (uint64_t)((int64_t)value >> 63);
+    }
+
+    /**
+     * @brief The log file descriptor.
+     */
+    int fd;
+    /**
+     * @brief The mapped file.
+     */
+    uint8_t *buf;
+    /**
+     * @brief The number of written bytes.
+     */
+    size_t used;
+    /**
+     * @brief The size of the mapping.
+     */
+    size_t capacity;
+    /**
+     * @brief The fall-through address of the last instruction.
+     */
+    uint64_t next_rip;
+    /**
+     * @brief The registers of the last `regs` record.
+     */
+    uint64_t last_regs[TRACELOG_NREGS];
+};
+
+#endif